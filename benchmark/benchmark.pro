@@ -0,0 +1,27 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    src/loopbackbenchmark.cpp
+
+unix{
+LIBS += -L$$PWD/../../build-rtplivelib-Desktop-Release/ -lrtplive \
+        -L$$PWD/../SDK/UNIX/lib/ -lavutil \
+        -lpthread
+
+INCLUDEPATH += $$PWD/../SDK/UNIX/include
+DEPENDPATH += $$PWD/../SDK/UNIX/include
+}
+
+win32{
+LIBS += -L$$PWD/../../build-rtplivelib-Desktop_Qt_5_14_2_MinGW_64_bit-Release/release/ -lrtplive \
+        -L$$PWD/../SDK/win64/bin/ -lavutil-56
+
+INCLUDEPATH += $$PWD/../SDK/win64/include
+DEPENDPATH += $$PWD/../SDK/win64/include
+}
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
@@ -0,0 +1,422 @@
+
+#include "liveengine.h"
+#include "core/globalcallback.h"
+#include "core/abstractqueue.h"
+#include "core/frameclock.h"
+#include "codec/videoencoder.h"
+extern "C"{
+#include "libavutil/frame.h"
+}
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 端到端回环基准测试
+ * 在127.0.0.1上运行一个发送引擎和一个接收引擎，使用合成的视频源，
+ * 帧经过真实的VideoEncoder、FEC、RTPSendThread、RTPRecvThread、FECDecoder和VideoDecoder
+ * 每一帧的左上角用亮暗块编码帧序号，解码后读出来计算端到端(glass-to-glass)延迟
+ * 对每个分辨率和编码器输出延迟分位数、持续帧率、码率和各个模块的CPU占用
+ *
+ * 用法:
+ * loopbackbenchmark [--resolution 640x360,1280x720] [--codec h264,hevc] [--fps 30]
+ *                   [--duration 10] [--warmup 2] [--port 31000]
+ *                   [--loss 0.01] [--burst 0.01,0.25] [--delay 20] [--jitter 5]
+ *                   [--bandwidth 4000000] [--seed 1]
+ */
+
+using namespace rtplivelib;
+using namespace std::chrono;
+
+using TimePoint = core::Clock::TimePoint;
+
+//帧序号标记:两行，每行16个块，24位序号和8位校验
+static constexpr int MARKER_COLUMNS = 16;
+static constexpr int MARKER_BITS = 32;
+static constexpr uint8_t MARKER_HIGH = 235;
+static constexpr uint8_t MARKER_LOW = 16;
+
+struct Options {
+	std::vector<std::pair<int,int>>				resolutions{{640,360},{1280,720}};
+	std::vector<codec::Encoder::EncoderType>	codecs{codec::Encoder::H264,codec::Encoder::HEVC};
+	int											fps{30};
+	int											duration{10};
+	int											warmup{2};
+	uint16_t									port{31000};
+	bool										impaired{false};
+	rtp_network::RTPImpairmentParams			impairment;
+};
+
+struct Result {
+	uint64_t				sent{0};
+	uint64_t				received{0};
+	double					fps{0};
+	double					kbps{0};
+	std::vector<double>		latency;
+	PipelineCPUTime			cpu;
+	double					seconds{0};
+};
+
+/**
+ * 发送端回调，统计上传的字节数
+ */
+class SenderCallBack : public core::GlobalCallBack
+{
+public:
+	virtual void on_upload_bandwidth(uint64_t,uint64_t total) override{
+		upload = total;
+	}
+	std::atomic<uint64_t>	upload{0};
+};
+
+/**
+ * 接收端回调，记录发送者的名字，在主线程设置输出队列
+ */
+class ReceiverCallBack : public core::GlobalCallBack
+{
+public:
+	virtual void on_new_user_join(const std::string& name) override{
+		std::lock_guard<std::mutex> lk(mutex);
+		joined.push_back(name);
+	}
+	std::mutex					mutex;
+	std::vector<std::string>	joined;
+};
+
+static uint32_t marker_checksum(uint32_t seq){
+	return (seq ^ (seq >> 8) ^ (seq >> 16) ^ 0x5a) & 0xff;
+}
+
+/**
+ * 在亮度平面左上角写入帧序号
+ */
+static void write_marker(uint8_t * y,int linesize,int width,uint32_t seq){
+	auto block = width / MARKER_COLUMNS;
+	uint32_t bits = ((seq & 0xffffff) << 8) | marker_checksum(seq & 0xffffff);
+	for(int n = 0; n < MARKER_BITS; ++n){
+		auto value = (bits >> (MARKER_BITS - 1 - n)) & 1 ? MARKER_HIGH : MARKER_LOW;
+		auto x0 = (n % MARKER_COLUMNS) * block;
+		auto y0 = (n / MARKER_COLUMNS) * block;
+		for(int row = y0; row < y0 + block; ++row)
+			memset(y + row * linesize + x0,value,block);
+	}
+}
+
+/**
+ * 读出帧序号，只采样每个块的中心，避免块边缘的编码失真
+ * @return
+ * 校验失败返回false
+ */
+static bool read_marker(const uint8_t * y,int linesize,int width,uint32_t & seq){
+	auto block = width / MARKER_COLUMNS;
+	uint32_t bits = 0;
+	for(int n = 0; n < MARKER_BITS; ++n){
+		auto x0 = (n % MARKER_COLUMNS) * block + block / 4;
+		auto y0 = (n / MARKER_COLUMNS) * block + block / 4;
+		int sum = 0,count = 0;
+		for(int row = y0; row < y0 + block / 2; ++row){
+			for(int col = x0; col < x0 + block / 2; ++col){
+				sum += y[row * linesize + col];
+				++count;
+			}
+		}
+		bits = (bits << 1) | (sum / count > (MARKER_HIGH + MARKER_LOW) / 2 ? 1 : 0);
+	}
+	seq = bits >> 8;
+	return (bits & 0xff) == marker_checksum(seq);
+}
+
+/**
+ * 生成一帧YUV420P图像，纹理随着帧序号移动，让编码器有真实的运动估计和残差
+ */
+static core::FramePacket::SharedPacket make_frame(int width,int height,int fps,
+												  uint32_t seq,int64_t pts){
+	auto frame = av_frame_alloc();
+	if(frame == nullptr)
+		return nullptr;
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = width;
+	frame->height = height;
+	if(av_frame_get_buffer(frame,32) < 0){
+		av_frame_free(&frame);
+		return nullptr;
+	}
+	for(int row = 0; row < height; ++row){
+		auto line = frame->data[0] + row * frame->linesize[0];
+		for(int col = 0; col < width; ++col)
+			line[col] = static_cast<uint8_t>(((col + seq * 2) ^ (row + seq)) + (col * row >> 6));
+	}
+	for(int row = 0; row < height / 2; ++row){
+		memset(frame->data[1] + row * frame->linesize[1],static_cast<uint8_t>(96 + row + seq),width / 2);
+		memset(frame->data[2] + row * frame->linesize[2],static_cast<uint8_t>(160 - row + seq),width / 2);
+	}
+	write_marker(frame->data[0],frame->linesize[0],width,seq);
+
+	auto packet = core::FramePacket::Make_Shared();
+	if(packet == nullptr){
+		av_frame_free(&frame);
+		return nullptr;
+	}
+	packet->data->set_frame_no_lock(frame);
+	packet->format.width = width;
+	packet->format.height = height;
+	packet->format.frame_rate = fps;
+	packet->format.pixel_format = AV_PIX_FMT_YUV420P;
+	packet->format.bits = 12;
+	packet->pts = pts;
+	packet->dts = pts;
+	return packet;
+}
+
+static double percentile(std::vector<double> & values,double p){
+	if(values.empty())
+		return 0;
+	std::sort(values.begin(),values.end());
+	auto index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+	return values[std::min(index,values.size() - 1)];
+}
+
+static const char * codec_name(codec::Encoder::EncoderType type){
+	return type == codec::Encoder::HEVC ? "hevc" : "h264";
+}
+
+static Result run(const Options & options,int width,int height,
+				  codec::Encoder::EncoderType type,uint16_t port){
+	auto clock = core::Clock::Get_Clock();
+	Result result;
+	//队列需要比引擎活得更久，引擎析构的时候还可能访问
+	core::AbstractQueue<core::FramePacket> source;
+	core::AbstractQueue<core::FramePacket> sink;
+	source.set_max_size(60);
+	sink.set_max_size(600);
+	LiveEngine receiver(true);
+	LiveEngine sender(true);
+	SenderCallBack sender_cb;
+	ReceiverCallBack receiver_cb;
+	receiver.register_call_back_object(&receiver_cb);
+	sender.register_call_back_object(&sender_cb);
+	receiver.set_log_level(LogLevel::WARNING_LEVEL);
+	sender.set_log_level(LogLevel::WARNING_LEVEL);
+
+	//互相把对方的本地端口作为服务器端口
+	uint8_t ip[4]{127,0,0,1};
+	receiver.set_server_address(ip,port + 4,port);
+	sender.set_server_address(ip,port,port + 4);
+	if(options.impaired)
+		sender.set_network_impairment(&options.impairment);
+	receiver.set_decoder_hwd_type(codec::HardwareDevice::None);
+	auto encoder = static_cast<codec::VideoEncoder*>(sender.get_video_encoder());
+	encoder->set_hardware_acceleration(false);
+	encoder->set_encoder_type(type);
+
+	receiver.set_local_name("receiver");
+	sender.set_local_name("sender");
+	receiver.join_room("benchmark");
+	sender.join_room("benchmark");
+	sender.set_video_source(&source);
+	sender.enabled_push(true);
+
+	auto total_frames = static_cast<uint32_t>(options.fps * (options.warmup + options.duration));
+	auto warmup_frames = static_cast<uint32_t>(options.fps * options.warmup);
+	std::vector<TimePoint> send_time(total_frames);
+	std::vector<bool> received(total_frames,false);
+	std::mutex send_mutex;
+	std::atomic<uint32_t> sent{0};
+
+	//按照帧率输出合成的帧
+	std::thread producer([&]{
+		core::FrameClock frame_clock(options.fps);
+		frame_clock.start();
+		while(frame_clock.get_frame_index() < total_frames){
+			auto seq = static_cast<uint32_t>(frame_clock.get_frame_index());
+			auto packet = make_frame(width,height,options.fps,seq,frame_clock.get_pts());
+			if(packet != nullptr){
+				{
+					std::lock_guard<std::mutex> lk(send_mutex);
+					send_time[seq] = clock->now();
+				}
+				sent = seq + 1;
+				source.push_one(packet);
+			}
+			frame_clock.wait_next_frame();
+		}
+	});
+
+	bool sink_set{false};
+	bool measuring{false};
+	PipelineCPUTime sender_cpu,receiver_cpu;
+	uint64_t upload{0};
+	TimePoint start;
+	auto end = clock->now() + seconds(options.warmup + options.duration + 1);
+	while(clock->now() < end){
+		if(!sink_set){
+			std::lock_guard<std::mutex> lk(receiver_cb.mutex);
+			if(!receiver_cb.joined.empty()){
+				receiver.set_remote_frame_sink(receiver_cb.joined.front(),&sink,nullptr);
+				sink_set = true;
+			}
+		}
+		//预热结束之后开始统计
+		if(!measuring && sent > warmup_frames){
+			measuring = true;
+			start = clock->now();
+			sender_cpu = sender.get_pipeline_cpu_time();
+			receiver_cpu = receiver.get_pipeline_cpu_time();
+			upload = sender_cb.upload;
+		}
+		if(measuring && result.seconds == 0 && sent == total_frames){
+			auto now = clock->now();
+			result.seconds = duration_cast<microseconds>(now - start).count() / 1e6;
+			auto s = sender.get_pipeline_cpu_time();
+			auto r = receiver.get_pipeline_cpu_time();
+			result.cpu.encode = s.encode - sender_cpu.encode;
+			result.cpu.send = s.send - sender_cpu.send;
+			result.cpu.receive = r.receive - receiver_cpu.receive;
+			result.cpu.decode = r.decode - receiver_cpu.decode;
+			result.kbps = (sender_cb.upload - upload) * 8 / 1000.0 / result.seconds;
+		}
+		if(!sink.wait_for_resource_push(10))
+			continue;
+		while(sink.has_data()){
+			auto packet = sink.get_next();
+			auto now = clock->now();
+			if(packet == nullptr || packet->format.width != width || packet->format.height != height)
+				continue;
+			uint32_t seq;
+			if(!read_marker((*packet->data)[0],packet->data->linesize[0],width,seq)
+					|| seq >= sent || received[seq])
+				continue;
+			received[seq] = true;
+			if(seq < warmup_frames)
+				continue;
+			std::lock_guard<std::mutex> lk(send_mutex);
+			result.latency.push_back(duration_cast<microseconds>(now - send_time[seq]).count() / 1000.0);
+		}
+	}
+	producer.join();
+	sender.set_video_source(nullptr);
+	sender.enabled_push(false);
+	sender.exit_room();
+	receiver.exit_room();
+
+	result.sent = total_frames - warmup_frames;
+	result.received = result.latency.size();
+	if(result.seconds > 0)
+		result.fps = result.received / result.seconds;
+	return result;
+}
+
+static void print_result(int width,int height,codec::Encoder::EncoderType type,Result & result){
+	auto cpu = [&result](int64_t ns){
+		return result.seconds > 0 ? ns / 1e7 / result.seconds : 0.0;
+	};
+	auto p50 = percentile(result.latency,0.5);
+	auto p90 = percentile(result.latency,0.9);
+	auto p99 = percentile(result.latency,0.99);
+	auto max = result.latency.empty() ? 0 : *std::max_element(result.latency.begin(),result.latency.end());
+	printf("%5dx%-5d %-5s %7llu %6llu %7.2f %9.1f %8.1f %8.1f %8.1f %8.1f %6.1f %6.1f %6.1f %6.1f\n",
+		   width,height,codec_name(type),
+		   static_cast<unsigned long long>(result.sent),
+		   static_cast<unsigned long long>(result.sent - std::min(result.sent,result.received)),
+		   result.fps,result.kbps,p50,p90,p99,max,
+		   cpu(result.cpu.encode),cpu(result.cpu.send),
+		   cpu(result.cpu.receive),cpu(result.cpu.decode));
+	fflush(stdout);
+}
+
+static bool parse_options(int argc,char **argv,Options & options){
+	for(int n = 1; n < argc; ++n){
+		std::string key = argv[n];
+		if(n + 1 >= argc){
+			fprintf(stderr,"missing value for %s\n",key.c_str());
+			return false;
+		}
+		std::string value = argv[++n];
+		auto & imp = options.impairment;
+		if(key == "--resolution"){
+			options.resolutions.clear();
+			size_t pos = 0;
+			while(pos < value.size()){
+				int w,h;
+				if(sscanf(value.c_str() + pos,"%dx%d",&w,&h) != 2 || w < MARKER_COLUMNS * 2 || h <= 0)
+					return false;
+				options.resolutions.emplace_back(w & ~1,h & ~1);
+				pos = value.find(',',pos);
+				pos = pos == std::string::npos ? value.size() : pos + 1;
+			}
+		} else if(key == "--codec"){
+			options.codecs.clear();
+			if(value.find("h264") != std::string::npos)
+				options.codecs.push_back(codec::Encoder::H264);
+			if(value.find("hevc") != std::string::npos)
+				options.codecs.push_back(codec::Encoder::HEVC);
+		} else if(key == "--fps"){
+			options.fps = std::max(1,atoi(value.c_str()));
+		} else if(key == "--duration"){
+			options.duration = std::max(1,atoi(value.c_str()));
+		} else if(key == "--warmup"){
+			options.warmup = std::max(0,atoi(value.c_str()));
+		} else if(key == "--port"){
+			options.port = static_cast<uint16_t>(atoi(value.c_str()));
+		} else if(key == "--loss"){
+			imp.loss_rate = atof(value.c_str());
+			options.impaired = true;
+		} else if(key == "--burst"){
+			if(sscanf(value.c_str(),"%lf,%lf",&imp.burst_enter,&imp.burst_exit) != 2)
+				return false;
+			options.impaired = true;
+		} else if(key == "--delay"){
+			imp.delay_ms = static_cast<uint32_t>(atoi(value.c_str()));
+			options.impaired = true;
+		} else if(key == "--jitter"){
+			imp.jitter_ms = static_cast<uint32_t>(atoi(value.c_str()));
+			options.impaired = true;
+		} else if(key == "--bandwidth"){
+			imp.bandwidth = strtoull(value.c_str(),nullptr,10);
+			imp.queue_bytes = imp.bandwidth / 8 / 5;
+			options.impaired = true;
+		} else if(key == "--seed"){
+			imp.seed = static_cast<uint32_t>(strtoul(value.c_str(),nullptr,10));
+		} else {
+			fprintf(stderr,"unknown option %s\n",key.c_str());
+			return false;
+		}
+	}
+	return !options.resolutions.empty() && !options.codecs.empty();
+}
+
+int main(int argc,char **argv)
+{
+	Options options;
+	if(!parse_options(argc,argv,options)){
+		fprintf(stderr,"usage: %s [--resolution WxH,...] [--codec h264,hevc] [--fps N] "
+					   "[--duration S] [--warmup S] [--port P] [--loss R] [--burst P,R] "
+					   "[--delay MS] [--jitter MS] [--bandwidth BPS] [--seed N]\n",argv[0]);
+		return 1;
+	}
+	printf("%-11s %-5s %7s %6s %7s %9s %8s %8s %8s %8s %6s %6s %6s %6s\n",
+		   "resolution","codec","frames","lost","fps","kbps",
+		   "p50(ms)","p90(ms)","p99(ms)","max(ms)","enc%","send%","recv%","dec%");
+	//每一轮换一组端口，避免收到上一轮残留的包
+	auto port = options.port;
+	int ret = 0;
+	for(auto & resolution : options.resolutions){
+		for(auto type : options.codecs){
+			auto result = run(options,resolution.first,resolution.second,type,port);
+			print_result(resolution.first,resolution.second,type,result);
+			//一帧都没有到达接收端的输出队列，延迟和帧率都是空的，不能当作有效的结果
+			if(result.received == 0){
+				fprintf(stderr,"%dx%d %s: no frame reached the remote frame sink\n",
+						resolution.first,resolution.second,codec_name(type));
+				ret = 2;
+			}
+			port = static_cast<uint16_t>(port + 8);
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,19 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += \
+    src/main.cpp
+
+unix{
+LIBS += -L$$PWD/../../build-rtplivelib-Desktop-Release/ -lrtplive \
+        -lpthread
+}
+
+win32{
+LIBS += -L$$PWD/../../build-rtplivelib-Desktop_Qt_5_14_2_MinGW_64_bit-Release/release/ -lrtplive
+}
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
@@ -0,0 +1,84 @@
+
+#include "rtp_network/rtprelay.h"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+/**
+ * 本地的选择性转发中继服务器
+ * 分别监听视频端口和音频端口(端口规则和config.h一样，音频是视频端口+2)，
+ * 同一个房间的用户互相转发rtp和rtcp包
+ * 客户端通过LiveEngine::set_server_address连接到该中继
+ *
+ * 用法:
+ * relay [--port 20000] [--interval 5]
+ * 多个中继使用不同的端口就可以在一台机器上运行多个，按照房间分配用户
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+static std::atomic<bool> running{true};
+
+static void on_signal(int){
+	running = false;
+}
+
+static void print_statistics(const char * name,RTPRelay & relay){
+	auto s = relay.get_statistics();
+	printf("%s: members:%llu rooms:%llu received:%llu forwarded:%llu ignored:%llu dropped:%llu replayed:%llu\n",
+		   name,
+		   static_cast<unsigned long long>(s.members),
+		   static_cast<unsigned long long>(s.rooms),
+		   static_cast<unsigned long long>(s.received),
+		   static_cast<unsigned long long>(s.forwarded),
+		   static_cast<unsigned long long>(s.ignored),
+		   static_cast<unsigned long long>(s.dropped),
+		   static_cast<unsigned long long>(s.replayed));
+	fflush(stdout);
+}
+
+int main(int argc,char **argv)
+{
+	uint16_t port = VIDEO_PORTBASE;
+	int interval = 5;
+	for(int n = 1; n + 1 < argc; n += 2){
+		std::string key = argv[n];
+		if(key == "--port")
+			port = static_cast<uint16_t>(atoi(argv[n + 1]));
+		else if(key == "--interval")
+			interval = atoi(argv[n + 1]);
+		else {
+			fprintf(stderr,"usage: %s [--port P] [--interval S]\n",argv[0]);
+			return 1;
+		}
+	}
+
+	RTPRelay video,audio;
+	if(!video.start(port) ||
+			!audio.start(static_cast<uint16_t>(port + AUDIO_PORTBASE - VIDEO_PORTBASE))){
+		fprintf(stderr,"listen on port %d failed\n",port);
+		return 1;
+	}
+	signal(SIGINT,on_signal);
+	signal(SIGTERM,on_signal);
+	printf("relay running on port %d(video) and %d(audio)\n",
+		   port,port + AUDIO_PORTBASE - VIDEO_PORTBASE);
+	fflush(stdout);
+
+	int elapsed = 0;
+	while(running){
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		if(interval <= 0 || ++elapsed < interval * 10)
+			continue;
+		elapsed = 0;
+		print_statistics("video",video);
+		print_statistics("audio",audio);
+	}
+	video.stop();
+	audio.stop();
+	return 0;
+}
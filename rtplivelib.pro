@@ -108,7 +108,22 @@ HEADERS += \
     src/core/error.h \
     src/codec/videodecoder.h \
     src/codec/videoencoder.h \
+    src/codec/simulcastencoder.h \
     src/rtp_network/rtpsession.h \
+    src/rtp_network/rtpbatchtransmitter.h \
+    src/rtp_network/rtppacer.h \
+    src/rtp_network/rtpcongestioncontroller.h \
+    src/rtp_network/rtppackethistory.h \
+    src/rtp_network/rtpnackgenerator.h \
+    src/rtp_network/rtpjitterbuffer.h \
+    src/rtp_network/rtpmediaclock.h \
+    src/rtp_network/rtpkeyframecache.h \
+    src/rtp_network/rtpkeyframerequester.h \
+    src/rtp_network/rtpmemorypool.h \
+    src/rtp_network/rtpnalpacketizer.h \
+    src/rtp_network/rtpnetworkemulator.h \
+    src/rtp_network/rtpimpairmenttransmitter.h \
+    src/rtp_network/rtprelay.h \
     src/liveengine.h \
     src/device_manager/devicemanager.h \
     src/rtp_network/rtpsendthread.h \
@@ -128,6 +143,8 @@ HEADERS += \
     src/core/stringformat.h \
     src/codec/audioencoder.h \
     src/core/globalcallback.h \
+    src/core/frameclock.h \
+    src/core/clock.h \
     src/audio_processing/resample.h \
     src/codec/audiodecoder.h \
     src/codec/encoder.h \
@@ -137,6 +154,7 @@ HEADERS += \
     src/rtp_network/fec/codec/wirehair.h \ 
     src/rtp_network/fec/fecdecoder.h \
     src/rtp_network/fec/fecencoder.h \
+    src/rtp_network/fec/fecheader.h \
     src/device_manager/gpudevice.h
 
 SOURCES += \
@@ -152,7 +170,22 @@ SOURCES += \
     src/core/logger.cpp \
     src/codec/videodecoder.cpp \
     src/codec/videoencoder.cpp \
+    src/codec/simulcastencoder.cpp \
     src/rtp_network/rtpsession.cpp \
+    src/rtp_network/rtpbatchtransmitter.cpp \
+    src/rtp_network/rtppacer.cpp \
+    src/rtp_network/rtpcongestioncontroller.cpp \
+    src/rtp_network/rtppackethistory.cpp \
+    src/rtp_network/rtpnackgenerator.cpp \
+    src/rtp_network/rtpjitterbuffer.cpp \
+    src/rtp_network/rtpmediaclock.cpp \
+    src/rtp_network/rtpkeyframecache.cpp \
+    src/rtp_network/rtpkeyframerequester.cpp \
+    src/rtp_network/rtpmemorypool.cpp \
+    src/rtp_network/rtpnalpacketizer.cpp \
+    src/rtp_network/rtpnetworkemulator.cpp \
+    src/rtp_network/rtpimpairmenttransmitter.cpp \
+    src/rtp_network/rtprelay.cpp \
     src/liveengine.cpp \
     src/device_manager/devicemanager.cpp \
     src/rtp_network/rtpsendthread.cpp \
@@ -169,6 +202,8 @@ SOURCES += \
     src/core/stringformat.cpp \
     src/codec/audioencoder.cpp \
     src/core/globalcallback.cpp \
+    src/core/frameclock.cpp \
+    src/core/clock.cpp \
     src/audio_processing/resample.cpp \
     src/codec/audiodecoder.cpp \
     src/codec/encoder.cpp \
@@ -177,5 +212,6 @@ SOURCES += \
     src/rtp_network/fec/codec/wirehair.cpp \ 
     src/rtp_network/fec/fecdecoder.cpp \
     src/rtp_network/fec/fecencoder.cpp \
+    src/rtp_network/fec/fecheader.cpp \
     src/rtp_network/fec/codec/fecabstractcodec.cpp \
     src/device_manager/gpudevice.cpp
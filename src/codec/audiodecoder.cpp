@@ -20,6 +20,8 @@ public:
 	PayloadType				cur_pt{PayloadType::RTP_PT_NONE};
 	core::Format			cur_fmt;
 	player::AbstractPlayer	*player{nullptr};
+	//解码帧的输出队列
+	core::AbstractQueue<core::FramePacket>	*sink{nullptr};
 	AVPacket				*pkt{nullptr};
 	AVFrame					*frame{nullptr};
 	AVFrame					*sw_frame{nullptr};
@@ -149,12 +151,45 @@ public:
 				return;
 			}
 			
+			output();
 			//			core::Logger::Print("size:{}",
 			//								__PRETTY_FUNCTION__,
 			//								LogLevel::INFO_LEVEL,sw_frame->format);
 		}
 	}
 	
+	/**
+	 * @brief output
+	 * 将解码帧推送到输出队列
+	 * 帧使用引用计数拷贝，不拷贝音频数据
+	 */
+	inline void output() noexcept {
+		if( sink == nullptr)
+			return;
+		
+		auto dst_frame = av_frame_clone(frame);
+		if(dst_frame == nullptr){
+			core::Logger::Print_APP_Info(core::Result::FramePacket_frame_alloc_failed,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+			return;
+		}
+		auto packet = core::FramePacket::Make_Shared();
+		if(packet == nullptr){
+			av_frame_free(&dst_frame);
+			return;
+		}
+		packet->data->set_frame_no_lock(dst_frame);
+		packet->format.sample_rate = dst_frame->sample_rate;
+		packet->format.channels = dst_frame->channels;
+		packet->format.bits = av_get_bytes_per_sample(static_cast<AVSampleFormat>(dst_frame->format)) * 8;
+		packet->format.pixel_format = dst_frame->format;
+		packet->payload_type = cur_pt;
+		packet->pts = frame->pts;
+		packet->dts = frame->pkt_dts;
+		sink->push_one(packet);
+	}
+	
 	/**
 	 * @brief parse
 	 * 解析数据
@@ -330,6 +365,11 @@ void AudioDecoder::set_player_object(player::AbstractPlayer *player) noexcept
 	d_ptr->player = player;
 }
 
+void AudioDecoder::set_frame_sink(core::AbstractQueue<core::FramePacket> *sink) noexcept
+{
+	d_ptr->sink = sink;
+}
+
 void AudioDecoder::on_thread_run() noexcept
 {
 	//等待资源到来
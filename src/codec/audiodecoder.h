@@ -33,6 +33,15 @@ public:
 	 * 临时接口，用于设置播放器
 	 */
 	void set_player_object(player::AbstractPlayer * player) noexcept;
+	
+	/**
+	 * @brief set_frame_sink
+	 * 设置解码帧的输出队列，用于无界面模式(不使用SDL播放)
+	 * 解码后的音频帧将会以FramePacket的形式推送到该队列
+	 * @param sink
+	 * 输出队列，传入nullptr则不输出
+	 */
+	void set_frame_sink(core::AbstractQueue<core::FramePacket> * sink) noexcept;
 protected:
 	/**
 	 * @brief on_thread_run
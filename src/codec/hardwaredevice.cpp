@@ -105,7 +105,9 @@ public:
 			frames_ctx->sw_format = AV_PIX_FMT_NV12;
 			ctx->gop_size = 250;
 			ctx->max_b_frames = 0;
-			ctx->bit_rate = 1024 * 1024;
+			//码率已经在编码器里面设置好了，没有设置才使用默认值
+			if(ctx->bit_rate <= 0)
+				ctx->bit_rate = 1024 * 1024;
 			break;
 		case AV_HWDEVICE_TYPE_VAAPI:
 			//?
@@ -135,7 +137,8 @@ public:
 			} else if(ctx->codec_id == AV_CODEC_ID_H264){
 				frames_ctx->initial_pool_size = 20;
 				ctx->gop_size = 10;
-				ctx->max_b_frames = 1;
+				//和软件编码一样不使用B帧
+				ctx->max_b_frames = 0;
 //				ctx->bit_rate = 12000;
 			}
 			break;
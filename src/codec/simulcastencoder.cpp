@@ -0,0 +1,264 @@
+#include "simulcastencoder.h"
+#include "../core/logger.h"
+#include "../image_processing/scale.h"
+extern "C"{
+#include "libavutil/frame.h"
+}
+
+namespace rtplivelib {
+
+namespace codec {
+
+//每一层编码器的输入队列长度，编码跟不上的时候丢弃旧的帧
+static constexpr uint32_t LAYER_QUEUE_SIZE = 10;
+
+constexpr uint8_t SimulcastEncoder::MAX_LAYERS;
+constexpr int SimulcastEncoder::MIN_LAYER_SIZE;
+
+class SimulcastEncoderPrivateData {
+public:
+	using Queue = SimulcastEncoder::Queue;
+	//第0层的编码器，不拥有所有权
+	VideoEncoder * const base;
+	//其他层的编码器，下标是层，第0个不使用
+	VideoEncoder * encoders[SimulcastEncoder::MAX_LAYERS]{nullptr};
+	//每一层编码器的输入队列
+	Queue queues[SimulcastEncoder::MAX_LAYERS];
+	//每一层的缩放，输入是上一层的图像，这样每一帧对每一层只缩放一次，而且越往下越快
+	image_processing::Scale scales[SimulcastEncoder::MAX_LAYERS];
+	Queue * input{nullptr};
+	uint8_t count{1};
+	uint64_t bitrate{0};
+	std::mutex mutex;
+
+	explicit SimulcastEncoderPrivateData(VideoEncoder * encoder):
+		base(encoder)
+	{
+		for(auto & queue:queues)
+			queue.set_max_size(LAYER_QUEUE_SIZE);
+		for(uint8_t n = 1; n < SimulcastEncoder::MAX_LAYERS; ++n)
+			encoders[n] = new VideoEncoder();
+	}
+
+	~SimulcastEncoderPrivateData(){
+		for(auto & encoder:encoders)
+			delete encoder;
+	}
+
+	inline VideoEncoder * get_encoder(uint8_t layer) noexcept{
+		return layer == 0 ? base : encoders[layer];
+	}
+
+	/**
+	 * @brief connect
+	 * 根据输入队列和层数重新设置各层编码器的输入
+	 * 只有一层的时候第0层的编码器直接读取输入队列
+	 */
+	void connect() noexcept{
+		auto multi = count > 1 && input != nullptr;
+		base->set_input_queue(multi ? &queues[0] : input);
+		for(uint8_t n = 1; n < SimulcastEncoder::MAX_LAYERS; ++n){
+			auto enabled = multi && n < count;
+			if(!enabled)
+				queues[n].clear();
+			encoders[n]->set_input_queue(enabled ? &queues[n] : nullptr);
+		}
+		update_bitrate();
+	}
+
+	/**
+	 * @brief update_bitrate
+	 * 按照层数把总码率分配给各层的编码器
+	 */
+	void update_bitrate() noexcept{
+		for(uint8_t n = 0; n < count; ++n)
+			get_encoder(n)->set_bitrate(SimulcastEncoder::Get_Layer_Bitrate(bitrate,n,count));
+	}
+
+	/**
+	 * @brief dispatch
+	 * 把一帧分发给各层，第0层直接使用原始的帧
+	 */
+	void dispatch(core::FramePacket::SharedPacket & packet) noexcept{
+		queues[0].push_one(packet);
+		auto src = packet;
+		for(uint8_t n = 1; n < count; ++n){
+			auto format = SimulcastEncoder::Get_Layer_Format(packet->format,n);
+			//更低的层分辨率更小，也不需要编码
+			if(format.width == 0)
+				break;
+			auto dst = scale(n,format,src);
+			if(dst == nullptr)
+				break;
+			queues[n].push_one(dst);
+			src = dst;
+		}
+	}
+
+	/**
+	 * @brief scale
+	 * 把上一层的图像缩放成这一层的分辨率
+	 */
+	core::FramePacket::SharedPacket scale(uint8_t layer,const core::Format & format,
+										  core::FramePacket::SharedPacket & src) noexcept{
+		auto frame = av_frame_alloc();
+		if(frame == nullptr){
+			core::Logger::Print_APP_Info(core::Result::FramePacket_frame_alloc_failed,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+			return nullptr;
+		}
+		frame->width = format.width;
+		frame->height = format.height;
+		frame->format = format.pixel_format;
+		if(av_frame_get_buffer(frame,0) < 0){
+			av_frame_free(&frame);
+			core::Logger::Print_APP_Info(core::Result::FramePacket_data_alloc_failed,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+			return nullptr;
+		}
+		auto & ctx = scales[layer];
+		ctx.set_default_input_format(src->format);
+		ctx.set_default_output_format(format);
+		auto ret = ctx.scale(&(*src->data)[0],src->data->linesize,frame->data,frame->linesize);
+		if(ret != core::Result::Success){
+			av_frame_free(&frame);
+			core::Logger::Print_APP_Info(ret,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+			return nullptr;
+		}
+		auto dst = core::FramePacket::Make_Shared();
+		if(dst == nullptr){
+			av_frame_free(&frame);
+			return nullptr;
+		}
+		//帧的所有权交给DataBuffer
+		dst->data->set_frame(frame);
+		dst->format = format;
+		dst->pts = src->pts;
+		dst->dts = src->dts;
+		dst->flag = src->flag;
+		return dst;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+SimulcastEncoder::SimulcastEncoder(VideoEncoder *base_encoder):
+	d_ptr(new SimulcastEncoderPrivateData(base_encoder))
+{
+
+}
+
+SimulcastEncoder::~SimulcastEncoder()
+{
+	exit_thread();
+	//第0层的编码器可能还在读取该类的队列
+	d_ptr->base->set_input_queue(nullptr);
+	delete d_ptr;
+}
+
+void SimulcastEncoder::set_input_queue(Queue *input_queue) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lk(d_ptr->mutex);
+		auto queue = d_ptr->input;
+		d_ptr->input = input_queue;
+		if(queue != nullptr)
+			queue->exit_wait_resource();
+		d_ptr->connect();
+	}
+	if(!get_thread_pause_condition())
+		start_thread();
+}
+
+bool SimulcastEncoder::set_layer_count(uint8_t count) noexcept
+{
+	if(count < 1 || count > MAX_LAYERS)
+		return false;
+	{
+		std::lock_guard<std::mutex> lk(d_ptr->mutex);
+		if(d_ptr->count == count)
+			return true;
+		d_ptr->count = count;
+		d_ptr->connect();
+	}
+	if(!get_thread_pause_condition())
+		start_thread();
+	return true;
+}
+
+uint8_t SimulcastEncoder::get_layer_count() noexcept
+{
+	return d_ptr->count;
+}
+
+VideoEncoder *SimulcastEncoder::get_layer_encoder(uint8_t layer) noexcept
+{
+	if(layer >= MAX_LAYERS)
+		return nullptr;
+	return d_ptr->get_encoder(layer);
+}
+
+void SimulcastEncoder::set_bitrate(uint64_t bitrate) noexcept
+{
+	std::lock_guard<std::mutex> lk(d_ptr->mutex);
+	d_ptr->bitrate = bitrate;
+	d_ptr->update_bitrate();
+}
+
+core::Format SimulcastEncoder::Get_Layer_Format(const core::Format &format, uint8_t layer) noexcept
+{
+	auto output = format;
+	if(layer == 0)
+		return output;
+	//YUV420的长宽需要是偶数
+	output.width = (format.width >> layer) & ~1;
+	output.height = (format.height >> layer) & ~1;
+	if(output.width < MIN_LAYER_SIZE || output.height < MIN_LAYER_SIZE)
+		output.width = output.height = 0;
+	return output;
+}
+
+uint64_t SimulcastEncoder::Get_Layer_Bitrate(uint64_t bitrate, uint8_t layer, uint8_t count) noexcept
+{
+	if(layer >= count)
+		return 0;
+	//最低的一层权重为1，往上每一层乘以3
+	uint64_t total{0},weight{0};
+	for(uint64_t n = 0,w = 1; n < count; ++n,w *= 3){
+		total += w;
+		if(n == static_cast<uint64_t>(count - 1 - layer))
+			weight = w;
+	}
+	return bitrate * weight / total;
+}
+
+void SimulcastEncoder::on_thread_run() noexcept
+{
+	auto input = d_ptr->input;
+	if(input == nullptr)
+		return;
+	input->wait_for_resource_push(16);
+	std::lock_guard<std::mutex> lk(d_ptr->mutex);
+	//等待期间可能修改了输入队列或者层数
+	if(d_ptr->input == nullptr || d_ptr->count <= 1)
+		return;
+	while(d_ptr->input->has_data()){
+		auto packet = d_ptr->input->get_next();
+		if(packet == nullptr || packet->data == nullptr)
+			continue;
+		d_ptr->dispatch(packet);
+	}
+}
+
+bool SimulcastEncoder::get_thread_pause_condition() noexcept
+{
+	return d_ptr->input == nullptr || d_ptr->count <= 1;
+}
+
+} // namespace codec
+
+} // namespace rtplivelib
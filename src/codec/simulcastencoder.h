@@ -0,0 +1,119 @@
+
+#pragma once
+
+#include "videoencoder.h"
+#include "../core/abstractthread.h"
+
+namespace rtplivelib {
+
+namespace codec {
+
+class SimulcastEncoderPrivateData;
+
+/**
+ * @brief The SimulcastEncoder class
+ * 联播(simulcast)编码
+ * 采集的每一帧只缩放一次得到多个分辨率(每一层长宽减半，下一层由上一层缩放)，
+ * 每一层由一个VideoEncoder在自己的线程里编码，各层并行
+ * 第0层(原始分辨率)使用外部传入的编码器，其他层的编码器由该类创建
+ * 只有一层的时候不开启联播，第0层的编码器直接读取输入队列，不经过该类的线程
+ */
+class RTPLIVELIBSHARED_EXPORT SimulcastEncoder : public core::AbstractThread
+{
+public:
+	using Queue = core::AbstractQueue<core::FramePacket>;
+public:
+	/**
+	 * @brief SimulcastEncoder
+	 * @param base_encoder
+	 * 第0层的编码器，该类不拥有它的所有权，需要在该类析构之后再释放
+	 */
+	explicit SimulcastEncoder(VideoEncoder * base_encoder);
+
+	/**
+	 * @brief ~SimulcastEncoder
+	 * 会断开第0层编码器和该类的联系
+	 */
+	virtual ~SimulcastEncoder() override;
+
+	/**
+	 * @brief set_input_queue
+	 * 设置未压缩的图像帧的输入队列，一般是视频处理工厂
+	 */
+	void set_input_queue(Queue * input_queue) noexcept;
+
+	/**
+	 * @brief set_layer_count
+	 * 设置层数，可以在编码过程中修改
+	 * @param count
+	 * [1,MAX_LAYERS]，1表示不开启联播
+	 * @return
+	 * 超出范围则返回false
+	 */
+	bool set_layer_count(uint8_t count) noexcept;
+
+	/**
+	 * @brief get_layer_count
+	 * 获取层数
+	 */
+	uint8_t get_layer_count() noexcept;
+
+	/**
+	 * @brief get_layer_encoder
+	 * 获取某一层的编码器，也就是该层的发送队列
+	 * @return
+	 * 超出范围则返回nullptr
+	 */
+	VideoEncoder * get_layer_encoder(uint8_t layer) noexcept;
+
+	/**
+	 * @brief set_bitrate
+	 * 设置所有层的总码率(bit/s)，按照固定比例分配给正在使用的层
+	 * @param bitrate
+	 * 0表示每一层根据分辨率自动选择
+	 * @see Get_Layer_Bitrate
+	 */
+	void set_bitrate(uint64_t bitrate) noexcept;
+
+	/**
+	 * @brief Get_Layer_Format
+	 * 获取某一层的图像格式，长宽是原始分辨率的1/2^layer(取偶数)
+	 * @return
+	 * 分辨率太小的层长宽为0，这一层不编码
+	 */
+	static core::Format Get_Layer_Format(const core::Format & format,uint8_t layer) noexcept;
+
+	/**
+	 * @brief Get_Layer_Bitrate
+	 * 获取某一层分配到的码率
+	 * 低分辨率的层每个像素需要更多的码率，所以像素数量是上一层的1/4，码率是上一层的1/3
+	 * @param bitrate
+	 * 总码率
+	 * @param count
+	 * 层数
+	 */
+	static uint64_t Get_Layer_Bitrate(uint64_t bitrate,uint8_t layer,uint8_t count) noexcept;
+public:
+	//最多的层数
+	static constexpr uint8_t MAX_LAYERS = 3;
+	//长或者宽小于该值的层不编码
+	static constexpr int MIN_LAYER_SIZE = 32;
+protected:
+	/**
+	 * @brief on_thread_run
+	 * 把输入队列的帧缩放后分发给各层的编码器
+	 */
+	virtual void on_thread_run() noexcept override;
+
+	/**
+	 * @brief get_thread_pause_condition
+	 * 没有输入队列或者没有开启联播的时候暂停
+	 */
+	virtual bool get_thread_pause_condition() noexcept override;
+private:
+	SimulcastEncoderPrivateData * const d_ptr;
+};
+
+} // namespace codec
+
+} // namespace rtplivelib
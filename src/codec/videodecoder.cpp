@@ -1,6 +1,7 @@
 #include "videodecoder.h"
 #include "../core/logger.h"
 #include "hardwaredevice.h"
+#include <atomic>
 extern "C"{
 #include "libavcodec/avcodec.h"
 }
@@ -26,6 +27,10 @@ public:
 	PayloadType							cur_pt{PayloadType::RTP_PT_NONE};
 	core::Format						cur_fmt;
 	player::VideoPlayer					*player{nullptr};
+	//解码帧的输出队列
+	core::AbstractQueue<core::FramePacket>	*sink{nullptr};
+	//解码出错的次数，其他线程会读取
+	std::atomic<uint64_t>				errors{0};
 	AVPacket							*pkt{nullptr};
 	AVFrame								*frame{nullptr};
 	AVFrame								*sw_frame{nullptr};
@@ -59,10 +64,10 @@ public:
 	inline void close_codec_ctx() noexcept {
 		if(decoder_ctx != nullptr){
 			if(pkt != nullptr){
-				//清空缓存
+				//清空缓存，关闭的时候不再输出
 				pkt->data = nullptr;
 				pkt->size = 0;
-				decode();
+				decode(false);
 			}
 			avcodec_free_context(&decoder_ctx);
 		}
@@ -230,12 +235,18 @@ public:
 	 * @brief decode
 	 * 解码操作
 	 * 在这里就不判断各种上下文了，直接开始解码
+	 * 每次avcodec_receive_frame都会先释放frame，所以每一帧都要在循环里面输出
+	 * @param emit
+	 * 是否输出解码帧
 	 */
-	inline void decode() noexcept{
+	inline void decode(bool emit = true) noexcept{
 		int ret = 0;
 		
 		ret = avcodec_send_packet(decoder_ctx,pkt);
 		if( ret < 0 ){
+			//清空缓存的时候(空包)出错不算
+			if(pkt->size > 0)
+				++errors;
 			core::Logger::Print_FFMPEG_Info(ret,
 											__PRETTY_FUNCTION__,
 											LogLevel::WARNING_LEVEL);
@@ -248,18 +259,26 @@ public:
 			if( ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
 				return;
 			else if( ret < 0){
+				++errors;
 				core::Logger::Print_FFMPEG_Info(ret,
 												__PRETTY_FUNCTION__,
 												LogLevel::WARNING_LEVEL);
 				return;
 			}
 			
+			//参考帧丢失的帧解码器会隐藏错误继续输出，同样需要关键帧恢复
+			if(frame->decode_error_flags != 0 || (frame->flags & AV_FRAME_FLAG_CORRUPT))
+				++errors;
 			if(use_hw_flag == true){
 				ret = av_hwframe_transfer_data(sw_frame, frame, 0);
 				if (ret < 0) {
 					fprintf(stderr, "Error transferring the data to system memory\n");
+					return;
 				}
-				return;
+			}
+			if(emit == true){
+				output();
+				display();
 			}
 			
 //			core::Logger::Print("size:{}",api,LogLevel::INFO_LEVEL,sw_frame->format);
@@ -295,11 +314,43 @@ public:
 			
 			if( pkt->size ){
 				decode();
-				display();
 			}
 		}
 	}
 	
+	/**
+	 * @brief output
+	 * 将解码帧推送到输出队列
+	 * 帧使用引用计数拷贝，不拷贝图像数据
+	 */
+	inline void output() noexcept {
+		if( sink == nullptr)
+			return;
+		
+		auto src = use_hw_flag ? sw_frame : frame;
+		auto dst_frame = av_frame_clone(src);
+		if(dst_frame == nullptr){
+			core::Logger::Print_APP_Info(core::Result::FramePacket_frame_alloc_failed,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+			return;
+		}
+		auto packet = core::FramePacket::Make_Shared();
+		if(packet == nullptr){
+			av_frame_free(&dst_frame);
+			return;
+		}
+		packet->data->set_frame_no_lock(dst_frame);
+		packet->format.width = dst_frame->width;
+		packet->format.height = dst_frame->height;
+		packet->format.pixel_format = dst_frame->format;
+		packet->payload_type = cur_pt;
+		packet->pts = frame->pts;
+		packet->dts = frame->pkt_dts;
+		packet->flag = frame->key_frame;
+		sink->push_one(packet);
+	}
+	
 	inline void display() noexcept {
 		if( player == nullptr)
 			return;
@@ -401,7 +452,6 @@ public:
 			pkt->size = pack.second->data->size;
 			//硬件加速，不需要解析
 			decode();
-			display();
 		} else {
 			//解析并解码
 			parse((*pack.second->data)[0],pack.second->data->size,pack.second->pts,pack.second->pos);
@@ -567,6 +617,11 @@ void VideoDecoder::set_player_object(player::VideoPlayer *player) noexcept
 	d_ptr->player = player;
 }
 
+void VideoDecoder::set_frame_sink(core::AbstractQueue<core::FramePacket> *sink) noexcept
+{
+	d_ptr->sink = sink;
+}
+
 void VideoDecoder::set_hwd_type(HardwareDevice::HWDType type) noexcept
 {
 	d_ptr->hwd_type_user = type;
@@ -577,6 +632,11 @@ HardwareDevice::HWDType VideoDecoder::get_hwd_type() noexcept
 	return d_ptr->hwd_type_cur;
 }
 
+uint64_t VideoDecoder::get_error_count() noexcept
+{
+	return d_ptr->errors;
+}
+
 void VideoDecoder::on_thread_run() noexcept
 {
 	//等待资源到来
@@ -38,6 +38,16 @@ public:
 	 */
 	void set_player_object(player::VideoPlayer * player) noexcept;
 	
+	/**
+	 * @brief set_frame_sink
+	 * 设置解码帧的输出队列，用于无界面模式(不使用SDL播放)
+	 * 解码后的帧(软件帧)将会以FramePacket的形式推送到该队列
+	 * 可以和播放器同时使用
+	 * @param sink
+	 * 输出队列，传入nullptr则不输出
+	 */
+	void set_frame_sink(core::AbstractQueue<core::FramePacket> * sink) noexcept;
+	
 	/**
 	 * @brief set_hwd_type
 	 * 设置硬件加速类型，默认设置为Auto，加速方案启动失败则会设置为None
@@ -51,6 +61,13 @@ public:
 	 * @return 
 	 */
 	HardwareDevice::HWDType get_hwd_type() noexcept;
+	
+	/**
+	 * @brief get_error_count
+	 * 获取解码出错的次数(包括解码出来但是有损坏的帧)，可以在其他线程调用
+	 * 接收端根据它判断是否需要请求关键帧
+	 */
+	uint64_t get_error_count() noexcept;
 protected:
 	/**
 	 * @brief on_thread_run
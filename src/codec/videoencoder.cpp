@@ -3,6 +3,9 @@
 #include "../core/time.h"
 #include "hardwaredevice.h"
 #include "../rtp_network/rtpsession.h"
+#include <cstring>
+#include <climits>
+#include <algorithm>
 extern "C"{
 #include "libavutil/opt.h"
 #include "libavcodec/avcodec.h"
@@ -13,6 +16,13 @@ namespace rtplivelib {
 
 namespace codec {
 
+//码率变化超过该比例才重启不支持动态修改码率的编码器
+static constexpr double RESTART_BITRATE_RATIO = 0.25;
+//两次因为码率改变而重启上下文的最小间隔
+static constexpr auto RESTART_INTERVAL = std::chrono::seconds(5);
+
+constexpr std::chrono::milliseconds VideoEncoder::KEY_FRAME_REQUEST_INTERVAL;
+
 VideoEncoder::VideoEncoder(bool use_hw_acceleration,
 						   HardwareDevice::HWDType hwa_type,
 						   EncoderType enc_type):
@@ -63,6 +73,9 @@ void VideoEncoder::encode(core::FramePacket::SharedPacket packet) noexcept
 		}
 	}
 	
+	//码率改变的时候更新编码器参数，可能会关闭上下文，然后在下面重新创建
+	_update_bitrate();
+	
 	if(_select_encoder(packet) == false){
 		set_encoder_type(Encoder::None);
 		_close_ctx();
@@ -87,6 +100,10 @@ void VideoEncoder::encode(core::FramePacket::SharedPacket packet) noexcept
 		return;
 	}
 	
+	//有关键帧请求则强制这一帧为I帧，帧是重复使用的，发送之后需要恢复
+	auto force_key_frame = _take_key_frame_request();
+	encode_sw_frame->pict_type = force_key_frame ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+	
 	if( use_hw_flag == true){
 		
 		//先判断相关结构体是否初始化完毕,这里一般是不会出错的
@@ -118,10 +135,13 @@ void VideoEncoder::encode(core::FramePacket::SharedPacket packet) noexcept
 											LogLevel::ERROR_LEVEL);
 			return;
 		}
+		encode_hw_frame->pict_type = encode_sw_frame->pict_type;
 		ret = avcodec_send_frame(encoder_ctx,encode_hw_frame);
+		encode_hw_frame->pict_type = AV_PICTURE_TYPE_NONE;
 	}
 	else
 		ret = avcodec_send_frame(encoder_ctx,encode_sw_frame);
+	encode_sw_frame->pict_type = AV_PICTURE_TYPE_NONE;
 	
 	if(ret < 0){
 		core::Logger::Print_FFMPEG_Info(ret,
@@ -143,13 +163,13 @@ void VideoEncoder::set_encoder_param(const core::Format &format) noexcept
 	
 	//以下是用于软压用的参数设置，在硬压的时候会在hw里面再设置一次
 	encoder_ctx->gop_size = 10;
-	encoder_ctx->max_b_frames = 1;
+	//实时传输不使用B帧:包按照解码顺序发送，pts会回退，接收端按照时间戳排序也无法处理
+	encoder_ctx->max_b_frames = 0;
+	//强制的I帧编码成IDR，否则接收端还是需要之前的参考帧，不支持该选项的编码器忽略
+	av_opt_set(encoder_ctx->priv_data,"forced-idr","1",0);
 	
-	//需要动态调整一下比特率,先不实行
-	if(format.height == 480 && format.width == 640)
-		encoder_ctx->bit_rate = 1536;
-	else if(format.height == 1080 && format.width == 1920)
-		encoder_ctx->bit_rate = 1000 * 12;
+	//码率由拥塞控制动态调整，还没有设置的时候根据分辨率估算
+	_set_bitrate_param(_get_default_bitrate(format));
 }
 
 void VideoEncoder::receive_packet() noexcept
@@ -211,6 +231,83 @@ void VideoEncoder::receive_packet() noexcept
 		av_packet_free(&src_packet);
 }
 
+bool VideoEncoder::request_key_frame() noexcept
+{
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(key_frame_mutex);
+	if(key_frame_pending)
+		return false;
+	if(last_forced_key_frame != core::Clock::TimePoint() &&
+			now - last_forced_key_frame < KEY_FRAME_REQUEST_INTERVAL)
+		return false;
+	key_frame_pending = true;
+	return true;
+}
+
+bool VideoEncoder::_take_key_frame_request() noexcept
+{
+	std::lock_guard<std::mutex> lk(key_frame_mutex);
+	if(!key_frame_pending)
+		return false;
+	key_frame_pending = false;
+	last_forced_key_frame = core::Clock::Get_Clock()->now();
+	return true;
+}
+
+void VideoEncoder::_update_bitrate() noexcept
+{
+	if(encoder_ctx == nullptr || encoder == nullptr || avcodec_is_open(encoder_ctx) == 0)
+		return;
+	uint64_t bitrate = target_bitrate;
+	if(bitrate == 0 || bitrate == applied_bitrate)
+		return;
+	if(strcmp(encoder->name,"libx264") == 0){
+		//libx264在编码的时候检测到码率改变会调用x264_encoder_reconfig
+		_set_bitrate_param(bitrate);
+		return;
+	}
+	//其他编码器只能重启上下文，重启会产生一个关键帧，代价较大
+	//所以只有变化足够大并且距离上次重启足够久才重启
+	auto diff = static_cast<double>(bitrate > applied_bitrate ? bitrate - applied_bitrate :
+																applied_bitrate - bitrate);
+	if(applied_bitrate != 0 && diff / applied_bitrate < RESTART_BITRATE_RATIO)
+		return;
+	auto now = core::Clock::Get_Clock()->now();
+	if(last_restart != core::Clock::TimePoint() && now - last_restart < RESTART_INTERVAL)
+		return;
+	last_restart = now;
+	core::Logger::Print("restart encoder,bitrate:{} -> {}",
+						__PRETTY_FUNCTION__,
+						LogLevel::INFO_LEVEL,
+						applied_bitrate,bitrate);
+	_close_ctx();
+}
+
+void VideoEncoder::_set_bitrate_param(uint64_t bitrate) noexcept
+{
+	//vbv缓冲区为1秒的数据量，限制码率的峰值，避免关键帧超出带宽太多
+	auto rate = static_cast<int64_t>(std::min<uint64_t>(bitrate,INT_MAX));
+	encoder_ctx->bit_rate = rate;
+	encoder_ctx->rc_max_rate = rate;
+	encoder_ctx->rc_buffer_size = static_cast<int>(rate);
+	applied_bitrate = bitrate;
+}
+
+uint64_t VideoEncoder::_get_default_bitrate(const core::Format &format) noexcept
+{
+	uint64_t bitrate = target_bitrate;
+	if(bitrate != 0)
+		return bitrate;
+	if(format.height == 480 && format.width == 640)
+		return 1536 * 1000;
+	else if(format.height == 1080 && format.width == 1920)
+		return 12000 * 1000;
+	//其他分辨率按照每个像素0.1bit估算
+	auto fps = format.frame_rate > 0 ? format.frame_rate : 15;
+	return static_cast<uint64_t>(format.width) * static_cast<uint64_t>(format.height) *
+			static_cast<uint64_t>(fps) / 10;
+}
+
 inline bool VideoEncoder::_init_hwdevice(HardwareDevice::HWDType hwdtype,const core::Format& format) noexcept
 {
 	bool ret;
@@ -3,6 +3,9 @@
 
 #include "encoder.h"
 #include "../image_processing/scale.h"
+#include "../core/clock.h"
+#include <atomic>
+#include <mutex>
 
 namespace rtplivelib {
 
@@ -44,6 +47,38 @@ public:
 	 * 释放资源
 	 */
 	virtual ~VideoEncoder() override;
+	
+	/**
+	 * @brief set_bitrate
+	 * 设置目标码率(bit/s)，一般由拥塞控制根据网络情况设置
+	 * 可以在其他线程调用，在编码下一帧的时候生效
+	 * libx264支持编码过程中修改码率，其他编码器需要重启上下文，
+	 * 所以只有码率变化足够大的时候才会重启
+	 * @param bitrate
+	 * 0表示根据分辨率自动选择
+	 */
+	void set_bitrate(uint64_t bitrate) noexcept;
+	
+	/**
+	 * @brief get_bitrate
+	 * 获取设置的目标码率(bit/s)，0表示根据分辨率自动选择
+	 */
+	uint64_t get_bitrate() const noexcept;
+	
+	/**
+	 * @brief request_key_frame
+	 * 请求编码器把下一帧编码成关键帧(IDR)，一般是接收端通过PLI/FIR请求的
+	 * 可以在其他线程调用，多个接收端同时请求只会产生一个关键帧:
+	 * 已经有请求在等待，或者距离上一个强制的关键帧不到KEY_FRAME_REQUEST_INTERVAL则忽略
+	 * GOP自然产生的关键帧不算，请求可能是因为那个关键帧丢失了才发出的
+	 * @return
+	 * 请求被忽略则返回false
+	 */
+	bool request_key_frame() noexcept;
+public:
+	//两个强制关键帧之间的最小间隔，合并多个接收端同时发出的请求，避免码率暴涨
+	//比接收端重发请求的间隔(RTPKeyFrameRequester::RETRY_INTERVAL_MS)短，关键帧丢失之后重发的请求不会被忽略
+	static constexpr auto KEY_FRAME_REQUEST_INTERVAL = std::chrono::milliseconds(200);
 protected:
 	/**
 	 * @brief encode
@@ -67,6 +102,31 @@ protected:
 	 */
 	void receive_packet() noexcept;
 private:
+	/**
+	 * @brief _update_bitrate
+	 * 目标码率改变的时候更新编码器的码率
+	 * 不支持动态修改码率的编码器将会关闭上下文，编码的时候重新创建
+	 */
+	void _update_bitrate() noexcept;
+	
+	/**
+	 * @brief _set_bitrate_param
+	 * 设置编码器上下文的码率参数
+	 */
+	void _set_bitrate_param(uint64_t bitrate) noexcept;
+	
+	/**
+	 * @brief _get_default_bitrate
+	 * 获取创建上下文时使用的码率，没有设置目标码率则根据分辨率估算
+	 */
+	uint64_t _get_default_bitrate(const core::Format & format) noexcept;
+	
+	/**
+	 * @brief _take_key_frame_request
+	 * 取出关键帧请求，有请求则这一帧需要编码成关键帧
+	 */
+	bool _take_key_frame_request() noexcept;
+
 	/**
 	 * @brief _init_hwdevice
 	 * 初始化硬件设备并启动编码器
@@ -159,8 +219,22 @@ private:
 	//随着格式的改变和上下文一起重新分配
 	AVFrame										* encode_sw_frame{nullptr};
 	AVFrame										* encode_hw_frame{nullptr};
+	//外部设置的目标码率
+	std::atomic<uint64_t>						target_bitrate{0};
+	//编码器上下文当前使用的码率
+	uint64_t									applied_bitrate{0};
+	//上一次因为码率改变而重启上下文的时间
+	core::Clock::TimePoint						last_restart;
+	//关键帧请求，外部线程和编码线程都会访问
+	std::mutex									key_frame_mutex;
+	bool										key_frame_pending{false};
+	//上一个强制的关键帧的时间
+	core::Clock::TimePoint						last_forced_key_frame;
 };
 
+inline void VideoEncoder::set_bitrate(uint64_t bitrate) noexcept				{		target_bitrate = bitrate;}
+inline uint64_t VideoEncoder::get_bitrate() const noexcept						{		return target_bitrate;}
+
 } // namespace codec
 
 } // namespace rtplivelib
@@ -64,10 +64,9 @@ public:
 		if(has_data())
 			return true;
 		std::unique_lock<std::mutex> lk(_mutex);
-		//		auto flag = _queue_read_condition.wait_for(lk,std::chrono::milliseconds(millisecond));
-		auto flag = _queue_read_condition.wait_until(lk,
-													 std::chrono::system_clock::now() + 
-													 std::chrono::milliseconds(millisecond));
+		//通过全局时钟等待，使用单调时钟，也可以运行在模拟时间上
+		auto flag = Clock::Get_Clock()->wait_for(_queue_read_condition,lk,
+												 std::chrono::milliseconds(millisecond));
 		return flag != std::cv_status::timeout;
 	}
 	
@@ -139,6 +138,27 @@ public:
 		_queue_read_condition.notify_one();
 	}
 	
+	/**
+	 * @brief push_batch
+	 * 一次性添加多个包进队列，只加锁和唤醒一次
+	 * 如果队列已经满了，则删除最早的包
+	 * @param packets
+	 * 新的包，添加后清空
+	 */
+	template<typename Container>
+	inline void push_batch(Container & packets) noexcept{
+		if(packets.empty())
+			return;
+		std::lock_guard<std::mutex> lk(_mutex);
+		for(auto & packet : packets){
+			while(_queue.size() >= _max_size)
+				_queue.pop();
+			_queue.push(packet);
+		}
+		packets.clear();
+		_queue_read_condition.notify_all();
+	}
+	
 	/**
 	 * @brief erase_first
 	 * 抹除首个元素
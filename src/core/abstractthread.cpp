@@ -1,5 +1,9 @@
 #include "abstractthread.h"
 #include <iostream>
+#if defined (unix)
+#include <pthread.h>
+#include <time.h>
+#endif
 
 namespace rtplivelib {
 
@@ -99,6 +103,22 @@ void AbstractThread::exit_thread() noexcept
 	}
 }
 
+int64_t AbstractThread::get_thread_cpu_time() noexcept
+{
+	if(get_exit_flag() || _thread == nullptr)
+		return 0;
+#if defined (unix)
+	clockid_t id;
+	if(pthread_getcpuclockid(_thread->native_handle(),&id) != 0)
+		return 0;
+	timespec ts;
+	if(clock_gettime(id,&ts) != 0)
+		return 0;
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+	return 0;
+#endif
+}
 
 } // namespace core
 
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "config.h"
+#include "clock.h"
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -46,6 +47,14 @@ public:
 	 */
 	std::thread::id get_thread_id() noexcept;
 	
+	/**
+	 * @brief get_thread_cpu_time
+	 * 获取线程启动以来占用的CPU时间，单位纳秒，用于统计每个模块的CPU占用
+	 * @return 
+	 * 线程没有启动或者平台不支持则返回0
+	 */
+	int64_t get_thread_cpu_time() noexcept;
+	
 	/**
 	 * @brief sleep
 	 * 线程睡眠，单位毫秒
@@ -158,8 +167,7 @@ inline std::thread::id AbstractThread::get_thread_id() noexcept				{
 inline void AbstractThread::sleep(int milliseconds) noexcept				{
 	if(get_exit_flag())
 		return;
-	std::chrono::milliseconds dura(milliseconds);
-	std::this_thread::sleep_for(dura);
+	Clock::Get_Clock()->sleep_for(std::chrono::milliseconds(milliseconds));
 }
 inline void AbstractThread::on_thread_run()noexcept							{		}
 inline void AbstractThread::on_thread_pause()noexcept						{		}
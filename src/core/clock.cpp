@@ -0,0 +1,157 @@
+#include "clock.h"
+#include <thread>
+#if defined (unix)
+#include <time.h>
+#include <errno.h>
+#endif
+
+namespace rtplivelib {
+
+namespace core {
+
+std::atomic<Clock *> Clock::clock_ptr{nullptr};
+
+Clock::~Clock()
+{
+
+}
+
+Clock *Clock::Get_Clock() noexcept
+{
+	static SystemClock system_clock;
+	auto clock = clock_ptr.load();
+	return clock != nullptr ? clock : &system_clock;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+Clock::TimePoint SystemClock::now() noexcept
+{
+	return std::chrono::steady_clock::now();
+}
+
+void SystemClock::sleep_until(const TimePoint &tp) noexcept
+{
+#if defined (unix)
+	//steady_clock在linux下就是CLOCK_MONOTONIC，直接使用绝对时间睡眠
+	//被信号中断时继续睡眠到同一个时间点，不会产生误差
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+	if(ns <= 0)
+		return;
+	struct timespec ts;
+	ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+	ts.tv_nsec = static_cast<long>(ns % 1000000000);
+	while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,nullptr) == EINTR);
+#else
+	std::this_thread::sleep_until(tp);
+#endif
+}
+
+std::cv_status SystemClock::wait_until(std::condition_variable &cv,
+									   std::unique_lock<std::mutex> &lk,
+									   const TimePoint &tp) noexcept
+{
+	return cv.wait_until(lk,tp);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+VirtualClock::VirtualClock(const TimePoint &start) noexcept:
+	_now(start)
+{
+
+}
+
+Clock::TimePoint VirtualClock::now() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _now;
+}
+
+void VirtualClock::sleep_until(const TimePoint &tp) noexcept
+{
+	std::unique_lock<std::mutex> lk(_mutex);
+	if(_now >= tp)
+		return;
+	_deadlines.insert(tp);
+	_try_auto_advance();
+	_cond.wait(lk,[this,&tp](){
+		return _now >= tp;
+	});
+	_remove_deadline(tp);
+}
+
+std::cv_status VirtualClock::wait_until(std::condition_variable &cv,
+										std::unique_lock<std::mutex> &lk,
+										const TimePoint &tp) noexcept
+{
+	//轮询模拟时间的真实时间间隔
+	constexpr auto poll_interval = std::chrono::milliseconds(1);
+	{
+		std::lock_guard<std::mutex> clk(_mutex);
+		if(_now >= tp)
+			return std::cv_status::timeout;
+		_deadlines.insert(tp);
+		_try_auto_advance();
+	}
+
+	while(true){
+		auto status = cv.wait_for(lk,poll_interval);
+		std::lock_guard<std::mutex> clk(_mutex);
+		if(status == std::cv_status::no_timeout){
+			_remove_deadline(tp);
+			return status;
+		}
+		if(_now >= tp){
+			_remove_deadline(tp);
+			return std::cv_status::timeout;
+		}
+	}
+}
+
+void VirtualClock::advance_to(const TimePoint &tp) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(tp <= _now)
+		return;
+	_now = tp;
+	_cond.notify_all();
+}
+
+void VirtualClock::set_participants(int count) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_participants = count < 0 ? 0 : count;
+	_try_auto_advance();
+}
+
+int VirtualClock::get_waiting_count() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return static_cast<int>(_deadlines.size());
+}
+
+void VirtualClock::_try_auto_advance() noexcept
+{
+	if(_participants <= 0 || _deadlines.empty())
+		return;
+	if(static_cast<int>(_deadlines.size()) < _participants)
+		return;
+	//所有参与的线程都阻塞了，跳到最早的截止时间
+	auto earliest = *_deadlines.begin();
+	if(earliest > _now){
+		_now = earliest;
+		_cond.notify_all();
+	}
+}
+
+void VirtualClock::_remove_deadline(const TimePoint &tp) noexcept
+{
+	auto it = _deadlines.find(tp);
+	if(it != _deadlines.end())
+		_deadlines.erase(it);
+}
+
+} // namespace core
+
+} // namespace rtplivelib
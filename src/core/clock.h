@@ -0,0 +1,202 @@
+
+#pragma once
+
+#include "config.h"
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <atomic>
+
+namespace rtplivelib {
+
+namespace core {
+
+/**
+ * @brief The Clock class
+ * 时钟接口，库里面所有的睡眠和超时等待都应该通过该接口完成
+ * (AbstractQueue::wait_for_resource_push,Timer,AbstractThread::sleep,FrameClock)
+ * 计时用的当前时间也一样通过Get_Clock()->now()获取(抖动缓冲、平滑发送、拥塞控制、重传、损伤模拟等)，
+ * 所以这些模块都可以在模拟时间下运行和测试
+ * 默认使用SystemClock,也就是真实的单调时钟
+ * 测试或者基准测试的时候可以注册VirtualClock，让整条流水线运行在模拟时间上，
+ * 可以比实时快很多倍，也可以手动推进时间得到确定的结果
+ * 注:需要在启动任何线程之前注册时钟，时钟指针是原子的，但是运行过程中切换时钟，
+ *    正在等待旧时钟的线程不会被新时钟唤醒
+ */
+class RTPLIVELIBSHARED_EXPORT Clock
+{
+public:
+	using Duration = std::chrono::nanoseconds;
+	using TimePoint = std::chrono::steady_clock::time_point;
+public:
+	Clock() = default;
+
+	virtual ~Clock();
+
+	/**
+	 * @brief now
+	 * 获取当前时间点
+	 */
+	virtual TimePoint now() noexcept = 0;
+
+	/**
+	 * @brief sleep_until
+	 * 睡眠到指定的绝对时间点
+	 */
+	virtual void sleep_until(const TimePoint & tp) noexcept = 0;
+
+	/**
+	 * @brief wait_until
+	 * 在条件变量上等待，直到被唤醒或者到达指定时间点
+	 * 和std::condition_variable::wait_until一样，可能会出现虚假唤醒
+	 * @param cv
+	 * 条件变量
+	 * @param lk
+	 * 已经上锁的锁
+	 * @param tp
+	 * 超时时间点
+	 * @return
+	 * 超时返回std::cv_status::timeout
+	 */
+	virtual std::cv_status wait_until(std::condition_variable & cv,
+									  std::unique_lock<std::mutex> & lk,
+									  const TimePoint & tp) noexcept = 0;
+
+	/**
+	 * @brief sleep_for
+	 * 睡眠一段时间，相当于sleep_until(now() + duration)
+	 */
+	void sleep_for(const Duration & duration) noexcept;
+
+	/**
+	 * @brief wait_for
+	 * 在条件变量上等待一段时间，相当于wait_until(cv,lk,now() + duration)
+	 */
+	std::cv_status wait_for(std::condition_variable & cv,
+							std::unique_lock<std::mutex> & lk,
+							const Duration & duration) noexcept;
+
+	/**
+	 * @brief Register_Clock
+	 * 注册全局时钟
+	 * 传入nullptr则恢复使用系统时钟
+	 * 该类不负责释放注册的时钟
+	 */
+	static void Register_Clock(Clock * clock) noexcept;
+
+	/**
+	 * @brief Get_Clock
+	 * 获取全局时钟，没有注册则返回系统时钟
+	 */
+	static Clock * Get_Clock() noexcept;
+private:
+	static std::atomic<Clock *> clock_ptr;
+};
+
+/**
+ * @brief The SystemClock class
+ * 系统时钟，基于单调时钟(steady_clock)
+ * 不会受到修改系统时间的影响
+ */
+class RTPLIVELIBSHARED_EXPORT SystemClock : public Clock
+{
+public:
+	virtual TimePoint now() noexcept override;
+
+	virtual void sleep_until(const TimePoint & tp) noexcept override;
+
+	virtual std::cv_status wait_until(std::condition_variable & cv,
+									  std::unique_lock<std::mutex> & lk,
+									  const TimePoint & tp) noexcept override;
+};
+
+/**
+ * @brief The VirtualClock class
+ * 模拟时钟，时间只会通过advance/advance_to推进，不会自己流逝
+ *
+ * 有两种使用方式:
+ * 1.手动推进:测试代码调用advance推进时间，到期的睡眠和等待将会被唤醒
+ * 2.自动推进:通过set_participants设置参与模拟的线程数，当这些线程全部阻塞在
+ * 睡眠或者等待上时，时钟自动跳到最早的截止时间，这样流水线就可以以最快的速度运行，
+ * 而且只要各个线程的处理是确定的，结果也是确定的
+ *
+ * 注:在条件变量上的超时等待无法直接被模拟时钟唤醒(锁是外部的)，
+ * 所以是以一个很短的真实时间间隔轮询模拟时间，被notify唤醒则立即返回
+ */
+class RTPLIVELIBSHARED_EXPORT VirtualClock : public Clock
+{
+public:
+	/**
+	 * @brief VirtualClock
+	 * 模拟时间从start开始
+	 */
+	explicit VirtualClock(const TimePoint & start = TimePoint()) noexcept;
+
+	virtual TimePoint now() noexcept override;
+
+	virtual void sleep_until(const TimePoint & tp) noexcept override;
+
+	virtual std::cv_status wait_until(std::condition_variable & cv,
+									  std::unique_lock<std::mutex> & lk,
+									  const TimePoint & tp) noexcept override;
+
+	/**
+	 * @brief advance
+	 * 推进一段时间，并唤醒所有到期的睡眠
+	 */
+	void advance(const Duration & duration) noexcept;
+
+	/**
+	 * @brief advance_to
+	 * 推进到指定时间点，时间不会倒退，tp比当前时间早则忽略
+	 */
+	void advance_to(const TimePoint & tp) noexcept;
+
+	/**
+	 * @brief set_participants
+	 * 设置参与自动推进的线程数
+	 * 当阻塞在该时钟上的线程数达到该值时，时钟自动跳到最早的截止时间
+	 * @param count
+	 * 设置为0则关闭自动推进(默认)
+	 */
+	void set_participants(int count) noexcept;
+
+	/**
+	 * @brief get_waiting_count
+	 * 获取当前阻塞在该时钟上的线程数
+	 */
+	int get_waiting_count() noexcept;
+private:
+	/**
+	 * @brief _try_auto_advance
+	 * 判断是否需要自动推进时间,调用前需要锁住_mutex
+	 */
+	void _try_auto_advance() noexcept;
+
+	/**
+	 * @brief _remove_deadline
+	 * 移除一个截止时间,调用前需要锁住_mutex
+	 */
+	void _remove_deadline(const TimePoint & tp) noexcept;
+private:
+	TimePoint						_now;
+	//阻塞在该时钟上的所有截止时间
+	std::multiset<TimePoint>		_deadlines;
+	int								_participants{0};
+	std::mutex						_mutex;
+	std::condition_variable			_cond;
+};
+
+inline void Clock::sleep_for(const Duration &duration) noexcept					{		sleep_until(now() + duration);}
+inline std::cv_status Clock::wait_for(std::condition_variable &cv,
+									  std::unique_lock<std::mutex> &lk,
+									  const Duration &duration) noexcept		{
+	return wait_until(cv,lk,now() + duration);
+}
+inline void Clock::Register_Clock(Clock *clock) noexcept							{		clock_ptr.store(clock);}
+inline void VirtualClock::advance(const Duration &duration) noexcept				{		advance_to(now() + duration);}
+
+} // namespace core
+
+} // namespace rtplivelib
@@ -0,0 +1,77 @@
+#include "frameclock.h"
+
+namespace rtplivelib {
+
+namespace core {
+
+FrameClock::FrameClock(int fps) noexcept:
+	_fps(fps > 0 ? fps : 15)
+{
+}
+
+void FrameClock::start(int64_t base_pts) noexcept
+{
+	_epoch = Clock::Get_Clock()->now();
+	_base_pts = base_pts;
+	_index = 0;
+	_overrun_count = 0;
+	_running = true;
+}
+
+void FrameClock::stop() noexcept
+{
+	_running = false;
+}
+
+void FrameClock::set_fps(int fps) noexcept
+{
+	if(fps <= 0 || fps == _fps)
+		return;
+	if(_running){
+		//以当前帧作为新起点，保证截止时间和pts连续
+		_epoch = _get_deadline(_index);
+		_base_pts = get_pts();
+		_index = 0;
+	}
+	_fps = fps;
+}
+
+int64_t FrameClock::wait_next_frame() noexcept
+{
+	if(!_running){
+		start();
+		return 0;
+	}
+
+	++_index;
+	int64_t missed{0};
+	auto now = Clock::Get_Clock()->now();
+	if(now >= _get_deadline(_index + 1)){
+		//已经错过了至少一帧，直接跳到当前时间所在的帧，不去补帧
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _epoch).count();
+		auto current = static_cast<int64_t>(elapsed * _fps / 1000000000);
+		missed = current - _index;
+		_index = current;
+		_overrun_count += static_cast<uint64_t>(missed);
+	}
+	Clock::Get_Clock()->sleep_until(_get_deadline(_index));
+	return missed;
+}
+
+int FrameClock::get_wait_time() const noexcept
+{
+	if(!_running)
+		return 1000 / _fps;
+	auto remain = std::chrono::duration_cast<std::chrono::milliseconds>(
+					  _get_deadline(_index + 1) - Clock::Get_Clock()->now()).count();
+	return remain > 0 ? static_cast<int>(remain) : 0;
+}
+
+FrameClock::TimePoint FrameClock::_get_deadline(int64_t index) const noexcept
+{
+	return _epoch + std::chrono::nanoseconds(index * 1000000000 / _fps);
+}
+
+} // namespace core
+
+} // namespace rtplivelib
@@ -0,0 +1,121 @@
+
+#pragma once
+
+#include "clock.h"
+
+namespace rtplivelib {
+
+namespace core {
+
+/**
+ * @brief The FrameClock class
+ * 帧时钟，用于按固定帧率节拍输出帧
+ * 所有截止时间都是以起始时间点加上帧序号乘以帧间隔计算得出的绝对时间点(单调时钟)，
+ * 而不是每次睡眠一段相对时间，所以不会因为处理耗时或者睡眠误差而累积漂移
+ * 如果处理耗时超过一帧以上(超时)，则跳过错过的帧，并记录超时次数，
+ * 而不是连续补发帧来追赶时间
+ * pts也是通过帧序号计算得出(单位微秒)，保证输出的pts严格按照帧率递增
+ * 注:该类不是线程安全的，只允许在同一个线程使用
+ */
+class RTPLIVELIBSHARED_EXPORT FrameClock
+{
+public:
+	using TimePoint = Clock::TimePoint;
+public:
+	explicit FrameClock(int fps = 15) noexcept;
+
+	/**
+	 * @brief start
+	 * 以当前时间作为起始时间点启动时钟,当前帧序号为0
+	 * @param base_pts
+	 * 第0帧的pts(单位微秒)，后续帧的pts都在此基础上递增
+	 */
+	void start(int64_t base_pts = 0) noexcept;
+
+	/**
+	 * @brief stop
+	 * 停止时钟，下次使用需要重新调用start
+	 */
+	void stop() noexcept;
+
+	/**
+	 * @brief is_running
+	 * 时钟是否已经启动
+	 */
+	bool is_running() const noexcept;
+
+	/**
+	 * @brief set_fps
+	 * 设置帧率
+	 * 如果时钟正在运行，则以当前帧的截止时间和pts作为新的起点，保证pts连续
+	 * @param fps
+	 * 帧率，小于等于0的值将被忽略
+	 */
+	void set_fps(int fps) noexcept;
+
+	/**
+	 * @brief get_fps
+	 * 获取帧率
+	 */
+	int get_fps() const noexcept;
+
+	/**
+	 * @brief wait_next_frame
+	 * 睡眠直到下一帧的截止时间，然后帧序号加1
+	 * 如果当前时间已经超过下一帧截止时间一帧以上，则跳过错过的帧(不睡眠)
+	 * 并将跳过的帧数累加到超时计数
+	 * @return
+	 * 返回本次跳过的帧数，没有超时则返回0
+	 */
+	int64_t wait_next_frame() noexcept;
+
+	/**
+	 * @brief get_wait_time
+	 * 获取距离下一帧截止时间还有多少毫秒
+	 * 用于等待资源时设置超时时间，已经超过截止时间则返回0
+	 * 时钟没有启动则返回一帧的时间
+	 */
+	int get_wait_time() const noexcept;
+
+	/**
+	 * @brief get_frame_index
+	 * 获取当前帧序号
+	 */
+	int64_t get_frame_index() const noexcept;
+
+	/**
+	 * @brief get_pts
+	 * 获取当前帧的pts,单位微秒
+	 */
+	int64_t get_pts() const noexcept;
+
+	/**
+	 * @brief get_overrun_count
+	 * 获取启动以来累计跳过的帧数
+	 */
+	uint64_t get_overrun_count() const noexcept;
+private:
+	/**
+	 * @brief _get_deadline
+	 * 计算第index帧的截止时间
+	 * 每次都是从起始时间点计算，不会累积取整误差
+	 */
+	TimePoint _get_deadline(int64_t index) const noexcept;
+private:
+	TimePoint				_epoch;
+	int64_t					_base_pts{0};
+	int64_t					_index{0};
+	uint64_t				_overrun_count{0};
+	int						_fps;
+	bool					_running{false};
+};
+
+inline bool FrameClock::is_running() const noexcept									{		return _running;}
+inline int FrameClock::get_fps() const noexcept										{		return _fps;}
+inline int64_t FrameClock::get_frame_index() const noexcept							{		return _index;}
+inline uint64_t FrameClock::get_overrun_count() const noexcept						{		return _overrun_count;}
+inline int64_t FrameClock::get_pts() const noexcept									{		return _base_pts + _index * 1000000 / _fps;}
+
+} // namespace core
+
+} // namespace rtplivelib
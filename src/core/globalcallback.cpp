@@ -1,4 +1,20 @@
 
 #include "globalcallback.h"
 
-rtplivelib::core::GlobalCallBack* rtplivelib::core::GlobalCallBack::cb_ptr = nullptr;
+namespace rtplivelib {
+
+namespace core {
+
+void CallBackObject::set_callback(GlobalCallBack *callback) noexcept
+{
+	_callback = callback;
+}
+
+GlobalCallBack *CallBackObject::get_callback() noexcept
+{
+	return _callback;
+}
+
+}// namespace core
+
+} // namespace rtplivelib
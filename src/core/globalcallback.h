@@ -63,6 +63,15 @@ public:
 	 */
 	virtual void on_video_real_time_fps(uint8_t fps);
 	
+	/**
+	 * @brief on_video_first_frame
+	 * 开始捕捉后输出第一帧的回调，用于统计首帧耗时
+	 * @param ms
+	 * 从视频处理线程开始运行(开始捕捉)到输出第一帧的时间，单位毫秒
+	 * 包括打开设备的时间
+	 */
+	virtual void on_video_first_frame(uint32_t ms);
+	
 	/*以下回调继承的时候业务不要写的太复杂，会干扰rtp包或者rtcp包的接收和处理*/
 	
 	/**
@@ -112,18 +121,31 @@ public:
 	virtual void on_local_network_information(uint32_t jitter,
 											  float fraction_lost,
 											  uint32_t delay) ;
-	
+};
+
+/**
+ * @brief The CallBackObject class
+ * 需要触发回调的类继承该类
+ * 回调对象不再是全局唯一的，而是由所属的引擎(LiveEngine)设置
+ * 这样一个进程可以同时运行多个互不影响的引擎(房间)
+ */
+class RTPLIVELIBSHARED_EXPORT CallBackObject
+{
+public:
 	/**
-	 * @brief Register_CallBack
-	 * 注册回调函数
-	 * 一个程序只需要一个回调
-	 * @return 
+	 * @brief set_callback
+	 * 设置回调对象，不拥有该对象的所有权
+	 * 传入nullptr则不回调
 	 */
-	static void Register_CallBack(GlobalCallBack *) noexcept;
+	void set_callback(GlobalCallBack * callback) noexcept;
 	
-	static GlobalCallBack * Get_CallBack() noexcept;
+	/**
+	 * @brief get_callback
+	 * 获取回调对象，没有设置则返回nullptr
+	 */
+	GlobalCallBack * get_callback() noexcept;
 private:
-	static GlobalCallBack * cb_ptr;
+	GlobalCallBack * volatile _callback{nullptr};
 };
 
 inline void GlobalCallBack::on_camera_frame(core::FramePacket::SharedPacket )						{}
@@ -132,6 +154,7 @@ inline void GlobalCallBack::on_video_frame_merge(core::FramePacket::SharedPacket
 inline void GlobalCallBack::on_microphone_packet(core::FramePacket::SharedPacket )					{}
 inline void GlobalCallBack::on_soundcard_packet(core::FramePacket::SharedPacket )					{}
 inline void GlobalCallBack::on_video_real_time_fps(uint8_t)											{}
+inline void GlobalCallBack::on_video_first_frame(uint32_t)											{}
 inline void GlobalCallBack::on_new_user_join(const std::string& )									{}
 inline void GlobalCallBack::on_user_exit(const std::string& ,
 										 const void *, const uint64_t& )							{}
@@ -139,13 +162,6 @@ inline void GlobalCallBack::on_upload_bandwidth(uint64_t ,uint64_t)									{}
 inline void GlobalCallBack::on_download_bandwidth(uint64_t,uint64_t)								{}
 inline void GlobalCallBack::on_local_network_information(uint32_t ,float,uint32_t  )				{}
 
-inline void GlobalCallBack::Register_CallBack(GlobalCallBack * ptr) noexcept				{
-	cb_ptr = ptr;
-}
-
-inline GlobalCallBack *GlobalCallBack::Get_CallBack() noexcept							{
-	return cb_ptr;
-}
 
 
 }// namespace core
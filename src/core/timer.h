@@ -4,6 +4,7 @@
 #include "abstractthread.h"
 #include "logger.h"
 #include "except.h"
+#include "clock.h"
 
 namespace rtplivelib {
 
@@ -76,7 +77,8 @@ protected:
 	virtual void on_thread_run() noexcept override{
 		std::unique_lock<decltype (_mutex)> lk(_mutex);
 		while(_start_flag){
-			if(_wait_cond_var.wait_for(lk,std::chrono::milliseconds(_wait_time)) == std::cv_status::timeout){
+			if(Clock::Get_Clock()->wait_for(_wait_cond_var,lk,
+											std::chrono::milliseconds(_wait_time)) == std::cv_status::timeout){
 				_cb();
 				if(_loop_flag == false){
 					stop();
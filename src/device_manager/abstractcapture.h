@@ -92,10 +92,20 @@ public:
 	/**
 	 * @brief get_current_device_info
 	 * 返回设备信息,包含设备名字和设备id，id是内部使用字段
+	 * 如果还没有探测设备，则会先探测设备(probe_device)
 	 * @return 
 	 */
 	virtual device_info get_current_device_info() noexcept;
 	
+	/**
+	 * @brief probe_device
+	 * 探测设备并选择默认设备
+	 * 枚举设备比较耗时，所以不在构造函数里面执行，而是在第一次使用的时候执行
+	 * 也可以提前在后台线程调用，该接口只会执行一次，多个线程同时调用会等待第一次执行完成
+	 * 默认不做任何操作
+	 */
+	virtual void probe_device() noexcept;
+	
 	/**
 	 * @brief get_all_device_info
 	 * 获取所有设备的信息，其实也就是名字而已
@@ -197,7 +207,11 @@ inline bool AbstractCapture::is_running() noexcept											{		return _is_runni
 inline AbstractCapture::CaptureType AbstractCapture::get_type()  noexcept					{		return _type;}
 inline void AbstractCapture::on_stop() noexcept												{		}
 inline bool AbstractCapture::get_thread_pause_condition() noexcept							{		return !_is_running_flag;}
-inline AbstractCapture::device_info AbstractCapture::get_current_device_info() noexcept		{		return current_device_info;}
+inline AbstractCapture::device_info AbstractCapture::get_current_device_info() noexcept		{
+	probe_device();
+	return current_device_info;
+}
+inline void AbstractCapture::probe_device() noexcept											{		}
 inline uint32_t AbstractCapture::get_device_value() noexcept								{		return current_device_value;}
 inline bool AbstractCapture::on_frame_data(SharedPacket)									{		return true;}
 inline void AbstractCapture::on_thread_pause() noexcept										{		this->on_stop();}
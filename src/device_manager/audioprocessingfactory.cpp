@@ -103,8 +103,8 @@ void AudioProcessingFactory::on_thread_run() noexcept
 		if(packet == nullptr)
 			return;
 		//第一时间回调
-		if(GlobalCallBack::Get_CallBack() != nullptr){
-			GlobalCallBack::Get_CallBack()->on_microphone_packet(packet);
+		if(get_callback() != nullptr){
+			get_callback()->on_microphone_packet(packet);
 		}
 		
 		if(play_flag == true){
@@ -129,8 +129,8 @@ void AudioProcessingFactory::on_thread_run() noexcept
 			return;
 		
 		//裁剪后回调
-		if(GlobalCallBack::Get_CallBack() != nullptr){
-			GlobalCallBack::Get_CallBack()->on_soundcard_packet(packet);
+		if(get_callback() != nullptr){
+			get_callback()->on_soundcard_packet(packet);
 		}
 		push_one(packet);
 		return;
@@ -22,6 +22,14 @@ public:
 	AVFormatContext *fmtContxt{nullptr};
 	std::mutex fmt_ctx_mutex;
 	AVPacket *packet{nullptr};
+	std::once_flag format_flag;
+	std::once_flag probe_flag;
+	
+	/**
+	 * @brief init_format
+	 * 注册设备并查找输入格式，只执行一次
+	 */
+	void init_format() noexcept;
 };
 
 #if defined (WIN64)
@@ -30,24 +38,29 @@ static constexpr char format_name[] = "dshow";
 static constexpr char format_name[] = "v4l2";
 #endif
 
+void CameraCapturePrivateData::init_format() noexcept
+{
+	std::call_once(format_flag,[this](){
+		avdevice_register_all();
+		
+		ifmt = av_find_input_format(format_name);
+		
+		//这里应该不会出现这种情况,但是ffmpeg库的编译出问题的话，这里就会触发了
+		if(ifmt == nullptr){
+			core::Logger::Print_APP_Info(core::Result::InputFormat_format_not_found,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::ERROR_LEVEL,
+										 format_name);
+		}
+	});
+}
+
 CameraCapture::CameraCapture() :
 	AbstractCapture(AbstractCapture::CaptureType::Camera),
 	_fps(15),
 	d_ptr(new CameraCapturePrivateData)
 {
-	avdevice_register_all();
-	
-	d_ptr->ifmt = av_find_input_format(format_name);
-	
-	//这里应该不会出现这种情况,但是ffmpeg库的编译出问题的话，这里就会触发了
-	if(d_ptr->ifmt == nullptr){
-		core::Logger::Print_APP_Info(core::Result::InputFormat_format_not_found,
-									 __PRETTY_FUNCTION__,
-									 LogLevel::ERROR_LEVEL,
-									 format_name);
-	}
-	//初始化的时候将设备设置成默认设备
-	set_default_device();
+	//枚举设备比较耗时，延迟到第一次使用(probe_device)的时候才选择默认设备
 }
 
 CameraCapture::~CameraCapture()
@@ -82,6 +95,7 @@ std::map<CameraCapture::device_id,CameraCapture::device_name>
 CameraCapture::get_all_device_info() noexcept(false)
 {
 #if defined (unix)
+	d_ptr->init_format();
 	if(d_ptr->ifmt == nullptr){
 		throw core::uninitialized_error("AVInputFormat(ifmt)");
 	}
@@ -100,7 +114,7 @@ CameraCapture::get_all_device_info() noexcept(false)
 	}
 	else {
 		//这里不判断返回值了，因为我知道失败的情况一般是函数未实现
-		throw core::func_not_implemented_error(core::MessageString[int(core::MessageNum::Device_info_failed)]);
+		throw core::func_not_implemented_error(core::MessageString[int(core::Result::Device_info_failed)]);
 	}
 #elif defined (WIN64)
 	ICreateDevEnum *pDevEnum{nullptr};
@@ -186,6 +200,8 @@ bool CameraCapture::set_default_device() noexcept
 
 bool CameraCapture::set_current_device(CameraCapture::device_id device_id) noexcept
 {
+	//先完成默认设备的探测，防止后台探测覆盖当前设置
+	probe_device();
 	//只区分设备id，不区分设备名字
 	if(device_id.compare(current_device_info.second) == 0){
 		return true;
@@ -204,6 +220,14 @@ bool CameraCapture::set_current_device(CameraCapture::device_id device_id) noexc
 	return result;
 }
 
+void CameraCapture::probe_device() noexcept
+{
+	std::call_once(d_ptr->probe_flag,[this](){
+		//说是默认设备，其实是第一个设备
+		set_default_device();
+	});
+}
+
 CameraCapture::SharedPacket CameraCapture::on_start() noexcept {
 	if(d_ptr->fmtContxt == nullptr){
 		if(!open_device()){
@@ -279,6 +303,8 @@ bool CameraCapture::open_device() noexcept
 	av_dict_set(&options,"framerate",std::to_string(_fps).c_str(),0);
 	av_dict_set(&options,"video_size",_size.to_string().c_str(),0);
 	
+	d_ptr->init_format();
+	probe_device();
 	std::lock_guard<std::mutex> lk(d_ptr->fmt_ctx_mutex);
 	if(d_ptr->fmtContxt != nullptr){
 		avformat_close_input(&d_ptr->fmtContxt);
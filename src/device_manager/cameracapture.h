@@ -115,6 +115,12 @@ public:
 	 * @see get_all_device_info
 	 */
 	virtual bool set_current_device(device_id device_id) noexcept override;
+	
+	/**
+	 * @brief probe_device
+	 * 查找输入格式并选择第一个摄像头作为当前设备，只执行一次
+	 */
+	virtual void probe_device() noexcept override;
 protected:
 	/**
 	 * @brief on_start
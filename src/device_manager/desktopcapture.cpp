@@ -20,6 +20,7 @@ public:
 	AVFormatContext *fmtContxt{nullptr};
 	std::mutex _fmt_ctx_mutex;
 	AVPacket *packet{nullptr};
+	std::once_flag probe_flag;
 	
 #ifdef WIN64
 	DXGICapture capture;
@@ -44,44 +45,7 @@ DesktopCapture::DesktopCapture() :
 	_fps(15),
 	d_ptr(new DesktopCapturePrivateData)
 {
-	if(use_ffmpeg){
-		avdevice_register_all();
-		
-		d_ptr->ifmt = av_find_input_format(format_name);
-		//这里应该不会出现这种情况,但是ffmpeg库的编译出问题的话，这里就会触发了
-		if(d_ptr->ifmt == nullptr){
-			core::Logger::Print_APP_Info(core::Result::InputFormat_format_not_found,
-										 __PRETTY_FUNCTION__,
-										 LogLevel::ERROR_LEVEL,
-										 format_name);
-		}
-		
-		//这里只是为了设置当前名字
-		AVDeviceInfoList *info_list = nullptr;
-		avdevice_list_input_sources(d_ptr->ifmt,nullptr,nullptr,&info_list);
-		if(info_list != nullptr && info_list->nb_devices != 0){
-			if(info_list->default_device == -1){
-				current_device_info.first = info_list->devices[0]->device_description;
-				current_device_info.second = current_device_info.first;
-			}
-			else{
-				current_device_info.first = info_list->devices[info_list->default_device]->device_description;
-				current_device_info.second = current_device_info.first;
-			}
-		}
-		
-	#if defined (WIN64)
-		current_device_info.first = "desktop";
-		current_device_info.second = current_device_info.first;
-	#endif
-	} else {
-		auto info = d_ptr->capture.get_current_device_info();
-		current_device_info.first = "0";
-		if(info.screen_list.size() == 0)
-			current_device_info.second = "";
-		else
-			current_device_info.second = info.screen_list[0];
-	}
+	//枚举设备比较耗时，延迟到第一次使用(probe_device)的时候才执行
 }
 
 DesktopCapture::~DesktopCapture()
@@ -106,6 +70,7 @@ void DesktopCapture::set_window(const uint64_t & id)  noexcept{
 
 std::map<DesktopCapture::device_id,DesktopCapture::device_name> DesktopCapture::get_all_device_info() noexcept(false)
 {
+	probe_device();
 	if(use_ffmpeg){
 		if(d_ptr->ifmt == nullptr){
 			throw core::uninitialized_error("AVInputFormat(ifmt)");
@@ -141,6 +106,8 @@ std::map<DesktopCapture::device_id,DesktopCapture::device_name> DesktopCapture::
 
 bool DesktopCapture::set_current_device(device_id device_id) noexcept
 {
+	//先完成默认设备的探测，防止后台探测覆盖当前设置
+	probe_device();
 	if(use_ffmpeg){
 		//只区分设备id，不区分设备名字
 		if(device_id.compare(current_device_info.first) == 0){
@@ -174,6 +141,51 @@ bool DesktopCapture::set_default_device() noexcept
 	}
 }
 
+void DesktopCapture::probe_device() noexcept
+{
+	std::call_once(d_ptr->probe_flag,[this](){
+		if(use_ffmpeg){
+			avdevice_register_all();
+			
+			d_ptr->ifmt = av_find_input_format(format_name);
+			//这里应该不会出现这种情况,但是ffmpeg库的编译出问题的话，这里就会触发了
+			if(d_ptr->ifmt == nullptr){
+				core::Logger::Print_APP_Info(core::Result::InputFormat_format_not_found,
+											 __PRETTY_FUNCTION__,
+											 LogLevel::ERROR_LEVEL,
+											 format_name);
+			}
+			
+			//这里只是为了设置当前名字
+			AVDeviceInfoList *info_list = nullptr;
+			avdevice_list_input_sources(d_ptr->ifmt,nullptr,nullptr,&info_list);
+			if(info_list != nullptr && info_list->nb_devices != 0){
+				if(info_list->default_device == -1){
+					current_device_info.first = info_list->devices[0]->device_description;
+					current_device_info.second = current_device_info.first;
+				}
+				else{
+					current_device_info.first = info_list->devices[info_list->default_device]->device_description;
+					current_device_info.second = current_device_info.first;
+				}
+			}
+			avdevice_free_list_devices(&info_list);
+			
+		#if defined (WIN64)
+			current_device_info.first = "desktop";
+			current_device_info.second = current_device_info.first;
+		#endif
+		} else {
+			auto info = d_ptr->capture.get_current_device_info();
+			current_device_info.first = "0";
+			if(info.screen_list.size() == 0)
+				current_device_info.second = "";
+			else
+				current_device_info.second = info.screen_list[0];
+		}
+	});
+}
+
 AbstractCapture::SharedPacket DesktopCapture::on_start() noexcept
 {
 	if(use_ffmpeg){
@@ -288,6 +300,7 @@ void DesktopCapture::on_stop() noexcept
 
 bool DesktopCapture::open_device() noexcept
 {
+	probe_device();
 	if(use_ffmpeg){
 		AVDictionary *options = nullptr;
 		//windows采用GDI采集桌面屏幕，比较吃资源，以后需要更换API
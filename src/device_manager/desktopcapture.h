@@ -98,6 +98,11 @@ public:
 	 */
 	virtual bool set_default_device() noexcept override;
 	
+	/**
+	 * @brief probe_device
+	 * 查找输入格式并设置当前设备名字，只执行一次
+	 */
+	virtual void probe_device() noexcept override;
 protected:
 	/**
 	 * @brief on_start
@@ -1,6 +1,7 @@
 
 #include "devicemanager.h"
 #include "../core/logger.h"
+#include <future>
 
 namespace rtplivelib {
 
@@ -23,6 +24,23 @@ DeviceManager::DeviceManager() :
 DeviceManager::~DeviceManager() {
 }
 
+void DeviceManager::probe_devices() noexcept
+{
+	//设备之间没有依赖关系，可以同时探测
+	std::future<void> camera;
+	try {
+		camera = std::async(std::launch::async,[this](){
+			camera_capture.probe_device();
+		});
+	} catch (const std::system_error&) {
+		//创建线程失败则在当前线程探测
+		camera_capture.probe_device();
+	}
+	desktop_capture.probe_device();
+	if(camera.valid())
+		camera.wait();
+}
+
 /**
  * @brief setDesktopCaptureEnable
  * 设置是否捕捉桌面画面
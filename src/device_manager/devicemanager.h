@@ -34,6 +34,14 @@ public:
 	DeviceManager(DeviceManager&) = delete;
 	DeviceManager(DeviceManager&&) = delete;
 	
+	/**
+	 * @brief probe_devices
+	 * 并行探测摄像头和桌面设备(枚举设备，选择默认设备)
+	 * 构造的时候不会探测设备，第一次使用设备的时候才会探测
+	 * 可以在后台线程调用该接口提前探测，减少第一次打开设备的耗时
+	 */
+	void probe_devices() noexcept;
+	
 	/**
 	 * @brief setDesktopCaptureEnable
 	 * 设置是否捕捉桌面画面
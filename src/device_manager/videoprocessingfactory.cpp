@@ -3,6 +3,7 @@
 #include <algorithm>
 #include "../player/videoplayer.h"
 #include "../core/time.h"
+#include "../core/frameclock.h"
 #include "../core/logger.h"
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -45,6 +46,11 @@ public:
 	//上一秒的时间戳，采用1秒多少张图片来判断每秒帧数
 	int64_t privious_ts{0};
 	uint8_t count{0};
+	//帧时钟，按绝对截止时间输出帧，避免帧间隔漂移
+	core::FrameClock clock;
+	//开始捕捉的时间，用于统计首帧耗时
+	core::Clock::TimePoint first_frame_begin;
+	bool wait_first_frame{false};
 	
 	///////////////////////
 	//转换格式用的上下文
@@ -69,21 +75,20 @@ public:
 	 * 获取最新的帧
 	 * 这个接口是为了统一获取桌面和摄像头的获取帧方式
 	 * 参数current_frame和privious_frame不共享，都是独立的
+	 * 最多等待到帧时钟的下一帧截止时间，超时则复制上一帧
+	 * (pts不在这里设置，统一由pace_frame按帧时钟设置)
 	 * @param caputre
 	 * 捕捉类，用于获取帧
 	 * @param current_frame
 	 * 当前帧,这个应该是外部调用所关注的
 	 * @param privious_frame
 	 * 上一帧
-	 * @param wait_time
-	 * 用于等待资源的时间间隔
 	 */
 	inline core::FramePacket::SharedPacket get_latest_frame(AbstractCapture* caputre,
-															core::FramePacket::SharedPacket &privious_frame,
-															const int &wait_time) {
+															core::FramePacket::SharedPacket &privious_frame) {
 		
-		//等待一个帧的时间
-		if(caputre->wait_for_resource_push(wait_time)){
+		//等待到下一帧的截止时间
+		if(caputre->wait_for_resource_push(clock.get_wait_time())){
 			//超时前获取到帧(也可能是队列本来就有帧，没有等待即返回)
 			//这里不采取特别措施，只获取最后一帧
 			privious_frame = caputre->get_latest();
@@ -99,21 +104,81 @@ public:
 			if(new_packet == nullptr)
 				return new_packet;
 			*new_packet = *privious_frame;
-			//然后修改pts和dts,为了保险起见，减6ms
-			auto time = static_cast<int64_t>(wait_time - 6);
-			//不能让time小于等于0
-			new_packet->pts +=  (time <= 0 ? 1:time)* 1000;
-			new_packet->dts = privious_frame->pts;
-			
 			privious_frame = new_packet;
 			return new_packet;
 		}
 	}
 	
-	inline void on_real_time_fps(int64_t ts) noexcept{
+	/**
+	 * @brief pace_frame
+	 * 按帧时钟节拍输出帧
+	 * 睡眠到该帧的截止时间，然后按帧序号设置pts和dts
+	 * 首帧将会启动帧时钟，并以首帧的pts作为起点，同时统计首帧耗时
+	 * @param packet
+	 * 需要输出的帧
+	 * @param fps
+	 * 当前帧率
+	 * @param callback
+	 * 回调对象，用于回调首帧耗时，可以为空
+	 * @return
+	 * 帧为空则返回false
+	 */
+	inline bool pace_frame(core::FramePacket::SharedPacket &packet,int fps,
+						   core::GlobalCallBack * callback) noexcept{
+		if(packet == nullptr)
+			return false;
+		clock.set_fps(fps);
+		if(!clock.is_running()){
+			clock.start(packet->pts);
+			on_first_frame(callback);
+		}
+		else {
+			auto missed = clock.wait_next_frame();
+			if(missed > 0){
+				core::Logger::Print("frame clock overrun,skip {} frame(s),total:{}",
+									__PRETTY_FUNCTION__,
+									LogLevel::MOREINFO_LEVEL,
+									missed,
+									clock.get_overrun_count());
+			}
+		}
+		packet->pts = packet->dts = clock.get_pts();
+		return true;
+	}
+	
+	/**
+	 * @brief begin_first_frame
+	 * 记录开始捕捉的时间，只有在还没有输出首帧的时候才记录
+	 */
+	inline void begin_first_frame() noexcept{
+		if(clock.is_running() || wait_first_frame)
+			return;
+		first_frame_begin = core::Clock::Get_Clock()->now();
+		wait_first_frame = true;
+	}
+	
+	/**
+	 * @brief on_first_frame
+	 * 输出首帧，打印并回调首帧耗时
+	 */
+	inline void on_first_frame(core::GlobalCallBack * callback) noexcept{
+		if(!wait_first_frame)
+			return;
+		wait_first_frame = false;
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+					  core::Clock::Get_Clock()->now() - first_frame_begin).count();
+		core::Logger::Print("time to first frame:{}ms",
+							__PRETTY_FUNCTION__,
+							LogLevel::INFO_LEVEL,
+							ms);
+		if(callback != nullptr)
+			callback->on_video_first_frame(static_cast<uint32_t>(ms));
+	}
+	
+	inline void on_real_time_fps(core::GlobalCallBack * callback,int64_t ts) noexcept{
 		if( ts - privious_ts > 1000000){
 			privious_ts = ts;
-			core::GlobalCallBack::Get_CallBack()->on_video_real_time_fps(count);
+			callback->on_video_real_time_fps(count);
 			count = 1;
 		} else {
 			count += 1;
@@ -295,20 +360,17 @@ void VideoProcessingFactory::on_thread_run() noexcept
 	 */
 	using namespace core;
 	
+	d_ptr->begin_first_frame();
 	if(cc_ptr != nullptr&& cc_ptr->is_running() &&
 			dc_ptr != nullptr && dc_ptr->is_running()){
 		//双开,使用的较少，因为桌面1080P需要优化，所以这里
 		//优化会推迟一点
-		int32_t wait_time;
-		wait_time = cc_ptr->get_fps() > dc_ptr->get_fps() ?
-					cc_ptr->get_fps():dc_ptr->get_fps();
-		wait_time = 1000 / wait_time;
+		auto fps = cc_ptr->get_fps() > dc_ptr->get_fps() ?
+					   cc_ptr->get_fps():dc_ptr->get_fps();
 		
-		auto before_time = Time::Now();
-		auto camera_frame = d_ptr->get_latest_frame(cc_ptr,d_ptr->privious_camera_frame,wait_time);
-		auto desktop_frame =d_ptr->get_latest_frame(dc_ptr,d_ptr->privious_desktop_frame,
-													wait_time - 
-													static_cast<int32_t>( (Time::Now() - before_time).to_timestamp() ));
+		//两次等待都以帧时钟的同一个截止时间为准
+		auto camera_frame = d_ptr->get_latest_frame(cc_ptr,d_ptr->privious_camera_frame);
+		auto desktop_frame =d_ptr->get_latest_frame(dc_ptr,d_ptr->privious_desktop_frame);
 		
 		//裁剪的判断
 		bool is_crop;
@@ -331,12 +393,13 @@ void VideoProcessingFactory::on_thread_run() noexcept
 		if(camera_frame != nullptr && desktop_frame != nullptr){
 			//合成图像,接口暂时置空不处理
 			auto merge_packet = _merge_frame(camera_frame,desktop_frame);
-			if(merge_packet == nullptr)
+			auto callback = get_callback();
+			if(d_ptr->pace_frame(merge_packet,fps,callback) == false)
 				return;
 			//回调合成图像
-			if(GlobalCallBack::Get_CallBack() != nullptr){
-				GlobalCallBack::Get_CallBack()->on_video_frame_merge(merge_packet);
-				d_ptr->on_real_time_fps(merge_packet->pts);
+			if(callback != nullptr){
+				callback->on_video_frame_merge(merge_packet);
+				d_ptr->on_real_time_fps(callback,merge_packet->pts);
 			}
 			std::lock_guard<std::mutex> lk(d_ptr->player_mutex);
 			if(d_ptr->player != nullptr)
@@ -346,14 +409,14 @@ void VideoProcessingFactory::on_thread_run() noexcept
 	}
 	else if( cc_ptr != nullptr&& cc_ptr->is_running() ){
 		//只开摄像头
-		auto packet = d_ptr->get_latest_frame(cc_ptr,d_ptr->privious_camera_frame,
-											  1000 / cc_ptr->get_fps());
-		if(packet == nullptr)
+		auto packet = d_ptr->get_latest_frame(cc_ptr,d_ptr->privious_camera_frame);
+		auto callback = get_callback();
+		if(d_ptr->pace_frame(packet,cc_ptr->get_fps(),callback) == false)
 			return;
 		//第一时间回调
-		if(GlobalCallBack::Get_CallBack() != nullptr){
-			GlobalCallBack::Get_CallBack()->on_camera_frame(packet);
-			d_ptr->on_real_time_fps(packet->pts);
+		if(callback != nullptr){
+			callback->on_camera_frame(packet);
+			d_ptr->on_real_time_fps(callback,packet->pts);
 		}
 		std::lock_guard<std::mutex> lk(d_ptr->player_mutex);
 		if(d_ptr->player != nullptr)
@@ -363,9 +426,9 @@ void VideoProcessingFactory::on_thread_run() noexcept
 	}
 	else if(dc_ptr != nullptr && dc_ptr->is_running()){
 		//只开桌面
-		auto packet =d_ptr->get_latest_frame(dc_ptr,d_ptr->privious_desktop_frame,
-											 1000 / dc_ptr->get_fps());
-		if(packet == nullptr)
+		auto packet =d_ptr->get_latest_frame(dc_ptr,d_ptr->privious_desktop_frame);
+		auto callback = get_callback();
+		if(d_ptr->pace_frame(packet,dc_ptr->get_fps(),callback) == false)
 			return;
 		
 		bool is_crop;
@@ -384,9 +447,9 @@ void VideoProcessingFactory::on_thread_run() noexcept
 			packet = new_frame;
 		}
 		//裁剪后回调
-		if(GlobalCallBack::Get_CallBack() != nullptr){
-			GlobalCallBack::Get_CallBack()->on_desktop_frame(packet);
-			d_ptr->on_real_time_fps(packet->pts);
+		if(callback != nullptr){
+			callback->on_desktop_frame(packet);
+			d_ptr->on_real_time_fps(callback,packet->pts);
 		}
 		
 		std::lock_guard<std::mutex> lk(d_ptr->player_mutex);
@@ -403,6 +466,10 @@ void VideoProcessingFactory::on_thread_run() noexcept
 
 void VideoProcessingFactory::on_thread_pause() noexcept
 {
+	//重新开始捕捉时需要重新对齐帧时钟，并重新统计首帧耗时
+	d_ptr->clock.stop();
+	d_ptr->wait_first_frame = false;
+	
 	//继续处理队列剩余的数据
 	if( dc_ptr != nullptr ){
 		dc_ptr->get_latest();
@@ -1,12 +1,15 @@
 #include "liveengine.h"
 #include "codec/videoencoder.h"
+#include "codec/simulcastencoder.h"
 #include "codec/audioencoder.h"
 #include "rtp_network/rtpsession.h"
 #include "rtp_network/rtpsendthread.h"
 #include "rtp_network/rtprecvthread.h"
 #include "rtp_network/rtpusermanager.h"
+#include "rtp_network/rtpcongestioncontroller.h"
 #include "core/logger.h"
 #include "rtp_network/fec/codec/wirehair.h"
+#include <future>
 extern "C"{
 #include "libavcodec/avcodec.h"
 }
@@ -19,12 +22,20 @@ namespace rtplivelib {
 class LiveEnginePrivateData {
 public:
 	codec::VideoEncoder * const video_encoder;
+	//联播编码，只有一层的时候video_encoder直接读取视频源
+	codec::SimulcastEncoder * const simulcast;
 	codec::AudioEncoder * const audio_encoder;
 	rtp_network::RTPSession * const video_session;
 	rtp_network::RTPSession * const audio_session;
 	rtp_network::RTPSendThread * const rtp_send;
 	rtp_network::RTPRecvThread * const rtp_recv;
 	rtp_network::RTPUserManager * const rtp_user;
+	//联播的其他层的会话，开启联播的时候才创建，下标是层，第0个不使用
+	rtp_network::RTPSession * layer_sessions[codec::SimulcastEncoder::MAX_LAYERS]{nullptr};
+	//拥塞控制，根据接收报告估计带宽，调整编码器码率和发送节拍
+	rtp_network::RTPCongestionController congestion;
+	//后台初始化(探测设备和初始化FEC编解码器)
+	std::future<void> warm_up;
 	
 	/**
 	 * @brief LiveEnginePrivateData
@@ -32,12 +43,13 @@ public:
 	 */
 	LiveEnginePrivateData():
 		video_encoder(new codec::VideoEncoder()),
+		simulcast(new codec::SimulcastEncoder(video_encoder)),
 		audio_encoder(new codec::AudioEncoder()),
 		video_session(new rtp_network::RTPSession),
 		audio_session(new rtp_network::RTPSession),
 		rtp_send(new rtp_network::RTPSendThread),
 		rtp_recv(new rtp_network::RTPRecvThread),
-		rtp_user(rtp_network::RTPUserManager::Get_user_manager())
+		rtp_user(new rtp_network::RTPUserManager)
 	{
 		
 	}
@@ -45,25 +57,28 @@ public:
 	~LiveEnginePrivateData(){
 		delete rtp_send;
 		delete rtp_recv;
+		for(auto & session:layer_sessions)
+			delete session;
+		//联播编码器会断开第0层编码器的输入，需要先释放
+		delete simulcast;
 		delete video_encoder;
 		delete audio_encoder;
-		delete video_session;
+		//音频会话可能绑定在视频会话上，需要先释放
 		delete audio_session;
-		
-		rtp_network::RTPUserManager::Release();
+		delete video_session;
+		//收发线程都会使用用户管理器，所以最后释放
+		delete rtp_user;
 	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
 
-LiveEngine::LiveEngine():
-	device(new device_manager::DeviceManager),
+LiveEngine::LiveEngine(bool headless):
+	device(headless ? nullptr : new device_manager::DeviceManager),
 	d_ptr(new LiveEnginePrivateData)
 {
 	//初始化日志等级
 	set_log_level(LogLevel::ALLINFO_LEVEL);
-	//初始化Wirehair编解码器
-	rtp_network::fec::Wirehair::InitCodec();
 	
 	//初始化socket
 #ifdef WIN64
@@ -75,12 +90,13 @@ LiveEngine::LiveEngine():
 	
 	/*在初始化的时候，关联所有类,让其可以正常工作*/
 	//设置视频输入队列，输入队列为device的video_factory
-	d_ptr->video_encoder->set_input_queue(device->get_video_factory());
+	//无界面模式下需要通过set_video_source设置
+	set_video_source(nullptr);
 	d_ptr->video_encoder->set_max_size(60);
-	device->get_video_factory()->set_max_size(60);
 	
 	//设置音频输入队列，输入队列为device的audio_factory
-	d_ptr->audio_encoder->set_input_queue(device->get_audio_factory());
+	//无界面模式下需要通过set_audio_source设置
+	set_audio_source(nullptr);
 	d_ptr->audio_encoder->set_max_size(30);
 	
 	//设置接口,只需要一个发送线程即可
@@ -97,11 +113,47 @@ LiveEngine::LiveEngine():
 	d_ptr->video_session->set_rtp_recv_object(d_ptr->rtp_recv);
 	d_ptr->audio_session->set_rtp_recv_object(d_ptr->rtp_recv);
 	
+	//用户管理器属于每个引擎，不再是全局单例
+	d_ptr->rtp_send->set_user_manager(d_ptr->rtp_user);
+	d_ptr->rtp_recv->set_user_manager(d_ptr->rtp_user);
+	
+	//拥塞控制估计出来的是总的发送码率，节拍器直接使用
+	//编码器则要扣除FEC冗余和头部的开销
+	d_ptr->congestion.set_observer([this](uint64_t bitrate){
+		d_ptr->rtp_send->set_target_bitrate(bitrate);
+		d_ptr->simulcast->set_bitrate(d_ptr->rtp_send->get_media_bitrate());
+	});
+	d_ptr->rtp_send->set_target_bitrate(d_ptr->congestion.get_target_bitrate());
+	d_ptr->simulcast->set_bitrate(d_ptr->rtp_send->get_media_bitrate());
+	d_ptr->rtp_user->set_congestion_controller(&d_ptr->congestion);
+	d_ptr->rtp_send->set_congestion_controller(&d_ptr->congestion);
+	
+	//接收端请求关键帧(PLI/FIR)的时候让对应层的编码器立即编码一个关键帧
+	d_ptr->rtp_user->set_key_frame_observer([this](uint8_t layer){
+		auto encoder = d_ptr->simulcast->get_layer_encoder(layer);
+		if(encoder != nullptr)
+			encoder->request_key_frame();
+	});
+	
+	//枚举设备和初始化Wirehair编解码器都比较耗时，而且都是在第一次使用的时候才初始化
+	//这里放到后台线程提前执行，不阻塞构造，用到的时候如果还没完成则会等待完成
+	try {
+		d_ptr->warm_up = std::async(std::launch::async,[this](){
+			rtp_network::fec::Wirehair::InitCodec();
+			if(!is_headless())
+				device->probe_devices();
+		});
+	} catch (const std::system_error&) {
+		//创建线程失败也没关系，第一次使用的时候会初始化
+	}
 }
 
 LiveEngine::~LiveEngine()
 {
-	d_ptr->video_encoder->set_input_queue(nullptr);
+	//后台初始化需要用到device，需要先等待完成
+	if(d_ptr->warm_up.valid())
+		d_ptr->warm_up.wait();
+	d_ptr->simulcast->set_input_queue(nullptr);
 	d_ptr->audio_encoder->set_input_queue(nullptr);
 	delete device;
 	delete d_ptr;
@@ -112,22 +164,31 @@ LiveEngine::~LiveEngine()
 
 void LiveEngine::set_local_microphone_audio(bool flag) noexcept
 {
+	if(is_headless())
+		return;
 	device->get_audio_factory()->play_microphone_audio(flag);
 }
 
 void LiveEngine::set_local_display_win_id(void *win_id)
 {
+	if(is_headless())
+		return;
 	device->get_video_factory()->set_display_win_id(win_id);
 }
 
 void LiveEngine::set_remote_display_win_id(void *win_id, const std::string &name)
 {
-	rtp_network::RTPUserManager::Get_user_manager()->set_show_win_id(win_id,name);
+	//无界面模式下不创建播放器
+	if(is_headless())
+		return;
+	d_ptr->rtp_user->set_show_win_id(win_id,name);
 }
 
 void LiveEngine::set_display_screen_size(const int &win_w, const int &win_h, 
 										 const int &frame_w, const int &frame_h) noexcept
 {
+	if(is_headless())
+		return;
 	device->get_video_factory()->set_display_screen_size(win_w,win_h,
 														 frame_w,frame_h);
 }
@@ -136,22 +197,58 @@ void LiveEngine::set_remote_display_screen_size(const std::string& name,
 												const int &win_w, const int &win_h, 
 												const int &frame_w, const int &frame_h) noexcept
 {
-	rtp_network::RTPUserManager::Get_user_manager()->set_screen_size(name,win_w,win_h,frame_w,frame_h);
+	if(is_headless())
+		return;
+	d_ptr->rtp_user->set_screen_size(name,win_w,win_h,frame_w,frame_h);
 }
 
 void LiveEngine::set_crop_rect(const image_processing::Rect &rect)noexcept
 {
+	if(is_headless())
+		return;
 	device->get_video_factory()->set_crop_rect(rect);
 }
 
 void LiveEngine::set_overlay_rect(const image_processing::FRect &rect) noexcept
 {
+	if(is_headless())
+		return;
 	device->get_video_factory()->set_overlay_rect(rect);
 }
 
+void LiveEngine::set_video_source(core::AbstractQueue<core::FramePacket> *source) noexcept
+{
+	if(source == nullptr && !is_headless()){
+		source = device->get_video_factory();
+		device->get_video_factory()->set_max_size(60);
+	}
+	d_ptr->simulcast->set_input_queue(source);
+}
+
+void LiveEngine::set_audio_source(core::AbstractQueue<core::FramePacket> *source) noexcept
+{
+	if(source == nullptr && !is_headless())
+		source = device->get_audio_factory();
+	d_ptr->audio_encoder->set_input_queue(source);
+}
+
+void LiveEngine::set_remote_frame_sink(const std::string &name,
+									   core::AbstractQueue<core::FramePacket> *video_sink,
+									   core::AbstractQueue<core::FramePacket> *audio_sink) noexcept
+{
+	d_ptr->rtp_user->set_frame_sink(name,video_sink,audio_sink);
+}
+
 void LiveEngine::register_call_back_object(core::GlobalCallBack *callback) noexcept
 {
-	core::GlobalCallBack::Register_CallBack(callback);
+	//回调对象只分发到该引擎的各个模块，多个引擎之间互不影响
+	d_ptr->rtp_user->set_callback(callback);
+	d_ptr->rtp_send->set_callback(callback);
+	d_ptr->rtp_recv->set_callback(callback);
+	if(is_headless())
+		return;
+	device->get_video_factory()->set_callback(callback);
+	device->get_audio_factory()->set_callback(callback);
 }
 
 bool LiveEngine::set_local_name(const std::string &name) noexcept
@@ -168,6 +265,10 @@ bool LiveEngine::join_room(const std::string& name)noexcept
 		//已经加入过房间
 		exit_room();
 	}
+	//新的房间网络情况不一样，重新开始估计带宽
+	d_ptr->congestion.reset();
+	d_ptr->rtp_send->set_target_bitrate(d_ptr->congestion.get_target_bitrate());
+	d_ptr->simulcast->set_bitrate(d_ptr->rtp_send->get_media_bitrate());
 	
 	return d_ptr->rtp_send->set_room_name(name);
 }
@@ -207,6 +308,75 @@ void *LiveEngine::get_video_encoder() noexcept
 	return d_ptr->video_encoder;
 }
 
+void LiveEngine::set_video_bitrate_range(uint64_t min_bitrate, uint64_t max_bitrate) noexcept
+{
+	d_ptr->congestion.set_bitrate_range(min_bitrate,max_bitrate);
+}
+
+uint64_t LiveEngine::get_video_target_bitrate() noexcept
+{
+	return d_ptr->congestion.get_target_bitrate();
+}
+
+void LiveEngine::set_fec_redundancy_range(float min_ratio, float max_ratio) noexcept
+{
+	d_ptr->rtp_send->set_fec_redundancy_range(min_ratio,max_ratio);
+}
+
+bool LiveEngine::set_simulcast_layers(int count) noexcept
+{
+	if(count < 1 || count > codec::SimulcastEncoder::MAX_LAYERS)
+		return false;
+	for(uint8_t n = 1; n < codec::SimulcastEncoder::MAX_LAYERS; ++n){
+		auto & session = d_ptr->layer_sessions[n];
+		if(n < count){
+			if(session == nullptr)
+				session = new rtp_network::RTPSession;
+			auto encoder = d_ptr->simulcast->get_layer_encoder(n);
+			encoder->set_max_size(60);
+			d_ptr->rtp_send->set_simulcast_layer(n,encoder,session);
+		}
+		else if(session != nullptr)
+			//会话保留下来，下次开启的时候继续使用
+			d_ptr->rtp_send->set_simulcast_layer(n,nullptr,nullptr);
+	}
+	return d_ptr->simulcast->set_layer_count(static_cast<uint8_t>(count));
+}
+
+void LiveEngine::set_remote_video_layer(const std::string &name, int layer) noexcept
+{
+	if(layer < 0 || layer >= codec::SimulcastEncoder::MAX_LAYERS)
+		return;
+	d_ptr->rtp_user->set_video_layer(name,static_cast<uint8_t>(layer));
+}
+
+void LiveEngine::set_server_address(const uint8_t *ip, uint16_t port_base, uint16_t local_port_base) noexcept
+{
+	d_ptr->rtp_send->set_server_address(ip,port_base,local_port_base);
+}
+
+void LiveEngine::set_network_impairment(const rtp_network::RTPImpairmentParams *params) noexcept
+{
+	d_ptr->rtp_send->set_network_impairment(params);
+}
+
+void LiveEngine::set_media_bundle(bool enable) noexcept
+{
+	d_ptr->rtp_send->set_media_bundle(enable);
+}
+
+PipelineCPUTime LiveEngine::get_pipeline_cpu_time() noexcept
+{
+	PipelineCPUTime time;
+	time.encode = d_ptr->simulcast->get_thread_cpu_time();
+	for(uint8_t n = 0; n < codec::SimulcastEncoder::MAX_LAYERS; ++n)
+		time.encode += d_ptr->simulcast->get_layer_encoder(n)->get_thread_cpu_time();
+	time.send = d_ptr->rtp_send->get_thread_cpu_time();
+	time.receive = d_ptr->rtp_recv->get_thread_cpu_time() + d_ptr->rtp_recv->get_worker_cpu_time();
+	time.decode = d_ptr->rtp_user->get_video_decoder_cpu_time();
+	return time;
+}
+
 void LiveEngine::set_log_level(LogLevel level) noexcept
 {
 	core::Logger::log_set_level(level);
@@ -4,15 +4,40 @@
 #include "core/config.h"
 #include "device_manager/devicemanager.h"
 #include "codec/hardwaredevice.h"
+#include "rtp_network/rtpnetworkemulator.h"
 
 namespace rtplivelib{
 
 class LiveEnginePrivateData;
 
+/**
+ * @brief The PipelineCPUTime struct
+ * 引擎各个模块的线程占用的CPU时间，单位纳秒，用于基准测试
+ * 不包括jrtplib的轮询线程(socket收发)和采集线程
+ */
+struct PipelineCPUTime {
+	//视频编码，包括联播的缩放和其他层的编码
+	int64_t encode{0};
+	//FEC编码、分包和发送
+	int64_t send{0};
+	//分发、FEC解码和组帧(接收线程和工作线程)
+	int64_t receive{0};
+	//所有远程用户的视频解码
+	int64_t decode{0};
+};
+
 class RTPLIVELIBSHARED_EXPORT LiveEngine
 {
 public:
-	LiveEngine();
+	/**
+	 * @brief LiveEngine
+	 * @param headless
+	 * 无界面模式，为true时不创建设备管理(摄像头，桌面，麦克风，声卡)，
+	 * 远程用户也不会创建SDL播放器，可以在没有X11和音频硬件的服务器上运行
+	 * 数据源通过set_video_source和set_audio_source设置，
+	 * 解码后的数据通过set_remote_frame_sink获取
+	 */
+	explicit LiveEngine(bool headless = false);
 	
 	virtual ~LiveEngine();
 	
@@ -81,6 +106,7 @@ public:
 	/**
 	 * @brief register_call_back_object
 	 * 注册回调函数的对象
+	 * 该对象只作用于当前引擎，同一进程里的多个引擎可以注册不同的回调对象
 	 */
 	void register_call_back_object(core::GlobalCallBack * callback) noexcept;
 	
@@ -161,6 +187,85 @@ public:
 	 */
 	void * get_video_encoder() noexcept;
 	
+	/**
+	 * @brief set_video_bitrate_range
+	 * 设置视频码率的范围(bit/s)，拥塞控制只会在这个范围内调整码率
+	 */
+	void set_video_bitrate_range(uint64_t min_bitrate,uint64_t max_bitrate) noexcept;
+	
+	/**
+	 * @brief get_video_target_bitrate
+	 * 获取拥塞控制估计出来的目标发送码率(bit/s)，包括FEC冗余和头部开销
+	 */
+	uint64_t get_video_target_bitrate() noexcept;
+	
+	/**
+	 * @brief set_fec_redundancy_range
+	 * 设置FEC冗余包数量占源数据包数量的比例范围
+	 * 冗余包数量会根据对方反馈的丢包率和突发丢包情况在这个范围内调整
+	 * 默认是[0.05,1.0]
+	 */
+	void set_fec_redundancy_range(float min_ratio,float max_ratio) noexcept;
+	
+	/**
+	 * @brief set_simulcast_layers
+	 * 设置联播(simulcast)的层数，每一层的分辨率是上一层的一半，使用独立的ssrc发送
+	 * 接收端可以根据自己的带宽和窗口大小选择其中一层，见set_remote_video_layer
+	 * 总码率按照9:3:1的比例分配给各层，默认只有一层(不开启联播)
+	 * @param count
+	 * [1,3]
+	 * @return
+	 * 超出范围则返回false
+	 */
+	bool set_simulcast_layers(int count) noexcept;
+	
+	/**
+	 * @brief set_remote_video_layer
+	 * 选择接收某个远程用户的哪一层视频，0是原始分辨率
+	 * 对方没有发送这一层的时候接收第0层，切换之后需要等到下一个关键帧才能显示
+	 * 经过中继的时候，中继只转发选择的这一层，切换时立即发送缓存的关键帧
+	 */
+	void set_remote_video_layer(const std::string& name,int layer) noexcept;
+	
+	/**
+	 * @brief set_server_address
+	 * 设置服务器地址和本地端口，下一次加入房间的时候生效
+	 * 默认使用config.h里的服务器，本地端口随机
+	 * 同一台机器上的两个引擎互相把对方的本地端口作为服务器端口就可以直接通信(回环测试)
+	 * @param ip
+	 * 服务器IP，4个字节
+	 * @param port_base
+	 * 服务器端口，视频x，音频x+2
+	 * @param local_port_base
+	 * 本地端口，视频x，音频x+2，0则由系统自动分配
+	 */
+	void set_server_address(const uint8_t * ip,uint16_t port_base,uint16_t local_port_base = 0) noexcept;
+	
+	/**
+	 * @brief set_network_impairment
+	 * 在发送端模拟网络损伤(丢包、延迟、乱序、带宽限制)，用于本机测试，下一次加入房间的时候生效
+	 * @param params
+	 * 损伤参数，nullptr则关闭
+	 * @see rtp_network::RTPNetworkEmulator
+	 */
+	void set_network_impairment(const rtp_network::RTPImpairmentParams * params) noexcept;
+	
+	/**
+	 * @brief set_media_bundle
+	 * 音频、视频和rtcp使用同一个socket(视频的端口)收发，按照ssrc和负载类型分流，下一次加入房间的时候生效
+	 * 每个用户少一个socket和一个轮询线程，接收和发送的系统调用也更少，适合大房间和中继
+	 * 服务器(或者对方)也需要在视频端口收发音频，同一个房间的用户需要使用相同的设置
+	 * 默认关闭
+	 * @see rtp_network::RTPSession::set_bundle_session
+	 */
+	void set_media_bundle(bool enable) noexcept;
+	
+	/**
+	 * @brief get_pipeline_cpu_time
+	 * 获取各个模块的线程启动以来占用的CPU时间，两次调用的差值除以经过的时间就是CPU占用率
+	 */
+	PipelineCPUTime get_pipeline_cpu_time() noexcept;
+	
 	/**
 	 * @brief set_log_level
 	 * 设置日志输出等级
@@ -170,10 +275,49 @@ public:
 	 */
 	void set_log_level(LogLevel level) noexcept;
 	
+	/**
+	 * @brief is_headless
+	 * 是否为无界面模式
+	 */
+	bool is_headless() noexcept;
+	
+	/**
+	 * @brief set_video_source
+	 * 设置视频编码的数据源，替换设备管理的视频处理工厂
+	 * 队列里面的帧需要是未压缩的图像帧，格式和视频处理工厂输出的一样
+	 * @param source
+	 * 数据源,传入nullptr则恢复使用设备管理的视频(无界面模式下则是停止编码)
+	 */
+	void set_video_source(core::AbstractQueue<core::FramePacket> * source) noexcept;
+	
+	/**
+	 * @brief set_audio_source
+	 * 设置音频编码的数据源，替换设备管理的音频处理工厂
+	 * @param source
+	 * 数据源,传入nullptr则恢复使用设备管理的音频(无界面模式下则是停止编码)
+	 */
+	void set_audio_source(core::AbstractQueue<core::FramePacket> * source) noexcept;
+	
+	/**
+	 * @brief set_remote_frame_sink
+	 * 设置远程用户解码后的帧的输出队列
+	 * 和set_remote_display_win_id一样，在用户退出后或者没有加入的时候设置是不会生效的
+	 * @param name
+	 * 用户名
+	 * @param video_sink
+	 * 视频帧输出队列
+	 * @param audio_sink
+	 * 音频帧输出队列
+	 */
+	void set_remote_frame_sink(const std::string& name,
+							   core::AbstractQueue<core::FramePacket> * video_sink,
+							   core::AbstractQueue<core::FramePacket> * audio_sink) noexcept;
+	
 	/**
 	 * @brief get_device_manager
 	 * 获取设备管理
 	 * @return 
+	 * 无界面模式下返回nullptr
 	 */
 	device_manager::DeviceManager		*get_device_manager() noexcept;
 private:
@@ -182,5 +326,6 @@ private:
 };
 
 inline device_manager::DeviceManager * LiveEngine::get_device_manager() noexcept			{	return device;		}
+inline bool LiveEngine::is_headless() noexcept												{	return device == nullptr;		}
 }
 
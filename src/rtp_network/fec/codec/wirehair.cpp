@@ -2,6 +2,7 @@
 #include "wirehair/wirehair.h"
 #include "../../../core/logger.h"
 #include <memory>
+#include <mutex>
 
 namespace rtplivelib {
 
@@ -28,6 +29,7 @@ Wirehair::Wirehair(FECAbstractCodec::CodecType type, uint32_t packet_size):
 	FECAbstractCodec(FountainCodes,type),
 	d_ptr(new WirehairPrivateData)
 {
+	InitCodec();
 	if(type == NotSetType || packet_size == 0)
 		return;
 	
@@ -211,16 +213,21 @@ core::Result Wirehair::data_recover(void *data) noexcept
 
 bool Wirehair::InitCodec() noexcept
 {
-	const WirehairResult initResult = wirehair_init();
-	
-	if (initResult != Wirehair_Success)
-	{
-		core::Logger::Print(wirehair_result_string(initResult),
-							__PRETTY_FUNCTION__,
-							LogLevel::WARNING_LEVEL);
-		return false;
-	} 
-	return true;
+	static std::once_flag flag;
+	static bool result{false};
+	std::call_once(flag,[](){
+		const WirehairResult initResult = wirehair_init();
+		
+		if (initResult != Wirehair_Success)
+		{
+			core::Logger::Print(wirehair_result_string(initResult),
+								__PRETTY_FUNCTION__,
+								LogLevel::WARNING_LEVEL);
+			return;
+		} 
+		result = true;
+	});
+	return result;
 }
 
 } //namespace fec
@@ -130,7 +130,8 @@ public:
 	
 	/**
 	 * @brief InitCodec
-	 * 调用该类的编解码功能需要先调用该接口初始化，只需要初始化一次即可
+	 * 初始化编解码器，整个进程只会执行一次，多个线程同时调用会等待第一次执行完成
+	 * 构造该类的时候会自动调用，也可以提前在后台线程调用，减少第一次编码的耗时
 	 * @return 
 	 */
 	static bool InitCodec() noexcept;
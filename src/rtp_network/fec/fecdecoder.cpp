@@ -1,9 +1,12 @@
 #include "fecdecoder.h"
-#include "fecencoder.h"
+#include "fecheader.h"
 #include "codec/wirehair.h"
 #include "../rtpsession.h"
+#include "../rtpnalpacketizer.h"
+#include "../../core/clock.h"
 #include "jrtplib3/rtppacket.h"
 #include <map>
+#include <deque>
 extern "C"{
 #include "libavcodec/avcodec.h"
 }
@@ -14,6 +17,19 @@ namespace rtp_network {
 
 namespace fec {
 
+constexpr int64_t FECDecoder::DEFAULT_MAX_WAIT_MS;
+
+/**
+ * @brief The TimestampLess struct
+ * 按照时间戳的先后排序，考虑翻转(和抖动缓冲区一样按照差值的符号比较)
+ * 同时存在的帧的时间戳相差很小，不会出现无法比较的情况
+ */
+struct TimestampLess {
+	inline bool operator()(uint32_t left,uint32_t right) const noexcept{
+		return static_cast<int32_t>(left - right) < 0;
+	}
+};
+
 class FECDecoderPrivateData{
 private:
 	struct NOFec{
@@ -32,23 +48,64 @@ private:
 			memcpy(d,data_vector[i],last_size);
 		}
 	};
+	/**
+	 * NAL模式下的一帧，源数据包收到就可以使用，不需要等待FEC解码
+	 * 不完整的帧在截止时间之前一直等待重传或者乱序的包
+	 */
+	struct NalFrame{
+		//保存源数据包，负载指向包里面的数据
+		std::vector<RTPPacket::SharedRTPPacket>	packets;
+		std::vector<RTPNalPacketizer::Payload>	payloads;
+		std::shared_ptr<Wirehair>				codec;
+		//FEC恢复的所有块，恢复的负载指向这里
+		std::vector<uint8_t>					slots;
+		int32_t									src_nb{0};
+		int32_t									symbol_size{0};
+		int32_t									count{0};
+		int										payload_type{0};
+		//所有源数据包都收到了或者FEC恢复了
+		bool									complete{false};
+		//收到的包的最大扩展序列号
+		uint32_t								max_seq{0};
+		//超过该时间还不完整则放弃等待，输出已经收到的NAL单元
+		core::Clock::TimePoint					deadline;
+	};
 public:
 	using Codec = std::shared_ptr<Wirehair>;
-	std::map<uint32_t,Codec> fec_map; 
-	std::map<uint32_t,NOFec> nofec_map;
-	core::FramePacket::SharedPacket next_pack;
+	std::map<uint32_t,Codec,TimestampLess> fec_map; 
+	std::map<uint32_t,NOFec,TimestampLess> nofec_map;
+	std::map<uint32_t,NalFrame,TimestampLess> nal_map;
+	//组帧完成的帧，一次解码可能输出多个帧(之前不完整的帧)
+	std::deque<core::FramePacket::SharedPacket> ready;
+	//NAL模式下最后输出的帧，比它旧的帧已经输出过了
+	bool has_output{false};
+	uint32_t last_output{0};
+	//已经输出的帧的包的最大扩展序列号，在这之前的包不再需要重传
+	uint32_t output_seq{0};
+	//不完整的帧最多等待的时间
+	int64_t max_wait{FECDecoder::DEFAULT_MAX_WAIT_MS};
+	//无法恢复的帧数
+	uint64_t lost_frames{0};
+	std::vector<uint8_t> slot_buffer;
+	std::vector<uint8_t> frame_buffer;
 	
 	inline Codec Make_Codec(){
 		return std::make_shared<Wirehair>(Wirehair::Decoder);
 	}
 	
+	/**
+	 * @brief get_correct_timestamp
+	 * 同一帧的所有包使用同一个时间戳(媒体时间)，包的位置在FEC头部里
+	 */
 	inline uint32_t get_correct_timestamp(const uint32_t &ts, const uint32_t &pos) noexcept{
-		return ts - pos;
+		UNUSED(pos)
+		return ts;
 	}
 	
 	inline void erase_fec_map(const uint32_t &timestamp) noexcept{
 		for(auto i = fec_map.begin();i != fec_map.end();){
-			if(i->first < timestamp){
+			if(TimestampLess()(i->first,timestamp)){
+				++lost_frames;
 				fec_map.erase(i++);
 			} else {
 				break;
@@ -58,7 +115,8 @@ public:
 	
 	inline void erase_nofec_map(const uint32_t &timestamp) noexcept{
 		for(auto i = nofec_map.begin();i != nofec_map.end();){
-			if(i->first < timestamp){
+			if(TimestampLess()(i->first,timestamp)){
+				++lost_frames;
 				nofec_map.erase(i++);
 			} else {
 				break;
@@ -116,7 +174,7 @@ public:
 					ptr->dts = ptr->pts = ts;
 				}
 				
-				next_pack.swap(ptr);
+				ready.push_back(ptr);
 				return core::Result::Success;
 			}
 			
@@ -126,7 +184,7 @@ public:
 				ptr.data_vector.resize(src_nb);
 				ptr.count = 0;
 				ptr.unit_size = symbol_size;
-				ptr.last_size = symbol_size - fill_size;
+				ptr.last_size = total_size - symbol_size * (src_nb - 1);
 			}
 			
 			ptr.vector[pos].swap(rtp_packet);
@@ -140,6 +198,179 @@ public:
 		}
 	}
 	
+	/**
+	 * @brief pop_nal
+	 * NAL模式的组帧，帧按照时间戳的顺序输出:
+	 * 1.一帧完成的时候，之前的帧都已经输出了才输出，否则等之前的帧完成或者超时
+	 * 2.不完整的帧到了截止时间才放弃等待，把已经收到的NAL单元输出，
+	 *   在这之前重传的包和乱序的包都还可以使用
+	 * @return 
+	 * 有帧可以取出则返回Success
+	 */
+	inline core::Result pop_nal(const uint8_t *data, const uint64_t &len,
+								const uint32_t &ts,
+								const uint32_t &seq,
+								FECParam & param,
+								const uint16_t &pos,
+								const int &payload_type,
+								RTPPacket::SharedRTPPacket &rtp_packet) noexcept{
+		auto ret = insert_nal(data,len,ts,seq,param,pos,payload_type,rtp_packet);
+		if(flush_nal())
+			return core::Result::Success;
+		return ret == core::Result::Success ? core::Result::FEC_Decode_Need_More : ret;
+	}
+	
+	/**
+	 * @brief insert_nal
+	 * 把一个包放进所属的帧:
+	 * 1.所有源数据包都收到了，该帧完成
+	 * 2.使用了FEC编码，源数据包放进块里和冗余包一起解码，解码成功后取出丢失的负载
+	 * @return 
+	 * 该帧完成则返回Success
+	 */
+	inline core::Result insert_nal(const uint8_t *data, const uint64_t &len,
+								   const uint32_t &ts,
+								   const uint32_t &seq,
+								   FECParam & param,
+								   const uint16_t &pos,
+								   const int &payload_type,
+								   RTPPacket::SharedRTPPacket &rtp_packet) noexcept{
+		auto it = nal_map.find(ts);
+		if(it == nal_map.end()){
+			//已经输出过的帧的包(比如超时之后才到的重传包)来得太晚
+			if(has_output && !TimestampLess()(last_output,ts))
+				return core::Result::FEC_Decode_Failed;
+			it = nal_map.emplace(ts,NalFrame()).first;
+			auto & frame = it->second;
+			frame.src_nb = param.get_src_nb();
+			frame.symbol_size = param.symbol_size;
+			frame.payload_type = payload_type;
+			frame.max_seq = seq;
+			frame.deadline = core::Clock::Get_Clock()->now() + std::chrono::milliseconds(max_wait);
+			frame.packets.resize(frame.src_nb);
+			frame.payloads.assign(frame.src_nb,RTPNalPacketizer::Payload(nullptr,0));
+		}
+		auto & frame = it->second;
+		if(frame.src_nb != param.get_src_nb() || frame.symbol_size != param.symbol_size)
+			return core::Result::FEC_Decode_Failed;
+		//已经完成，在等之前的帧，多余的包(重复的重传或者冗余包)不需要了
+		if(frame.complete)
+			return core::Result::FEC_Decode_Need_More;
+		if(static_cast<int32_t>(seq - frame.max_seq) > 0)
+			frame.max_seq = seq;
+		
+		core::Result ret{core::Result::FEC_Decode_Need_More};
+		auto symbol_size = static_cast<uint32_t>(frame.symbol_size);
+		if(pos < frame.src_nb){
+			if(frame.payloads[pos].first != nullptr)
+				return core::Result::FEC_Decode_Need_More;
+			frame.payloads[pos] = RTPNalPacketizer::Payload(data,len);
+			frame.packets[pos].swap(rtp_packet);
+			if(++frame.count == frame.src_nb)
+				return complete_nal(it);
+			if(!param.flag)
+				return core::Result::FEC_Decode_Need_More;
+			slot_buffer.resize(symbol_size);
+			if(!FECHeader::Pack_Slot(data,static_cast<uint32_t>(len),slot_buffer.data(),symbol_size))
+				return core::Result::FEC_Decode_Failed;
+			ret = decode_nal(frame,pos,slot_buffer.data(),symbol_size,param.size);
+		}
+		else if(param.flag)
+			ret = decode_nal(frame,pos,const_cast<uint8_t*>(data),static_cast<uint32_t>(len),param.size);
+		
+		if(ret != core::Result::Success)
+			return ret;
+		//FEC解码成功，取出丢失的负载
+		frame.slots.resize(static_cast<size_t>(frame.src_nb) * symbol_size);
+		if(frame.codec->data_recover(frame.slots.data()) == core::Result::Success){
+			for(int32_t n = 0; n < frame.src_nb; ++n){
+				if(frame.payloads[n].first != nullptr)
+					continue;
+				const uint8_t * payload{nullptr};
+				uint32_t size{0};
+				if(FECHeader::Unpack_Slot(frame.slots.data() + n * symbol_size,symbol_size,payload,size))
+					frame.payloads[n] = RTPNalPacketizer::Payload(payload,size);
+			}
+		}
+		return complete_nal(it);
+	}
+	
+	/**
+	 * @brief decode_nal
+	 * 把一个块交给FEC解码器
+	 */
+	inline core::Result decode_nal(NalFrame & frame,const uint16_t &pos,
+								   void * data,uint32_t len,int32_t total_size) noexcept{
+		if(frame.codec == nullptr){
+			frame.codec = Make_Codec();
+			if(frame.codec == nullptr)
+				return core::Result::Codec_codec_open_failed;
+			frame.codec->set_packet_size(static_cast<uint32_t>(frame.symbol_size));
+		}
+		return frame.codec->decode(pos,data,len,static_cast<uint32_t>(total_size));
+	}
+	
+	/**
+	 * @brief complete_nal
+	 * 一帧完成，等到之前的帧都输出了再输出(flush_nal)
+	 */
+	inline core::Result complete_nal(std::map<uint32_t,NalFrame,TimestampLess>::iterator it) noexcept{
+		it->second.complete = true;
+		return core::Result::Success;
+	}
+	
+	/**
+	 * @brief flush_nal
+	 * 从最旧的帧开始，输出完成的帧和到了截止时间的不完整的帧，
+	 * 遇到还在等待的帧就停下来，保证输出的顺序
+	 * @return 
+	 * 有帧输出则返回true
+	 */
+	inline bool flush_nal() noexcept{
+		auto now = core::Clock::Get_Clock()->now();
+		bool output{false};
+		for(auto i = nal_map.begin(); i != nal_map.end(); i = nal_map.erase(i)){
+			auto & frame = i->second;
+			if(!frame.complete && now < frame.deadline)
+				break;
+			push_nal(i->first,frame);
+			has_output = true;
+			last_output = i->first;
+			output_seq = frame.max_seq;
+			output = true;
+		}
+		return output;
+	}
+	
+	/**
+	 * @brief push_nal
+	 * 输出一帧，不完整的帧只有收到的NAL单元，丢失的slice需要关键帧才能恢复
+	 * 完整的关键帧设置flag，接收端据此判断是否还需要请求关键帧
+	 */
+	inline void push_nal(uint32_t ts,NalFrame & frame) noexcept{
+		auto codec = RTPNalPacketizer::Get_Codec(frame.payload_type);
+		bool complete{true},key{false};
+		for(auto & payload:frame.payloads){
+			if(payload.first == nullptr)
+				complete = false;
+			else if(!key)
+				key = RTPNalPacketizer::Is_Key_Payload(codec,payload.first,payload.second);
+		}
+		if(!complete)
+			++lost_frames;
+		//一个NAL单元都没有的帧不输出
+		if(RTPNalPacketizer::Depacketize(codec,frame.payloads,frame_buffer) == 0)
+			return;
+		auto packet = core::FramePacket::Make_Shared();
+		if(packet == nullptr || packet->data == nullptr)
+			return;
+		packet->data->copy_data_no_lock(frame_buffer.data(),frame_buffer.size());
+		packet->payload_type = frame.payload_type;
+		packet->dts = packet->pts = ts;
+		packet->flag = complete && key;
+		ready.push_back(packet);
+	}
+	
 	inline void push(const int32_t &total_size,
 					 const int &payload_type,
 					 const int32_t &flag) noexcept {
@@ -158,13 +389,13 @@ public:
 		
 		auto i = fec_map.begin();
 		if( packet == nullptr || packet->data == nullptr){
-			next_pack.swap(packet);
+			ready.push_back(packet);
 			fec_map.erase(i);
 			return;
 		} 
 		
 		if(packet->data->data_resize_no_lock(total_size) == false){
-			next_pack.swap(packet);
+			ready.push_back(packet);
 			fec_map.erase(i);
 			return;
 		}
@@ -175,7 +406,7 @@ public:
 			packet->payload_type = payload_type;
 			packet->dts = packet->pts = i->first;
 		} 
-		next_pack.swap(packet);
+		ready.push_back(packet);
 		fec_map.erase(i);
 	}
 	
@@ -185,12 +416,12 @@ public:
 		
 		auto i = nofec_map.begin();
 		if( packet == nullptr || packet->data == nullptr){
-			next_pack.swap(packet);
+			ready.push_back(packet);
 			nofec_map.erase(i);
 			return;
 		} 
 		if(packet->data->data_resize_no_lock(total_size) == false){
-			next_pack.swap(packet);
+			ready.push_back(packet);
 			nofec_map.erase(i);
 			return;
 		}
@@ -198,7 +429,7 @@ public:
 		i->second.get_data((*packet->data)[0]);
 		packet->payload_type = payload_type;
 		packet->dts = packet->pts = i->first;
-		next_pack.swap(packet);
+		ready.push_back(packet);
 		nofec_map.erase(i);
 	}
 	
@@ -222,42 +453,74 @@ FECDecoder::~FECDecoder()
 core::Result FECDecoder::decode(RTPPacket::SharedRTPPacket rtp_packet) noexcept
 {
 	jrtplib::RTPPacket * packet = static_cast<jrtplib::RTPPacket*>(rtp_packet->get_packet());
-	core::Result ret;
-	if(packet->GetExtensionData() != nullptr){
-		FECParam param;
-		memcpy(&param,packet->GetExtensionData(),sizeof(FECParam));
-		ret = d_ptr->pop(packet->GetPayloadData(),packet->GetPayloadLength(),
-						 packet->GetTimestamp(),
-						 param.get_src_nb(),
-						 param.repair_nb,
-						 param.get_fill_size(),
-						 param.symbol_size,
-						 param.size,
-						 packet->GetExtensionID(),
-						 packet->GetPayloadType(),
-						 param.flag,
-						 rtp_packet);
-	}
-	else
-		//没有fec的情况,默认只有一个包
-		ret = d_ptr->pop(packet->GetPayloadData(),packet->GetPayloadLength(),
-						 packet->GetTimestamp(),
-						 1,
-						 0,
-						 0,
-						 packet->GetPayloadLength(),
-						 packet->GetPayloadLength(),
-						 0,
-						 packet->GetPayloadType(),
-						 0,
-						 rtp_packet);
+	//负载最前面是FEC头部
+	FECParam param;
+	uint16_t pos{0};
+	auto payload = packet->GetPayloadData();
+	auto len = packet->GetPayloadLength();
+	auto header_size = FECHeader::Unpack(payload,len,param,pos);
+	//没有FEC编码的时候包的位置不能超过源数据包数量
+	if(header_size == 0 || (!param.flag && pos >= param.get_src_nb()))
+		return core::Result::FEC_Decode_Failed;
 	
+	if(param.nal)
+		return d_ptr->pop_nal(payload + header_size,len - header_size,
+							  packet->GetTimestamp(),
+							  packet->GetExtendedSequenceNumber(),
+							  param,
+							  pos,
+							  packet->GetPayloadType(),
+							  rtp_packet);
+	auto ret = d_ptr->pop(payload + header_size,len - header_size,
+					  packet->GetTimestamp(),
+					  param.get_src_nb(),
+					  param.repair_nb,
+					  param.get_fill_size(),
+					  param.symbol_size,
+					  param.size,
+					  pos,
+					  packet->GetPayloadType(),
+					  param.flag,
+					  rtp_packet);
+	if(ret == core::Result::Success)
+		d_ptr->output_seq = packet->GetExtendedSequenceNumber();
 	return ret;
 }
 
 core::FramePacket::SharedPacket FECDecoder::get_packet() noexcept
 {
-	return d_ptr->next_pack;
+	if(d_ptr->ready.empty())
+		return nullptr;
+	auto packet = d_ptr->ready.front();
+	d_ptr->ready.pop_front();
+	return packet;
+}
+
+void FECDecoder::reset() noexcept
+{
+	d_ptr->fec_map.clear();
+	d_ptr->nofec_map.clear();
+	d_ptr->nal_map.clear();
+	d_ptr->ready.clear();
+	d_ptr->has_output = false;
+	d_ptr->last_output = 0;
+	d_ptr->output_seq = 0;
+}
+
+uint64_t FECDecoder::get_lost_frame_count() noexcept
+{
+	return d_ptr->lost_frames;
+}
+
+void FECDecoder::set_max_wait_time(int64_t ms) noexcept
+{
+	if(ms >= 0)
+		d_ptr->max_wait = ms;
+}
+
+uint32_t FECDecoder::get_output_sequence() noexcept
+{
+	return d_ptr->output_seq;
 }
 
 } //namespace fec
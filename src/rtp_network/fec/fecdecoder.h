@@ -36,9 +36,39 @@ public:
 	/**
 	 * @brief get_packet
 	 * 当解码成功后，调用该接口获取数据
+	 * NAL模式下一次解码成功可能有多个帧(之前等待的帧)，需要一直获取直到返回nullptr
 	 * @return 
 	 */
 	virtual core::FramePacket::SharedPacket get_packet() noexcept;
+	
+	/**
+	 * @brief reset
+	 * 丢弃所有未完成和未取出的帧，接收的流改变(比如切换联播的层)的时候调用
+	 */
+	void reset() noexcept;
+	
+	/**
+	 * @brief get_lost_frame_count
+	 * 获取无法恢复的帧数(到了截止时间还不完整的帧)，用于判断是否需要请求关键帧
+	 */
+	uint64_t get_lost_frame_count() noexcept;
+	
+	/**
+	 * @brief set_max_wait_time
+	 * 设置NAL模式下不完整的帧最多等待的时间(毫秒)，从收到该帧的第一个包开始计算
+	 * 在这之前重传和乱序的包都可以补全该帧，之后的帧也要等它输出了才输出
+	 * 截止时间只在收到包的时候检查
+	 */
+	void set_max_wait_time(int64_t ms) noexcept;
+	
+	/**
+	 * @brief get_output_sequence
+	 * 获取已经输出的帧的包的最大扩展序列号，在这之前丢失的包不需要再重传
+	 */
+	uint32_t get_output_sequence() noexcept;
+public:
+	//默认等待的时间，足够几次NACK重传(最大rtt 150ms)
+	static constexpr int64_t DEFAULT_MAX_WAIT_MS = 250;
 private:
 	FECDecoderPrivateData * const d_ptr;
 };
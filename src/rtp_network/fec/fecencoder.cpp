@@ -1,5 +1,10 @@
 #include "fecencoder.h"
+#include "fecheader.h"
 #include "codec/wirehair.h"
+#include <cstring>
+#include <cmath>
+#include <mutex>
+#include <algorithm>
 
 namespace rtplivelib {
 
@@ -7,10 +12,33 @@ namespace rtp_network {
 
 namespace fec {
 
+//丢包数的置信系数(标准差的倍数)，非关键帧大约97%的概率可以恢复，关键帧大约99.8%
+static constexpr double DELTA_CONFIDENCE = 2.0;
+static constexpr double KEY_CONFIDENCE = 3.0;
+//可以重传的时候使用的置信系数，FEC大约恢复84%和97%的帧，其余的通过重传恢复
+static constexpr double NACK_DELTA_CONFIDENCE = 1.0;
+static constexpr double NACK_KEY_CONFIDENCE = 2.0;
+//喷泉码刚好收到源数据包数量的包时有小概率解码失败，多发一个包
+static constexpr uint32_t DECODE_OVERHEAD = 1;
+//计算编码率时使用的普通非关键帧的包数
+static constexpr uint32_t TYPICAL_SOURCE_NB = 20;
+
+constexpr float FECEncoder::DEFAULT_MIN_REDUNDANCY;
+constexpr float FECEncoder::DEFAULT_MAX_REDUNDANCY;
+
 class FECEncoderPrivateData{
 public:
 	/*编码器*/
 	Wirehair codec;
+	/*丢包统计和冗余比例范围，会在其他线程设置*/
+	std::mutex mutex;
+	float loss_rate{0};
+	float burst_length{1};
+	float min_ratio{FECEncoder::DEFAULT_MIN_REDUNDANCY};
+	float max_ratio{FECEncoder::DEFAULT_MAX_REDUNDANCY};
+	bool nack_enabled{false};
+	/*NAL模式下所有负载放进块里，编码期间需要一直有效*/
+	std::vector<uint8_t> slots;
 	
 	FECEncoderPrivateData():
 		codec(Wirehair::Encoder){
@@ -63,19 +91,107 @@ core::Result FECEncoder::encode(core::FramePacket::SharedPacket packet,
 		return core::Result::Success;
 	}
 	
-	float rate;
-	if(packet->is_key())
-		rate = 0.83f;
-	else  
-		rate = 0.9f;
-	
-	auto ret = d_ptr->codec.encode((*packet->data)[0],packet->data->size,rate,output);
 	param.size = packet->data->size;
 	param.symbol_size = d_ptr->codec.get_packet_size();
+	auto src_nb = static_cast<uint32_t>(param.get_src_nb());
+	param.repair_nb = get_repair_count(src_nb,packet->is_key());
+	
+	auto ret = d_ptr->codec.encode((*packet->data)[0],packet->data->size,src_nb + param.repair_nb,output);
 	param.flag = 1;
 	return ret;
 }
 
+core::Result FECEncoder::encode_nal(const std::vector<std::vector<uint8_t>> &payloads, bool key,
+									std::vector<std::vector<int8_t>> &repair,
+									FECParam &param) noexcept
+{
+	repair.clear();
+	auto symbol_size = d_ptr->codec.get_packet_size();
+	auto src_nb = static_cast<uint32_t>(payloads.size());
+	param.nal = 1;
+	param.flag = 0;
+	param.repair_nb = 0;
+	param.symbol_size = static_cast<int32_t>(symbol_size);
+	param.size = static_cast<int32_t>(src_nb * symbol_size);
+	if(src_nb == 0)
+		return core::Result::Invalid_Parameter;
+	//只有一个包的时候和encode一样，不编码
+	if(src_nb == 1)
+		return core::Result::Success;
+	
+	//每个负载占一个块，源数据包依旧直接发送负载，接收端按照同样的方式放进块里
+	d_ptr->slots.resize(param.size);
+	for(uint32_t n = 0; n < src_nb; ++n){
+		auto & payload = payloads[n];
+		if(!FECHeader::Pack_Slot(payload.data(),static_cast<uint32_t>(payload.size()),
+								 d_ptr->slots.data() + n * symbol_size,symbol_size))
+			return core::Result::Invalid_Parameter;
+	}
+	
+	auto repair_nb = get_repair_count(src_nb,key);
+	d_ptr->codec.set_encode_data(d_ptr->slots.data(),static_cast<uint32_t>(d_ptr->slots.size()));
+	repair.resize(repair_nb);
+	uint32_t output_size{0};
+	for(uint32_t n = 0; n < repair_nb; ++n){
+		auto ret = d_ptr->codec.encode(static_cast<uint16_t>(src_nb + n),repair[n],output_size);
+		if(ret != core::Result::Success){
+			repair.clear();
+			return ret;
+		}
+		repair[n].resize(output_size);
+	}
+	param.repair_nb = repair_nb;
+	param.flag = 1;
+	return core::Result::Success;
+}
+
+void FECEncoder::set_loss_statistics(float loss_rate, float burst_length) noexcept
+{
+	std::lock_guard<std::mutex> lk(d_ptr->mutex);
+	d_ptr->loss_rate = std::min(std::max(loss_rate,0.0f),1.0f);
+	d_ptr->burst_length = std::max(burst_length,1.0f);
+}
+
+void FECEncoder::set_redundancy_range(float min_ratio, float max_ratio) noexcept
+{
+	if(min_ratio < 0 || min_ratio > max_ratio)
+		return;
+	std::lock_guard<std::mutex> lk(d_ptr->mutex);
+	d_ptr->min_ratio = min_ratio;
+	d_ptr->max_ratio = max_ratio;
+}
+
+void FECEncoder::set_nack_enabled(bool flag) noexcept
+{
+	std::lock_guard<std::mutex> lk(d_ptr->mutex);
+	d_ptr->nack_enabled = flag;
+}
+
+uint32_t FECEncoder::get_repair_count(uint32_t src_nb, bool key) noexcept
+{
+	if(src_nb == 0)
+		return 0;
+	std::lock_guard<std::mutex> lk(d_ptr->mutex);
+	//把一帧的包看作n次伯努利试验，丢包数的均值是np，方差是np(1-p)
+	//突发丢包会让丢包数更集中，方差按照平均连续丢包长度放大(2b-1)倍
+	//冗余包数量 = 均值 + 置信系数 * 标准差
+	double n = src_nb;
+	double p = d_ptr->loss_rate;
+	double var = n * p * (1 - p) * (2 * d_ptr->burst_length - 1);
+	auto z = d_ptr->nack_enabled ? ( key ? NACK_KEY_CONFIDENCE : NACK_DELTA_CONFIDENCE ) :
+								   ( key ? KEY_CONFIDENCE : DELTA_CONFIDENCE );
+	auto repair = n * p + z * std::sqrt(var);
+	repair = std::min(std::max(repair,n * d_ptr->min_ratio),n * d_ptr->max_ratio);
+	//比例是float，减去一个很小的数避免误差导致多取一个包
+	return static_cast<uint32_t>(std::ceil(repair - 1e-6)) + DECODE_OVERHEAD;
+}
+
+float FECEncoder::get_code_rate() noexcept
+{
+	auto repair = get_repair_count(TYPICAL_SOURCE_NB,false);
+	return static_cast<float>(TYPICAL_SOURCE_NB) / (TYPICAL_SOURCE_NB + repair);
+}
+
 } //namespace fec
 
 } //namespace rtp_network
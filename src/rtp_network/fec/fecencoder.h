@@ -30,6 +30,16 @@ struct FECParam{
 	 * 非0:使用了
 	 */
 	int32_t			flag{0};
+	/*是否按照NAL单元分包(RFC6184/RFC7798)
+	 * 0:帧按照块大小切分
+	 * 非0:每个源数据包是一个标准的负载，放在一个块里(见FECHeader::Pack_Slot)，
+	 * size是所有块的大小
+	 */
+	int32_t			nal{0};
+	/*联播(simulcast)的层，0是原始分辨率，数字越大分辨率越低
+	 * 同一个用户的每一层使用不同的ssrc发送，接收端和转发服务器根据它选择需要的层
+	 */
+	int32_t			layer{0};
 	
 	inline int32_t get_fill_size() noexcept{
 		return size -  size % symbol_size;
@@ -79,11 +89,75 @@ public:
 	virtual core::Result encode(core::FramePacket::SharedPacket packet,
 								std::vector<std::vector<int8_t>> & output,
 								FECParam & param) noexcept;
+	
+	/**
+	 * @brief encode_nal
+	 * 按照NAL单元分包后的编码，每个负载作为一个源数据包
+	 * 源数据包直接发送负载，输出只有冗余包，包的位置从负载数量开始
+	 * @param payloads
+	 * 分好的负载，每个不超过块大小减去FECHeader::SLOT_HEADER_SIZE
+	 * @param key
+	 * 是否是关键帧
+	 * @param repair
+	 * 输出冗余包，原来的数据将会被擦除，只有一个负载或者编码失败的时候为空
+	 * @param param
+	 * 编码失败也会设置param
+	 */
+	core::Result encode_nal(const std::vector<std::vector<uint8_t>> & payloads,bool key,
+							std::vector<std::vector<int8_t>> & repair,
+							FECParam & param) noexcept;
+	
+	/**
+	 * @brief set_loss_statistics
+	 * 设置对方反馈的丢包情况，下一帧开始按照该丢包情况计算冗余包数量
+	 * 可以在其他线程调用
+	 * @param loss_rate
+	 * 丢包率[0,1]
+	 * @param burst_length
+	 * 平均连续丢包长度，随机丢包是1，突发丢包越严重越大
+	 */
+	void set_loss_statistics(float loss_rate,float burst_length) noexcept;
+	
+	/**
+	 * @brief set_redundancy_range
+	 * 设置冗余包数量占源数据包数量的比例范围
+	 * 网络良好的时候使用最小值，丢包严重的时候最多使用最大值
+	 * min大于max或者小于0将被忽略
+	 */
+	void set_redundancy_range(float min_ratio,float max_ratio) noexcept;
+	
+	/**
+	 * @brief set_nack_enabled
+	 * 设置丢包是否可以通过重传恢复(rtt足够小)
+	 * 可以重传的时候FEC只需要覆盖大部分的丢包，剩下的交给重传，冗余包更少
+	 * 不能重传的时候(rtt太大)完全依靠FEC
+	 */
+	void set_nack_enabled(bool flag) noexcept;
+	
+	/**
+	 * @brief get_repair_count
+	 * 根据当前的丢包情况计算需要的冗余包数量
+	 * @param src_nb
+	 * 源数据包数量
+	 * @param key
+	 * 是否是关键帧，关键帧丢失的代价更大，冗余包更多
+	 */
+	uint32_t get_repair_count(uint32_t src_nb,bool key) noexcept;
+	
+	/**
+	 * @brief get_code_rate
+	 * 获取当前丢包情况下一个普通大小的非关键帧的编码率(源数据包占所有包的比例)
+	 * 用于从发送码率中扣除FEC冗余包的开销
+	 */
+	float get_code_rate() noexcept;
+public:
+	//默认的冗余比例范围
+	static constexpr float DEFAULT_MIN_REDUNDANCY = 0.05f;
+	static constexpr float DEFAULT_MAX_REDUNDANCY = 1.0f;
 private:
 	FECEncoderPrivateData * const d_ptr;
 };
 
-
 } //namespace fec
 
 } //namespace rtp_network
@@ -0,0 +1,148 @@
+#include "fecheader.h"
+#include <cstdint>
+#include <cstring>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+namespace fec {
+
+//第一个字节的各个标志位
+static constexpr uint8_t VERSION_SHIFT = 6;
+static constexpr uint8_t FLAG_FEC = 0x20;
+static constexpr uint8_t FLAG_SYMBOL = 0x10;
+static constexpr uint8_t FLAG_ONE = 0x08;
+static constexpr uint8_t FLAG_NAL = 0x04;
+static constexpr uint8_t LAYER_MASK = 0x03;
+
+constexpr uint8_t FECHeader::VERSION;
+constexpr uint32_t FECHeader::MAX_SIZE;
+constexpr uint32_t FECHeader::SLOT_HEADER_SIZE;
+constexpr uint8_t FECHeader::MAX_LAYERS;
+constexpr int32_t FECHeader::MAX_SYMBOL_SIZE;
+constexpr int32_t FECHeader::MAX_SOURCE_NB;
+
+/**
+ * @brief write_varint
+ * 写入变长整数，返回写入的字节数
+ */
+static inline uint32_t write_varint(uint32_t value,uint8_t * output) noexcept{
+	uint32_t n = 0;
+	while(value >= 0x80){
+		output[n++] = static_cast<uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+	output[n++] = static_cast<uint8_t>(value);
+	return n;
+}
+
+/**
+ * @brief read_varint
+ * 读取变长整数，返回读取的字节数，数据不完整或者超出32位则返回0
+ */
+static inline uint32_t read_varint(const uint8_t * data,uint64_t len,uint32_t & value) noexcept{
+	value = 0;
+	for(uint32_t n = 0; n < len && n < 5; ++n){
+		//第5个字节只剩下4位有效，高位不为0则超出32位
+		if(n == 4 && (data[n] & 0x70))
+			return 0;
+		value |= static_cast<uint32_t>(data[n] & 0x7F) << (7 * n);
+		if((data[n] & 0x80) == 0)
+			return n + 1;
+	}
+	return 0;
+}
+
+uint32_t FECHeader::Pack(const FECParam &param, uint16_t pos, uint32_t payload_size, uint8_t *output) noexcept
+{
+	auto & first = output[0];
+	first = static_cast<uint8_t>(VERSION << VERSION_SHIFT);
+	if(param.nal)
+		first |= FLAG_NAL;
+	first |= static_cast<uint8_t>(param.layer) & LAYER_MASK;
+	if(param.flag)
+		first |= FLAG_FEC;
+	else if(pos == 0 && static_cast<uint32_t>(param.size) == payload_size){
+		first |= FLAG_ONE;
+		return 1;
+	}
+	uint32_t n = 1;
+	n += write_varint(pos,output + n);
+	n += write_varint(static_cast<uint32_t>(param.size),output + n);
+	if(payload_size != static_cast<uint32_t>(param.symbol_size)){
+		first |= FLAG_SYMBOL;
+		n += write_varint(static_cast<uint32_t>(param.symbol_size),output + n);
+	}
+	return n;
+}
+
+uint32_t FECHeader::Unpack(const uint8_t *data, uint64_t len, FECParam &param, uint16_t &pos) noexcept
+{
+	if(len < 1 || (data[0] >> VERSION_SHIFT) != VERSION)
+		return 0;
+	param.repair_nb = 0;
+	param.flag = (data[0] & FLAG_FEC) ? 1 : 0;
+	param.nal = (data[0] & FLAG_NAL) ? 1 : 0;
+	param.layer = data[0] & LAYER_MASK;
+	if(data[0] & FLAG_ONE){
+		if(len < 2)
+			return 0;
+		pos = 0;
+		param.size = param.symbol_size = static_cast<int32_t>(len - 1);
+		return 1;
+	}
+	uint32_t n = 1;
+	uint32_t value{0};
+	uint32_t ret;
+	if((ret = read_varint(data + n,len - n,value)) == 0 || value > UINT16_MAX)
+		return 0;
+	n += ret;
+	pos = static_cast<uint16_t>(value);
+	if((ret = read_varint(data + n,len - n,value)) == 0 || value > INT32_MAX)
+		return 0;
+	n += ret;
+	param.size = static_cast<int32_t>(value);
+	if(data[0] & FLAG_SYMBOL){
+		if((ret = read_varint(data + n,len - n,value)) == 0 || value > INT32_MAX)
+			return 0;
+		n += ret;
+		param.symbol_size = static_cast<int32_t>(value);
+	}
+	else
+		param.symbol_size = static_cast<int32_t>(len - n);
+	//块大小为0会导致后面除零
+	if(param.symbol_size <= 0 || param.size <= 0 || param.symbol_size > MAX_SYMBOL_SIZE)
+		return 0;
+	if(param.get_src_nb() > MAX_SOURCE_NB)
+		return 0;
+	return n;
+}
+
+bool FECHeader::Pack_Slot(const uint8_t *payload, uint32_t len, uint8_t *slot, uint32_t symbol_size) noexcept
+{
+	if(len + SLOT_HEADER_SIZE > symbol_size || len > UINT16_MAX)
+		return false;
+	slot[0] = static_cast<uint8_t>(len >> 8);
+	slot[1] = static_cast<uint8_t>(len);
+	memcpy(slot + SLOT_HEADER_SIZE,payload,len);
+	memset(slot + SLOT_HEADER_SIZE + len,0,symbol_size - SLOT_HEADER_SIZE - len);
+	return true;
+}
+
+bool FECHeader::Unpack_Slot(const uint8_t *slot, uint32_t symbol_size, const uint8_t *&payload, uint32_t &len) noexcept
+{
+	if(symbol_size < SLOT_HEADER_SIZE)
+		return false;
+	len = static_cast<uint32_t>(slot[0] << 8) | slot[1];
+	if(len + SLOT_HEADER_SIZE > symbol_size)
+		return false;
+	payload = slot + SLOT_HEADER_SIZE;
+	return true;
+}
+
+} //namespace fec
+
+} //namespace rtp_network
+
+} //namespace rtplivelib
@@ -0,0 +1,105 @@
+
+#pragma once
+
+#include "fecencoder.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+namespace fec {
+
+/**
+ * @brief The FECHeader class
+ * FEC负载头部，放在每个rtp包负载的最前面，代替原来放在rtp扩展头部的FECParam
+ * 格式如下，整数都是变长编码(每个字节低7位是数据，最高位表示后面还有字节):
+ * +-+-+-+-+-+-+-+-+
+ * |V=1|F|S|O|N| L |
+ * +-+-+-+-+-+-+-+-+
+ * | 包的位置(变长)  |  O=0
+ * | 帧大小(变长)    |  O=0
+ * | 块大小(变长)    |  O=0且S=1
+ * V:版本号
+ * F:是否使用了FEC编码
+ * N:负载按照NAL单元分包(见FECParam::nal)
+ * L:联播(simulcast)的层，0是原始分辨率，见FECParam::layer
+ * S:该包的负载大小不是块大小(最后一个源数据包或者NAL模式的源数据包)，需要带上块大小，
+ *   其他包的块大小就是负载大小
+ * O:整帧只有一个包，后面没有其他字段，帧大小就是负载大小
+ * 冗余包数量接收端不需要，不再发送
+ * 这样一个1KB左右的包头部只需要5字节左右，小的音频帧只需要1字节
+ */
+class RTPLIVELIBSHARED_EXPORT FECHeader
+{
+public:
+	/**
+	 * @brief Pack
+	 * 写入头部
+	 * @param param
+	 * 帧的FEC参数
+	 * @param pos
+	 * 包的位置
+	 * @param payload_size
+	 * 该包的负载大小(不包括头部)
+	 * @param output
+	 * 输出，至少要有MAX_SIZE字节
+	 * @return
+	 * 头部的大小
+	 */
+	static uint32_t Pack(const FECParam & param,uint16_t pos,uint32_t payload_size,uint8_t * output) noexcept;
+
+	/**
+	 * @brief Unpack
+	 * 解析头部
+	 * @param data
+	 * rtp包的负载
+	 * @param len
+	 * 负载长度
+	 * @param param
+	 * 输出帧的FEC参数，repair_nb总是0
+	 * @param pos
+	 * 输出包的位置
+	 * @return
+	 * 头部的大小，版本不对、数据不完整或者参数超出范围则返回0
+	 * 块大小不能超过MAX_SYMBOL_SIZE，源数据包数量不能超过MAX_SOURCE_NB，
+	 * 否则一个伪造的包就能让解码器分配几个GB的内存
+	 */
+	static uint32_t Unpack(const uint8_t * data,uint64_t len,FECParam & param,uint16_t & pos) noexcept;
+
+	/**
+	 * @brief Pack_Slot
+	 * NAL模式下把一个负载放进一个块:2字节长度 + 负载 + 填充0
+	 * @param slot
+	 * 输出，大小为块大小
+	 * @return
+	 * 负载太大则返回false
+	 */
+	static bool Pack_Slot(const uint8_t * payload,uint32_t len,uint8_t * slot,uint32_t symbol_size) noexcept;
+
+	/**
+	 * @brief Unpack_Slot
+	 * 从块里取出负载
+	 * @return
+	 * 长度不对则返回false
+	 */
+	static bool Unpack_Slot(const uint8_t * slot,uint32_t symbol_size,const uint8_t *& payload,uint32_t & len) noexcept;
+public:
+	//当前版本号
+	static constexpr uint8_t VERSION = 1;
+	//头部最大的大小
+	static constexpr uint32_t MAX_SIZE = 1 + 3 + 5 + 5;
+	//NAL模式下块里面长度字段的大小
+	static constexpr uint32_t SLOT_HEADER_SIZE = 2;
+	//L字段能表示的层数
+	static constexpr uint8_t MAX_LAYERS = 4;
+	//块大小的上限:udp包最大的负载减去rtp头部
+	static constexpr int32_t MAX_SYMBOL_SIZE = 65507 - 12;
+	//一帧源数据包数量的上限，包的位置是16位
+	static constexpr int32_t MAX_SOURCE_NB = 65536;
+};
+
+} //namespace fec
+
+} //namespace rtp_network
+
+} //namespace rtplivelib
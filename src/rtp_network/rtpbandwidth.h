@@ -17,7 +17,7 @@ class RTPLIVELIBSHARED_EXPORT RTPBandwidth
 public:
 	template<typename CallBack>
 	RTPBandwidth(CallBack cb):
-		timer([&cb,this](){
+		timer([cb,this]() mutable {
 			cb(get_speed(),get_total());
 			reset_speed();})
 	{
@@ -0,0 +1,523 @@
+#include "rtpbatchtransmitter.h"
+#include "rtppackethistory.h"
+#include "../core/logger.h"
+#include "jrtplib3/rtpipv4address.h"
+#include "jrtplib3/rtperrors.h"
+#include "jrtplib3/rtprawpacket.h"
+#include "jrtplib3/rtptimeutilities.h"
+#include "jrtplib3/rtpstructs.h"
+#include <algorithm>
+#include <cstring>
+#if defined (unix)
+#include <sys/socket.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#endif
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+RTPBatchTransmitter::RTPBatchTransmitter(jrtplib::RTPMemoryManager *mgr):
+	jrtplib::RTPUDPv4Transmitter(mgr)
+{
+	_buffer.reserve(MAX_BATCH_PACKETS * 1500);
+	_offsets.reserve(MAX_BATCH_PACKETS);
+}
+
+RTPBatchTransmitter::~RTPBatchTransmitter()
+{
+	_clear_raw_packets();
+}
+
+int RTPBatchTransmitter::Create(size_t maxpacksize, const jrtplib::RTPTransmissionParams *transparams)
+{
+	auto ret = jrtplib::RTPUDPv4Transmitter::Create(maxpacksize,transparams);
+	if(ret < 0)
+		return ret;
+#if defined (unix)
+	//父类的socket是私有的，只能通过传输信息获取
+	auto info = static_cast<jrtplib::RTPUDPv4TransmissionInfo *>(GetTransmissionInfo());
+	if(info != nullptr){
+		std::lock_guard<std::mutex> lk(_mutex);
+		std::lock_guard<std::mutex> recv_lk(_recv_mutex);
+		_socket = info->GetRTPSocket();
+		_rtcp_socket = info->GetRTCPSocket();
+		DeleteTransmissionInfo(info);
+		
+		//预先分配接收缓冲区，接收的时候不再分配
+		_recv_buffer.resize(MAX_RECV_PACKETS * RECV_SLOT_SIZE);
+		_recv_addrs.resize(MAX_RECV_PACKETS);
+		_recv_iovs.resize(MAX_RECV_PACKETS);
+		_recv_msgs.resize(MAX_RECV_PACKETS);
+		for(size_t n = 0; n < MAX_RECV_PACKETS; ++n){
+			_recv_iovs[n].iov_base = _recv_buffer.data() + n * RECV_SLOT_SIZE;
+			_recv_iovs[n].iov_len = RECV_SLOT_SIZE;
+		}
+	}
+#endif
+	return ret;
+}
+
+void RTPBatchTransmitter::Destroy()
+{
+	{
+		//和Create一样锁住两个锁，发送和接收都会读取socket
+		std::lock_guard<std::mutex> lk(_mutex);
+		std::lock_guard<std::mutex> recv_lk(_recv_mutex);
+		_batching = false;
+		_buffer.clear();
+		_offsets.clear();
+#if defined (unix)
+		_socket = -1;
+		_rtcp_socket = -1;
+		_destinations.clear();
+#endif
+	}
+	_clear_raw_packets();
+	jrtplib::RTPUDPv4Transmitter::Destroy();
+}
+
+int RTPBatchTransmitter::SendRTPData(const void *data, size_t len)
+{
+	//jrtplib在这里已经填好了序列号和时间戳，保存下来重传的时候原样发送
+	auto history = _history.load();
+	if(history != nullptr)
+		history->put(data,len);
+	return _send_rtp_data(data,len);
+}
+
+int RTPBatchTransmitter::_send_rtp_data(const void *data, size_t len) noexcept
+{
+	std::unique_lock<std::mutex> lk(_mutex);
+	if(!_batching){
+		lk.unlock();
+		return jrtplib::RTPUDPv4Transmitter::SendRTPData(data,len);
+	}
+
+	auto ptr = static_cast<const uint8_t *>(data);
+	_offsets.push_back(_buffer.size());
+	_buffer.insert(_buffer.end(),ptr,ptr + len);
+	//缓存太多则先发送一部分，避免占用太多内存
+	if(_offsets.size() >= MAX_BATCH_PACKETS)
+		return _send_batch();
+	return 0;
+}
+
+int RTPBatchTransmitter::AddDestination(const jrtplib::RTPAddress &addr)
+{
+	auto ret = jrtplib::RTPUDPv4Transmitter::AddDestination(addr);
+	if(ret < 0)
+		return ret;
+#if defined (unix)
+	if(addr.GetAddressType() != jrtplib::RTPAddress::IPv4Address)
+		return ret;
+	auto & address = static_cast<const jrtplib::RTPIPv4Address &>(addr);
+	sockaddr_in dest;
+	memset(&dest,0,sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl(address.GetIP());
+	dest.sin_port = htons(address.GetPort());
+	std::lock_guard<std::mutex> lk(_mutex);
+	_destinations.push_back(dest);
+#endif
+	return ret;
+}
+
+int RTPBatchTransmitter::DeleteDestination(const jrtplib::RTPAddress &addr)
+{
+	auto ret = jrtplib::RTPUDPv4Transmitter::DeleteDestination(addr);
+	if(ret < 0)
+		return ret;
+#if defined (unix)
+	if(addr.GetAddressType() != jrtplib::RTPAddress::IPv4Address)
+		return ret;
+	auto & address = static_cast<const jrtplib::RTPIPv4Address &>(addr);
+	auto ip = htonl(address.GetIP());
+	auto port = htons(address.GetPort());
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto it = std::find_if(_destinations.begin(),_destinations.end(),
+						   [ip,port](const sockaddr_in & dest){
+		return dest.sin_addr.s_addr == ip && dest.sin_port == port;
+	});
+	if(it != _destinations.end())
+		_destinations.erase(it);
+#endif
+	return ret;
+}
+
+void RTPBatchTransmitter::ClearDestinations()
+{
+	jrtplib::RTPUDPv4Transmitter::ClearDestinations();
+#if defined (unix)
+	std::lock_guard<std::mutex> lk(_mutex);
+	_destinations.clear();
+#endif
+}
+
+int RTPBatchTransmitter::SetReceiveMode(jrtplib::RTPTransmitter::ReceiveMode m)
+{
+	auto ret = jrtplib::RTPUDPv4Transmitter::SetReceiveMode(m);
+	if(ret < 0)
+		return ret;
+	std::lock_guard<std::mutex> lk(_recv_mutex);
+	_accept_all = m == jrtplib::RTPTransmitter::AcceptAll;
+	return ret;
+}
+
+int RTPBatchTransmitter::Poll()
+{
+#if defined (unix)
+	std::unique_lock<std::mutex> lk(_recv_mutex);
+	//需要过滤地址的时候交给父类处理
+	if(_socket < 0 || !_accept_all){
+		lk.unlock();
+		return jrtplib::RTPUDPv4Transmitter::Poll();
+	}
+	
+	auto ret = _poll_socket(_socket,true);
+	if(ret < 0)
+		return ret;
+	//rtp和rtcp不复用同一个端口的时候，rtcp还有另外一个socket
+	if(_rtcp_socket >= 0 && _rtcp_socket != _socket)
+		ret = _poll_socket(_rtcp_socket,false);
+	return ret;
+#else
+	return jrtplib::RTPUDPv4Transmitter::Poll();
+#endif
+}
+
+bool RTPBatchTransmitter::NewDataAvailable()
+{
+	{
+		std::lock_guard<std::mutex> lk(_recv_mutex);
+		if(!_raw_packets.empty())
+			return true;
+	}
+	return jrtplib::RTPUDPv4Transmitter::NewDataAvailable();
+}
+
+jrtplib::RTPRawPacket *RTPBatchTransmitter::GetNextPacket()
+{
+	while(true){
+		jrtplib::RTPRawPacket * packet{nullptr};
+		{
+			std::lock_guard<std::mutex> lk(_recv_mutex);
+			if(!_raw_packets.empty()){
+				packet = _raw_packets.front();
+				_raw_packets.pop_front();
+			}
+		}
+		if(packet == nullptr)
+			packet = jrtplib::RTPUDPv4Transmitter::GetNextPacket();
+		//属于其他会话的包由分流器处理，继续取下一个
+		if(packet == nullptr || !_demuxer || !_demuxer(*packet))
+			return packet;
+		RTPDelete(packet,GetMemoryManager());
+	}
+}
+
+void RTPBatchTransmitter::begin_batch() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_batching = true;
+}
+
+int RTPBatchTransmitter::flush_batch() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_batching = false;
+	return _send_batch();
+}
+
+int RTPBatchTransmitter::_send_batch() noexcept
+{
+	if(_offsets.empty())
+		return 0;
+#if defined (unix)
+	if(_socket < 0)
+		return _send_one_by_one();
+
+	auto packet_size = [this](size_t index){
+		auto end = index + 1 < _offsets.size() ? _offsets[index + 1] : _buffer.size();
+		return end - _offsets[index];
+	};
+
+	//先把包分组，连续等长的包(最后一个可以短一点)合并成一个GSO包
+	struct Group {
+		size_t offset;
+		size_t size;
+		uint16_t segment;
+	};
+	std::vector<Group> groups;
+	groups.reserve(_offsets.size());
+	for(size_t i = 0; i < _offsets.size();){
+		auto seg = packet_size(i);
+		auto total = seg;
+		auto j = i + 1;
+#if defined (UDP_SEGMENT)
+		if(_gso_enable){
+			while(j < _offsets.size() && j - i < MAX_GSO_SEGMENTS &&
+				  total + packet_size(j) <= MAX_GSO_SIZE){
+				auto size = packet_size(j);
+				if(size > seg)
+					break;
+				total += size;
+				++j;
+				//短包只能是最后一个分片
+				if(size < seg)
+					break;
+			}
+		}
+#endif
+		groups.push_back(Group{_offsets[i],total,static_cast<uint16_t>(j - i > 1 ? seg : 0)});
+		i = j;
+	}
+
+	auto count = groups.size() * _destinations.size();
+	std::vector<mmsghdr> msgs(count);
+	std::vector<iovec> iovs(count);
+#if defined (UDP_SEGMENT)
+	std::vector<char> controls(count * CMSG_SPACE(sizeof(uint16_t)),0);
+#endif
+	size_t n = 0;
+	for(auto & dest : _destinations){
+		for(auto & group : groups){
+			memset(&msgs[n],0,sizeof(mmsghdr));
+			iovs[n].iov_base = _buffer.data() + group.offset;
+			iovs[n].iov_len = group.size;
+			auto & hdr = msgs[n].msg_hdr;
+			hdr.msg_name = &dest;
+			hdr.msg_namelen = sizeof(sockaddr_in);
+			hdr.msg_iov = &iovs[n];
+			hdr.msg_iovlen = 1;
+#if defined (UDP_SEGMENT)
+			if(group.segment != 0){
+				hdr.msg_control = controls.data() + n * CMSG_SPACE(sizeof(uint16_t));
+				hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+				auto cm = CMSG_FIRSTHDR(&hdr);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				memcpy(CMSG_DATA(cm),&group.segment,sizeof(uint16_t));
+			}
+#endif
+			++n;
+		}
+	}
+
+	auto sent = _send_messages(msgs,_socket);
+	auto error = errno;
+	if(sent < count && msgs[sent].msg_hdr.msg_controllen != 0){
+		//内核或者网卡不支持GSO才以后都不再使用，ENOBUFS、EAGAIN这些暂时的错误下一次继续使用
+		if(error == EIO || error == EINVAL || error == ENOPROTOOPT){
+			_gso_enable = false;
+			core::Logger::Print("UDP GSO unsupported({}),fall back to sendmmsg",
+								__PRETTY_FUNCTION__,
+								LogLevel::INFO_LEVEL,
+								error);
+		}
+		//剩下没有发送的GSO包拆成单独的包重新发送
+		std::vector<iovec> rest_iovs;
+		rest_iovs.reserve(_offsets.size() * _destinations.size());
+		std::vector<mmsghdr> rest;
+		for(auto index = sent; index < count; ++index){
+			auto & group = groups[index % groups.size()];
+			size_t seg = group.segment != 0 ? group.segment : group.size;
+			for(size_t pos = 0; pos < group.size; pos += seg){
+				iovec iov;
+				iov.iov_base = _buffer.data() + group.offset + pos;
+				iov.iov_len = std::min(seg,group.size - pos);
+				rest_iovs.push_back(iov);
+				mmsghdr msg;
+				memset(&msg,0,sizeof(mmsghdr));
+				msg.msg_hdr.msg_name = msgs[index].msg_hdr.msg_name;
+				msg.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+				msg.msg_hdr.msg_iov = &rest_iovs.back();
+				msg.msg_hdr.msg_iovlen = 1;
+				rest.push_back(msg);
+			}
+		}
+		_send_messages(rest,_socket);
+	}
+	_buffer.clear();
+	_offsets.clear();
+	return 0;
+#else
+	return _send_one_by_one();
+#endif
+}
+
+int RTPBatchTransmitter::send_to(uint32_t ip, uint16_t port,
+								 const std::vector<Buffer> &packets, bool rtp) noexcept
+{
+	if(packets.empty())
+		return 0;
+#if defined (unix)
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto socket = rtp ? _socket : _rtcp_socket;
+	if(socket < 0)
+		return ERR_RTP_UDPV4TRANS_NOTCREATED;
+	sockaddr_in dest;
+	memset(&dest,0,sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl(ip);
+	dest.sin_port = htons(port);
+	
+	//所有消息指向同一个地址，数据直接指向调用者的缓冲区
+	std::vector<mmsghdr> msgs(packets.size());
+	std::vector<iovec> iovs(packets.size());
+	for(size_t n = 0; n < packets.size(); ++n){
+		memset(&msgs[n],0,sizeof(mmsghdr));
+		iovs[n].iov_base = const_cast<void *>(packets[n].first);
+		iovs[n].iov_len = packets[n].second;
+		auto & hdr = msgs[n].msg_hdr;
+		hdr.msg_name = &dest;
+		hdr.msg_namelen = sizeof(sockaddr_in);
+		hdr.msg_iov = &iovs[n];
+		hdr.msg_iovlen = 1;
+	}
+	_send_messages(msgs,socket);
+	return 0;
+#else
+	//父类只能发送给目标地址列表，临时添加目标地址
+	jrtplib::RTPIPv4Address address(ip,port);
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto ret = jrtplib::RTPUDPv4Transmitter::AddDestination(address);
+	if(ret < 0)
+		return ret;
+	for(auto & packet : packets){
+		if(rtp)
+			jrtplib::RTPUDPv4Transmitter::SendRTPData(packet.first,packet.second);
+		else
+			jrtplib::RTPUDPv4Transmitter::SendRTCPData(packet.first,packet.second);
+	}
+	jrtplib::RTPUDPv4Transmitter::DeleteDestination(address);
+	return 0;
+#endif
+}
+
+#if defined (unix)
+size_t RTPBatchTransmitter::_send_messages(std::vector<mmsghdr> &msgs,int socket) noexcept
+{
+	size_t sent = 0;
+	while(sent < msgs.size()){
+		auto ret = sendmmsg(socket,msgs.data() + sent,static_cast<unsigned int>(msgs.size() - sent),0);
+		++_syscall_count;
+		if(ret > 0){
+			sent += static_cast<size_t>(ret);
+			continue;
+		}
+		if(errno == EINTR)
+			continue;
+		//GSO包发送失败由调用者处理，其他错误则丢弃剩下的包(和sendto一样，udp不保证送达)
+		if(msgs[sent].msg_hdr.msg_controllen == 0){
+			core::Logger::Print("sendmmsg failed({}),drop {} packet(s)",
+								__PRETTY_FUNCTION__,
+								LogLevel::WARNING_LEVEL,
+								errno,
+								msgs.size() - sent);
+		}
+		break;
+	}
+	return sent;
+}
+#endif
+
+#if defined (unix)
+int RTPBatchTransmitter::_poll_socket(int socket, bool rtp) noexcept
+{
+	while(true){
+		for(size_t n = 0; n < MAX_RECV_PACKETS; ++n){
+			memset(&_recv_msgs[n],0,sizeof(mmsghdr));
+			auto & hdr = _recv_msgs[n].msg_hdr;
+			hdr.msg_name = &_recv_addrs[n];
+			hdr.msg_namelen = sizeof(sockaddr_in);
+			hdr.msg_iov = &_recv_iovs[n];
+			hdr.msg_iovlen = 1;
+		}
+		
+		auto ret = recvmmsg(socket,_recv_msgs.data(),MAX_RECV_PACKETS,MSG_DONTWAIT,nullptr);
+		++_recv_syscall_count;
+		if(ret < 0){
+			if(errno == EINTR)
+				continue;
+			//EAGAIN说明已经读完了，其他错误和父类一样忽略
+			break;
+		}
+		
+		//同一批包使用同一个接收时间
+		auto recv_time = jrtplib::RTPTime::CurrentTime();
+		for(int n = 0; n < ret; ++n){
+			auto & msg = _recv_msgs[static_cast<size_t>(n)];
+			auto len = static_cast<size_t>(msg.msg_len);
+			if(len == 0)
+				continue;
+			if(msg.msg_hdr.msg_flags & MSG_TRUNC){
+				core::Logger::Print("drop truncated packet({} bytes)",
+									__PRETTY_FUNCTION__,
+									LogLevel::WARNING_LEVEL,
+									len);
+				continue;
+			}
+			auto data = static_cast<uint8_t *>(_recv_iovs[static_cast<size_t>(n)].iov_base);
+			auto & from = _recv_addrs[static_cast<size_t>(n)];
+			
+			bool is_rtp = rtp;
+			//rtp和rtcp复用同一个socket，根据包类型区分(和父类的判断一样)
+			if(_socket == _rtcp_socket){
+				is_rtp = true;
+				if(len > sizeof(jrtplib::RTCPCommonHeader)){
+					auto header = reinterpret_cast<jrtplib::RTCPCommonHeader *>(data);
+					if(header->packettype >= 200 && header->packettype <= 204)
+						is_rtp = false;
+				}
+			}
+			
+			auto mgr = GetMemoryManager();
+			auto address = RTPNew(mgr,RTPMEM_TYPE_CLASS_RTPADDRESS)
+						   jrtplib::RTPIPv4Address(ntohl(from.sin_addr.s_addr),ntohs(from.sin_port));
+			auto copy = RTPNew(mgr,is_rtp ? RTPMEM_TYPE_BUFFER_RECEIVEDRTPPACKET :
+											RTPMEM_TYPE_BUFFER_RECEIVEDRTCPPACKET) uint8_t[len];
+			memcpy(copy,data,len);
+			auto packet = RTPNew(mgr,RTPMEM_TYPE_CLASS_RTPRAWPACKET)
+						  jrtplib::RTPRawPacket(copy,len,address,recv_time,is_rtp,mgr);
+			_raw_packets.push_back(packet);
+		}
+		
+		//没有填满说明socket已经读完了
+		if(static_cast<size_t>(ret) < MAX_RECV_PACKETS)
+			break;
+	}
+	return 0;
+}
+#endif
+
+void RTPBatchTransmitter::_clear_raw_packets() noexcept
+{
+	std::lock_guard<std::mutex> lk(_recv_mutex);
+	for(auto & packet : _raw_packets)
+		RTPDelete(packet,GetMemoryManager());
+	_raw_packets.clear();
+}
+
+int RTPBatchTransmitter::_send_one_by_one() noexcept
+{
+	int result = 0;
+	for(size_t i = 0; i < _offsets.size(); ++i){
+		auto end = i + 1 < _offsets.size() ? _offsets[i + 1] : _buffer.size();
+		auto ret = jrtplib::RTPUDPv4Transmitter::SendRTPData(_buffer.data() + _offsets[i],
+															  end - _offsets[i]);
+		++_syscall_count;
+		if(ret < 0 && result == 0)
+			result = ret;
+	}
+	_buffer.clear();
+	_offsets.clear();
+	return result;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,241 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "jrtplib3/rtpudpv4transmitter.h"
+#include <vector>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#if defined (unix)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+class RTPPacketHistory;
+
+/**
+ * @brief The RTPBatchTransmitter class
+ * 批量发送的UDP传输器，继承jrtplib的RTPUDPv4Transmitter
+ * 一帧数据经过FEC编码后会分成几十甚至上百个rtp包，原来每个包都要调用一次sendto
+ * 调用begin_batch后，SendRTPData不再立即发送，而是把rtp包缓存起来，
+ * 调用flush_batch的时候再一次性发送给所有目标地址
+ * Linux下使用sendmmsg一次系统调用发送多个包，如果内核支持UDP GSO(UDP_SEGMENT)，
+ * 还会把连续等长的包合并成一个大包交给内核分片，进一步减少系统调用和协议栈开销
+ * 其他平台则退化成逐个包发送
+ * rtcp包不受影响，依旧立即发送
+ *
+ * 接收也是批量的:父类每个包调用一次recvfrom，这里Poll使用recvmmsg一次性把socket
+ * 缓冲区里的包读到预先分配好的缓冲区，再生成jrtplib的RTPRawPacket交给会话处理
+ * 只有在接收所有地址的包(AcceptAll)的时候才使用，否则交给父类处理
+ * 多个会话共用一个socket(bundle)的时候，收到的包先经过分流器，属于其他会话的包不再交给该会话
+ * 注:该类由RTPSession创建和释放(通过NewUserDefinedTransmitter)
+ */
+class RTPBatchTransmitter : public jrtplib::RTPUDPv4Transmitter
+{
+public:
+	//一个需要发送的包:数据和长度，数据由调用者持有
+	using Buffer = std::pair<const void *,size_t>;
+	/**
+	 * @brief Demuxer
+	 * 分流器，在轮询线程调用，返回true表示该包已经交给其他会话，传输器直接释放
+	 */
+	using Demuxer = std::function<bool(jrtplib::RTPRawPacket &)>;
+public:
+	explicit RTPBatchTransmitter(jrtplib::RTPMemoryManager *mgr);
+
+	~RTPBatchTransmitter() override;
+
+	int Create(size_t maxpacksize,const jrtplib::RTPTransmissionParams *transparams) override;
+
+	void Destroy() override;
+
+	int SendRTPData(const void *data,size_t len) override;
+
+	int AddDestination(const jrtplib::RTPAddress &addr) override;
+
+	int DeleteDestination(const jrtplib::RTPAddress &addr) override;
+
+	void ClearDestinations() override;
+
+	int SetReceiveMode(jrtplib::RTPTransmitter::ReceiveMode m) override;
+
+	int Poll() override;
+
+	bool NewDataAvailable() override;
+
+	jrtplib::RTPRawPacket *GetNextPacket() override;
+
+	/**
+	 * @brief begin_batch
+	 * 开始批量发送，之后的rtp包都会缓存起来，直到调用flush_batch
+	 */
+	void begin_batch() noexcept;
+
+	/**
+	 * @brief flush_batch
+	 * 发送缓存的所有rtp包，并结束批量发送
+	 * @return
+	 * 成功返回0，失败返回jrtplib的错误码(小于0)
+	 */
+	int flush_batch() noexcept;
+
+	/**
+	 * @brief get_syscall_count
+	 * 获取批量发送时调用的系统调用次数，用于统计
+	 */
+	uint64_t get_syscall_count() noexcept;
+
+	/**
+	 * @brief get_recv_syscall_count
+	 * 获取批量接收时调用的系统调用次数，用于统计
+	 */
+	uint64_t get_recv_syscall_count() noexcept;
+
+	/**
+	 * @brief set_packet_history
+	 * 设置历史记录，之后通过SendRTPData发送的rtp包都会保存一份
+	 */
+	void set_packet_history(RTPPacketHistory * history) noexcept;
+
+	/**
+	 * @brief resend_rtp_data
+	 * 重传rtp包，和SendRTPData一样(批量发送的时候也会缓存)，只是不保存到历史记录
+	 */
+	int resend_rtp_data(const void *data,size_t len) noexcept;
+
+	/**
+	 * @brief send_to
+	 * 把多个包发送给指定的地址，不经过目标地址列表，也不保存到历史记录，用于中继转发
+	 * 数据不会拷贝，Linux下一次sendmmsg发送，其他平台逐个包发送
+	 * @param ip
+	 * 目标IP(主机字节序)
+	 * @param port
+	 * 目标端口
+	 * @param packets
+	 * 需要发送的包
+	 * @param rtp
+	 * 是否是rtp包，rtp和rtcp不复用端口的时候，rtcp包从rtcp的socket发送
+	 * @return
+	 * 成功返回0，失败返回jrtplib的错误码(小于0)
+	 */
+	int send_to(uint32_t ip,uint16_t port,const std::vector<Buffer> & packets,bool rtp) noexcept;
+
+	/**
+	 * @brief set_demuxer
+	 * 设置分流器，需要在Create之前设置(轮询线程开始之后不能再修改)
+	 */
+	void set_demuxer(Demuxer demuxer) noexcept;
+protected:
+	/**
+	 * @brief _send_rtp_data
+	 * 发送或者缓存rtp包，SendRTPData和resend_rtp_data最终都是调用该函数
+	 */
+	virtual int _send_rtp_data(const void *data,size_t len) noexcept;
+private:
+
+	/**
+	 * @brief _send_batch
+	 * 批量发送的具体实现，调用前需要锁住_mutex
+	 */
+	int _send_batch() noexcept;
+
+#if defined (unix)
+	/**
+	 * @brief _send_messages
+	 * 调用sendmmsg发送所有消息，被信号中断则继续发送
+	 * @param socket
+	 * 发送使用的socket
+	 * @return
+	 * 返回成功发送的消息数，小于消息总数则是发送失败
+	 */
+	size_t _send_messages(std::vector<mmsghdr> & msgs,int socket) noexcept;
+#endif
+
+	/**
+	 * @brief _send_one_by_one
+	 * 逐个包发送，不支持sendmmsg的平台使用
+	 */
+	int _send_one_by_one() noexcept;
+
+#if defined (unix)
+	/**
+	 * @brief _poll_socket
+	 * 使用recvmmsg读取socket里面的所有包，直到没有数据为止
+	 * @param socket
+	 * 需要读取的socket
+	 * @param rtp
+	 * 是否是rtp的socket，rtp和rtcp复用同一个socket的时候需要根据包类型判断
+	 */
+	int _poll_socket(int socket,bool rtp) noexcept;
+#endif
+
+	/**
+	 * @brief _clear_raw_packets
+	 * 释放还没有被取走的包
+	 */
+	void _clear_raw_packets() noexcept;
+private:
+	//缓存的包数超过该值则自动发送
+	static constexpr size_t MAX_BATCH_PACKETS = 256;
+	//一个GSO包最多包含的分片数和字节数(内核限制)
+	static constexpr size_t MAX_GSO_SEGMENTS = 64;
+	static constexpr size_t MAX_GSO_SIZE = 65000;
+	//一次recvmmsg最多接收的包数
+	static constexpr size_t MAX_RECV_PACKETS = 64;
+	//接收缓冲区每个包的大小，本库发送的包最大也就是RTPPACKET_MAX_SIZE加上头部
+	static constexpr size_t RECV_SLOT_SIZE = 4096;
+
+	std::mutex						_mutex;
+	bool							_batching{false};
+	bool							_gso_enable{true};
+	std::atomic<RTPPacketHistory *>	_history{nullptr};
+	//rtp包连续存放，便于GSO直接发送
+	std::vector<uint8_t>			_buffer;
+	std::vector<size_t>				_offsets;
+	uint64_t						_syscall_count{0};
+	//接收用的锁，和发送分开，避免互相阻塞
+	std::mutex						_recv_mutex;
+	bool							_accept_all{true};
+	std::list<jrtplib::RTPRawPacket*>	_raw_packets;
+	uint64_t						_recv_syscall_count{0};
+	Demuxer							_demuxer;
+#if defined (unix)
+	int								_socket{-1};
+	int								_rtcp_socket{-1};
+	//由于父类的目标地址是私有的，这里保存一份
+	std::vector<sockaddr_in>		_destinations;
+	//接收用的缓冲区，创建的时候分配，每个包一个槽
+	std::vector<uint8_t>			_recv_buffer;
+	std::vector<sockaddr_in>		_recv_addrs;
+	std::vector<iovec>				_recv_iovs;
+	std::vector<mmsghdr>			_recv_msgs;
+#endif
+};
+
+inline uint64_t RTPBatchTransmitter::get_syscall_count() noexcept						{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _syscall_count;
+}
+inline uint64_t RTPBatchTransmitter::get_recv_syscall_count() noexcept					{
+	std::lock_guard<std::mutex> lk(_recv_mutex);
+	return _recv_syscall_count;
+}
+inline void RTPBatchTransmitter::set_packet_history(RTPPacketHistory *history) noexcept	{
+	_history = history;
+}
+inline void RTPBatchTransmitter::set_demuxer(Demuxer demuxer) noexcept				{
+	_demuxer = demuxer;
+}
+inline int RTPBatchTransmitter::resend_rtp_data(const void *data, size_t len) noexcept	{
+	return _send_rtp_data(data,len);
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,259 @@
+#include "rtpcongestioncontroller.h"
+#include <algorithm>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//丢包率超过该值则降低码率
+static constexpr float LOSS_HIGH = 0.1f;
+//丢包率低于该值则增加码率
+static constexpr float LOSS_LOW = 0.02f;
+//每秒增加的码率比例
+static constexpr double INCREASE_PER_SECOND = 0.08;
+//两次报告的间隔超过该值也只按照该值增加，避免长时间没有报告后码率突增
+static constexpr double MAX_INCREASE_ELAPSED = 2.0;
+//检测到延迟增长时码率下降的比例
+static constexpr double DELAY_BACKOFF = 0.85;
+//rtt增长趋势超过该值(毫秒/秒)认为网络队列在堆积
+static constexpr double OVERUSE_TREND = 5.0;
+//rtt比最小rtt大于该值(毫秒)才认为是过载，避免抖动引起误判
+static constexpr double OVERUSE_QUEUE_DELAY = 20.0;
+//接收端超过该时间(秒)没有报告则不再统计它的rtt，正常的rtcp间隔是几秒
+static constexpr double REPORTER_TIMEOUT = 15.0;
+//丢包率下降时的平滑系数
+static constexpr float LOSS_DECAY = 0.3f;
+//丢包数太少的时候方差没有意义，按照随机丢包处理
+static constexpr double MIN_BURST_LOST = 4;
+//平均连续丢包长度的上限
+static constexpr double MAX_BURST_LENGTH = 10;
+
+constexpr uint64_t RTPCongestionController::DEFAULT_START_BITRATE;
+constexpr uint64_t RTPCongestionController::DEFAULT_MIN_BITRATE;
+constexpr uint64_t RTPCongestionController::DEFAULT_MAX_BITRATE;
+constexpr size_t RTPCongestionController::TREND_WINDOW;
+constexpr size_t RTPCongestionController::LOSS_WINDOW;
+
+RTPCongestionController::RTPCongestionController(uint64_t start_bitrate) noexcept:
+	_start_bitrate(start_bitrate > 0 ? start_bitrate : DEFAULT_START_BITRATE)
+{
+	reset();
+}
+
+void RTPCongestionController::set_observer(RTPCongestionController::Observer observer) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_observer = observer;
+}
+
+void RTPCongestionController::set_bitrate_range(uint64_t min_bitrate, uint64_t max_bitrate) noexcept
+{
+	if(max_bitrate == 0 || min_bitrate > max_bitrate)
+		return;
+	Observer observer;
+	uint64_t target;
+	{
+		std::lock_guard<std::mutex> lk(_mutex);
+		_min_bitrate = min_bitrate;
+		_max_bitrate = max_bitrate;
+		_loss_bitrate = _clamp(_loss_bitrate);
+		_delay_bitrate = _clamp(_delay_bitrate);
+		target = static_cast<uint64_t>(std::min(_loss_bitrate,_delay_bitrate));
+		if(target == _target_bitrate)
+			return;
+		_target_bitrate = target;
+		observer = _observer;
+	}
+	if(observer)
+		observer(target);
+}
+
+void RTPCongestionController::on_receiver_report(uint32_t reporter, float fraction_lost, int64_t rtt) noexcept
+{
+	Observer observer;
+	uint64_t target;
+	{
+		std::lock_guard<std::mutex> lk(_mutex);
+		auto now = core::Clock::Get_Clock()->now();
+		double elapsed = 0;
+		if(!_started){
+			_started = true;
+			_start_time = now;
+		}
+		else {
+			elapsed = std::chrono::duration<double>(now - _last_time).count();
+			elapsed = std::min(std::max(elapsed,0.0),MAX_INCREASE_ELAPSED);
+		}
+		_last_time = now;
+
+		if(fraction_lost > _loss_rate)
+			_loss_rate = fraction_lost;
+		else
+			_loss_rate += LOSS_DECAY * (fraction_lost - _loss_rate);
+		_update_loss(fraction_lost,elapsed);
+		if(rtt >= 0){
+			//和tcp一样，1/8的平滑系数
+			_srtt = _srtt < 0 ? rtt : _srtt + (rtt - _srtt) / 8;
+			_update_delay(reporter,rtt,now,elapsed);
+		}
+
+		target = static_cast<uint64_t>(std::min(_loss_bitrate,_delay_bitrate));
+		if(target == _target_bitrate)
+			return;
+		_target_bitrate = target;
+		observer = _observer;
+	}
+	if(observer)
+		observer(target);
+}
+
+void RTPCongestionController::on_loss_report(uint32_t reporter, int32_t cumulative_lost, uint32_t highest_seq) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto it = _loss_counters.find(reporter);
+	if(it == _loss_counters.end()){
+		_loss_counters[reporter] = {cumulative_lost,highest_seq};
+		return;
+	}
+	auto expected = static_cast<int32_t>(highest_seq - it->second.seq);
+	auto lost = cumulative_lost - it->second.lost;
+	it->second = {cumulative_lost,highest_seq};
+	//没有收到新的包，或者对方重置了统计(序列号回退)
+	if(expected <= 0 || lost < 0 || lost > expected)
+		return;
+	_loss_intervals.push_back({static_cast<double>(expected),static_cast<double>(lost)});
+	while(_loss_intervals.size() > LOSS_WINDOW)
+		_loss_intervals.pop_front();
+	_update_burst_length();
+}
+
+void RTPCongestionController::reset() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_loss_bitrate = _delay_bitrate = _clamp(static_cast<double>(_start_bitrate));
+	_target_bitrate = static_cast<uint64_t>(_loss_bitrate);
+	_state = Normal;
+	_delay_trackers.clear();
+	_srtt = -1;
+	_started = false;
+	_loss_rate = 0;
+	_burst_length = 1;
+	_loss_counters.clear();
+	_loss_intervals.clear();
+}
+
+void RTPCongestionController::_update_loss(float fraction_lost, double elapsed) noexcept
+{
+	if(fraction_lost > LOSS_HIGH)
+		_loss_bitrate *= 1.0 - 0.5 * static_cast<double>(fraction_lost);
+	else if(fraction_lost < LOSS_LOW)
+		_loss_bitrate *= 1.0 + INCREASE_PER_SECOND * elapsed;
+	_loss_bitrate = _clamp(_loss_bitrate);
+}
+
+void RTPCongestionController::_update_delay(uint32_t reporter, int64_t rtt,
+											const core::Clock::TimePoint &now, double elapsed) noexcept
+{
+	auto & tracker = _delay_trackers[reporter];
+	auto & samples = tracker.samples;
+	auto time = std::chrono::duration<double>(now - _start_time).count();
+	samples.push_back({time,static_cast<double>(rtt)});
+	while(samples.size() > TREND_WINDOW)
+		samples.pop_front();
+	if(tracker.min_rtt < 0 || rtt < tracker.min_rtt)
+		tracker.min_rtt = rtt;
+	tracker.last_time = now;
+
+	tracker.state = Normal;
+	if(samples.size() >= 3){
+		auto trend = _get_trend(samples);
+		if(trend > OVERUSE_TREND && rtt - tracker.min_rtt > OVERUSE_QUEUE_DELAY)
+			tracker.state = Overuse;
+		else if(trend < -OVERUSE_TREND)
+			tracker.state = Underuse;
+	}
+	if(tracker.state == Overuse){
+		//以当前的目标码率为基准降低，然后重新统计趋势，避免同一次拥塞多次降低
+		_delay_bitrate = DELAY_BACKOFF * std::min(_delay_bitrate,_loss_bitrate);
+		samples.erase(samples.begin(),samples.end() - 1);
+	}
+
+	//最拥塞的接收端的状态:过载 > 队列正在排空 > 正常，已经离开的接收端不算
+	_state = Normal;
+	auto it = _delay_trackers.begin();
+	while(it != _delay_trackers.end()){
+		if(std::chrono::duration<double>(now - it->second.last_time).count() > REPORTER_TIMEOUT){
+			it = _delay_trackers.erase(it);
+			continue;
+		}
+		if(it->second.state == Overuse)
+			_state = Overuse;
+		else if(it->second.state == Underuse && _state != Overuse)
+			_state = Underuse;
+		++it;
+	}
+
+	switch (_state) {
+	case Overuse:
+		//过载的接收端报告的时候已经降低过了，等它的下一个报告
+		break;
+	case Underuse:
+		//队列正在排空，保持码率不变
+		break;
+	default:
+		_delay_bitrate *= 1.0 + INCREASE_PER_SECOND * elapsed;
+		break;
+	}
+	_delay_bitrate = _clamp(_delay_bitrate);
+}
+
+void RTPCongestionController::_update_burst_length() noexcept
+{
+	double expected{0},lost{0};
+	for(auto & i:_loss_intervals){
+		expected += i.expected;
+		lost += i.lost;
+	}
+	if(lost < MIN_BURST_LOST || expected <= lost){
+		_burst_length = 1;
+		return;
+	}
+	//实际的方差和随机丢包的方差之比(离散指数)
+	auto p = lost / expected;
+	double observed{0},binomial{0};
+	for(auto & i:_loss_intervals){
+		auto d = i.lost - i.expected * p;
+		observed += d * d;
+		binomial += i.expected * p * (1 - p);
+	}
+	auto dispersion = observed / binomial;
+	_burst_length = static_cast<float>(std::min(std::max((dispersion + 1) / 2,1.0),MAX_BURST_LENGTH));
+}
+
+double RTPCongestionController::_get_trend(const std::deque<RTTSample> &samples) noexcept
+{
+	double sum_t{0},sum_r{0};
+	for(auto & s:samples){
+		sum_t += s.time;
+		sum_r += s.rtt;
+	}
+	auto n = static_cast<double>(samples.size());
+	auto avg_t = sum_t / n;
+	auto avg_r = sum_r / n;
+	double num{0},den{0};
+	for(auto & s:samples){
+		num += (s.time - avg_t) * (s.rtt - avg_r);
+		den += (s.time - avg_t) * (s.time - avg_t);
+	}
+	return den > 0 ? num / den : 0;
+}
+
+double RTPCongestionController::_clamp(double bitrate) noexcept
+{
+	return std::min(std::max(bitrate,static_cast<double>(_min_bitrate)),
+					static_cast<double>(_max_bitrate));
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
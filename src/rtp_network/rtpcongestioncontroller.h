@@ -0,0 +1,238 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <map>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPCongestionController class
+ * 发送端的拥塞控制(带宽估计)，参考GCC的做法，由两部分组成:
+ * 1.基于丢包:丢包率大于10%则按丢包率降低码率，小于2%则缓慢增加，中间保持不变
+ * 2.基于延迟:统计最近一段时间的rtt，用最小二乘法计算rtt的变化趋势，
+ *   如果rtt持续增长(网络队列正在堆积)，说明已经超出了链路的容量，降低码率
+ *   每个接收端的rtt和最小rtt分开统计，远近不同的接收端交替报告不会被误判为rtt增长，
+ *   以最拥塞的接收端的状态为准
+ * 最终的目标码率取两者的最小值，并限制在[min,max]之间
+ * 另外还会统计丢包率和平均连续丢包长度，用于FEC选择冗余包的数量
+ * 注:GCC的延迟估计需要接收端反馈每个包的到达时间，本库只有标准的RR报告，
+ *    所以这里使用RR里面的LSR/DLSR计算出来的rtt代替单向延迟
+ * 该类是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPCongestionController
+{
+public:
+	/**
+	 * @brief Observer
+	 * 目标码率改变的时候回调，参数是新的目标码率(bit/s)
+	 * 回调的时候没有持有锁，可以在回调里面调用本类的接口
+	 */
+	using Observer = std::function<void(uint64_t)>;
+
+	/**
+	 * @brief The DelayState enum
+	 * 延迟检测的状态
+	 */
+	enum DelayState{
+		Normal = 0,
+		Overuse,
+		Underuse
+	};
+public:
+	/**
+	 * @brief RTPCongestionController
+	 * @param start_bitrate
+	 * 初始码率，单位bit/s
+	 */
+	explicit RTPCongestionController(uint64_t start_bitrate = DEFAULT_START_BITRATE) noexcept;
+
+	/**
+	 * @brief set_observer
+	 * 设置目标码率的回调
+	 */
+	void set_observer(Observer observer) noexcept;
+
+	/**
+	 * @brief set_bitrate_range
+	 * 设置码率的范围，单位bit/s，min大于max或者max为0将被忽略
+	 */
+	void set_bitrate_range(uint64_t min_bitrate,uint64_t max_bitrate) noexcept;
+
+	/**
+	 * @brief on_receiver_report
+	 * 收到对方关于本地视频流的接收报告
+	 * @param reporter
+	 * 发送报告的用户的ssrc，每个接收端的rtt分开统计
+	 * @param fraction_lost
+	 * 丢包率[0,1]
+	 * @param rtt
+	 * 往返时间，单位毫秒，没有LSR的报告无法计算rtt，传入负数
+	 */
+	void on_receiver_report(uint32_t reporter,float fraction_lost,int64_t rtt) noexcept;
+
+	/**
+	 * @brief on_loss_report
+	 * 收到对方关于本地视频流的累计丢包数，用于估计平均连续丢包长度
+	 * RR里面没有丢包的分布信息，这里统计每个报告间隔的丢包数，
+	 * 丢包越集中(突发丢包)，丢包数的方差相对于随机丢包就越大:
+	 * 方差 = np(1-p)(2b-1)，b是平均连续丢包长度
+	 * @param reporter
+	 * 发送报告的用户的ssrc，每个接收端的累计值需要分开统计
+	 * @param cumulative_lost
+	 * 累计丢包数
+	 * @param highest_seq
+	 * 收到的最大扩展序列号
+	 */
+	void on_loss_report(uint32_t reporter,int32_t cumulative_lost,uint32_t highest_seq) noexcept;
+
+	/**
+	 * @brief get_loss_rate
+	 * 获取平滑后的丢包率[0,1]，丢包增加时立即跟随，减少时缓慢下降
+	 */
+	float get_loss_rate() noexcept;
+
+	/**
+	 * @brief get_burst_length
+	 * 获取估计的平均连续丢包长度，随机丢包是1
+	 */
+	float get_burst_length() noexcept;
+
+	/**
+	 * @brief get_rtt
+	 * 获取平滑后的rtt，单位毫秒，还没有收到带有rtt的报告则返回-1
+	 * 用于决定丢包时使用重传还是FEC
+	 */
+	int64_t get_rtt() noexcept;
+
+	/**
+	 * @brief get_target_bitrate
+	 * 获取当前的目标码率，单位bit/s
+	 */
+	uint64_t get_target_bitrate() noexcept;
+
+	/**
+	 * @brief get_delay_state
+	 * 获取延迟检测的状态，多个接收端的时候是最拥塞的那个
+	 */
+	DelayState get_delay_state() noexcept;
+
+	/**
+	 * @brief reset
+	 * 恢复到初始码率，清空统计的rtt，重新加入房间的时候调用
+	 */
+	void reset() noexcept;
+public:
+	//默认初始码率,1Mbit/s
+	static constexpr uint64_t DEFAULT_START_BITRATE = 1000 * 1000;
+	//默认的码率范围
+	static constexpr uint64_t DEFAULT_MIN_BITRATE = 100 * 1000;
+	static constexpr uint64_t DEFAULT_MAX_BITRATE = 12 * 1000 * 1000;
+	//统计rtt趋势的报告数，每个接收端分开统计
+	static constexpr size_t TREND_WINDOW = 20;
+	//统计连续丢包长度的报告间隔数
+	static constexpr size_t LOSS_WINDOW = 16;
+private:
+	/**
+	 * @brief _update_loss
+	 * 基于丢包的码率估计，调用前需要锁住_mutex
+	 */
+	void _update_loss(float fraction_lost,double elapsed) noexcept;
+
+	/**
+	 * @brief _update_delay
+	 * 基于延迟的码率估计，调用前需要锁住_mutex
+	 */
+	void _update_delay(uint32_t reporter,int64_t rtt,const core::Clock::TimePoint & now,double elapsed) noexcept;
+
+	struct RTTSample;
+	/**
+	 * @brief _get_trend
+	 * 计算rtt的变化趋势(最小二乘法的斜率)，单位是毫秒/秒
+	 */
+	static double _get_trend(const std::deque<RTTSample> & samples) noexcept;
+
+	/**
+	 * @brief _update_burst_length
+	 * 根据最近的报告间隔估计平均连续丢包长度，调用前需要锁住_mutex
+	 */
+	void _update_burst_length() noexcept;
+
+	/**
+	 * @brief _clamp
+	 * 把码率限制在[min,max]之间
+	 */
+	double _clamp(double bitrate) noexcept;
+private:
+	struct RTTSample{
+		double time;
+		double rtt;
+	};
+	//每个接收端的rtt统计
+	struct DelayTracker{
+		std::deque<RTTSample>		samples;
+		int64_t						min_rtt{-1};
+		DelayState					state{Normal};
+		core::Clock::TimePoint		last_time;
+	};
+	//每个接收端上一次报告的累计值
+	struct LossCounter{
+		int32_t lost;
+		uint32_t seq;
+	};
+	//一个报告间隔内的期望收到的包数和丢包数
+	struct LossInterval{
+		double expected;
+		double lost;
+	};
+	std::mutex					_mutex;
+	Observer					_observer;
+	const uint64_t				_start_bitrate;
+	uint64_t					_min_bitrate{DEFAULT_MIN_BITRATE};
+	uint64_t					_max_bitrate{DEFAULT_MAX_BITRATE};
+	double						_loss_bitrate;
+	double						_delay_bitrate;
+	uint64_t					_target_bitrate;
+	DelayState					_state{Normal};
+	std::map<uint32_t,DelayTracker>	_delay_trackers;
+	int64_t						_srtt{-1};
+	core::Clock::TimePoint		_start_time;
+	core::Clock::TimePoint		_last_time;
+	bool						_started{false};
+	float						_loss_rate{0};
+	float						_burst_length{1};
+	std::map<uint32_t,LossCounter>	_loss_counters;
+	std::deque<LossInterval>	_loss_intervals;
+};
+
+inline uint64_t RTPCongestionController::get_target_bitrate() noexcept					{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _target_bitrate;
+}
+inline float RTPCongestionController::get_loss_rate() noexcept							{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _loss_rate;
+}
+inline float RTPCongestionController::get_burst_length() noexcept						{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _burst_length;
+}
+inline int64_t RTPCongestionController::get_rtt() noexcept								{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _srtt;
+}
+inline RTPCongestionController::DelayState
+RTPCongestionController::get_delay_state() noexcept									{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _state;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
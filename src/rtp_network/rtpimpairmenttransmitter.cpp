@@ -0,0 +1,87 @@
+#include "rtpimpairmenttransmitter.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+constexpr int64_t RTPImpairmentTransmitter::MAX_WAIT_MS;
+
+RTPImpairmentTransmitter::RTPImpairmentTransmitter(jrtplib::RTPMemoryManager *mgr,
+												   const RTPNetworkEmulator::Params &params):
+	RTPBatchTransmitter(mgr),
+	_emulator(params)
+{
+	start_thread();
+}
+
+RTPImpairmentTransmitter::~RTPImpairmentTransmitter()
+{
+	{
+		//线程可能在等待下一个包，先唤醒
+		std::lock_guard<std::mutex> lk(_queue_mutex);
+		_queue.clear();
+		_queue_cond.notify_all();
+	}
+	exit_thread();
+}
+
+void RTPImpairmentTransmitter::Destroy()
+{
+	{
+		//还在路上的包直接丢弃，和真实网络里socket关闭一样
+		std::lock_guard<std::mutex> lk(_queue_mutex);
+		_queue.clear();
+	}
+	RTPBatchTransmitter::Destroy();
+}
+
+int RTPImpairmentTransmitter::SendRTCPData(const void *data, size_t len)
+{
+	return _push(data,len,false);
+}
+
+int RTPImpairmentTransmitter::_send_rtp_data(const void *data, size_t len) noexcept
+{
+	return _push(data,len,true);
+}
+
+int RTPImpairmentTransmitter::_push(const void *data, size_t len, bool rtp) noexcept
+{
+	auto ptr = static_cast<const uint8_t *>(data);
+	std::lock_guard<std::mutex> lk(_queue_mutex);
+	//丢失的包对于发送者来说也是发送成功
+	if(_emulator.process(len,core::Clock::Get_Clock()->now(),_release) == 0)
+		return 0;
+	for(auto & tp:_release)
+		_queue.emplace(tp,Packet{std::vector<uint8_t>(ptr,ptr + len),rtp});
+	_queue_cond.notify_one();
+	return 0;
+}
+
+void RTPImpairmentTransmitter::on_thread_run() noexcept
+{
+	auto clock = core::Clock::Get_Clock();
+	std::unique_lock<std::mutex> lk(_queue_mutex);
+	if(get_exit_flag())
+		return;
+	auto now = clock->now();
+	auto deadline = now + std::chrono::milliseconds(MAX_WAIT_MS);
+	if(!_queue.empty() && _queue.begin()->first <= now){
+		auto it = _queue.begin();
+		auto & packet = it->second;
+		//直接交给父类的父类发送，不经过批量发送的缓存
+		if(packet.rtp)
+			jrtplib::RTPUDPv4Transmitter::SendRTPData(packet.data.data(),packet.data.size());
+		else
+			jrtplib::RTPUDPv4Transmitter::SendRTCPData(packet.data.data(),packet.data.size());
+		_queue.erase(it);
+		return;
+	}
+	if(!_queue.empty() && _queue.begin()->first < deadline)
+		deadline = _queue.begin()->first;
+	clock->wait_until(_queue_cond,lk,deadline);
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,91 @@
+
+#pragma once
+
+#include "rtpbatchtransmitter.h"
+#include "rtpnetworkemulator.h"
+#include "../core/abstractthread.h"
+#include <map>
+#include <condition_variable>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPImpairmentTransmitter class
+ * 带网络损伤模拟的传输器，用于在一台机器上(回环地址)测试和基准测试
+ * 发送的rtp和rtcp包(包括重传的包)先经过RTPNetworkEmulator决定是否丢失和到达时间，
+ * 然后放进队列，由该类的线程在到达时间再真正发送出去，接收和父类一样
+ * 这样FEC、拥塞控制和抖动缓冲都可以在可重现的丢包、延迟、乱序和带宽限制下运行
+ * 注:损伤是在发送端模拟的，每个包都会自己延迟发送，所以不再批量发送
+ * @see RTPSession::set_network_impairment
+ */
+class RTPImpairmentTransmitter :
+		public RTPBatchTransmitter,
+		public core::AbstractThread
+{
+public:
+	RTPImpairmentTransmitter(jrtplib::RTPMemoryManager *mgr,const RTPNetworkEmulator::Params & params);
+
+	~RTPImpairmentTransmitter() override;
+
+	void Destroy() override;
+
+	int SendRTCPData(const void *data,size_t len) override;
+
+	/**
+	 * @brief get_emulator
+	 * 获取网络损伤模拟，可以在运行过程中修改参数和获取统计
+	 */
+	RTPNetworkEmulator & get_emulator() noexcept;
+protected:
+	/**
+	 * @brief _send_rtp_data
+	 * rtp包不直接发送，经过损伤模拟后放进队列
+	 */
+	int _send_rtp_data(const void *data,size_t len) noexcept override;
+
+	/**
+	 * @brief on_thread_run
+	 * 发送到达时间的包，没有到达时间的包则等待
+	 */
+	virtual void on_thread_run() noexcept override;
+
+	/**
+	 * @brief get_thread_pause_condition
+	 * 线程一直运行，在on_thread_run里面等待
+	 */
+	virtual bool get_thread_pause_condition() noexcept override;
+private:
+	/**
+	 * @brief _push
+	 * 经过损伤模拟后放进队列
+	 */
+	int _push(const void *data,size_t len,bool rtp) noexcept;
+private:
+	using TimePoint = RTPNetworkEmulator::TimePoint;
+	struct Packet {
+		std::vector<uint8_t> data;
+		bool rtp;
+	};
+	//没有包的时候最多等待的时间
+	static constexpr int64_t MAX_WAIT_MS = 10;
+
+	RTPNetworkEmulator					_emulator;
+	std::mutex							_queue_mutex;
+	std::condition_variable				_queue_cond;
+	//按照到达时间排序，时间一样的按照放进去的顺序
+	std::multimap<TimePoint,Packet>		_queue;
+	std::vector<TimePoint>				_release;
+};
+
+inline RTPNetworkEmulator &RTPImpairmentTransmitter::get_emulator() noexcept				{
+	return _emulator;
+}
+inline bool RTPImpairmentTransmitter::get_thread_pause_condition() noexcept				{
+	return false;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,179 @@
+#include "rtpjitterbuffer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//抖动的平滑系数，和RFC3550一样
+static constexpr double JITTER_GAIN = 16;
+//抖动变小的时候目标延迟的下降速度，避免频繁变化导致播放忽快忽慢
+static constexpr double DELAY_DECAY = 64;
+//最小传输时间变大(时钟漂移或者路由变化)的时候缓慢跟随
+static constexpr double OFFSET_DRIFT = 512;
+//时间戳跳变超过该值则认为对方重新推流
+static constexpr int64_t MAX_JUMP_SECONDS = 10;
+static constexpr int64_t MAX_JUMP_NO_CLOCK = 1 << 16;
+
+constexpr int64_t RTPJitterBuffer::DEFAULT_MIN_DELAY;
+constexpr int64_t RTPJitterBuffer::DEFAULT_MAX_DELAY;
+constexpr double RTPJitterBuffer::JITTER_FACTOR;
+constexpr size_t RTPJitterBuffer::MAX_FRAMES;
+
+RTPJitterBuffer::RTPJitterBuffer(uint32_t clock_rate) noexcept:
+	_clock_rate(clock_rate)
+{
+
+}
+
+void RTPJitterBuffer::set_clock_rate(uint32_t clock_rate) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(_clock_rate == clock_rate)
+		return;
+	_clock_rate = clock_rate;
+	_reset();
+}
+
+void RTPJitterBuffer::set_delay_range(int64_t min_ms, int64_t max_ms) noexcept
+{
+	if(min_ms < 0 || min_ms > max_ms)
+		return;
+	std::lock_guard<std::mutex> lk(_mutex);
+	_min_delay = min_ms;
+	_max_delay = max_ms;
+	//还没有收到帧的时候直接从最小延迟开始
+	_target_delay = _started ? std::min(std::max(_target_delay,_min_delay),_max_delay) : _min_delay;
+}
+
+bool RTPJitterBuffer::push(uint32_t timestamp, RTPJitterBuffer::Frame frame) noexcept
+{
+	if(frame == nullptr)
+		return false;
+	auto arrival = _to_ms(core::Clock::Get_Clock()->now());
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(_started){
+		int64_t diff = static_cast<int32_t>(timestamp - static_cast<uint32_t>(_highest_ts));
+		auto max_jump = _clock_rate > 0 ? MAX_JUMP_SECONDS * _clock_rate : MAX_JUMP_NO_CLOCK;
+		if(std::abs(diff) > max_jump)
+			_reset();
+	}
+	if(!_started){
+		_started = true;
+		_highest_ts = timestamp;
+	}
+	//以最大的时间戳为基准展开，翻转之后依旧是递增的
+	int64_t ts = _highest_ts + static_cast<int32_t>(timestamp - static_cast<uint32_t>(_highest_ts));
+	if(_played && ts <= _last_played_ts){
+		++_late_count;
+		return false;
+	}
+	_highest_ts = std::max(_highest_ts,ts);
+	_update_jitter(ts,arrival);
+
+	auto base = arrival;
+	if(_clock_rate > 0){
+		auto media = static_cast<double>(ts) * 1000 / _clock_rate;
+		auto transit = arrival - media;
+		if(!_has_offset || transit < _offset){
+			_has_offset = true;
+			_offset = transit;
+		}
+		else
+			_offset += (transit - _offset) / OFFSET_DRIFT;
+		base = media + _offset;
+	}
+	_frames[ts] = {frame,base};
+	return true;
+}
+
+RTPJitterBuffer::Frame RTPJitterBuffer::pop() noexcept
+{
+	auto now = _to_ms(core::Clock::Get_Clock()->now());
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(_frames.empty())
+		return nullptr;
+	auto it = _frames.begin();
+	if(_frames.size() <= MAX_FRAMES && now < _get_playout_time(it->second.base))
+		return nullptr;
+	Frame frame;
+	frame.swap(it->second.frame);
+	_played = true;
+	_last_played_ts = it->first;
+	_frames.erase(it);
+	return frame;
+}
+
+RTPJitterBuffer::TimePoint RTPJitterBuffer::get_next_playout_time() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(_frames.empty())
+		return TimePoint::max();
+	if(_frames.size() > MAX_FRAMES)
+		return core::Clock::Get_Clock()->now();
+	auto ms = std::chrono::duration<double,std::milli>(_get_playout_time(_frames.begin()->second.base));
+	return TimePoint(std::chrono::duration_cast<core::Clock::Duration>(ms));
+}
+
+void RTPJitterBuffer::_reset() noexcept
+{
+	_frames.clear();
+	_started = false;
+	_played = false;
+	_has_last = false;
+	_interval = 0;
+	_has_offset = false;
+	_jitter = 0;
+	_target_delay = _min_delay;
+}
+
+void RTPJitterBuffer::_update_jitter(int64_t ts, double arrival) noexcept
+{
+	//只统计按顺序到达的帧，乱序的帧在重传的时候已经体现在后一帧的延迟里了
+	if(_has_last && ts <= _last_ts)
+		return;
+	if(!_has_last){
+		_has_last = true;
+		_last_ts = ts;
+		_last_arrival = arrival;
+		return;
+	}
+	auto delta = arrival - _last_arrival;
+	double d;
+	if(_clock_rate > 0){
+		//RFC3550:两个包的传输时间之差
+		d = delta - static_cast<double>(ts - _last_ts) * 1000 / _clock_rate;
+	}
+	else {
+		//不知道帧间隔，用平均的到达间隔代替
+		if(_interval <= 0)
+			_interval = delta;
+		else
+			_interval += (delta - _interval) / JITTER_GAIN;
+		d = delta - _interval;
+	}
+	_jitter += (std::abs(d) - _jitter) / JITTER_GAIN;
+	_last_ts = ts;
+	_last_arrival = arrival;
+
+	auto desired = std::min(std::max(_min_delay + JITTER_FACTOR * _jitter,_min_delay),_max_delay);
+	if(desired > _target_delay)
+		_target_delay = desired;
+	else
+		_target_delay += (desired - _target_delay) / DELAY_DECAY;
+}
+
+double RTPJitterBuffer::_get_playout_time(double base) noexcept
+{
+	return base + _target_delay;
+}
+
+double RTPJitterBuffer::_to_ms(const TimePoint &tp) noexcept
+{
+	return std::chrono::duration<double,std::milli>(tp.time_since_epoch()).count();
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,191 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include "../core/format.h"
+#include <map>
+#include <mutex>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPJitterBuffer class
+ * 接收端的帧级别抖动缓冲区，位于FEC组帧和解码器之间
+ * 1.按照时间戳排序，乱序完成的帧(比如前一帧等重传)按照正确的顺序交给解码器
+ * 2.根据测量到的抖动调整目标延迟:抖动变大立即增加延迟，抖动变小缓慢减少延迟
+ * 3.比已经播放的帧还旧的帧直接丢弃
+ *
+ * 时间戳有两种模式:
+ * 1.设置了时钟频率:时间戳是媒体时间，按照RFC3550计算传输时间的抖动，
+ *   播放时间 = 媒体时间 + 最小传输时间 + 目标延迟，输出的帧间隔是均匀的
+ * 2.时钟频率为0:时间戳只表示顺序，抖动按照帧到达间隔的变化估计，
+ *   播放时间 = 到达时间 + 目标延迟，只负责排序和丢弃过期的帧
+ * 该类是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPJitterBuffer
+{
+public:
+	using Frame = core::FramePacket::SharedPacket;
+	using TimePoint = core::Clock::TimePoint;
+public:
+	/**
+	 * @brief RTPJitterBuffer
+	 * @param clock_rate
+	 * 时间戳的时钟频率，0表示时间戳只表示顺序
+	 */
+	explicit RTPJitterBuffer(uint32_t clock_rate = 0) noexcept;
+
+	/**
+	 * @brief set_clock_rate
+	 * 设置时间戳的时钟频率，会清空缓冲区
+	 */
+	void set_clock_rate(uint32_t clock_rate) noexcept;
+
+	/**
+	 * @brief set_delay_range
+	 * 设置目标延迟的范围，单位毫秒，min大于max将被忽略
+	 */
+	void set_delay_range(int64_t min_ms,int64_t max_ms) noexcept;
+
+	/**
+	 * @brief push
+	 * 放入一个完整的帧
+	 * @param timestamp
+	 * 帧的rtp时间戳
+	 * @return
+	 * 帧来得太晚(比已经播放的帧还旧)被丢弃则返回false
+	 */
+	bool push(uint32_t timestamp,Frame frame) noexcept;
+
+	/**
+	 * @brief pop
+	 * 取出一个到了播放时间的帧
+	 * @return
+	 * 没有到期的帧则返回nullptr
+	 */
+	Frame pop() noexcept;
+
+	/**
+	 * @brief get_next_playout_time
+	 * 获取下一帧的播放时间，缓冲区为空则返回TimePoint::max()
+	 */
+	TimePoint get_next_playout_time() noexcept;
+
+	/**
+	 * @brief get_target_delay
+	 * 获取当前的目标延迟，单位毫秒
+	 */
+	double get_target_delay() noexcept;
+
+	/**
+	 * @brief get_jitter
+	 * 获取估计的抖动，单位毫秒
+	 */
+	double get_jitter() noexcept;
+
+	/**
+	 * @brief get_late_count
+	 * 获取因为来得太晚而丢弃的帧数
+	 */
+	uint64_t get_late_count() noexcept;
+
+	/**
+	 * @brief size
+	 * 获取缓冲的帧数
+	 */
+	size_t size() noexcept;
+
+	/**
+	 * @brief reset
+	 * 清空缓冲区和统计，时间戳不连续(对方重新推流)的时候也会自动调用
+	 */
+	void reset() noexcept;
+public:
+	//默认的目标延迟范围(毫秒)
+	static constexpr int64_t DEFAULT_MIN_DELAY = 10;
+	static constexpr int64_t DEFAULT_MAX_DELAY = 500;
+	//目标延迟是抖动的倍数
+	static constexpr double JITTER_FACTOR = 3.0;
+	//缓冲的帧数超过该值则不再等待，直接播放最旧的帧
+	static constexpr size_t MAX_FRAMES = 64;
+private:
+	/**
+	 * @brief _reset
+	 * reset的具体实现，调用前需要锁住_mutex
+	 */
+	void _reset() noexcept;
+
+	/**
+	 * @brief _update_jitter
+	 * 根据新到的帧更新抖动和目标延迟，调用前需要锁住_mutex
+	 */
+	void _update_jitter(int64_t ts,double arrival) noexcept;
+
+	/**
+	 * @brief _get_playout_time
+	 * 计算帧的播放时间(毫秒)
+	 */
+	double _get_playout_time(double base) noexcept;
+
+	/**
+	 * @brief _to_ms
+	 * 时间点转换成毫秒
+	 */
+	static double _to_ms(const TimePoint & tp) noexcept;
+private:
+	struct Entry{
+		Frame	frame;
+		//播放时间的基准(毫秒)，加上目标延迟就是播放时间
+		double	base;
+	};
+	std::mutex					_mutex;
+	uint32_t					_clock_rate;
+	double						_min_delay{DEFAULT_MIN_DELAY};
+	double						_max_delay{DEFAULT_MAX_DELAY};
+	//展开后的时间戳(处理32位翻转)
+	std::map<int64_t,Entry>		_frames;
+	bool						_started{false};
+	int64_t						_highest_ts{0};
+	bool						_played{false};
+	int64_t						_last_played_ts{0};
+	//上一个按顺序到达的帧，用于计算抖动
+	bool						_has_last{false};
+	int64_t						_last_ts{0};
+	double						_last_arrival{0};
+	//没有时钟频率的时候估计的帧间隔
+	double						_interval{0};
+	//最小传输时间(到达时间 - 媒体时间)
+	bool						_has_offset{false};
+	double						_offset{0};
+	double						_jitter{0};
+	double						_target_delay{DEFAULT_MIN_DELAY};
+	uint64_t					_late_count{0};
+};
+
+inline double RTPJitterBuffer::get_target_delay() noexcept								{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _target_delay;
+}
+inline double RTPJitterBuffer::get_jitter() noexcept									{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _jitter;
+}
+inline uint64_t RTPJitterBuffer::get_late_count() noexcept								{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _late_count;
+}
+inline size_t RTPJitterBuffer::size() noexcept											{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _frames.size();
+}
+inline void RTPJitterBuffer::reset() noexcept											{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_reset();
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
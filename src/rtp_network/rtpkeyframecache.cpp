@@ -0,0 +1,180 @@
+#include "rtpkeyframecache.h"
+#include "rtpnalpacketizer.h"
+#include "fec/fecheader.h"
+#include "jrtplib3/rtprawpacket.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//rtp固定头部的长度
+static constexpr size_t RTP_HEADER_SIZE = 12;
+
+constexpr size_t RTPKeyFrameCache::DEFAULT_MAX_BYTES;
+
+RTPKeyFrameCache::RTPKeyFrameCache(size_t max_bytes) noexcept:
+	_max_bytes(max_bytes)
+{
+
+}
+
+void RTPKeyFrameCache::put(const SharedRawPacket &packet) noexcept
+{
+	if(packet == nullptr || !packet->IsRTP())
+		return;
+	auto data = packet->GetData();
+	size_t len = packet->GetDataLength();
+	if(data == nullptr || len < RTP_HEADER_SIZE || (data[0] >> 6) != 2)
+		return;
+	auto payload_type = data[1] & 0x7F;
+	if(!RTPNalPacketizer::Is_Supported(payload_type))
+		return;
+	uint32_t timestamp = (static_cast<uint32_t>(data[4]) << 24) | (static_cast<uint32_t>(data[5]) << 16) |
+			(static_cast<uint32_t>(data[6]) << 8) | data[7];
+	uint32_t ssrc = (static_cast<uint32_t>(data[8]) << 24) | (static_cast<uint32_t>(data[9]) << 16) |
+			(static_cast<uint32_t>(data[10]) << 8) | data[11];
+
+	//跳过CSRC、扩展头部和填充，找到负载
+	size_t offset = RTP_HEADER_SIZE + (data[0] & 0x0F) * 4u;
+	if(data[0] & 0x10){
+		if(offset + 4 > len)
+			return;
+		offset += 4 + ((static_cast<size_t>(data[offset + 2]) << 8) | data[offset + 3]) * 4;
+	}
+	if(data[0] & 0x20){
+		if(len <= offset || data[len - 1] > len - offset)
+			return;
+		len -= data[len - 1];
+	}
+	if(offset >= len)
+		return;
+	auto payload = data + offset;
+	auto payload_len = len - offset;
+
+	fec::FECParam param;
+	uint16_t pos{0};
+	auto header_size = fec::FECHeader::Unpack(payload,payload_len,param,pos);
+	if(header_size == 0 || param.nal == 0)
+		return;
+
+	if(!_has_ssrc || ssrc != _ssrc){
+		clear();
+		_has_ssrc = true;
+		_ssrc = ssrc;
+	}
+	if(_has_frame && timestamp != _frame.timestamp){
+		//比当前帧旧的包是重传的包，GOP需要它
+		if(static_cast<int32_t>(timestamp - _frame.timestamp) < 0){
+			if(!_gop.empty())
+				_append(packet,packet->GetDataLength());
+			return;
+		}
+		_finish_frame();
+	}
+	if(!_has_frame){
+		_has_frame = true;
+		_frame.timestamp = timestamp;
+		_frame.src_nb = static_cast<uint32_t>(param.get_src_nb());
+		_frame.received_nb = 0;
+		_frame.key = false;
+		_frame.overflow = false;
+		_frame.bytes = 0;
+		_frame.received.clear();
+		_frame.packets.clear();
+	}
+
+	//重复的包不需要再保存
+	if(pos >= _frame.received.size())
+		_frame.received.resize(pos + 1u,false);
+	if(_frame.received[pos])
+		return;
+	_frame.received[pos] = true;
+	++_frame.received_nb;
+	if(pos < _frame.src_nb && !_frame.key)
+		_frame.key = RTPNalPacketizer::Is_Key_Payload(RTPNalPacketizer::Get_Codec(payload_type),
+													  payload + header_size,payload_len - header_size);
+	if(_frame.overflow)
+		return;
+	auto bytes = packet->GetDataLength();
+	if(_frame.bytes + bytes > _max_bytes){
+		_frame.overflow = true;
+		_frame.packets.clear();
+		_frame.bytes = 0;
+		return;
+	}
+	_frame.packets.push_back(packet);
+	_frame.bytes += bytes;
+}
+
+bool RTPKeyFrameCache::get(std::vector<SharedRawPacket> &output) const noexcept
+{
+	//正在接收的帧是完整的关键帧，它就是新的GOP
+	if(_is_complete_key()){
+		output.insert(output.end(),_frame.packets.begin(),_frame.packets.end());
+		return true;
+	}
+	if(_gop.empty())
+		return false;
+	output.insert(output.end(),_gop.begin(),_gop.end());
+	if(_has_frame && !_frame.key && !_frame.overflow)
+		output.insert(output.end(),_frame.packets.begin(),_frame.packets.end());
+	return true;
+}
+
+void RTPKeyFrameCache::clear() noexcept
+{
+	_has_ssrc = false;
+	_has_frame = false;
+	_frame.received.clear();
+	_frame.packets.clear();
+	_frame.bytes = 0;
+	_gop.clear();
+	_gop_bytes = 0;
+}
+
+size_t RTPKeyFrameCache::get_size() const noexcept
+{
+	return _gop_bytes + (_has_frame ? _frame.bytes : 0);
+}
+
+void RTPKeyFrameCache::_finish_frame() noexcept
+{
+	_has_frame = false;
+	if(_frame.key){
+		_gop.clear();
+		_gop_bytes = 0;
+		//不完整的关键帧解不出来，后面的帧也没用了
+		if(_frame.overflow || _frame.received_nb < _frame.src_nb)
+			return;
+		_gop.swap(_frame.packets);
+		_gop_bytes = _frame.bytes;
+	}
+	else if(_frame.overflow){
+		_gop.clear();
+		_gop_bytes = 0;
+	}
+	else if(!_gop.empty()){
+		for(auto & packet : _frame.packets)
+			_append(packet,packet->GetDataLength());
+	}
+	_frame.packets.clear();
+	_frame.bytes = 0;
+}
+
+void RTPKeyFrameCache::_append(const SharedRawPacket &packet, size_t bytes) noexcept
+{
+	if(_gop.empty())
+		return;
+	//GOP太长，等待下一个关键帧
+	if(_gop_bytes + bytes > _max_bytes){
+		_gop.clear();
+		_gop_bytes = 0;
+		return;
+	}
+	_gop.push_back(packet);
+	_gop_bytes += bytes;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
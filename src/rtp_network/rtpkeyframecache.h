@@ -0,0 +1,125 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include <vector>
+#include <memory>
+
+namespace jrtplib {
+class RTPRawPacket;
+}
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPKeyFrameCache class
+ * 转发服务器的关键帧缓存，一个推流成员(一个ssrc)一个
+ * 保存最近一个完整的关键帧以及之后的所有帧(一个GOP)，新成员加入房间的时候先发送缓存，
+ * 不需要等待推流端的下一个关键帧就可以立即显示画面
+ * 只缓存关键帧的话后面的P帧会缺少参考帧，接收端还会因为序列号不连续发送大量NACK，
+ * 所以缓存的是关键帧开始的整个GOP
+ * 1.包原样缓存(rtp头部、FEC头部、源数据包和冗余包)，引用收到的包，不拷贝
+ * 2.通过rtp时间戳区分帧，收到下一帧的包时判断上一帧:
+ *   关键帧并且收到的包足够恢复(源数据包和冗余包的数量不少于源数据包总数)则成为新的GOP，
+ *   不完整的关键帧会清空缓存，普通帧则追加到GOP后面
+ * 3.旧的帧的包(重传)追加到GOP后面
+ * 4.GOP超过大小上限(GOP很长)则清空缓存，等待下一个关键帧
+ * 只处理按照NAL单元分包的视频(见RTPNalPacketizer)，其他包将被忽略
+ * 该类不是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPKeyFrameCache
+{
+public:
+	using SharedRawPacket = std::shared_ptr<jrtplib::RTPRawPacket>;
+public:
+	/**
+	 * @brief RTPKeyFrameCache
+	 * @param max_bytes
+	 * 缓存的大小上限，单位字节
+	 */
+	explicit RTPKeyFrameCache(size_t max_bytes = DEFAULT_MAX_BYTES) noexcept;
+
+	/**
+	 * @brief put
+	 * 放入一个收到的rtp包，ssrc变化的时候会先清空缓存
+	 */
+	void put(const SharedRawPacket & packet) noexcept;
+
+	/**
+	 * @brief get
+	 * 获取从关键帧开始的所有包(包括正在接收的帧)，按照收到的顺序追加到output后面
+	 * @return
+	 * 没有关键帧则返回false
+	 */
+	bool get(std::vector<SharedRawPacket> & output) const noexcept;
+
+	/**
+	 * @brief clear
+	 * 清空缓存
+	 */
+	void clear() noexcept;
+
+	/**
+	 * @brief has_key_frame
+	 * 是否有可以发送的关键帧
+	 */
+	bool has_key_frame() const noexcept;
+
+	/**
+	 * @brief get_size
+	 * 获取缓存的大小(包括正在接收的帧)，单位字节
+	 */
+	size_t get_size() const noexcept;
+public:
+	//默认的缓存上限，不超过客户端socket缓冲区(4MB)的一半，一次发送给新成员也不会溢出
+	static constexpr size_t DEFAULT_MAX_BYTES = 2 * 1024 * 1024;
+private:
+	struct Frame {
+		uint32_t						timestamp{0};
+		//源数据包数量
+		uint32_t						src_nb{0};
+		//收到的不同位置的包数量
+		uint32_t						received_nb{0};
+		bool							key{false};
+		//帧太大，没有保存所有的包
+		bool							overflow{false};
+		size_t							bytes{0};
+		std::vector<bool>				received;
+		std::vector<SharedRawPacket>	packets;
+	};
+
+	/**
+	 * @brief _finish_frame
+	 * 当前帧接收结束，根据关键帧和完整性更新GOP
+	 */
+	void _finish_frame() noexcept;
+
+	/**
+	 * @brief _append
+	 * 追加到GOP后面，超过上限则清空GOP
+	 */
+	void _append(const SharedRawPacket & packet,size_t bytes) noexcept;
+
+	bool _is_complete_key() const noexcept;
+private:
+	size_t							_max_bytes;
+	bool							_has_ssrc{false};
+	uint32_t						_ssrc{0};
+	bool							_has_frame{false};
+	Frame							_frame;
+	std::vector<SharedRawPacket>	_gop;
+	size_t							_gop_bytes{0};
+};
+
+inline bool RTPKeyFrameCache::has_key_frame() const noexcept								{
+	return !_gop.empty() || _is_complete_key();
+}
+inline bool RTPKeyFrameCache::_is_complete_key() const noexcept							{
+	return _has_frame && _frame.key && !_frame.overflow && _frame.received_nb >= _frame.src_nb;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,111 @@
+#include "rtpkeyframerequester.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+const uint8_t RTPKeyFrameRequester::PLI_NAME[4] = {'P','L','I',' '};
+const uint8_t RTPKeyFrameRequester::FIR_NAME[4] = {'F','I','R',' '};
+constexpr int64_t RTPKeyFrameRequester::RETRY_INTERVAL_MS;
+constexpr int64_t RTPKeyFrameRequester::DECODE_ERROR_GRACE_MS;
+
+void RTPKeyFrameRequester::on_frame_lost(uint32_t ssrc) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_request(ssrc,PLI);
+}
+
+void RTPKeyFrameRequester::on_stream_start(uint32_t ssrc) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_request(ssrc,FIR);
+}
+
+void RTPKeyFrameRequester::on_decode_error(uint32_t ssrc) noexcept
+{
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(_mutex);
+	//关键帧之前的帧解码出错，关键帧已经到了
+	if(ssrc == _ssrc && _has_key_frame &&
+			now - _last_key_frame < std::chrono::milliseconds(DECODE_ERROR_GRACE_MS))
+		return;
+	_request(ssrc,PLI);
+}
+
+void RTPKeyFrameRequester::on_key_frame(uint32_t ssrc) noexcept
+{
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(ssrc != _ssrc){
+		if(_pending)
+			return;
+		_ssrc = ssrc;
+		_has_sent = false;
+	}
+	_pending = false;
+	_has_key_frame = true;
+	_last_key_frame = now;
+}
+
+bool RTPKeyFrameRequester::get_request(uint32_t &ssrc, Type &type) noexcept
+{
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(!_pending)
+		return false;
+	if(_has_sent && now - _last_send < std::chrono::milliseconds(RETRY_INTERVAL_MS))
+		return false;
+	_has_sent = true;
+	_last_send = now;
+	ssrc = _ssrc;
+	type = _type;
+	return true;
+}
+
+void RTPKeyFrameRequester::reset() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_pending = false;
+	_ssrc = 0;
+	_has_sent = false;
+	_has_key_frame = false;
+}
+
+void RTPKeyFrameRequester::Pack(uint32_t media_ssrc, std::vector<uint8_t> &output) noexcept
+{
+	output.clear();
+	output.push_back(static_cast<uint8_t>(media_ssrc >> 24));
+	output.push_back(static_cast<uint8_t>(media_ssrc >> 16));
+	output.push_back(static_cast<uint8_t>(media_ssrc >> 8));
+	output.push_back(static_cast<uint8_t>(media_ssrc));
+}
+
+bool RTPKeyFrameRequester::Unpack(const void *data, size_t len, uint32_t &media_ssrc) noexcept
+{
+	if(data == nullptr || len != 4)
+		return false;
+	auto ptr = static_cast<const uint8_t *>(data);
+	media_ssrc = (static_cast<uint32_t>(ptr[0]) << 24) | (static_cast<uint32_t>(ptr[1]) << 16) |
+				 (static_cast<uint32_t>(ptr[2]) << 8) | ptr[3];
+	return true;
+}
+
+void RTPKeyFrameRequester::_request(uint32_t ssrc, Type type) noexcept
+{
+	if(ssrc == 0)
+		return;
+	//流改变了，之前的请求作废
+	if(ssrc != _ssrc){
+		_ssrc = ssrc;
+		_has_sent = false;
+		_has_key_frame = false;
+		_pending = false;
+	}
+	if(!_pending || type == FIR)
+		_type = type;
+	_pending = true;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
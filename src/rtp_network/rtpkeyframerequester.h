@@ -0,0 +1,121 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include <vector>
+#include <mutex>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPKeyFrameRequester class
+ * 接收端的关键帧请求，每个用户的视频流一个
+ * 丢失的包重传和FEC都恢复不了的时候，解码器只能等到下一个关键帧，GOP很长的时候花屏的时间也很长，
+ * 所以接收端主动请求推流端立即编码一个关键帧:
+ * 1.PLI(RFC4585):一帧不完整(重传和FEC都失败)、帧来得太晚被丢弃、解码出错
+ * 2.FIR(RFC5104):开始接收一个新的流(比如切换联播的层)，需要一个完整的关键帧
+ * 由发送线程定时取出，通过rtcp发送给推流端，推流端的编码器负责合并同一时间的多个请求
+ * 请求一直保留到收到关键帧为止，请求的包或者关键帧丢失了也能恢复:
+ * 每隔RETRY_INTERVAL_MS重发一次，间隔之内的多次请求只发送一次
+ * 收到关键帧之后，之前的帧导致的解码错误不再请求(解码器处理的帧比收到的帧晚)
+ *
+ * jrtplib不能发送PSFB类型的rtcp包，和NACK一样放在APP包里面，数据是媒体流的ssrc
+ * 该类是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPKeyFrameRequester
+{
+public:
+	enum Type{
+		PLI,
+		FIR
+	};
+public:
+	RTPKeyFrameRequester() = default;
+
+	/**
+	 * @brief on_frame_lost
+	 * 一帧数据无法恢复
+	 * @param ssrc
+	 * 媒体流的ssrc
+	 */
+	void on_frame_lost(uint32_t ssrc) noexcept;
+
+	/**
+	 * @brief on_stream_start
+	 * 开始接收一个新的流
+	 */
+	void on_stream_start(uint32_t ssrc) noexcept;
+
+	/**
+	 * @brief on_decode_error
+	 * 解码出错
+	 * @param ssrc
+	 * 正在接收的流
+	 */
+	void on_decode_error(uint32_t ssrc) noexcept;
+
+	/**
+	 * @brief on_key_frame
+	 * 收到了一个完整的关键帧，不再需要请求
+	 * 正在请求另外一个流(比如刚切换了联播的层)的时候，旧的流的关键帧不算
+	 */
+	void on_key_frame(uint32_t ssrc) noexcept;
+
+	/**
+	 * @brief get_request
+	 * 取出需要发送的请求，发送之后请求仍然保留，直到收到关键帧
+	 * @return
+	 * 没有请求或者距离上一次发送太近则返回false
+	 */
+	bool get_request(uint32_t & ssrc,Type & type) noexcept;
+
+	/**
+	 * @brief reset
+	 * 清除所有记录
+	 */
+	void reset() noexcept;
+
+	/**
+	 * @brief Pack
+	 * 把请求打包成APP包的数据:媒体流ssrc，网络字节序
+	 */
+	static void Pack(uint32_t media_ssrc,std::vector<uint8_t> & output) noexcept;
+
+	/**
+	 * @brief Unpack
+	 * 解析APP包的数据
+	 * @return
+	 * 数据格式不对则返回false
+	 */
+	static bool Unpack(const void * data,size_t len,uint32_t & media_ssrc) noexcept;
+public:
+	//APP包的名字
+	static const uint8_t PLI_NAME[4];
+	static const uint8_t FIR_NAME[4];
+	//同一个流两次发送请求的间隔，关键帧还没到的时候按照这个间隔重发
+	static constexpr int64_t RETRY_INTERVAL_MS = 300;
+	//收到关键帧之后这段时间内的解码错误不请求，和抖动缓冲区的最大延迟一样
+	static constexpr int64_t DECODE_ERROR_GRACE_MS = 500;
+private:
+	/**
+	 * @brief _request
+	 * 记录一个请求，FIR优先
+	 */
+	void _request(uint32_t ssrc,Type type) noexcept;
+private:
+	std::mutex						_mutex;
+	bool							_pending{false};
+	Type							_type{PLI};
+	uint32_t						_ssrc{0};
+	bool							_has_sent{false};
+	core::Clock::TimePoint			_last_send;
+	bool							_has_key_frame{false};
+	core::Clock::TimePoint			_last_key_frame;
+};
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
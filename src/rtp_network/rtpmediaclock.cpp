@@ -0,0 +1,61 @@
+#include "rtpmediaclock.h"
+#include <algorithm>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+constexpr uint32_t RTPMediaClock::VIDEO_CLOCK_RATE;
+constexpr int64_t RTPMediaClock::MAX_GAP_SECONDS;
+constexpr int64_t RTPMediaClock::MAX_REORDER_SECONDS;
+
+RTPMediaClock::RTPMediaClock(uint32_t clock_rate, int64_t pts_rate) noexcept:
+	_clock_rate(clock_rate),
+	_pts_rate(pts_rate)
+{
+
+}
+
+void RTPMediaClock::set_clock_rate(uint32_t clock_rate, int64_t pts_rate) noexcept
+{
+	if(_clock_rate == clock_rate && _pts_rate == pts_rate)
+		return;
+	_clock_rate = clock_rate;
+	_pts_rate = pts_rate;
+	reset();
+}
+
+uint32_t RTPMediaClock::next_frame(int64_t pts, uint32_t duration) noexcept
+{
+	if(!_started){
+		_started = true;
+		_anchor_pts = _max_pts = pts;
+		_anchor_ts = _last_ts = 0;
+		return 0;
+	}
+	auto ts = _last_ts + std::max(duration,1u);
+	if(_pts_rate > 0 && _clock_rate > 0){
+		//分开计算整数部分和余数部分，避免溢出
+		auto elapsed = pts - _anchor_pts;
+		auto target = _anchor_ts + elapsed / _pts_rate * _clock_rate +
+					  elapsed % _pts_rate * _clock_rate / _pts_rate;
+		if(target > _last_ts && target - _last_ts <= MAX_GAP_SECONDS * _clock_rate)
+			ts = target;
+		else if(pts < _max_pts && _max_pts - pts <= MAX_REORDER_SECONDS * _pts_rate){
+			//解码顺序的B帧，保持原来的起点
+		} else {
+			//pts回退或者跳变，以当前帧作为新的起点
+			_anchor_pts = pts;
+			_anchor_ts = ts;
+			_max_pts = pts;
+		}
+		_max_pts = std::max(_max_pts,pts);
+	}
+	auto inc = static_cast<uint32_t>(ts - _last_ts);
+	_last_ts = ts;
+	return inc;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
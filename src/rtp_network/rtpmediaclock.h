@@ -0,0 +1,98 @@
+
+#pragma once
+
+#include "../core/config.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPMediaClock class
+ * 发送端的媒体时钟，把帧的pts换算成rtp时间戳
+ * 视频使用90kHz，音频使用采样率，同一帧的所有包使用同一个时间戳
+ * 接收端可以据此计算抖动、播放时间以及音视频同步
+ *
+ * 只计算相对于上一帧的时间戳增量，时间戳的随机初始值由rtp会话决定:
+ * 1.pts的单位已知(pts_rate大于0)并且pts正常递增，时间戳按照pts换算
+ * 2.pts不可用(pts_rate为0)，或者pts回退、跳变太大，则按照帧的默认时长递增，
+ *   并以当前帧作为新的起点继续按照pts换算
+ * 3.pts比之前最大的pts小不到MAX_REORDER_SECONDS，认为是按照解码顺序输出的B帧，
+ *   按照默认时长递增但不改变起点，之后的帧仍然按照原来的起点换算，时间戳不会越来越快
+ *   (编码器已经关闭了B帧，接收端按照时间戳排序也不支持B帧，这里只是避免误用的时候时钟跑飞)
+ * 时间戳严格递增，不同的帧不会使用同一个时间戳
+ * 注:该类不是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPMediaClock
+{
+public:
+	/**
+	 * @brief RTPMediaClock
+	 * @param clock_rate
+	 * rtp时间戳的时钟频率
+	 * @param pts_rate
+	 * pts的单位(每秒多少个单位)，0表示pts不可用
+	 */
+	explicit RTPMediaClock(uint32_t clock_rate = VIDEO_CLOCK_RATE,int64_t pts_rate = 0) noexcept;
+
+	/**
+	 * @brief set_clock_rate
+	 * 设置时钟频率和pts的单位，变化的时候会重新开始
+	 */
+	void set_clock_rate(uint32_t clock_rate,int64_t pts_rate) noexcept;
+
+	/**
+	 * @brief get_clock_rate
+	 * 获取时钟频率
+	 */
+	uint32_t get_clock_rate() const noexcept;
+
+	/**
+	 * @brief next_frame
+	 * 计算新的一帧的时间戳
+	 * @param pts
+	 * 帧的pts
+	 * @param duration
+	 * 帧的默认时长(时钟频率的单位)，pts不可用的时候使用，至少为1
+	 * @return
+	 * 相对于上一帧的时间戳增量，第一帧返回0
+	 */
+	uint32_t next_frame(int64_t pts,uint32_t duration) noexcept;
+
+	/**
+	 * @brief get_timestamp
+	 * 获取当前帧相对于第一帧的时间戳(没有翻转)
+	 */
+	int64_t get_timestamp() const noexcept;
+
+	/**
+	 * @brief reset
+	 * 重新开始，下一帧作为第一帧
+	 */
+	void reset() noexcept;
+public:
+	//视频的时钟频率
+	static constexpr uint32_t VIDEO_CLOCK_RATE = 90000;
+	//pts跳变超过该值(秒)则重新选择起点
+	static constexpr int64_t MAX_GAP_SECONDS = 5;
+	//pts回退不超过该值(秒)认为是帧的重排序，不重新选择起点
+	static constexpr int64_t MAX_REORDER_SECONDS = 1;
+private:
+	uint32_t	_clock_rate;
+	int64_t		_pts_rate;
+	bool		_started{false};
+	//换算的起点
+	int64_t		_anchor_pts{0};
+	int64_t		_anchor_ts{0};
+	int64_t		_last_ts{0};
+	//收到的最大的pts
+	int64_t		_max_pts{0};
+};
+
+inline uint32_t RTPMediaClock::get_clock_rate() const noexcept						{		return _clock_rate;}
+inline int64_t RTPMediaClock::get_timestamp() const noexcept						{		return _last_ts;}
+inline void RTPMediaClock::reset() noexcept											{		_started = false;}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,117 @@
+#include "rtpmemorypool.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+constexpr size_t RTPMemoryPool::MIN_BLOCK_SIZE;
+constexpr size_t RTPMemoryPool::CLASS_COUNT;
+constexpr size_t RTPMemoryPool::MAX_BLOCK_SIZE;
+constexpr size_t RTPMemoryPool::BLOCKS_PER_SLAB;
+constexpr size_t RTPMemoryPool::LARGE_CLASS;
+
+RTPMemoryPool::~RTPMemoryPool()
+{
+	for(auto & pool : _classes){
+		for(auto slab : pool.slabs)
+			::operator delete(slab);
+		pool.slabs.clear();
+		pool.free = nullptr;
+	}
+}
+
+void *RTPMemoryPool::AllocateBuffer(size_t numbytes, int memtype)
+{
+	UNUSED(memtype)
+	auto size_class = _get_size_class(numbytes);
+	Header * header{nullptr};
+	if(size_class == LARGE_CLASS){
+		header = static_cast<Header *>(::operator new(sizeof(Header) + numbytes,std::nothrow));
+		if(header == nullptr)
+			return nullptr;
+		std::lock_guard<std::mutex> lk(_large_mutex);
+		++_large_allocations;
+	}
+	else {
+		auto & pool = _classes[size_class];
+		std::lock_guard<std::mutex> lk(pool.mutex);
+		if(pool.free == nullptr && !_grow(pool,size_class))
+			return nullptr;
+		auto block = pool.free;
+		pool.free = block->next;
+		++pool.allocations;
+		header = reinterpret_cast<Header *>(block);
+	}
+	header->size_class = size_class;
+	return header + 1;
+}
+
+void RTPMemoryPool::FreeBuffer(void *buffer)
+{
+	if(buffer == nullptr)
+		return;
+	auto header = static_cast<Header *>(buffer) - 1;
+	auto size_class = header->size_class;
+	if(size_class >= LARGE_CLASS){
+		::operator delete(header);
+		return;
+	}
+	auto block = reinterpret_cast<FreeBlock *>(header);
+	auto & pool = _classes[size_class];
+	std::lock_guard<std::mutex> lk(pool.mutex);
+	block->next = pool.free;
+	pool.free = block;
+}
+
+RTPMemoryPool::Statistics RTPMemoryPool::get_statistics() noexcept
+{
+	Statistics statistics;
+	for(size_t n = 0; n < CLASS_COUNT; ++n){
+		auto & pool = _classes[n];
+		std::lock_guard<std::mutex> lk(pool.mutex);
+		statistics.allocations += pool.allocations;
+		statistics.system_allocations += pool.slabs.size();
+		statistics.slab_bytes += pool.slabs.size() * BLOCKS_PER_SLAB *
+				(sizeof(Header) + (MIN_BLOCK_SIZE << n));
+	}
+	std::lock_guard<std::mutex> lk(_large_mutex);
+	statistics.allocations += _large_allocations;
+	statistics.system_allocations += _large_allocations;
+	return statistics;
+}
+
+size_t RTPMemoryPool::_get_size_class(size_t size) noexcept
+{
+	size_t size_class = 0;
+	size_t block_size = MIN_BLOCK_SIZE;
+	while(block_size < size && size_class < CLASS_COUNT){
+		block_size <<= 1;
+		++size_class;
+	}
+	return size_class;
+}
+
+bool RTPMemoryPool::_grow(SizeClass &pool, size_t size_class) noexcept
+{
+	//块的大小是对齐大小的倍数，每个块的头部和数据都是对齐的
+	auto block_size = sizeof(Header) + (MIN_BLOCK_SIZE << size_class);
+	auto slab = static_cast<unsigned char *>(::operator new(block_size * BLOCKS_PER_SLAB,std::nothrow));
+	if(slab == nullptr)
+		return false;
+	try {
+		pool.slabs.push_back(slab);
+	} catch (const std::bad_alloc &) {
+		::operator delete(slab);
+		return false;
+	}
+	for(size_t n = 0; n < BLOCKS_PER_SLAB; ++n){
+		auto block = reinterpret_cast<FreeBlock *>(slab + n * block_size);
+		block->next = pool.free;
+		pool.free = block;
+	}
+	return true;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,152 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "jrtplib3/rtpmemorymanager.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <cstddef>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPMemoryPoolStatistics struct
+ * 内存池的统计
+ */
+struct RTPMemoryPoolStatistics {
+	//从池里分配的次数
+	uint64_t allocations{0};
+	//向系统申请内存的次数(新的slab和超过最大块的分配)，稳定之后不再增加
+	uint64_t system_allocations{0};
+	//当前持有的slab的总字节数
+	size_t slab_bytes{0};
+};
+
+/**
+ * @brief The RTPMemoryPool class
+ * jrtplib的内存管理器，使用固定大小的块(slab)池
+ * 每收到一个包，jrtplib都要分配原始包、地址、数据缓冲区和RTPPacket，再加上shared_ptr的控制块，
+ * 原来都是直接new和delete，这里按照大小分成几个等级，每个等级一个空闲链表:
+ * 1.分配的时候从对应等级的空闲链表取出一个块，链表空了才向系统申请一个slab(BLOCKS_PER_SLAB个块)
+ * 2.释放的时候放回空闲链表，slab不会还给系统，直到内存池销毁
+ * 所以稳定之后接收路径不再向系统申请内存，内存占用是峰值时的大小
+ * 超过最大等级的分配直接向系统申请
+ * 包会在其他线程(解码线程)释放，每个等级一个锁，该类是线程安全的
+ * 注:需要比从它分配的所有内存后释放，所以使用shared_ptr管理(见Allocator)
+ */
+class RTPLIVELIBSHARED_EXPORT RTPMemoryPool : public jrtplib::RTPMemoryManager
+{
+public:
+	using Statistics = RTPMemoryPoolStatistics;
+
+	/**
+	 * @brief The Allocator class
+	 * 标准库的分配器，用于std::allocate_shared，持有内存池的引用，
+	 * 控制块释放之前内存池不会被销毁
+	 */
+	template<typename Type>
+	class Allocator {
+	public:
+		using value_type = Type;
+
+		explicit Allocator(std::shared_ptr<RTPMemoryPool> pool) noexcept:
+			pool(std::move(pool))
+		{	}
+
+		template<typename Other>
+		Allocator(const Allocator<Other> & other) noexcept:
+			pool(other.pool)
+		{	}
+
+		Type * allocate(size_t n){
+			auto ptr = pool->AllocateBuffer(n * sizeof(Type),RTPMEM_TYPE_OTHER);
+			if(ptr == nullptr)
+				throw std::bad_alloc();
+			return static_cast<Type *>(ptr);
+		}
+
+		void deallocate(Type * ptr,size_t) noexcept{
+			pool->FreeBuffer(ptr);
+		}
+
+		template<typename Other>
+		bool operator==(const Allocator<Other> & other) const noexcept{
+			return pool == other.pool;
+		}
+
+		template<typename Other>
+		bool operator!=(const Allocator<Other> & other) const noexcept{
+			return pool != other.pool;
+		}
+
+		std::shared_ptr<RTPMemoryPool> pool;
+	};
+public:
+	RTPMemoryPool() = default;
+
+	~RTPMemoryPool() override;
+
+	RTPMemoryPool(const RTPMemoryPool &) = delete;
+	RTPMemoryPool & operator=(const RTPMemoryPool &) = delete;
+
+	void *AllocateBuffer(size_t numbytes,int memtype) override;
+
+	void FreeBuffer(void *buffer) override;
+
+	/**
+	 * @brief get_statistics
+	 * 获取统计
+	 */
+	Statistics get_statistics() noexcept;
+public:
+	//块的等级:64,128,...,4096字节，RECV_SLOT_SIZE大小的包也可以放进池里
+	static constexpr size_t MIN_BLOCK_SIZE = 64;
+	static constexpr size_t CLASS_COUNT = 7;
+	static constexpr size_t MAX_BLOCK_SIZE = MIN_BLOCK_SIZE << (CLASS_COUNT - 1);
+	//每次向系统申请的块数
+	static constexpr size_t BLOCKS_PER_SLAB = 64;
+private:
+	//每个块前面的头部，记录所属的等级，保证返回的地址按照max_align_t对齐
+	union alignas(alignof(std::max_align_t)) Header {
+		size_t						size_class;
+		unsigned char				padding[alignof(std::max_align_t)];
+	};
+	//空闲的块，复用块的内容保存链表
+	struct FreeBlock {
+		FreeBlock					*next;
+	};
+	struct SizeClass {
+		std::mutex					mutex;
+		FreeBlock					*free{nullptr};
+		//所有slab，销毁的时候释放
+		std::vector<void *>			slabs;
+		uint64_t					allocations{0};
+	};
+
+	/**
+	 * @brief _get_size_class
+	 * 获取能放下size字节的最小等级，超过最大等级则返回CLASS_COUNT
+	 */
+	static size_t _get_size_class(size_t size) noexcept;
+
+	/**
+	 * @brief _grow
+	 * 申请一个新的slab，放进空闲链表，调用前需要锁住该等级的锁
+	 */
+	bool _grow(SizeClass & pool,size_t size_class) noexcept;
+private:
+	//超过最大等级的分配使用的等级
+	static constexpr size_t LARGE_CLASS = CLASS_COUNT;
+
+	SizeClass						_classes[CLASS_COUNT];
+	std::mutex						_large_mutex;
+	uint64_t						_large_allocations{0};
+};
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
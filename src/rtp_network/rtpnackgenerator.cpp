@@ -0,0 +1,134 @@
+#include "rtpnackgenerator.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//一个条目最多表示的包数:PID加上BLP的16位
+static constexpr uint16_t NACK_ENTRY_RANGE = 17;
+
+const uint8_t RTPNackGenerator::APP_NAME[4] = {'N','A','C','K'};
+constexpr size_t RTPNackGenerator::MAX_MISSING;
+constexpr int64_t RTPNackGenerator::REORDER_DELAY_MS;
+constexpr int64_t RTPNackGenerator::RETRY_INTERVAL_MS;
+constexpr int RTPNackGenerator::MAX_RETRIES;
+constexpr int64_t RTPNackGenerator::MAX_AGE_MS;
+
+void RTPNackGenerator::on_packet(uint32_t ssrc, uint32_t ext_seq) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(!_started || ssrc != _ssrc){
+		_started = true;
+		_ssrc = ssrc;
+		_highest = ext_seq;
+		_missing.clear();
+		return;
+	}
+	//重传或者乱序的包
+	if(static_cast<int32_t>(ext_seq - _highest) <= 0){
+		_missing.erase(ext_seq);
+		return;
+	}
+	auto gap = ext_seq - _highest - 1;
+	if(gap > MAX_MISSING){
+		_missing.clear();
+	}
+	else if(gap > 0){
+		Missing missing;
+		missing.detect_time = core::Clock::Get_Clock()->now();
+		for(auto seq = _highest + 1; seq != ext_seq; ++seq)
+			_missing[seq] = missing;
+		//丢包太多的时候只保留最新的
+		while(_missing.size() > MAX_MISSING)
+			_missing.erase(_missing.begin());
+	}
+	_highest = ext_seq;
+}
+
+void RTPNackGenerator::on_frame_complete(uint32_t ext_seq) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_missing.erase(_missing.begin(),_missing.upper_bound(ext_seq));
+}
+
+uint32_t RTPNackGenerator::get_nack_list(RTPNackGenerator::NackList &list) noexcept
+{
+	list.clear();
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(_mutex);
+	for(auto it = _missing.begin(); it != _missing.end();){
+		auto & missing = it->second;
+		if(missing.retries >= MAX_RETRIES ||
+				now - missing.detect_time > std::chrono::milliseconds(MAX_AGE_MS)){
+			_missing.erase(it++);
+			continue;
+		}
+		bool due = missing.retries == 0 ?
+					   now - missing.detect_time >= std::chrono::milliseconds(REORDER_DELAY_MS) :
+					   now - missing.last_send >= std::chrono::milliseconds(RETRY_INTERVAL_MS);
+		if(due){
+			++missing.retries;
+			missing.last_send = now;
+			list.push_back(static_cast<uint16_t>(it->first));
+		}
+		++it;
+	}
+	return _ssrc;
+}
+
+void RTPNackGenerator::reset() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_started = false;
+	_missing.clear();
+}
+
+void RTPNackGenerator::Pack(uint32_t media_ssrc, const NackList &list, std::vector<uint8_t> &output) noexcept
+{
+	output.clear();
+	output.push_back(static_cast<uint8_t>(media_ssrc >> 24));
+	output.push_back(static_cast<uint8_t>(media_ssrc >> 16));
+	output.push_back(static_cast<uint8_t>(media_ssrc >> 8));
+	output.push_back(static_cast<uint8_t>(media_ssrc));
+	size_t n = 0;
+	while(n < list.size()){
+		uint16_t pid = list[n++];
+		uint16_t blp = 0;
+		//序列号是16位的，用差值判断，翻转的时候也正确
+		while(n < list.size()){
+			uint16_t diff = static_cast<uint16_t>(list[n] - pid);
+			if(diff == 0 || diff >= NACK_ENTRY_RANGE)
+				break;
+			blp |= static_cast<uint16_t>(1 << (diff - 1));
+			++n;
+		}
+		output.push_back(static_cast<uint8_t>(pid >> 8));
+		output.push_back(static_cast<uint8_t>(pid));
+		output.push_back(static_cast<uint8_t>(blp >> 8));
+		output.push_back(static_cast<uint8_t>(blp));
+	}
+}
+
+bool RTPNackGenerator::Unpack(const void *data, size_t len, uint32_t &media_ssrc, NackList &list) noexcept
+{
+	list.clear();
+	if(data == nullptr || len < 8 || len % 4 != 0)
+		return false;
+	auto ptr = static_cast<const uint8_t *>(data);
+	media_ssrc = (static_cast<uint32_t>(ptr[0]) << 24) | (static_cast<uint32_t>(ptr[1]) << 16) |
+				 (static_cast<uint32_t>(ptr[2]) << 8) | ptr[3];
+	for(size_t offset = 4; offset < len; offset += 4){
+		uint16_t pid = static_cast<uint16_t>((ptr[offset] << 8) | ptr[offset + 1]);
+		uint16_t blp = static_cast<uint16_t>((ptr[offset + 2] << 8) | ptr[offset + 3]);
+		list.push_back(pid);
+		for(uint16_t bit = 0; bit < 16; ++bit){
+			if(blp & (1 << bit))
+				list.push_back(static_cast<uint16_t>(pid + bit + 1));
+		}
+	}
+	return true;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
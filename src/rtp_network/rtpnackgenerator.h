@@ -0,0 +1,111 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPNackGenerator class
+ * 接收端的丢包检测，每个用户的视频流一个
+ * 根据收到的rtp包的扩展序列号记录中间缺失的包，
+ * 由发送线程定时取出需要请求重传的序列号，通过rtcp发送给推流端
+ * 同一个包隔一段时间再请求一次，超过重试次数或者太旧就放弃，交给FEC或者下一个关键帧恢复
+ * 一帧数据已经解码成功(FEC恢复了丢失的包)，这一帧之前的丢包就不需要再请求了
+ *
+ * 请求的格式参考RFC4585的Generic NACK:
+ * 每个条目4个字节，PID(16位)是丢失的序列号，BLP(16位)表示PID之后16个包是否也丢失
+ * jrtplib不能发送RTPFB类型的rtcp包，所以放在APP包里面，前面加上媒体流的ssrc
+ * 该类是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPNackGenerator
+{
+public:
+	using NackList = std::vector<uint16_t>;
+public:
+	RTPNackGenerator() = default;
+
+	/**
+	 * @brief on_packet
+	 * 收到一个rtp包
+	 * @param ssrc
+	 * 该包的ssrc，ssrc改变(对方重新创建了会话)则重新统计
+	 * @param ext_seq
+	 * 扩展序列号(高16位是序列号翻转次数)
+	 */
+	void on_packet(uint32_t ssrc,uint32_t ext_seq) noexcept;
+
+	/**
+	 * @brief on_frame_complete
+	 * 一帧数据解码成功，不再请求该包以及之前的丢包
+	 * @param ext_seq
+	 * 使该帧解码成功的包的扩展序列号
+	 */
+	void on_frame_complete(uint32_t ext_seq) noexcept;
+
+	/**
+	 * @brief get_nack_list
+	 * 取出当前需要请求重传的序列号(按照从旧到新的顺序)
+	 * @param list
+	 * 输出的序列号
+	 * @return
+	 * 媒体流的ssrc，没有需要请求的包则list为空
+	 */
+	uint32_t get_nack_list(NackList & list) noexcept;
+
+	/**
+	 * @brief reset
+	 * 清除所有记录
+	 */
+	void reset() noexcept;
+
+	/**
+	 * @brief Pack
+	 * 把序列号打包成APP包的数据:媒体流ssrc + 若干个PID/BLP条目，都是网络字节序
+	 * @param list
+	 * 需要按照从旧到新排序
+	 */
+	static void Pack(uint32_t media_ssrc,const NackList & list,std::vector<uint8_t> & output) noexcept;
+
+	/**
+	 * @brief Unpack
+	 * 解析APP包的数据
+	 * @return
+	 * 数据格式不对则返回false
+	 */
+	static bool Unpack(const void * data,size_t len,uint32_t & media_ssrc,NackList & list) noexcept;
+public:
+	//APP包的名字
+	static const uint8_t APP_NAME[4];
+	//缺失的包超过该数量(比如网络中断了一段时间)则放弃重传，等待关键帧
+	static constexpr size_t MAX_MISSING = 512;
+	//检测到丢包后等待一段时间再请求，避免把乱序当成丢包
+	static constexpr int64_t REORDER_DELAY_MS = 10;
+	//同一个包两次请求的间隔
+	static constexpr int64_t RETRY_INTERVAL_MS = 50;
+	//同一个包最多请求的次数
+	static constexpr int MAX_RETRIES = 3;
+	//超过该时间还没收到则放弃
+	static constexpr int64_t MAX_AGE_MS = 1000;
+private:
+	struct Missing{
+		core::Clock::TimePoint	detect_time;
+		core::Clock::TimePoint	last_send;
+		int						retries{0};
+	};
+	std::mutex						_mutex;
+	bool							_started{false};
+	uint32_t						_ssrc{0};
+	uint32_t						_highest{0};
+	std::map<uint32_t,Missing>		_missing;
+};
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,286 @@
+#include "rtpnalpacketizer.h"
+#include "rtpsession.h"
+#include <algorithm>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//H.264的NAL头部1字节，聚合包类型STAP-A，分片包类型FU-A
+static constexpr uint8_t H264_STAP_A = 24;
+static constexpr uint8_t H264_FU_A = 28;
+//HEVC的NAL头部2字节，聚合包类型AP，分片包类型FU
+static constexpr uint8_t HEVC_AP = 48;
+static constexpr uint8_t HEVC_FU = 49;
+//FU头部的起始和结束标志
+static constexpr uint8_t FU_START = 0x80;
+static constexpr uint8_t FU_END = 0x40;
+//聚合包里每个NAL单元前面的长度字段
+static constexpr size_t AGG_LENGTH_SIZE = 2;
+
+static constexpr uint8_t START_CODE[4] = {0,0,0,1};
+
+static inline size_t get_header_size(RTPNalPacketizer::Codec codec) noexcept{
+	return codec == RTPNalPacketizer::H264 ? 1 : 2;
+}
+
+static inline uint8_t get_type(RTPNalPacketizer::Codec codec,const uint8_t * nal) noexcept{
+	return codec == RTPNalPacketizer::H264 ? nal[0] & 0x1F : (nal[0] >> 1) & 0x3F;
+}
+
+/**
+ * @brief find_start_code
+ * 从pos开始查找起始码(00 00 01)，找不到则返回len
+ */
+static inline size_t find_start_code(const uint8_t * data,size_t len,size_t pos) noexcept{
+	for(; pos + 2 < len; ++pos){
+		if(data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1)
+			return pos;
+	}
+	return len;
+}
+
+/**
+ * @brief aggregate
+ * 把多个NAL单元合并成一个STAP-A/AP包
+ */
+static void aggregate(RTPNalPacketizer::Codec codec,const std::vector<RTPNalPacketizer::Payload> & nals,
+					  std::vector<uint8_t> & output) noexcept{
+	output.clear();
+	if(codec == RTPNalPacketizer::H264){
+		//F取或，NRI取最大值
+		uint8_t f{0},nri{0};
+		for(auto & nal:nals){
+			f |= nal.first[0] & 0x80;
+			nri = std::max<uint8_t>(nri,nal.first[0] & 0x60);
+		}
+		output.push_back(f | nri | H264_STAP_A);
+	}
+	else {
+		//F取或，LayerId和TID取最小值
+		uint8_t f{0},layer{0x3F},tid{0x07};
+		for(auto & nal:nals){
+			f |= nal.first[0] & 0x80;
+			layer = std::min<uint8_t>(layer,static_cast<uint8_t>(((nal.first[0] & 0x01) << 5) | (nal.first[1] >> 3)));
+			tid = std::min<uint8_t>(tid,nal.first[1] & 0x07);
+		}
+		output.push_back(static_cast<uint8_t>(f | (HEVC_AP << 1) | (layer >> 5)));
+		output.push_back(static_cast<uint8_t>(((layer & 0x1F) << 3) | tid));
+	}
+	for(auto & nal:nals){
+		output.push_back(static_cast<uint8_t>(nal.second >> 8));
+		output.push_back(static_cast<uint8_t>(nal.second));
+		output.insert(output.end(),nal.first,nal.first + nal.second);
+	}
+}
+
+/**
+ * @brief fragment
+ * 把一个大的NAL单元分成多个FU-A/FU包
+ */
+static void fragment(RTPNalPacketizer::Codec codec,const RTPNalPacketizer::Payload & nal,size_t max_payload,
+					 std::vector<std::vector<uint8_t>> & output) noexcept{
+	auto header_size = get_header_size(codec);
+	//分片包的头部比NAL头部多一个FU头部
+	auto unit = max_payload - header_size - 1;
+	auto type = get_type(codec,nal.first);
+	auto data = nal.first + header_size;
+	auto remain = nal.second - header_size;
+	bool start = true;
+	while(remain > 0){
+		auto size = std::min(unit,remain);
+		uint8_t fu_header = type;
+		if(start)
+			fu_header |= FU_START;
+		if(size == remain)
+			fu_header |= FU_END;
+		std::vector<uint8_t> packet;
+		packet.reserve(header_size + 1 + size);
+		if(codec == RTPNalPacketizer::H264)
+			packet.push_back(static_cast<uint8_t>((nal.first[0] & 0xE0) | H264_FU_A));
+		else {
+			packet.push_back(static_cast<uint8_t>((nal.first[0] & 0x81) | (HEVC_FU << 1)));
+			packet.push_back(nal.first[1]);
+		}
+		packet.push_back(fu_header);
+		packet.insert(packet.end(),data,data + size);
+		output.push_back(std::move(packet));
+		data += size;
+		remain -= size;
+		start = false;
+	}
+}
+
+bool RTPNalPacketizer::Is_Supported(int payload_type) noexcept
+{
+	return payload_type == RTPSession::PayloadType::RTP_PT_H264 ||
+			payload_type == RTPSession::PayloadType::RTP_PT_HEVC;
+}
+
+RTPNalPacketizer::Codec RTPNalPacketizer::Get_Codec(int payload_type) noexcept
+{
+	return payload_type == RTPSession::PayloadType::RTP_PT_HEVC ? HEVC : H264;
+}
+
+void RTPNalPacketizer::Split(const uint8_t *data, size_t len, std::vector<Payload> &nals) noexcept
+{
+	nals.clear();
+	auto start = find_start_code(data,len,0);
+	//没有起始码，整个数据当作一个NAL单元
+	if(start == len){
+		if(len > 0)
+			nals.emplace_back(data,len);
+		return;
+	}
+	while(start < len){
+		auto begin = start + 3;
+		auto next = find_start_code(data,len,begin);
+		//4字节起始码的第一个0属于上一个NAL单元的末尾，去掉
+		auto end = next;
+		while(end > begin && data[end - 1] == 0)
+			--end;
+		if(end > begin)
+			nals.emplace_back(data + begin,end - begin);
+		start = next;
+	}
+}
+
+void RTPNalPacketizer::Packetize(Codec codec, const uint8_t *data, size_t len, size_t max_payload,
+								 std::vector<std::vector<uint8_t>> &output) noexcept
+{
+	output.clear();
+	auto header_size = get_header_size(codec);
+	//至少要能放下分片包的头部和1字节数据
+	if(data == nullptr || max_payload <= header_size + 1)
+		return;
+	std::vector<Payload> nals;
+	Split(data,len,nals);
+
+	std::vector<Payload> pending;
+	auto pending_size = header_size;
+	std::vector<uint8_t> packet;
+	auto flush = [&](){
+		if(pending.size() == 1)
+			output.emplace_back(pending[0].first,pending[0].first + pending[0].second);
+		else if(pending.size() > 1){
+			aggregate(codec,pending,packet);
+			output.push_back(packet);
+		}
+		pending.clear();
+		pending_size = header_size;
+	};
+	for(auto & nal:nals){
+		if(nal.second <= header_size)
+			continue;
+		if(nal.second > max_payload){
+			flush();
+			fragment(codec,nal,max_payload,output);
+			continue;
+		}
+		//小的NAL单元尽量合并，放不下就先发送之前的
+		if(!pending.empty() && pending_size + AGG_LENGTH_SIZE + nal.second > max_payload)
+			flush();
+		pending.push_back(nal);
+		pending_size += AGG_LENGTH_SIZE + nal.second;
+	}
+	flush();
+}
+
+size_t RTPNalPacketizer::Depacketize(Codec codec, const std::vector<Payload> &payloads,
+									 std::vector<uint8_t> &output) noexcept
+{
+	output.clear();
+	size_t count{0};
+	auto put = [&](const uint8_t * nal,size_t size){
+		output.insert(output.end(),START_CODE,START_CODE + sizeof(START_CODE));
+		output.insert(output.end(),nal,nal + size);
+		++count;
+	};
+	auto header_size = get_header_size(codec);
+	auto agg_type = codec == H264 ? H264_STAP_A : HEVC_AP;
+	auto fu_type = codec == H264 ? H264_FU_A : HEVC_FU;
+	//正在组装的分片，中间丢了包则丢弃整个NAL单元
+	std::vector<uint8_t> fu;
+	bool fu_valid{false};
+	for(auto & payload:payloads){
+		auto p = payload.first;
+		auto len = payload.second;
+		if(p == nullptr || len <= header_size){
+			fu_valid = false;
+			continue;
+		}
+		auto type = get_type(codec,p);
+		if(type == agg_type){
+			size_t offset = header_size;
+			while(offset + AGG_LENGTH_SIZE <= len){
+				size_t size = static_cast<size_t>(p[offset] << 8) | p[offset + 1];
+				offset += AGG_LENGTH_SIZE;
+				if(size == 0 || offset + size > len)
+					break;
+				put(p + offset,size);
+				offset += size;
+			}
+		}
+		else if(type == fu_type){
+			auto fu_header = p[header_size];
+			if(fu_header & FU_START){
+				fu.clear();
+				if(codec == H264)
+					fu.push_back(static_cast<uint8_t>((p[0] & 0xE0) | (fu_header & 0x1F)));
+				else {
+					fu.push_back(static_cast<uint8_t>((p[0] & 0x81) | ((fu_header & 0x3F) << 1)));
+					fu.push_back(p[1]);
+				}
+				fu_valid = true;
+			}
+			if(!fu_valid)
+				continue;
+			fu.insert(fu.end(),p + header_size + 1,p + len);
+			if(fu_header & FU_END){
+				put(fu.data(),fu.size());
+				fu_valid = false;
+			}
+		}
+		//H.264的1~23和HEVC的0~47是单NAL单元包，其他的类型不支持
+		else if( codec == H264 ? (type >= 1 && type <= 23) : type < HEVC_AP )
+			put(p,len);
+	}
+	return count;
+}
+
+bool RTPNalPacketizer::Is_Key_Payload(Codec codec, const uint8_t *payload, size_t len) noexcept
+{
+	auto header_size = get_header_size(codec);
+	if(payload == nullptr || len <= header_size)
+		return false;
+	//H.264:IDR(5)、SPS(7)、PPS(8)
+	//HEVC:IRAP(16~21)、VPS(32)、SPS(33)、PPS(34)
+	auto is_key = [codec](uint8_t type){
+		if(codec == H264)
+			return type == 5 || type == 7 || type == 8;
+		return (type >= 16 && type <= 21) || (type >= 32 && type <= 34);
+	};
+	auto type = get_type(codec,payload);
+	if(type == (codec == H264 ? H264_FU_A : HEVC_FU)){
+		auto fu_header = payload[header_size];
+		return is_key(codec == H264 ? fu_header & 0x1F : fu_header & 0x3F);
+	}
+	if(type == (codec == H264 ? H264_STAP_A : HEVC_AP)){
+		size_t offset = header_size;
+		while(offset + AGG_LENGTH_SIZE <= len){
+			size_t size = static_cast<size_t>(payload[offset] << 8) | payload[offset + 1];
+			offset += AGG_LENGTH_SIZE;
+			if(size == 0 || offset + size > len)
+				break;
+			if(is_key(get_type(codec,payload + offset)))
+				return true;
+			offset += size;
+		}
+		return false;
+	}
+	return is_key(type);
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,91 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPNalPacketizer class
+ * H.264(RFC6184)和HEVC(RFC7798)的rtp负载格式，按照NAL单元分包
+ * 1.一个NAL单元能放进一个包:单NAL单元包，多个小的NAL单元(比如SPS/PPS)合并成STAP-A/AP包
+ * 2.一个NAL单元太大:分成多个FU-A/FU包
+ * 这样丢失一个包只会影响一个NAL单元(一个slice)，其他的NAL单元依旧可以解码
+ * 输入和输出的帧都是AnnexB格式(起始码分隔)
+ */
+class RTPLIVELIBSHARED_EXPORT RTPNalPacketizer
+{
+public:
+	enum Codec{
+		H264,
+		HEVC
+	};
+	//一个包的负载，丢失的包用nullptr表示
+	using Payload = std::pair<const uint8_t*,size_t>;
+public:
+	/**
+	 * @brief Is_Supported
+	 * 有效负载类型是否支持按照NAL单元分包
+	 */
+	static bool Is_Supported(int payload_type) noexcept;
+
+	/**
+	 * @brief Get_Codec
+	 * 根据有效负载类型获取编码格式
+	 */
+	static Codec Get_Codec(int payload_type) noexcept;
+
+	/**
+	 * @brief Packetize
+	 * 把一帧分成多个负载
+	 * @param codec
+	 * 编码格式
+	 * @param data
+	 * AnnexB格式的帧
+	 * @param len
+	 * 帧的大小
+	 * @param max_payload
+	 * 一个负载的最大大小
+	 * @param output
+	 * 输出，原来的数据将会被擦除
+	 */
+	static void Packetize(Codec codec,const uint8_t * data,size_t len,size_t max_payload,
+						  std::vector<std::vector<uint8_t>> & output) noexcept;
+
+	/**
+	 * @brief Depacketize
+	 * 把一帧的负载按照顺序还原成AnnexB格式的帧
+	 * 丢失的包所在的NAL单元会被丢弃，其他的NAL单元正常输出
+	 * @param payloads
+	 * 按照发送顺序排列的负载
+	 * @param output
+	 * 输出，原来的数据将会被擦除
+	 * @return
+	 * 输出的NAL单元数量
+	 */
+	static size_t Depacketize(Codec codec,const std::vector<Payload> & payloads,
+							  std::vector<uint8_t> & output) noexcept;
+
+	/**
+	 * @brief Split
+	 * 按照起始码把AnnexB格式的帧分成NAL单元(不包括起始码)
+	 */
+	static void Split(const uint8_t * data,size_t len,std::vector<Payload> & nals) noexcept;
+
+	/**
+	 * @brief Is_Key_Payload
+	 * 一个负载是否包含关键帧的NAL单元(IDR/IRAP的slice或者参数集)
+	 * 分片包看原来的NAL类型，合并包看里面的每一个NAL单元
+	 * 转发服务器不解码，通过它判断一帧是不是关键帧
+	 */
+	static bool Is_Key_Payload(Codec codec,const uint8_t * payload,size_t len) noexcept;
+};
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
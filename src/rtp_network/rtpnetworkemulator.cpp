@@ -0,0 +1,97 @@
+#include "rtpnetworkemulator.h"
+#include <algorithm>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+RTPNetworkEmulator::RTPNetworkEmulator(const Params &params) noexcept
+{
+	set_params(params);
+}
+
+void RTPNetworkEmulator::set_params(const Params &params) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_params = params;
+	_statistics = Statistics();
+	_engine.seed(params.seed);
+	_burst = false;
+	_link_started = false;
+}
+
+size_t RTPNetworkEmulator::process(size_t bytes, const TimePoint &now, std::vector<TimePoint> &release) noexcept
+{
+	release.clear();
+	std::lock_guard<std::mutex> lk(_mutex);
+	++_statistics.packets;
+	if(_is_lost()){
+		++_statistics.lost;
+		return 0;
+	}
+	//复制的包紧跟着原来的包进入瓶颈链路
+	auto copies = _random() < _params.duplicate_rate ? 2 : 1;
+	if(copies > 1)
+		++_statistics.duplicated;
+	for(auto n = 0; n < copies; ++n){
+		TimePoint tp;
+		if(!_transmit(bytes,now,tp)){
+			++_statistics.queue_dropped;
+			continue;
+		}
+		release.push_back(tp);
+	}
+	return release.size();
+}
+
+bool RTPNetworkEmulator::_is_lost() noexcept
+{
+	//先更新状态再决定是否丢包，这样进入坏状态的第一个包也会受影响
+	if(_params.burst_enter > 0){
+		if(_burst)
+			_burst = !(_random() < _params.burst_exit);
+		else
+			_burst = _random() < _params.burst_enter;
+		if(_burst && _random() < _params.burst_loss)
+			return true;
+	}
+	return _random() < _params.loss_rate;
+}
+
+bool RTPNetworkEmulator::_transmit(size_t bytes, const TimePoint &now, TimePoint &release) noexcept
+{
+	using namespace std::chrono;
+	auto depart = now;
+	if(_params.bandwidth > 0){
+		if(!_link_started || _link_free < now){
+			_link_free = now;
+			_link_started = true;
+		}
+		//排队中的数据量就是链路还需要发送的时间乘以带宽
+		if(_params.queue_bytes > 0){
+			auto backlog = duration_cast<nanoseconds>(_link_free - now).count() * 1e-9
+						   * _params.bandwidth / 8;
+			if(backlog + bytes > _params.queue_bytes)
+				return false;
+		}
+		_link_free += nanoseconds(static_cast<int64_t>(bytes * 8 * 1e9 / _params.bandwidth));
+		depart = _link_free;
+	}
+
+	int64_t delay = static_cast<int64_t>(_params.delay_ms) * 1000;
+	if(_params.jitter_ms > 0){
+		int64_t jitter = static_cast<int64_t>(_params.jitter_ms) * 1000;
+		delay += static_cast<int64_t>((_random() * 2 - 1) * jitter);
+		delay = std::max<int64_t>(delay,0);
+	}
+	if(_params.reorder_rate > 0 && _random() < _params.reorder_rate){
+		delay += static_cast<int64_t>(_params.reorder_delay_ms) * 1000;
+		++_statistics.reordered;
+	}
+	release = depart + microseconds(delay);
+	return true;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,168 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include <vector>
+#include <random>
+#include <mutex>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPImpairmentParams struct
+ * 网络损伤模拟的参数，概率都是[0,1]，默认不做任何损伤
+ */
+struct RTPImpairmentParams {
+	//随机丢包率
+	double loss_rate{0};
+	//Gilbert-Elliott模型:好状态进入坏状态的概率，0表示不使用突发丢包
+	double burst_enter{0};
+	//坏状态回到好状态的概率，平均突发长度是1/burst_exit
+	double burst_exit{1};
+	//坏状态下的丢包率
+	double burst_loss{1};
+	//固定的传播延迟，单位毫秒
+	uint32_t delay_ms{0};
+	//延迟抖动，实际延迟在[delay-jitter,delay+jitter]均匀分布
+	uint32_t jitter_ms{0};
+	//乱序的概率，乱序的包额外延迟reorder_delay_ms，后面的包会先到达
+	double reorder_rate{0};
+	uint32_t reorder_delay_ms{20};
+	//复制包的概率
+	double duplicate_rate{0};
+	//瓶颈带宽，单位bit/s，0表示不限制
+	uint64_t bandwidth{0};
+	//瓶颈链路的队列长度，单位字节，0表示不限制
+	size_t queue_bytes{0};
+	//随机数种子
+	uint32_t seed{1};
+};
+
+/**
+ * @brief The RTPImpairmentStatistics struct
+ * 网络损伤模拟的统计，单位都是包
+ */
+struct RTPImpairmentStatistics {
+	//经过该类的包
+	uint64_t packets{0};
+	//随机丢包和突发丢包
+	uint64_t lost{0};
+	//瓶颈链路队列满了丢弃的包
+	uint64_t queue_dropped{0};
+	uint64_t duplicated{0};
+	uint64_t reordered{0};
+};
+
+/**
+ * @brief The RTPNetworkEmulator class
+ * 网络损伤模拟，决定每个发送出去的包是否丢失、什么时候到达对方
+ * 包依次经过:
+ * 1.丢包:随机丢包和Gilbert-Elliott两状态突发丢包
+ * 2.瓶颈链路:按照带宽匀速发送，排队的数据超过队列长度则丢弃(drop-tail)
+ * 3.传播延迟:固定延迟加上抖动，一部分包额外延迟造成乱序
+ * 一部分包会复制一份，复制的包同样经过瓶颈链路
+ * 随机数只由种子决定，同样的参数和同样的发送顺序得到同样的结果，方便测试和基准测试重现
+ * 时间由调用者传入，不依赖真实时间
+ * 该类是线程安全的
+ * @see RTPImpairmentTransmitter
+ */
+class RTPLIVELIBSHARED_EXPORT RTPNetworkEmulator
+{
+public:
+	using TimePoint = core::Clock::TimePoint;
+	using Params = RTPImpairmentParams;
+	using Statistics = RTPImpairmentStatistics;
+public:
+	explicit RTPNetworkEmulator(const Params & params = Params()) noexcept;
+
+	/**
+	 * @brief set_params
+	 * 设置损伤参数，同时根据种子重新开始生成随机数，并清空统计和链路状态
+	 */
+	void set_params(const Params & params) noexcept;
+
+	/**
+	 * @brief get_params
+	 * 获取损伤参数
+	 */
+	Params get_params() noexcept;
+
+	/**
+	 * @brief process
+	 * 一个包进入网络
+	 * @param bytes
+	 * 包的大小
+	 * @param now
+	 * 发送的时间
+	 * @param release
+	 * 输出到达对方的时间，每个副本一个，原来的数据将会被擦除
+	 * @return
+	 * 到达对方的副本数量，0表示丢失
+	 */
+	size_t process(size_t bytes,const TimePoint & now,std::vector<TimePoint> & release) noexcept;
+
+	/**
+	 * @brief get_statistics
+	 * 获取统计
+	 */
+	Statistics get_statistics() noexcept;
+
+	/**
+	 * @brief reset
+	 * 按照当前参数重新开始，相当于set_params(get_params())
+	 */
+	void reset() noexcept;
+private:
+	/**
+	 * @brief _random
+	 * 生成[0,1)的随机数
+	 * 不使用std::uniform_real_distribution，因为不同标准库的实现结果不一样
+	 */
+	double _random() noexcept;
+
+	/**
+	 * @brief _is_lost
+	 * 判断该包是否丢失，会更新突发丢包的状态
+	 */
+	bool _is_lost() noexcept;
+
+	/**
+	 * @brief _transmit
+	 * 包经过瓶颈链路和传播延迟，计算到达时间
+	 * @return
+	 * 队列满了则返回false
+	 */
+	bool _transmit(size_t bytes,const TimePoint & now,TimePoint & release) noexcept;
+private:
+	std::mutex			_mutex;
+	Params				_params;
+	Statistics			_statistics;
+	std::mt19937		_engine;
+	//Gilbert-Elliott模型是否处于坏状态
+	bool				_burst{false};
+	//瓶颈链路空闲的时间，在这之前发送的包需要排队
+	TimePoint			_link_free;
+	bool				_link_started{false};
+};
+
+inline RTPNetworkEmulator::Params RTPNetworkEmulator::get_params() noexcept					{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _params;
+}
+inline RTPNetworkEmulator::Statistics RTPNetworkEmulator::get_statistics() noexcept			{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _statistics;
+}
+inline void RTPNetworkEmulator::reset() noexcept												{
+	set_params(get_params());
+}
+inline double RTPNetworkEmulator::_random() noexcept											{
+	return _engine() / 4294967296.0;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
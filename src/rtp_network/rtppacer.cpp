@@ -0,0 +1,101 @@
+#include "rtppacer.h"
+#include <algorithm>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//rtp头部和扩展头部的大小，估算桶的最小容量用
+static constexpr double PACKET_OVERHEAD = 64;
+
+constexpr uint64_t RTPPacer::DEFAULT_TARGET_BITRATE;
+constexpr double RTPPacer::DEFAULT_PACING_FACTOR;
+constexpr int64_t RTPPacer::BURST_TIME_US;
+
+RTPPacer::RTPPacer(uint64_t target_bitrate, double pacing_factor) noexcept:
+	_target_bitrate(target_bitrate > 0 ? target_bitrate : DEFAULT_TARGET_BITRATE),
+	_pacing_factor(pacing_factor >= 1 ? pacing_factor : DEFAULT_PACING_FACTOR)
+{
+
+}
+
+void RTPPacer::set_target_bitrate(uint64_t bitrate) noexcept
+{
+	if(bitrate == 0)
+		return;
+	std::lock_guard<std::mutex> lk(_mutex);
+	//先按照原来的速率添加令牌，再修改速率
+	if(_started)
+		_refill(core::Clock::Get_Clock()->now());
+	_target_bitrate = bitrate;
+	_tokens = std::min(_tokens,_get_capacity());
+}
+
+void RTPPacer::set_pacing_factor(double factor) noexcept
+{
+	if(factor < 1)
+		return;
+	std::lock_guard<std::mutex> lk(_mutex);
+	if(_started)
+		_refill(core::Clock::Get_Clock()->now());
+	_pacing_factor = factor;
+	_tokens = std::min(_tokens,_get_capacity());
+}
+
+bool RTPPacer::try_consume(size_t bytes) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_refill(core::Clock::Get_Clock()->now());
+	//比桶还大的包，等桶满了就可以发送
+	auto need = std::min(static_cast<double>(bytes),_get_capacity());
+	if(_tokens < need)
+		return false;
+	_tokens -= bytes;
+	return true;
+}
+
+RTPPacer::TimePoint RTPPacer::get_next_send_time(size_t bytes) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto now = core::Clock::Get_Clock()->now();
+	_refill(now);
+	auto need = std::min(static_cast<double>(bytes),_get_capacity()) - _tokens;
+	if(need <= 0)
+		return now;
+	//向上取整，保证到了这个时间点令牌一定足够
+	auto us = static_cast<int64_t>(need / _get_bytes_per_us()) + 1;
+	return now + std::chrono::microseconds(us);
+}
+
+void RTPPacer::reset() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	_started = false;
+	_tokens = _get_capacity();
+}
+
+void RTPPacer::_refill(const TimePoint &now) noexcept
+{
+	if(!_started){
+		//第一次使用，桶是满的
+		_started = true;
+		_last_time = now;
+		_tokens = _get_capacity();
+		return;
+	}
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - _last_time).count();
+	if(us <= 0)
+		return;
+	_last_time = now;
+	_tokens = std::min(_tokens + us * _get_bytes_per_us(),_get_capacity());
+}
+
+double RTPPacer::_get_capacity() noexcept
+{
+	return std::max(BURST_TIME_US * _get_bytes_per_us(),
+					2 * (RTPPACKET_MAX_SIZE + PACKET_OVERHEAD));
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -0,0 +1,129 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include <mutex>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPPacer class
+ * 发送端的包节拍器(令牌桶)
+ * 一个关键帧经过FEC编码后会有上百个包，如果一次性发送出去，很容易把路由器或者网卡的
+ * 队列撑满，造成突发丢包，FEC反而要去修复自己造成的丢包
+ * 该类按照目标码率的若干倍(pacing_factor)匀速往桶里添加令牌，桶的容量只够一小段时间的
+ * 突发(burst_time)，发送一个包需要消耗对应字节数的令牌，没有足够的令牌则需要等待
+ * 允许欠账:令牌数只要够一个包或者桶已经满了就可以发送，发送后令牌数可能是负数，
+ * 保证长时间的平均速率不会超过设置的速率
+ * 该类是线程安全的，码率可以在其他线程修改(例如带宽估计)
+ */
+class RTPLIVELIBSHARED_EXPORT RTPPacer
+{
+public:
+	using TimePoint = core::Clock::TimePoint;
+public:
+	/**
+	 * @brief RTPPacer
+	 * @param target_bitrate
+	 * 目标码率，单位bit/s
+	 * @param pacing_factor
+	 * 发送速率是目标码率的多少倍
+	 */
+	explicit RTPPacer(uint64_t target_bitrate = DEFAULT_TARGET_BITRATE,
+					  double pacing_factor = DEFAULT_PACING_FACTOR) noexcept;
+
+	/**
+	 * @brief set_target_bitrate
+	 * 设置目标码率，单位bit/s，0将被忽略
+	 */
+	void set_target_bitrate(uint64_t bitrate) noexcept;
+
+	/**
+	 * @brief get_target_bitrate
+	 * 获取目标码率，单位bit/s
+	 */
+	uint64_t get_target_bitrate() noexcept;
+
+	/**
+	 * @brief set_pacing_factor
+	 * 设置发送速率是目标码率的多少倍，小于1将被忽略
+	 */
+	void set_pacing_factor(double factor) noexcept;
+
+	/**
+	 * @brief get_pacing_rate
+	 * 获取发送速率(目标码率乘以倍数)，单位bit/s
+	 */
+	uint64_t get_pacing_rate() noexcept;
+
+	/**
+	 * @brief try_consume
+	 * 尝试发送bytes字节的包
+	 * @return
+	 * 令牌足够则扣除令牌并返回true，否则返回false，不扣除令牌
+	 */
+	bool try_consume(size_t bytes) noexcept;
+
+	/**
+	 * @brief get_next_send_time
+	 * 获取令牌足够发送bytes字节的包的时间点
+	 */
+	TimePoint get_next_send_time(size_t bytes) noexcept;
+
+	/**
+	 * @brief reset
+	 * 重置令牌桶，桶将会被填满
+	 */
+	void reset() noexcept;
+public:
+	//默认的目标码率,2Mbit/s
+	static constexpr uint64_t DEFAULT_TARGET_BITRATE = 2 * 1024 * 1024;
+	//默认的发送速率倍数
+	static constexpr double DEFAULT_PACING_FACTOR = 2.5;
+	//桶的容量，允许突发的时间
+	static constexpr int64_t BURST_TIME_US = 5000;
+private:
+	/**
+	 * @brief _refill
+	 * 根据流逝的时间添加令牌，调用前需要锁住_mutex
+	 */
+	void _refill(const TimePoint & now) noexcept;
+
+	/**
+	 * @brief _get_capacity
+	 * 获取桶的容量(字节),至少能容纳两个最大的包
+	 */
+	double _get_capacity() noexcept;
+
+	/**
+	 * @brief _get_bytes_per_us
+	 * 获取每微秒添加的令牌数(字节)
+	 */
+	double _get_bytes_per_us() noexcept;
+private:
+	std::mutex				_mutex;
+	uint64_t				_target_bitrate;
+	double					_pacing_factor;
+	double					_tokens{0};
+	TimePoint				_last_time;
+	bool					_started{false};
+};
+
+inline uint64_t RTPPacer::get_target_bitrate() noexcept							{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _target_bitrate;
+}
+inline uint64_t RTPPacer::get_pacing_rate() noexcept								{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return static_cast<uint64_t>(_target_bitrate * _pacing_factor);
+}
+inline double RTPPacer::_get_bytes_per_us() noexcept								{
+	return _target_bitrate * _pacing_factor / 8 / 1000000;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -1,4 +1,5 @@
 #include "rtppacket.h"
+#include "rtpmemorypool.h"
 #include "jrtplib3/rtppacket.h"
 #include "jrtplib3/rtpsourcedata.h"
 
@@ -11,9 +12,11 @@ namespace rtp_network {
  *同时能够让模板编译成功*/
 
 RTPPacket::RTPPacket(void *packet,
-					 void * source_data):
+					 void * source_data,
+					 jrtplib::RTPMemoryManager * memory_manager):
 	packet(packet),
-	source_data(source_data)
+	source_data(source_data),
+	memory_manager(memory_manager)
 {
 }
 
@@ -21,10 +24,19 @@ RTPPacket::~RTPPacket()
 {
 	if(packet != nullptr){
 		auto p = static_cast<jrtplib::RTPPacket*>(packet);
-		delete p;
+		RTPDelete(p,memory_manager);
 	}
 }
 
+RTPPacket::SharedRTPPacket RTPPacket::Make_Shared(void *packet, void *source_data,
+												  const std::shared_ptr<RTPMemoryPool> &pool)
+{
+	if(pool == nullptr)
+		return Make_Shared(packet,source_data);
+	return std::allocate_shared<RTPPacket>(RTPMemoryPool::Allocator<RTPPacket>(pool),
+										   packet,source_data,pool.get());
+}
+
 } // namespace rtplivelib
 
 } // rtp_network
@@ -3,10 +3,16 @@
 
 #include <memory>
 
+namespace jrtplib {
+class RTPMemoryManager;
+}
+
 namespace rtplivelib {
 
 namespace rtp_network {
 
+class RTPMemoryPool;
+
 /**
  * @brief The RTPPacket class
  * rtp数据包，只在内部使用
@@ -21,9 +27,12 @@ public:
 	 * @brief RTPPacket
 	 * 构造函数，将会传入一个指针作为内部使用
 	 * @param ptr
+	 * @param memory_manager
+	 * 分配该包使用的jrtplib内存管理器，释放的时候使用
 	 */
 	RTPPacket(void * packet,
-			  void * source_data);
+			  void * source_data,
+			  jrtplib::RTPMemoryManager * memory_manager = nullptr);
 	
 	~RTPPacket();
 	
@@ -32,6 +41,15 @@ public:
 		return std::make_shared<RTPPacket>(packet,source_data);
 	}
 	
+	/**
+	 * @brief Make_Shared
+	 * 包是从内存池分配的，包装对象和shared_ptr的控制块也从内存池分配，
+	 * 所有引用释放之前内存池不会被销毁
+	 */
+	static SharedRTPPacket Make_Shared(void * packet,
+									   void * source_data,
+									   const std::shared_ptr<RTPMemoryPool> & pool);
+	
 	/**
 	 * @brief get_object
 	 * 获取内部包指针,有可能为空
@@ -46,6 +64,7 @@ public:
 private:
 	void * packet;
 	void * source_data;
+	jrtplib::RTPMemoryManager * memory_manager;
 };
 
 inline void * RTPPacket::get_packet() noexcept							{		return packet;}
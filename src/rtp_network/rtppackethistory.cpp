@@ -0,0 +1,66 @@
+#include "rtppackethistory.h"
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+//rtp固定头部的长度
+static constexpr size_t RTP_HEADER_SIZE = 12;
+
+constexpr size_t RTPPacketHistory::DEFAULT_CAPACITY;
+constexpr int64_t RTPPacketHistory::MAX_AGE_MS;
+
+RTPPacketHistory::RTPPacketHistory(size_t capacity):
+	_slots(capacity > 0 ? capacity : DEFAULT_CAPACITY)
+{
+
+}
+
+void RTPPacketHistory::put(const void *data, size_t len) noexcept
+{
+	if(data == nullptr || len < RTP_HEADER_SIZE)
+		return;
+	auto ptr = static_cast<const uint8_t *>(data);
+	//序列号在rtp头部的第2、3个字节，网络字节序
+	uint16_t seq = static_cast<uint16_t>((ptr[2] << 8) | ptr[3]);
+	auto now = core::Clock::Get_Clock()->now();
+
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto & slot = _slots[seq % _slots.size()];
+	slot.valid = true;
+	slot.seq = seq;
+	slot.send_time = now;
+	slot.resent = false;
+	//vector的容量会保留下来，稳定之后不再需要分配内存
+	slot.data.assign(ptr,ptr + len);
+}
+
+bool RTPPacketHistory::get_for_resend(uint16_t seq, std::vector<uint8_t> &output,
+									  const Duration &min_interval) noexcept
+{
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto & slot = _slots[seq % _slots.size()];
+	if(!slot.valid || slot.seq != seq)
+		return false;
+	if(now - slot.send_time > std::chrono::milliseconds(MAX_AGE_MS))
+		return false;
+	if(slot.resent && now - slot.resend_time < min_interval)
+		return false;
+	slot.resent = true;
+	slot.resend_time = now;
+	output = slot.data;
+	++_resend_count;
+	return true;
+}
+
+void RTPPacketHistory::clear() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	for(auto & slot:_slots)
+		slot.valid = false;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
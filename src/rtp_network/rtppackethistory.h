@@ -0,0 +1,94 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/clock.h"
+#include <vector>
+#include <mutex>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+/**
+ * @brief The RTPPacketHistory class
+ * 发送端的rtp包历史记录，用于NACK重传
+ * 固定大小的环形缓冲区，按照序列号存放已经发送的完整rtp包(包括rtp头部)，
+ * 新的包会覆盖掉序列号相差capacity的旧包，所以内存占用是有上限的
+ * 重传的时候直接发送原来的数据，序列号和时间戳都不变，接收端不需要额外处理
+ * 该类是线程安全的
+ */
+class RTPLIVELIBSHARED_EXPORT RTPPacketHistory
+{
+public:
+	using Duration = core::Clock::Duration;
+public:
+	/**
+	 * @brief RTPPacketHistory
+	 * @param capacity
+	 * 最多保存的包数
+	 */
+	explicit RTPPacketHistory(size_t capacity = DEFAULT_CAPACITY);
+
+	/**
+	 * @brief put
+	 * 保存一个已经发送的rtp包
+	 * @param data
+	 * 完整的rtp包
+	 * @param len
+	 * 长度，小于rtp头部的包将被忽略
+	 */
+	void put(const void * data,size_t len) noexcept;
+
+	/**
+	 * @brief get_for_resend
+	 * 获取需要重传的包
+	 * @param seq
+	 * 包的序列号
+	 * @param output
+	 * 输出的rtp包
+	 * @param min_interval
+	 * 同一个包两次重传的最小间隔，一般是rtt，避免同一个丢包的多个NACK导致重复重传
+	 * @return
+	 * 包不存在(已经被覆盖或者太旧)或者刚刚重传过则返回false
+	 */
+	bool get_for_resend(uint16_t seq,std::vector<uint8_t> & output,const Duration & min_interval) noexcept;
+
+	/**
+	 * @brief clear
+	 * 清除所有记录，重新创建会话的时候调用
+	 */
+	void clear() noexcept;
+
+	/**
+	 * @brief get_resend_count
+	 * 获取重传的包数，用于统计
+	 */
+	uint64_t get_resend_count() noexcept;
+public:
+	//默认保存的包数，2Mbit/s的码率下大约可以保存4秒
+	static constexpr size_t DEFAULT_CAPACITY = 1024;
+	//超过该时间的包不再重传，接收端早就放弃这一帧了
+	static constexpr int64_t MAX_AGE_MS = 1000;
+private:
+	struct Slot{
+		bool					valid{false};
+		bool					resent{false};
+		uint16_t				seq{0};
+		core::Clock::TimePoint	send_time;
+		core::Clock::TimePoint	resend_time;
+		std::vector<uint8_t>	data;
+	};
+	std::mutex					_mutex;
+	std::vector<Slot>			_slots;
+	uint64_t					_resend_count{0};
+};
+
+inline uint64_t RTPPacketHistory::get_resend_count() noexcept							{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _resend_count;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -2,33 +2,133 @@
 #include "rtpusermanager.h"
 #include "rtpbandwidth.h"
 #include "../core/logger.h"
+#include "../core/clock.h"
 #include "jrtplib3/rtppacket.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <memory>
 
 namespace rtplivelib {
 
 namespace rtp_network {
 
 struct DownloadBW {
+	RTPRecvThread * object;
+	
 	void operator () (uint64_t speed,uint64_t total) {
-		if(core::GlobalCallBack::Get_CallBack() != nullptr)
-			core::GlobalCallBack::Get_CallBack()->on_download_bandwidth(speed,total);
+		if(object->get_callback() != nullptr)
+			object->get_callback()->on_download_bandwidth(speed,total);
+	}
+};
+
+//没有数据的时候最长的等待时间(毫秒)
+static constexpr int64_t MAX_WAIT_TIME = 100;
+//自动选择的工作线程数的上限
+static constexpr size_t MAX_AUTO_WORKERS = 4;
+
+/**
+ * @brief Get_Wait_Time
+ * 计算等待新包的时间，最少1毫秒
+ * @param next_playout
+ * 抖动缓冲区里下一帧的播放时间，在这之前醒来把帧交给解码器
+ */
+static int Get_Wait_Time(const core::Clock::TimePoint & next_playout) noexcept{
+	if(next_playout == core::Clock::TimePoint::max())
+		return MAX_WAIT_TIME;
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+				  next_playout - core::Clock::Get_Clock()->now()).count();
+	return static_cast<int>(std::min(std::max(ms,static_cast<int64_t>(1)),MAX_WAIT_TIME));
+}
+
+/**
+ * @brief The RTPRecvWorker class
+ * 接收的工作线程，处理分配给它的ssrc的rtp包(FEC组帧、丢包检测、抖动缓冲)
+ * 同一个ssrc的包总是由同一个工作线程按照到达的顺序处理
+ * 组好的帧由工作线程放进抖动缓冲区，所以也由工作线程按照播放时间醒来把帧交给解码器，
+ * 一批包的最后几帧不需要等到下一个包到来才播放
+ */
+class RTPRecvWorker : public core::AbstractQueue<RTPPacket>
+{
+public:
+	explicit RTPRecvWorker(RTPRecvThread * recv):
+		_recv(recv){
+		set_max_size(65535);
+		start_thread();
+	}
+	
+	virtual ~RTPRecvWorker() override {
+		this->exit_wait_resource();
+		exit_thread();
+	}
+protected:
+	virtual void on_thread_run() noexcept override {
+		//最多100ms检查一次，抖动缓冲区里有帧的时候按照播放时间醒来
+		this->wait_for_resource_push(Get_Wait_Time(_next_playout));
+		auto manager = _recv->get_user_manager();
+		RTPPacket::SharedRTPPacket ptr;
+		while( (ptr = this->get_next()) != nullptr ){
+			if(manager != nullptr)
+				manager->deal_with_rtp(ptr);
+		}
+		//没有新包的时候缓冲的帧也要按时交给解码器
+		//在处理完这一批包之后计算，这一批组好的帧也包括在内
+		_next_playout = manager != nullptr ? manager->play_out() : core::Clock::TimePoint::max();
+	}
+	
+	virtual bool get_thread_pause_condition() noexcept override {
+		return false;
 	}
+private:
+	RTPRecvThread * const _recv;
+	//抖动缓冲区里下一帧的播放时间，只在该线程使用
+	core::Clock::TimePoint _next_playout{core::Clock::TimePoint::max()};
 };
 
 class RTPRecvThreadPrivateData {
 public:
 	RTPBandwidth bw;
+	//工作线程，按照ssrc分配
+	std::vector<std::unique_ptr<RTPRecvWorker>> workers;
+	//每个工作线程这一轮分到的包，一次性交给工作线程
+	std::vector<std::vector<RTPPacket::SharedRTPPacket>> shards;
+	
+	RTPRecvThreadPrivateData(RTPRecvThread * obj,size_t worker_count):
+		bw(DownloadBW{obj}){
+		if(worker_count == 0){
+			//留一半的核给编解码
+			worker_count = std::thread::hardware_concurrency() / 2;
+			worker_count = std::min(std::max(worker_count,static_cast<size_t>(1)),MAX_AUTO_WORKERS);
+		}
+		shards.resize(worker_count);
+		for(size_t n = 0; n < worker_count; ++n)
+			workers.emplace_back(new RTPRecvWorker(obj));
+	}
 	
-	RTPRecvThreadPrivateData():
-		bw(DownloadBW()){
-		
+	/**
+	 * @brief dispatch
+	 * 把包按照ssrc分配给工作线程
+	 */
+	void dispatch(RTPPacket::SharedRTPPacket & ptr) noexcept{
+		auto packet = static_cast<jrtplib::RTPPacket*>(ptr->get_packet());
+		bw.add_value(packet->GetPacketLength());
+		shards[packet->GetSSRC() % shards.size()].push_back(ptr);
+	}
+	
+	/**
+	 * @brief flush
+	 * 把分好的包交给工作线程
+	 */
+	void flush() noexcept{
+		for(size_t n = 0; n < shards.size(); ++n)
+			workers[n]->push_batch(shards[n]);
 	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
 
-RTPRecvThread::RTPRecvThread():
-	d_ptr(new RTPRecvThreadPrivateData)
+RTPRecvThread::RTPRecvThread(size_t worker_count):
+	d_ptr(new RTPRecvThreadPrivateData(this,worker_count))
 {
 	set_max_size(65535);
 	start_thread();
@@ -41,20 +141,30 @@ RTPRecvThread::~RTPRecvThread()
 	delete d_ptr;
 }
 
+size_t RTPRecvThread::get_worker_count() noexcept
+{
+	return d_ptr->workers.size();
+}
+
+int64_t RTPRecvThread::get_worker_cpu_time() noexcept
+{
+	int64_t total{0};
+	for(auto & worker:d_ptr->workers)
+		total += worker->get_thread_cpu_time();
+	return total;
+}
+
 void RTPRecvThread::on_thread_run() noexcept
 {
 	//等待资源到来
-	//100ms检查一次
-	this->wait_for_resource_push(100);
-	
-	auto ptr = this->get_next();
-	if(ptr == nullptr)
-		return;
-	
-	d_ptr->bw.add_value(static_cast<jrtplib::RTPPacket*>(ptr->get_packet())->GetPacketLength());
+	this->wait_for_resource_push(MAX_WAIT_TIME);
 	
-	//统计一下流量，然后都扔给用户管理处理
-	RTPUserManager::Get_user_manager()->deal_with_rtp(ptr);
+	//统计一下流量，然后按照ssrc分给工作线程处理
+	//这里只做分发，一个用户的关键帧恢复不会阻塞其他用户
+	RTPPacket::SharedRTPPacket ptr;
+	while( (ptr = this->get_next()) != nullptr )
+		d_ptr->dispatch(ptr);
+	d_ptr->flush();
 }
 
 
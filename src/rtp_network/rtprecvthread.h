@@ -2,6 +2,7 @@
 #pragma once
 
 #include "../core/abstractqueue.h"
+#include "../core/globalcallback.h"
 #include "rtppacket.h"
 
 namespace rtplivelib {
@@ -9,14 +10,49 @@ namespace rtplivelib {
 namespace rtp_network {
 
 class RTPRecvThreadPrivateData;
+class RTPUserManager;
 
 class RTPLIVELIBSHARED_EXPORT RTPRecvThread:
-		public core::AbstractQueue<RTPPacket>
+		public core::AbstractQueue<RTPPacket>,
+		public core::CallBackObject
 {
 public:
-	RTPRecvThread();
+	/**
+	 * @brief RTPRecvThread
+	 * 本线程只负责把会话收到的包按照ssrc分发给工作线程，
+	 * 每个ssrc(用户的音频或者视频流)固定由一个工作线程按顺序处理
+	 * @param worker_count
+	 * 工作线程数，0则根据cpu核数自动选择
+	 */
+	explicit RTPRecvThread(size_t worker_count = 0);
 	
 	virtual ~RTPRecvThread() override;
+	
+	/**
+	 * @brief set_user_manager
+	 * 设置用户管理器，接收到的rtp和rtcp包都交给该对象处理
+	 * 该类不拥有该对象的所有权
+	 * 需要在会话启动之前设置
+	 */
+	void set_user_manager(RTPUserManager * manager) noexcept;
+	
+	/**
+	 * @brief get_user_manager
+	 * 获取用户管理器
+	 */
+	RTPUserManager * get_user_manager() noexcept;
+	
+	/**
+	 * @brief get_worker_count
+	 * 获取工作线程数
+	 */
+	size_t get_worker_count() noexcept;
+	
+	/**
+	 * @brief get_worker_cpu_time
+	 * 获取所有工作线程占用的CPU时间之和，单位纳秒
+	 */
+	int64_t get_worker_cpu_time() noexcept;
 protected:
 	/**
 	 * @brief on_thread_run
@@ -30,10 +66,13 @@ protected:
 	 */
 	virtual bool get_thread_pause_condition() noexcept override;
 private:
+	RTPUserManager			* volatile _user_manager{nullptr};
 	RTPRecvThreadPrivateData * const d_ptr;
 };
 
 inline bool RTPRecvThread::get_thread_pause_condition() noexcept								{		return false;}
+inline void RTPRecvThread::set_user_manager(RTPUserManager *manager) noexcept					{		_user_manager = manager;}
+inline RTPUserManager *RTPRecvThread::get_user_manager() noexcept								{		return _user_manager;}
 
 } // rtp_network
 
@@ -0,0 +1,448 @@
+#include "rtprelay.h"
+#include "rtpbatchtransmitter.h"
+#include "rtpsession.h"
+#include "../core/logger.h"
+#include "jrtplib3/rtpudpv4transmitter.h"
+#include "jrtplib3/rtpipv4address.h"
+#include "jrtplib3/rtprawpacket.h"
+#include "jrtplib3/rtptimeutilities.h"
+#include "jrtplib3/rtperrors.h"
+#include "jrtplib3/rtcpcompoundpacket.h"
+#include "jrtplib3/rtcpsdespacket.h"
+#include "jrtplib3/rtcpbyepacket.h"
+#include "jrtplib3/rtcpapppacket.h"
+#include <algorithm>
+#include <cstring>
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+constexpr int64_t RTPRelay::WAIT_MS;
+constexpr int64_t RTPRelay::MEMBER_TIMEOUT_MS;
+constexpr size_t RTPRelay::MAX_QUEUE_PACKETS;
+constexpr size_t RTPRelay::MAX_PACKET_SIZE;
+
+//和客户端的会话使用一样大的socket缓冲区
+static constexpr int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+
+RTPRelay::RTPRelay()
+{
+}
+
+RTPRelay::~RTPRelay()
+{
+	stop();
+}
+
+bool RTPRelay::start(uint16_t port_base) noexcept
+{
+	stop();
+
+	jrtplib::RTPUDPv4TransmissionParams params;
+#if defined(SINGLEPORT)
+	params.SetRTCPMultiplexing(true);
+#endif
+	params.SetPortbase(port_base);
+	params.SetRTPReceiveBuffer(SOCKET_BUFFER_SIZE);
+	params.SetRTPSendBuffer(SOCKET_BUFFER_SIZE);
+
+	auto transmitter = new (std::nothrow) RTPBatchTransmitter(nullptr);
+	if(transmitter == nullptr)
+		return false;
+	auto ret = transmitter->Init(true);
+	if(ret >= 0)
+		ret = transmitter->Create(MAX_PACKET_SIZE,&params);
+	if(ret < 0){
+		core::Logger::Print("relay listen on port {} failed:{}",
+							__PRETTY_FUNCTION__,
+							LogLevel::ERROR_LEVEL,
+							port_base,
+							jrtplib::RTPGetErrorString(ret));
+		delete transmitter;
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(_mutex);
+		_transmitter = transmitter;
+		_rtcp_mux = params.GetRTCPMultiplexing();
+		_last_expire = core::Clock::Get_Clock()->now();
+	}
+	core::Logger::Print("relay listen on port {}",
+						__PRETTY_FUNCTION__,
+						LogLevel::INFO_LEVEL,
+						port_base);
+	return start_thread();
+}
+
+void RTPRelay::stop() noexcept
+{
+	//先停止线程，线程只在运行的时候访问传输器
+	exit_thread();
+	std::lock_guard<std::mutex> lk(_mutex);
+	_close();
+}
+
+RTPRelay::Statistics RTPRelay::get_statistics() noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto statistics = _statistics;
+	statistics.members = _members.size();
+	statistics.rooms = _rooms.size();
+	return statistics;
+}
+
+std::list<std::string> RTPRelay::get_room_members(const std::string &room) noexcept
+{
+	std::list<std::string> list;
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto it = _rooms.find(room);
+	if(it == _rooms.end())
+		return list;
+	for(auto & key : it->second){
+		auto & name = _members[key].name;
+		if(std::find(list.begin(),list.end(),name) == list.end())
+			list.push_back(name);
+	}
+	return list;
+}
+
+void RTPRelay::on_thread_run() noexcept
+{
+	//传输器在线程退出之后才会释放，这里不需要加锁
+	bool available{false};
+	_transmitter->WaitForIncomingData(jrtplib::RTPTime(0,WAIT_MS * 1000),&available);
+	if(get_exit_flag())
+		return;
+	_transmitter->Poll();
+
+	auto now = core::Clock::Get_Clock()->now();
+	std::lock_guard<std::mutex> lk(_mutex);
+	jrtplib::RTPRawPacket * raw;
+	while( (raw = _transmitter->GetNextPacket()) != nullptr ){
+		//包的所有权交给智能指针，所有接收者的队列都发送完之后才释放
+		SharedRawPacket packet(raw,[](jrtplib::RTPRawPacket * p){
+			RTPDelete(p,nullptr);
+		});
+		++_statistics.received;
+		_deal_with_packet(packet,now);
+	}
+	_flush();
+	if(now - _last_expire >= std::chrono::seconds(1))
+		_expire(now);
+}
+
+void RTPRelay::_deal_with_packet(const SharedRawPacket &packet, const TimePoint &now) noexcept
+{
+	auto address = packet->GetSenderAddress();
+	if(address == nullptr || address->GetAddressType() != jrtplib::RTPAddress::IPv4Address){
+		++_statistics.ignored;
+		return;
+	}
+	auto ipv4 = static_cast<const jrtplib::RTPIPv4Address *>(address);
+	auto ip = ipv4->GetIP();
+	//rtcp不复用端口的时候是从rtp端口+1发过来的，成员按照rtp端口区分
+	uint16_t port = ipv4->GetPort();
+	if(!packet->IsRTP() && !_rtcp_mux)
+		--port;
+	auto key = _make_key(ip,port);
+
+	std::string room;
+	auto it = _members.find(key);
+	if(it != _members.end())
+		room = it->second.room;
+
+	if(packet->IsRTP()){
+		//只转发推流用户的rtp包
+		if(it == _members.end() || room.empty() || !it->second.push){
+			++_statistics.ignored;
+			return;
+		}
+		it->second.last_active = now;
+		it->second.cache.put(packet);
+	} else {
+		jrtplib::RTCPCompoundPacket rtcp(packet->GetData(),packet->GetDataLength(),false);
+		if(rtcp.GetCreationError() < 0){
+			++_statistics.ignored;
+			return;
+		}
+		//BYE包需要先转发给房间的其他成员，再移除该成员，所以移除的时候使用原来的房间
+		if(!_deal_with_rtcp(packet,rtcp,key,ip,port,now)){
+			it = _members.find(key);
+			room = it == _members.end() ? std::string() : it->second.room;
+		}
+		if(room.empty()){
+			++_statistics.ignored;
+			return;
+		}
+	}
+
+	auto room_it = _rooms.find(room);
+	if(room_it == _rooms.end())
+		return;
+	for(auto & receiver_key : room_it->second){
+		if(receiver_key == key)
+			continue;
+		auto & receiver = _members[receiver_key];
+		if(receiver.layer != 0)
+			continue;
+		//联播的用户只转发接收者选择的那一层
+		if(packet->IsRTP() &&
+				it->second.layer != _get_selected_layer(receiver,it->second.name,room_it->second))
+			continue;
+		auto & queue = packet->IsRTP() ? receiver.rtp_queue : receiver.rtcp_queue;
+		//接收者处理不过来的时候丢弃最早的包，不影响其他接收者
+		if(queue.size() >= MAX_QUEUE_PACKETS){
+			queue.erase(queue.begin());
+			++_statistics.dropped;
+		}
+		queue.push_back(packet);
+		++_statistics.forwarded;
+	}
+}
+
+bool RTPRelay::_deal_with_rtcp(const SharedRawPacket &packet, jrtplib::RTCPCompoundPacket &rtcp,
+							   uint64_t key, uint32_t ip, uint16_t port, const TimePoint &now) noexcept
+{
+	bool changed{false};
+	bool removed{false};
+	bool joined{false};
+	//选择的联播层改变了的用户
+	std::vector<std::string> switched;
+	auto it = _members.find(key);
+	if(it != _members.end())
+		it->second.last_active = now;
+
+	jrtplib::RTCPPacket * rtcp_packet;
+	rtcp.GotoFirstPacket();
+	while( (rtcp_packet = rtcp.GetNextPacket()) != nullptr ){
+		if(rtcp_packet->GetPacketType() == jrtplib::RTCPPacket::SDES){
+			auto sdes = static_cast<jrtplib::RTCPSDESPacket *>(rtcp_packet);
+			if(!sdes->GotoFirstChunk())
+				continue;
+			do{
+				//和RTPUserManager::deal_with_sdes一样的字段
+				std::string name,room;
+				bool push{false},has_note{false};
+				uint8_t layer{0};
+				if(!sdes->GotoFirstItem())
+					continue;
+				do{
+					auto data = sdes->GetItemData();
+					auto len = sdes->GetItemLength();
+					switch (sdes->GetItemType()) {
+					case jrtplib::RTCPSDESPacket::NAME:
+						name.assign(reinterpret_cast<char *>(data),len);
+						break;
+					case jrtplib::RTCPSDESPacket::NOTE:
+						has_note = RTPSession::Parse_Room_Note(data,len,room,push);
+						break;
+					case jrtplib::RTCPSDESPacket::TOOL:
+						layer = RTPSession::Get_Simulcast_Layer(data,len);
+						break;
+					default:
+						break;
+					}
+				}while(sdes->GotoNextItem());
+				if(name.empty())
+					continue;
+
+				auto & member = _members[key];
+				if(member.name.empty()){
+					member.ip = ip;
+					member.port = port;
+					member.last_active = now;
+				}
+				member.name = name;
+				member.layer = layer;
+				member.sdes[sdes->GetChunkSSRC()] = packet;
+				if(has_note && (member.room != room || member.push != push)){
+					if(member.room != room){
+						core::Logger::Print("{}({}) room:[{}] -> [{}]",
+											__PRETTY_FUNCTION__,
+											LogLevel::INFO_LEVEL,
+											name,sdes->GetChunkSSRC(),member.room,room);
+						changed = true;
+						joined = !room.empty();
+					}
+					member.room = room;
+					member.push = push;
+				}
+			}while(sdes->GotoNextChunk());
+		} else if(rtcp_packet->GetPacketType() == jrtplib::RTCPPacket::BYE){
+			auto bye = static_cast<jrtplib::RTCPBYEPacket *>(rtcp_packet);
+			it = _members.find(key);
+			if(it == _members.end())
+				continue;
+			//音视频共用socket的时候，一个ssrc离开不影响该成员的其他流
+			for(int n = 0; n < bye->GetSSRCCount(); ++n)
+				it->second.sdes.erase(bye->GetSSRC(n));
+			if(!it->second.sdes.empty())
+				continue;
+			core::Logger::Print("{} leave room:[{}]",
+								__PRETTY_FUNCTION__,
+								LogLevel::INFO_LEVEL,
+								it->second.name,it->second.room);
+			_members.erase(it);
+			changed = true;
+			removed = true;
+		} else if(rtcp_packet->GetPacketType() == jrtplib::RTCPPacket::APP){
+			auto app = static_cast<jrtplib::RTCPAPPPacket *>(rtcp_packet);
+			if(app->GetSubType() != RTPSession::APPPacketType::RTP_APP_TYPE_LAYER ||
+					memcmp(app->GetName(),RTPSession::LAYER_APP_NAME,4) != 0)
+				continue;
+			it = _members.find(key);
+			RTPSession::LayerSelection selection;
+			if(it == _members.end() ||
+					!RTPSession::Unpack_Layer_Selection(app->GetAPPData(),app->GetAPPDataLength(),selection))
+				continue;
+			auto & member = it->second;
+			auto room_it = _rooms.find(member.room);
+			if(room_it == _rooms.end()){
+				member.selection.swap(selection);
+				continue;
+			}
+			//比较实际转发的层而不是选择的层，选择的层不在房间里的时候转发的都是第0层
+			std::vector<std::pair<std::string,uint8_t>> before;
+			for(auto & sender_key : room_it->second){
+				auto & sender = _members[sender_key];
+				if(sender.push && sender.layer == 0)
+					before.emplace_back(sender.name,_get_selected_layer(member,sender.name,room_it->second));
+			}
+			member.selection.swap(selection);
+			for(auto & pair : before){
+				if(pair.second != _get_selected_layer(member,pair.first,room_it->second) &&
+						std::find(switched.begin(),switched.end(),pair.first) == switched.end())
+					switched.push_back(pair.first);
+			}
+		}
+	}
+	if(changed)
+		_update_rooms();
+	//立即放进队列，保证缓存的包在这之后收到的包之前发送
+	if(joined && !removed)
+		_replay(key);
+	else if(!switched.empty() && !removed)
+		_replay(key,switched);
+	return removed;
+}
+
+void RTPRelay::_replay(uint64_t key, const std::vector<std::string> &names) noexcept
+{
+	auto it = _members.find(key);
+	if(it == _members.end() || it->second.layer != 0)
+		return;
+	auto & member = it->second;
+	auto room_it = _rooms.find(member.room);
+	if(room_it == _rooms.end())
+		return;
+	for(auto & sender_key : room_it->second){
+		if(sender_key == key)
+			continue;
+		auto & sender = _members[sender_key];
+		if(!sender.push || sender.sdes.empty())
+			continue;
+		if(!names.empty() && std::find(names.begin(),names.end(),sender.name) == names.end())
+			continue;
+		if(sender.layer != _get_selected_layer(member,sender.name,room_it->second))
+			continue;
+		auto size = member.rtp_queue.size();
+		if(!sender.cache.get(member.rtp_queue))
+			continue;
+		//一个rtcp包可能带有多个ssrc的SDES，只发送一次
+		auto rtcp_size = member.rtcp_queue.size();
+		for(auto & pair : sender.sdes){
+			auto begin = member.rtcp_queue.begin() + static_cast<std::ptrdiff_t>(rtcp_size);
+			if(std::find(begin,member.rtcp_queue.end(),pair.second) == member.rtcp_queue.end())
+				member.rtcp_queue.push_back(pair.second);
+		}
+		_statistics.replayed += member.rtp_queue.size() - size + member.rtcp_queue.size() - rtcp_size;
+		core::Logger::Print("replay {} packets of {} to {}",
+							__PRETTY_FUNCTION__,
+							LogLevel::INFO_LEVEL,
+							member.rtp_queue.size() - size,
+							sender.name,member.name);
+	}
+}
+
+uint8_t RTPRelay::_get_selected_layer(const Member &receiver, const std::string &name,
+									 const std::vector<uint64_t> &room) noexcept
+{
+	auto it = receiver.selection.find(name);
+	if(it == receiver.selection.end() || it->second == 0)
+		return 0;
+	for(auto & key : room){
+		auto & sender = _members[key];
+		if(sender.name == name && sender.push && sender.layer == it->second)
+			return it->second;
+	}
+	return 0;
+}
+
+void RTPRelay::_flush() noexcept
+{
+	for(auto & pair : _members){
+		auto & member = pair.second;
+		if(!member.rtcp_queue.empty()){
+			_buffers.clear();
+			for(auto & packet : member.rtcp_queue)
+				_buffers.emplace_back(packet->GetData(),packet->GetDataLength());
+			_transmitter->send_to(member.ip,_rtcp_mux ? member.port : member.port + 1,
+								  _buffers,false);
+			member.rtcp_queue.clear();
+		}
+		if(!member.rtp_queue.empty()){
+			_buffers.clear();
+			for(auto & packet : member.rtp_queue)
+				_buffers.emplace_back(packet->GetData(),packet->GetDataLength());
+			_transmitter->send_to(member.ip,member.port,_buffers,true);
+			member.rtp_queue.clear();
+		}
+	}
+}
+
+void RTPRelay::_expire(const TimePoint &now) noexcept
+{
+	_last_expire = now;
+	bool changed{false};
+	auto it = _members.begin();
+	while(it != _members.end()){
+		if(now - it->second.last_active < std::chrono::milliseconds(MEMBER_TIMEOUT_MS)){
+			++it;
+			continue;
+		}
+		core::Logger::Print("{} timeout,leave room:[{}]",
+							__PRETTY_FUNCTION__,
+							LogLevel::INFO_LEVEL,
+							it->second.name,it->second.room);
+		it = _members.erase(it);
+		changed = true;
+	}
+	if(changed)
+		_update_rooms();
+}
+
+void RTPRelay::_update_rooms() noexcept
+{
+	_rooms.clear();
+	for(auto & pair : _members){
+		if(!pair.second.room.empty())
+			_rooms[pair.second.room].push_back(pair.first);
+	}
+}
+
+void RTPRelay::_close() noexcept
+{
+	_members.clear();
+	_rooms.clear();
+	if(_transmitter == nullptr)
+		return;
+	_transmitter->Destroy();
+	delete _transmitter;
+	_transmitter = nullptr;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
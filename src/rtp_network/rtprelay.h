@@ -0,0 +1,241 @@
+
+#pragma once
+
+#include "../core/config.h"
+#include "../core/abstractthread.h"
+#include "../core/clock.h"
+#include "rtpkeyframecache.h"
+#include "rtpsession.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace jrtplib {
+class RTPRawPacket;
+class RTCPCompoundPacket;
+}
+
+namespace rtplivelib {
+
+namespace rtp_network {
+
+class RTPBatchTransmitter;
+
+/**
+ * @brief The RTPRelayStatistics struct
+ * 中继的统计，单位都是包
+ */
+struct RTPRelayStatistics {
+	//收到的rtp和rtcp包
+	uint64_t received{0};
+	//转发出去的包，一个包转发给多个成员算多个
+	uint64_t forwarded{0};
+	//来源不在房间里的包，或者没有推流的用户的rtp包
+	uint64_t ignored{0};
+	//接收者的发送队列满了丢弃的包
+	uint64_t dropped{0};
+	//新成员加入房间时从关键帧缓存发送给它的包
+	uint64_t replayed{0};
+	//当前的成员数和房间数
+	uint64_t members{0};
+	uint64_t rooms{0};
+};
+
+/**
+ * @brief The RTPRelay class
+ * 选择性转发中继(SFU)，监听一个媒体端口(视频或者音频)，
+ * 把房间里面每个成员发过来的rtp和rtcp包原样转发给同一个房间的其他成员，不解码也不修改
+ * 房间成员和客户端一样通过rtcp的SDES识别:NAME是用户名，NOTE是房间名加推流标志，
+ * TOOL是联播的层(见RTPSession::set_room_name和set_simulcast_layer)
+ * 1.只转发推流用户的rtp包，rtcp包(接收报告、重传请求等)所有成员都转发
+ * 2.联播的其他层的会话只发送不接收，不会转发给它们
+ * 3.联播的用户的rtp包只转发选择的那一层:接收者通过APP包告诉中继每个用户选择的层
+ *   (见RTPSession::Pack_Layer_Selection)，没有选择或者对方没有发送这一层则转发第0层，
+ *   和客户端的选择方式一样(RTPUser::_accept_video)，切换的时候立即发送新的一层的关键帧缓存
+ * 4.成员的所有ssrc都收到BYE或者一段时间没有收到任何包则移除该成员
+ * 收包使用RTPBatchTransmitter(recvmmsg)，收到的包通过引用计数放进每个接收者自己的发送队列，
+ * 不拷贝数据，每一轮接收结束后每个接收者的队列用一次sendmmsg发送出去
+ * 每个接收者的队列有长度上限，一个接收者处理不过来不会影响其他接收者
+ * 每个推流成员有一个关键帧缓存(见RTPKeyFrameCache)，新成员加入房间的时候立即发送
+ * 房间里其他推流成员最近的SDES和从关键帧开始的包，首帧时间不再取决于GOP的长度
+ * 成员按照地址(ip和rtp端口)区分，一个引擎的视频和音频分别连接视频中继和音频中继，
+ * 音视频共用一个socket(见LiveEngine::set_media_bundle)的时候都连接视频中继，
+ * 这时一个成员有音频和视频两个ssrc，每个ssrc的SDES分别保存，新成员加入的时候都要发送
+ * 注:房间只在一个中继内有效，多个中继之间不共享房间，可以按照房间把用户分配到不同的中继(水平扩展)
+ */
+class RTPLIVELIBSHARED_EXPORT RTPRelay : public core::AbstractThread
+{
+public:
+	using Statistics = RTPRelayStatistics;
+	using TimePoint = core::Clock::TimePoint;
+public:
+	RTPRelay();
+
+	~RTPRelay() override;
+
+	/**
+	 * @brief start
+	 * 监听端口并开始转发，已经开始的话先停止
+	 * @param port_base
+	 * 监听的端口，rtp和rtcp不复用端口的时候rtcp是port_base+1
+	 * @return
+	 * 端口被占用等情况返回false
+	 */
+	bool start(uint16_t port_base) noexcept;
+
+	/**
+	 * @brief stop
+	 * 停止转发并关闭端口，清空所有成员
+	 */
+	void stop() noexcept;
+
+	/**
+	 * @brief is_running
+	 * 是否正在转发
+	 */
+	bool is_running() noexcept;
+
+	/**
+	 * @brief get_statistics
+	 * 获取统计
+	 */
+	Statistics get_statistics() noexcept;
+
+	/**
+	 * @brief get_room_members
+	 * 获取房间里面所有成员的用户名，一个用户可能有多个会话(联播)，只返回一次
+	 */
+	std::list<std::string> get_room_members(const std::string & room) noexcept;
+protected:
+	/**
+	 * @brief on_thread_run
+	 * 等待数据，接收、分发并发送出去
+	 */
+	virtual void on_thread_run() noexcept override;
+
+	/**
+	 * @brief get_thread_pause_condition
+	 * 线程一直运行，在on_thread_run里面等待数据
+	 */
+	virtual bool get_thread_pause_condition() noexcept override;
+private:
+	using SharedRawPacket = std::shared_ptr<jrtplib::RTPRawPacket>;
+
+	struct Member {
+		std::string						name;
+		std::string						room;
+		uint32_t						ip{0};
+		//rtp端口，rtp和rtcp不复用端口的时候rtcp是port+1
+		uint16_t						port{0};
+		bool							push{false};
+		//发送的联播层，非0的层只发送不接收
+		uint8_t							layer{0};
+		//该成员选择接收的其他用户的联播层，没有选择的用户接收第0层
+		RTPSession::LayerSelection		selection;
+		TimePoint						last_active;
+		//每个ssrc最近一个带SDES的rtcp包，key也就是该成员的所有ssrc
+		//新成员加入的时候先发送它们，客户端才会创建该用户
+		std::unordered_map<uint32_t,SharedRawPacket>	sdes;
+		//推流成员的关键帧缓存
+		RTPKeyFrameCache				cache;
+		//发送给该成员的包，引用收到的包，不拷贝
+		std::vector<SharedRawPacket>	rtp_queue;
+		std::vector<SharedRawPacket>	rtcp_queue;
+	};
+
+	/**
+	 * @brief _deal_with_packet
+	 * 处理一个收到的包:rtcp包先更新成员，然后放进同一个房间其他成员的队列
+	 */
+	void _deal_with_packet(const SharedRawPacket & packet,const TimePoint & now) noexcept;
+
+	/**
+	 * @brief _deal_with_rtcp
+	 * 解析rtcp包里面的SDES和BYE，更新成员
+	 * @return
+	 * 该成员被移除(BYE)则返回true
+	 */
+	bool _deal_with_rtcp(const SharedRawPacket & packet,jrtplib::RTCPCompoundPacket & rtcp,
+						 uint64_t key,uint32_t ip,uint16_t port,const TimePoint & now) noexcept;
+
+	/**
+	 * @brief _replay
+	 * 成员加入房间或者切换联播层之后，把房间里其他推流成员的SDES和关键帧缓存放进它的队列，
+	 * 联播的用户只放选择的那一层
+	 * @param names
+	 * 只处理这些用户，为空则处理所有用户
+	 */
+	void _replay(uint64_t key,const std::vector<std::string> & names = {}) noexcept;
+
+	/**
+	 * @brief _get_selected_layer
+	 * 获取接收者要接收的某个用户的联播层，选择的层不在房间里则是第0层
+	 */
+	uint8_t _get_selected_layer(const Member & receiver,const std::string & name,
+								const std::vector<uint64_t> & room) noexcept;
+
+	/**
+	 * @brief _flush
+	 * 把所有成员的发送队列发送出去，rtcp先发送，保证SDES在缓存的rtp包之前到达
+	 */
+	void _flush() noexcept;
+
+	/**
+	 * @brief _expire
+	 * 移除超时的成员
+	 */
+	void _expire(const TimePoint & now) noexcept;
+
+	/**
+	 * @brief _update_rooms
+	 * 成员变化之后重新生成房间索引
+	 */
+	void _update_rooms() noexcept;
+
+	/**
+	 * @brief _close
+	 * 关闭传输器，清空成员，调用前需要锁住_mutex
+	 */
+	void _close() noexcept;
+
+	static uint64_t _make_key(uint32_t ip,uint16_t port) noexcept;
+private:
+	//等待数据的最长时间
+	static constexpr int64_t WAIT_MS = 10;
+	//多久没有收到包则移除该成员，客户端每隔几秒就会发送一次rtcp
+	static constexpr int64_t MEMBER_TIMEOUT_MS = 20000;
+	//每个接收者的发送队列上限，超过则丢弃最早的包
+	static constexpr size_t MAX_QUEUE_PACKETS = 1024;
+	//最大的包大小
+	static constexpr size_t MAX_PACKET_SIZE = 4096;
+
+	std::mutex									_mutex;
+	RTPBatchTransmitter							*_transmitter{nullptr};
+	bool										_rtcp_mux{true};
+	//地址 -> 成员
+	std::unordered_map<uint64_t,Member>			_members;
+	//房间名 -> 成员地址
+	std::unordered_map<std::string,std::vector<uint64_t>>	_rooms;
+	Statistics									_statistics;
+	TimePoint									_last_expire;
+	//发送时使用的缓存，避免每一轮都分配
+	std::vector<std::pair<const void *,size_t>>	_buffers;
+};
+
+inline bool RTPRelay::is_running() noexcept												{
+	std::lock_guard<std::mutex> lk(_mutex);
+	return _transmitter != nullptr;
+}
+inline bool RTPRelay::get_thread_pause_condition() noexcept								{
+	return false;
+}
+inline uint64_t RTPRelay::_make_key(uint32_t ip, uint16_t port) noexcept					{
+	return (static_cast<uint64_t>(ip) << 16) | port;
+}
+
+} // namespace rtp_network
+
+} // namespace rtplivelib
@@ -2,8 +2,15 @@
 #include "../core/logger.h"
 #include "../core/time.h"
 #include "rtpbandwidth.h"
+#include "rtppacer.h"
+#include "rtpcongestioncontroller.h"
 #include "rtpusermanager.h"
-#include "./fec/fecencoder.h"
+#include "rtppackethistory.h"
+#include "rtpnackgenerator.h"
+#include "rtpkeyframerequester.h"
+#include "rtpmediaclock.h"
+#include "rtpnalpacketizer.h"
+#include "./fec/fecheader.h"
 #include "jrtplib3/rtpsession.h"
 #include "jrtplib3/rtpudpv4transmitter.h"
 #include "jrtplib3/rtpsessionparams.h"
@@ -15,27 +22,92 @@ namespace rtplivelib{
 
 namespace rtp_network{
 
+//rtt超过该值(毫秒)时重传的包到达太晚，不再重传，丢包完全依靠FEC恢复
+static constexpr int64_t NACK_MAX_RTT = 150;
+//还不知道rtt的时候，同一个包两次重传的最小间隔(毫秒)
+static constexpr int64_t NACK_DEFAULT_RESEND_INTERVAL = 20;
+//检查重传请求的间隔(毫秒)
+static constexpr int64_t NACK_CHECK_INTERVAL = 5;
+//选择的联播层没有改变的时候，重新发送给中继的间隔(毫秒)，rtcp包丢了或者中继重启之后也能恢复
+static constexpr int64_t LAYER_SELECTION_INTERVAL = 1000;
+//视频帧的pts由帧时钟设置，单位微秒
+static constexpr int64_t VIDEO_PTS_RATE = 1000000;
+//帧率未知的时候使用的帧率
+static constexpr uint32_t DEFAULT_FRAME_RATE = 15;
+//采样率未知的时候使用的采样率
+static constexpr uint32_t DEFAULT_SAMPLE_RATE = 8000;
+//一个AAC帧的采样数
+static constexpr uint32_t AAC_FRAME_SIZE = 1024;
+
 //回调函数设计失败，太过耦合，需要重新设计
 struct BandwidthCB {
+	RTPSendThread * object;
+	
 	void operator () (uint64_t speed,uint64_t total) {
-		if(core::GlobalCallBack::Get_CallBack() != nullptr)
-			core::GlobalCallBack::Get_CallBack()->on_upload_bandwidth(speed,total);
+		if(object->get_callback() != nullptr)
+			object->get_callback()->on_upload_bandwidth(speed,total);
 	}
 };
 
 class RtpSendThreadPrivateData {
 public:
-	//用户保存音频采样率,要设置时间增长幅度
-	int latest_sample_rate;
+	//用户保存音频采样率,要设置时间戳的时钟频率
+	int latest_sample_rate{0};
 	//用于保存上一次发送的编码格式
-	int latest_video_pt;
-	int latest_audio_pt;
+	int latest_video_pt{-1};
+	int latest_audio_pt{-1};
+	//把帧的pts换算成rtp时间戳，视频90kHz
+	//音频编码器输出的包没有可靠的pts，按照每帧的采样数递增
+	RTPMediaClock video_clock{RTPMediaClock::VIDEO_CLOCK_RATE,VIDEO_PTS_RATE};
+	RTPMediaClock audio_clock{DEFAULT_SAMPLE_RATE,0};
+	/**
+	 * 联播(simulcast)的其他层，每一层有自己的会话(ssrc)和时间戳
+	 * 重传只针对第0层，其他层丢包只依靠FEC恢复
+	 */
+	struct SimulcastLayer {
+		RTPSendThread::SendQueue * queue{nullptr};
+		RTPSession * session{nullptr};
+		RTPMediaClock clock{RTPMediaClock::VIDEO_CLOCK_RATE,VIDEO_PTS_RATE};
+		int latest_pt{-1};
+	};
+	//下标是层，第0个不使用，第0层就是视频会话
+	SimulcastLayer layers[fec::FECHeader::MAX_LAYERS];
 	//这个主要是用来获取rtp会话
 	RTPSendThread * object{nullptr};
+	//加入房间时使用的服务器地址和本地端口，默认是配置文件里的服务器，本地端口随机
+	uint8_t server_ip[4]{SERVER_IP[0],SERVER_IP[1],SERVER_IP[2],SERVER_IP[3]};
+	uint16_t server_port_base{VIDEO_PORTBASE};
+	uint16_t local_port_base{0};
+	//创建会话时使用的网络损伤模拟和音视频共用socket的设置
+	bool impairment{false};
+	RTPNetworkEmulator::Params impairment_params;
+	bool bundle{false};
 	//统计上传流量
 	RTPBandwidth bandwidth;
 	//用于FEC编码
 	fec::FECEncoder fec_encoder;
+	//视频包的发送节拍，音频包数据量小而且对延迟敏感，不经过节拍器
+	RTPPacer pacer;
+	//已经发送的视频包，用于重传
+	RTPPacketHistory history;
+	//上一次检查重传请求的时间
+	core::Clock::TimePoint last_nack_check;
+	//避免每次检查重传请求都分配内存
+	std::vector<RTPUserManager::NackRequest> nack_requests;
+	RTPNackGenerator::NackList resend_list;
+	std::vector<uint8_t> nack_buffer;
+	std::vector<RTPUserManager::KeyFrameRequest> key_frame_requests;
+	std::vector<uint8_t> key_frame_buffer;
+	//上一次发送选择的联播层的时间
+	core::Clock::TimePoint last_layer_selection;
+	RTPSession::LayerSelection layer_selection;
+	std::vector<uint8_t> layer_selection_buffer;
+	std::vector<uint8_t> resend_buffer;
+	//FEC头部加上负载
+	std::vector<uint8_t> packet_buffer;
+	//按照NAL单元分包的负载和冗余包
+	std::vector<std::vector<uint8_t>> nal_payloads;
+	std::vector<std::vector<int8_t>> nal_repair;
 	
 	/**
 	 * @brief RtpSendThreadPrivateData
@@ -43,7 +115,7 @@ public:
 	 */
 	RtpSendThreadPrivateData(RTPSendThread * obj):
 		object(obj),
-		bandwidth(BandwidthCB())
+		bandwidth(BandwidthCB{obj})
 	{		
 		fec_encoder.set_symbol_size(RTPPACKET_MAX_SIZE);
 	}
@@ -63,16 +135,20 @@ public:
 	 * 是否是视频格式
 	 * true:视频
 	 * false:音频
+	 * @param layer
+	 * 视频的联播层
 	 */
 	void check_format(int payload_type,
 					  int sample_rate,
-					  bool is_video) noexcept {
+					  bool is_video,
+					  uint8_t layer = 0) noexcept {
 		if( is_video == true){
-			if( latest_video_pt == payload_type)
+			auto & latest_pt = get_latest_pt(layer);
+			if( latest_pt == payload_type)
 				return;
 			else
 				//设置最新格式
-				latest_video_pt = payload_type;
+				latest_pt = payload_type;
 		}
 		else {
 			if( latest_audio_pt == payload_type && sample_rate == latest_sample_rate)
@@ -85,8 +161,7 @@ public:
 		}
 		
 		const char *type = is_video == true?"video":"audio";
-		auto & session = is_video == true ? object->_video_session:
-											object->_audio_session;
+		auto session = get_session(is_video,layer);
 		
 		auto && pt = static_cast<RTPSession::PayloadType>(payload_type);
 		auto && ret = session->set_default_payload_type(pt);
@@ -108,15 +183,13 @@ public:
 										 __PRETTY_FUNCTION__,
 										 LogLevel::WARNING_LEVEL);
 		}
-		//不知道怎么算这个数
-		if(is_video){
-			//			auto fps = format.frame_rate == 0 ? 15u : static_cast<uint32_t>(format.frame_rate);
-			ret = session->set_default_timestamp_increment( 1 );
-		}
-		else {
-			auto sample_rate = latest_sample_rate == 0 ? 8000u : static_cast<uint32_t>(latest_sample_rate);
-			//不知道怎么算这个数
-			ret = session->set_default_timestamp_increment( 1u / sample_rate );
+		//时间戳由媒体时钟按帧设置，同一帧的包时间戳不变
+		ret = session->set_default_timestamp_increment( 0 );
+		if(ret >= 0 && !is_video){
+			//音频的时钟频率就是采样率
+			auto sample_rate = latest_sample_rate <= 0 ? DEFAULT_SAMPLE_RATE : static_cast<uint32_t>(latest_sample_rate);
+			audio_clock.set_clock_rate(sample_rate,0);
+			ret = session->set_timestamp_unit(1.0 / sample_rate);
 		}
 		if(ret < 0){
 			core::Logger::Print_APP_Info(core::Result::Rtp_set_timestamp_increment_failed,
@@ -140,13 +213,19 @@ public:
 	 * 时间戳增量
 	 * @param is_video
 	 * 视频或者音频
+	 * @param layer
+	 * 视频的联播层
 	 */
 	void init_session(RTPSession *session,
 					  const uint16_t & port_base,
 					  const double & timestampUnit,
-					  bool is_video) noexcept {
+					  bool is_video,
+					  uint8_t layer = 0) noexcept {
 		int ret;
 		
+		session->set_network_impairment(impairment ? &impairment_params : nullptr);
+		if(!is_video)
+			session->set_bundle_session(bundle ? object->_video_session : nullptr);
 		ret = session->create(timestampUnit,port_base);
 		//设置最大发送包的大小,不过好像分包还是要自己实现
 		session->set_maximum_packet_size(65535u);
@@ -167,16 +246,25 @@ public:
 										 LogLevel::INFO_LEVEL,
 										 type,
 										 port_base);
-			//设置本地SSRC
-			if(is_video)
-				RTPUserManager::_local_video_ssrc = session->get_ssrc();
-			else
-				RTPUserManager::_local_audio_ssrc = session->get_ssrc();
-			//创建完成后，设置服务器ip和端口
+			//设置本地SSRC，联播的其他层不是用户的主要视频流
+			set_local_ssrc(session->get_ssrc(),is_video,layer);
+			//新的会话序列号重新开始，之前的包不能再重传
+			if(is_video && layer == 0)
+				history.clear();
+			//新的会话时间戳重新开始，并且需要重新设置格式
+			if(is_video){
+				get_clock(layer).reset();
+				get_latest_pt(layer) = -1;
+			}
+			else {
+				audio_clock.reset();
+				latest_audio_pt = -1;
+			}
+			//创建完成后，设置服务器ip和端口，音频端口在视频端口之后
 			if(is_video)
-				set_destination(SERVER_IP,VIDEO_PORTBASE,session,type);
+				set_destination(server_ip,server_port_base,session,type);
 			else
-				set_destination(SERVER_IP,AUDIO_PORTBASE,session,type);
+				set_destination(server_ip,server_port_base + AUDIO_PORTBASE - VIDEO_PORTBASE,session,type);
 		}
 	}
 	
@@ -191,17 +279,73 @@ public:
 	 * 长度
 	 * @param is_video
 	 * 视频或者音频
+	 * @param layer
+	 * 视频的联播层
 	 */
 	void exit_session(RTPSession *session,
 					  const char * reason,const size_t& reason_len,
-					  bool is_video) noexcept{
+					  bool is_video,
+					  uint8_t layer = 0) noexcept{
 		
 		session->BYE_destroy(10,0,reason,reason_len);
 		//设置本地SSRC
-		if(is_video)
-			RTPUserManager::_local_video_ssrc = 0;
+		set_local_ssrc(0,is_video,layer);
+	}
+	
+	/**
+	 * @brief get_session
+	 * 获取发送该媒体流的会话
+	 */
+	inline RTPSession * get_session(bool is_video,uint8_t layer) noexcept{
+		if(!is_video)
+			return object->_audio_session;
+		return layer == 0 ? object->_video_session : layers[layer].session;
+	}
+	
+	/**
+	 * @brief get_clock
+	 * 获取视频某一层的媒体时钟
+	 */
+	inline RTPMediaClock & get_clock(uint8_t layer) noexcept{
+		return layer == 0 ? video_clock : layers[layer].clock;
+	}
+	
+	/**
+	 * @brief get_latest_pt
+	 * 获取视频某一层上一次发送的编码格式
+	 */
+	inline int & get_latest_pt(uint8_t layer) noexcept{
+		return layer == 0 ? latest_video_pt : layers[layer].latest_pt;
+	}
+	
+	/**
+	 * @brief send_layer_packet
+	 * 发送联播的其他层的视频帧，第0层使用RTPSendThread::send_video_packet
+	 */
+	void send_layer_packet(uint8_t layer,core::FramePacket::SharedPacket packet) noexcept{
+		auto session = layers[layer].session;
+		if(packet == nullptr || session == nullptr)
+			return;
+		if(!session->is_active() || session->get_room_name().size() == 0)
+			return;
+		check_format(packet->payload_type,0,true,layer);
+		send_packet(packet,true,layer);
+	}
+	
+	/**
+	 * @brief set_local_ssrc
+	 * 设置用户管理器保存的本地ssrc，联播的其他层单独保存，用于响应关键帧请求
+	 */
+	inline void set_local_ssrc(uint32_t ssrc,bool is_video,uint8_t layer) noexcept{
+		auto manager = object->_user_manager;
+		if(manager == nullptr)
+			return;
+		if(is_video && layer != 0)
+			manager->_local_layer_ssrc[layer] = ssrc;
+		else if(is_video)
+			manager->_local_video_ssrc = ssrc;
 		else
-			RTPUserManager::_local_audio_ssrc = 0;
+			manager->_local_audio_ssrc = ssrc;
 	}
 	
 	/**
@@ -252,16 +396,37 @@ public:
 	 * 发送的类型,音频或者视频
 	 * true为视频
 	 * false为音频
+	 * @param layer
+	 * 视频的联播层
 	 */
 	void send_packet(core::FramePacket::SharedPacket packet,
-					 bool is_video) noexcept {
+					 bool is_video,
+					 uint8_t layer = 0) noexcept {
 		
-		auto & session = is_video == true ? object->_video_session:
-											object->_audio_session;
+		auto session = get_session(is_video,layer);
 		
 		std::vector<std::vector<int8_t>> data;
 		fec::FECParam param;
-		if( fec_encoder.encode(packet,data,param) != core::Result::Success) {
+		//一帧的所有包批量发送，视频包没有令牌的时候会先把缓存的包发送出去
+		BatchGuard guard(session);
+		auto pace = is_video ? &pacer : nullptr;
+		auto pt = static_cast<uint8_t>(packet->payload_type);
+		//同一帧的所有包(包括冗余包)使用同一个时间戳
+		_increment_timestamp(packet,session,is_video,layer);
+		//每一帧都根据最新的丢包情况选择冗余包的数量
+		auto congestion = object->_congestion;
+		if(is_video && congestion != nullptr){
+			fec_encoder.set_loss_statistics(congestion->get_loss_rate(),congestion->get_burst_length());
+			fec_encoder.set_nack_enabled(is_nack_usable());
+		}
+		//H.264和HEVC按照NAL单元分包
+		if(is_video && RTPNalPacketizer::Is_Supported(packet->payload_type)){
+			_send_nal_frame(packet,session,pt,layer,pace);
+			return;
+		}
+		auto ret = fec_encoder.encode(packet,data,param);
+		param.layer = layer;
+		if( ret != core::Result::Success) {
 			core::Logger::Print_APP_Info(core::Result::FEC_Encode_Failed,
 										 __PRETTY_FUNCTION__,
 										 LogLevel::WARNING_LEVEL);
@@ -277,39 +442,303 @@ public:
 			uint16_t cur_pos = 0u;
 			
 			for( ; cur_pos < src_nb - 1; ++cur_pos ){
-				_send_packet_ex(session,
+				_send_fec_packet(session,
 								_d + cur_pos * param.symbol_size,
 								fec_encoder.get_symbol_size(),
 								cur_pos,
-								param);
+								param,
+								pt,false,
+								pace);
 			}
 			
-			//发送最后一个包
-			_send_packet_ex(session,
+			//发送最后一个包，设置标志位表示这一帧结束
+			_send_fec_packet(session,
 							_d + cur_pos * param.symbol_size,
-							param.size % param.symbol_size,
+							param.size - cur_pos * param.symbol_size,
 							cur_pos,
-							param);
+							param,
+							pt,true,
+							pace);
 		} else {
 			//分包处理
-			//分包策略是，id为当前包位置
-			//然后发送的数据固定8字节，高4位中数据高二位是源数据包数，数据低二位是冗余包数
-			//低4位中,数据高二位是最后一个包填充字节数,低二位保留
+			//每个包的负载前面是FEC头部(见FECHeader)，包含当前包位置和帧大小
 			//16bit,65535个包数，够用了
+			//最后一个包设置标志位表示这一帧结束
 			for( uint16_t cur_nb = 0u; cur_nb < data.size(); ++ cur_nb){
-				_send_packet_ex(session,
+				_send_fec_packet(session,
 								data[cur_nb].data(),
 								data[cur_nb].size(),
 								cur_nb,
-								param);
+								param,
+								pt,cur_nb + 1u == data.size(),
+								pace);
 			}
 		}
 		
 	}
 	
+	/**
+	 * @brief is_nack_usable
+	 * rtt足够小的时候重传的包可以及时到达，丢包优先通过重传恢复
+	 * 还没有rtt的时候也认为可以重传
+	 */
+	bool is_nack_usable() noexcept{
+		auto congestion = object->_congestion;
+		return congestion == nullptr || congestion->get_rtt() <= NACK_MAX_RTT;
+	}
+	
+	/**
+	 * @brief process_nack
+	 * 定时处理重传:
+	 * 1.把收到的视频流的丢包通过rtcp请求对方重传
+	 * 2.对方请求重传本地视频流的包，从历史记录中取出重新发送
+	 * 3.收到的视频流无法恢复或者解码出错，通过rtcp请求对方发送关键帧
+	 * 4.把选择接收的联播层告诉中继
+	 */
+	void process_nack() noexcept{
+		auto manager = object->_user_manager;
+		auto session = object->_video_session;
+		if(manager == nullptr || session == nullptr || !session->is_active())
+			return;
+		auto now = core::Clock::Get_Clock()->now();
+		if(now - last_nack_check < std::chrono::milliseconds(NACK_CHECK_INTERVAL))
+			return;
+		last_nack_check = now;
+		_send_nack_requests(manager,session);
+		_send_key_frame_requests(manager,session);
+		_send_layer_selection(manager,session,now);
+		_resend_packets(manager,session);
+	}
 private:
-	void _send_packet_ex(RTPSession * session,void *d,uint32_t size,uint16_t cur_pos,fec::FECParam param) noexcept{
-		auto ret = session->send_packet_ex( d, size,cur_pos,&param,sizeof(fec::FECParam));
+	/**
+	 * @brief _send_nack_requests
+	 * 发送重传请求，每个媒体流一个APP包
+	 */
+	void _send_nack_requests(RTPUserManager * manager,RTPSession * session) noexcept{
+		manager->get_nack_requests(nack_requests);
+		for(auto & request:nack_requests){
+			RTPNackGenerator::Pack(request.first,request.second,nack_buffer);
+			auto ret = session->send_rtcp_app_packet(RTPSession::APPPacketType::RTP_APP_TYPE_NACK,
+													 RTPNackGenerator::APP_NAME,
+													 nack_buffer.data(),nack_buffer.size());
+			if(ret < 0)
+				core::Logger::Print_RTP_Info(ret,
+											 __PRETTY_FUNCTION__,
+											 LogLevel::WARNING_LEVEL);
+		}
+	}
+	
+	/**
+	 * @brief _send_key_frame_requests
+	 * 发送关键帧请求，每个媒体流一个APP包，PLI和FIR的子类型和名字不同
+	 */
+	void _send_key_frame_requests(RTPUserManager * manager,RTPSession * session) noexcept{
+		manager->get_key_frame_requests(key_frame_requests);
+		for(auto & request:key_frame_requests){
+			RTPKeyFrameRequester::Pack(request.first,key_frame_buffer);
+			auto is_fir = request.second == RTPKeyFrameRequester::FIR;
+			auto ret = session->send_rtcp_app_packet(is_fir ? RTPSession::APPPacketType::RTP_APP_TYPE_FIR :
+															  RTPSession::APPPacketType::RTP_APP_TYPE_PLI,
+													 is_fir ? RTPKeyFrameRequester::FIR_NAME :
+															  RTPKeyFrameRequester::PLI_NAME,
+													 key_frame_buffer.data(),key_frame_buffer.size());
+			if(ret < 0)
+				core::Logger::Print_RTP_Info(ret,
+											 __PRETTY_FUNCTION__,
+											 LogLevel::WARNING_LEVEL);
+		}
+	}
+	
+	/**
+	 * @brief _send_layer_selection
+	 * 发送选择接收的联播层，改变的时候立即发送，否则定时发送
+	 * 所有用户放在一个APP包里，没有经过中继的时候对方会忽略该包
+	 */
+	void _send_layer_selection(RTPUserManager * manager,RTPSession * session,
+							   const core::Clock::TimePoint & now) noexcept{
+		auto changed = manager->get_layer_selection(layer_selection);
+		if(layer_selection.empty())
+			return;
+		if(!changed && now - last_layer_selection < std::chrono::milliseconds(LAYER_SELECTION_INTERVAL))
+			return;
+		last_layer_selection = now;
+		RTPSession::Pack_Layer_Selection(layer_selection,layer_selection_buffer);
+		auto ret = session->send_rtcp_app_packet(RTPSession::APPPacketType::RTP_APP_TYPE_LAYER,
+												 RTPSession::LAYER_APP_NAME,
+												 layer_selection_buffer.data(),
+												 layer_selection_buffer.size());
+		if(ret < 0)
+			core::Logger::Print_RTP_Info(ret,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+	}
+	
+	/**
+	 * @brief _resend_packets
+	 * 重传对方请求的包，重传的包同样经过节拍器，避免拥塞的时候雪上加霜
+	 */
+	void _resend_packets(RTPUserManager * manager,RTPSession * session) noexcept{
+		manager->take_resend_requests(resend_list);
+		if(resend_list.empty() || !is_nack_usable())
+			return;
+		auto congestion = object->_congestion;
+		auto rtt = congestion == nullptr ? -1 : congestion->get_rtt();
+		//同一个包在一个rtt内只重传一次，多个接收端请求同一个包的时候也只发送一次
+		auto interval = std::chrono::milliseconds(rtt < 0 ? NACK_DEFAULT_RESEND_INTERVAL : rtt);
+		BatchGuard guard(session);
+		for(auto & seq:resend_list){
+			if(!history.get_for_resend(seq,resend_buffer,interval))
+				continue;
+			_wait_pacer(&pacer,session,resend_buffer.size());
+			auto ret = session->resend_packet(resend_buffer.data(),resend_buffer.size());
+			if(ret < 0){
+				core::Logger::Print_RTP_Info(ret,
+											 __PRETTY_FUNCTION__,
+											 LogLevel::WARNING_LEVEL);
+				break;
+			}
+			bandwidth.add_value(resend_buffer.size());
+		}
+	}
+	
+	/**
+	 * @brief The BatchGuard struct
+	 * 作用域内批量发送rtp包，离开作用域的时候发送
+	 */
+	struct BatchGuard {
+		RTPSession * session;
+		
+		explicit BatchGuard(RTPSession * s):session(s)		{		session->begin_batch();}
+		~BatchGuard(){
+			auto ret = session->end_batch();
+			if( ret < 0 ){
+				core::Logger::Print_APP_Info(core::Result::Rtp_send_packet_failed,
+											 __PRETTY_FUNCTION__,
+											 LogLevel::WARNING_LEVEL);
+				core::Logger::Print_RTP_Info(ret,
+											 __PRETTY_FUNCTION__,
+											 LogLevel::WARNING_LEVEL);
+			}
+		}
+	};
+	
+	/**
+	 * @brief _wait_pacer
+	 * 等待节拍器有足够的令牌发送该包
+	 * 等待之前先把已经缓存的包发送出去，等待期间继续发送音频包，避免音频被视频帧阻塞
+	 */
+	void _wait_pacer(RTPPacer * pace,RTPSession * session,size_t bytes) noexcept{
+		if(pace == nullptr || pace->try_consume(bytes))
+			return;
+		session->end_batch();
+		auto clock = core::Clock::Get_Clock();
+		while(!pace->try_consume(bytes)){
+			_send_pending_audio();
+			//最多睡眠1ms，及时发送新的音频包
+			auto tp = std::min(pace->get_next_send_time(bytes),
+							   clock->now() + std::chrono::milliseconds(1));
+			clock->sleep_until(tp);
+		}
+		session->begin_batch();
+	}
+	
+	/**
+	 * @brief _send_pending_audio
+	 * 发送音频队列里面所有的包
+	 */
+	void _send_pending_audio() noexcept{
+		auto queue = object->_audio_queue;
+		if(queue == nullptr)
+			return;
+		while(queue->has_data()){
+			auto packet = queue->get_next();
+			if(packet != nullptr)
+				object->send_audio_packet(packet);
+		}
+	}
+	
+	/**
+	 * @brief _increment_timestamp
+	 * 根据帧的pts计算时间戳增量，在发送这一帧之前增加会话的时间戳
+	 */
+	void _increment_timestamp(core::FramePacket::SharedPacket & packet,RTPSession * session,bool is_video,uint8_t layer) noexcept{
+		uint32_t inc;
+		if(is_video){
+			auto & clock = get_clock(layer);
+			auto fps = packet->format.frame_rate > 0 ? static_cast<uint32_t>(packet->format.frame_rate) : DEFAULT_FRAME_RATE;
+			inc = clock.next_frame(packet->pts,clock.get_clock_rate() / fps);
+		}
+		else
+			inc = audio_clock.next_frame(packet->pts,AAC_FRAME_SIZE);
+		if(inc == 0)
+			return;
+		auto ret = session->increment_timestamp(inc);
+		if(ret < 0)
+			core::Logger::Print_RTP_Info(ret,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+	}
+	
+	/**
+	 * @brief _send_nal_frame
+	 * 按照RFC6184/RFC7798分包后发送一帧，每个负载是一个源数据包
+	 * 丢失的包不能通过FEC恢复的时候，接收端依旧可以使用收到的NAL单元
+	 */
+	void _send_nal_frame(core::FramePacket::SharedPacket & packet,RTPSession * session,
+						 uint8_t pt,uint8_t layer,RTPPacer * pace) noexcept{
+		auto symbol_size = fec_encoder.get_symbol_size();
+		{
+			std::lock_guard<decltype (packet->data->mutex)> lg(packet->data->mutex);
+			RTPNalPacketizer::Packetize(RTPNalPacketizer::Get_Codec(packet->payload_type),
+										(*packet->data)[0],static_cast<size_t>(packet->data->size),
+										symbol_size - fec::FECHeader::SLOT_HEADER_SIZE,
+										nal_payloads);
+		}
+		if(nal_payloads.empty())
+			return;
+		
+		fec::FECParam param;
+		if(fec_encoder.encode_nal(nal_payloads,packet->is_key(),nal_repair,param) != core::Result::Success)
+			//编码失败后，只发送源数据包
+			core::Logger::Print_APP_Info(core::Result::FEC_Encode_Failed,
+										 __PRETTY_FUNCTION__,
+										 LogLevel::WARNING_LEVEL);
+		param.layer = layer;
+		
+		//最后一个包设置标志位表示这一帧结束
+		auto total = nal_payloads.size() + nal_repair.size();
+		uint16_t pos = 0u;
+		for(auto & payload:nal_payloads){
+			_send_fec_packet(session,payload.data(),static_cast<uint32_t>(payload.size()),pos,param,
+							 pt,pos + 1u == total,pace);
+			++pos;
+		}
+		for(auto & repair:nal_repair){
+			_send_fec_packet(session,repair.data(),static_cast<uint32_t>(repair.size()),pos,param,
+							 pt,pos + 1u == total,pace);
+			++pos;
+		}
+	}
+	
+	/**
+	 * @brief _send_fec_packet
+	 * 在负载前面加上FEC头部后发送
+	 * @param pt
+	 * 有效负载类型
+	 * @param mark
+	 * 标志位，一帧的最后一个包设置为true
+	 */
+	void _send_fec_packet(RTPSession * session,const void *d,uint32_t size,uint16_t cur_pos,const fec::FECParam & param,
+						  uint8_t pt,bool mark,RTPPacer * pace) noexcept{
+		uint8_t header[fec::FECHeader::MAX_SIZE];
+		auto header_size = fec::FECHeader::Pack(param,cur_pos,size,header);
+		//先等待令牌再写packet_buffer，等待期间发送的音频包也会使用packet_buffer
+		//rtp头部12字节
+		_wait_pacer(pace,session,header_size + size + 12);
+		packet_buffer.resize(header_size + size);
+		memcpy(packet_buffer.data(),header,header_size);
+		memcpy(packet_buffer.data() + header_size,d,size);
+		auto ret = session->send_packet(packet_buffer.data(),header_size + size,pt,mark,0);
 		
 		if( ret < 0 ){
 			core::Logger::Print_APP_Info(core::Result::Rtp_send_packet_failed,
@@ -342,10 +771,15 @@ RTPSendThread::~RTPSendThread()
 	exit_thread();
 	if(_video_session != nullptr){
 		d_ptr->exit_session(_video_session,nullptr,0,true);
+		_video_session->set_packet_history(nullptr);
 	}
 	if(_audio_session !=  nullptr){
 		d_ptr->exit_session(_audio_session,nullptr,0,false);
 	}
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(d_ptr->layers[n].session != nullptr)
+			d_ptr->exit_session(d_ptr->layers[n].session,nullptr,0,true,n);
+	}
 }
 
 void RTPSendThread::set_video_session(RTPSession *video_session) noexcept
@@ -354,10 +788,12 @@ void RTPSendThread::set_video_session(RTPSession *video_session) noexcept
 	//如果之前设置了一个会话，则先吧之前的会话关闭
 	if(_video_session != nullptr){
 		d_ptr->exit_session(_video_session,nullptr,0,true);
+		_video_session->set_packet_history(nullptr);
 	}
 	_video_session = video_session;
 	if(video_session == nullptr)
 		return;
+	video_session->set_packet_history(&d_ptr->history);
 	
 	this->notify_thread();
 }
@@ -375,6 +811,34 @@ void RTPSendThread::set_audio_session(RTPSession *audio_session) noexcept
 	this->notify_thread();
 }
 
+void RTPSendThread::set_simulcast_layer(uint8_t layer, SendQueue *queue, RTPSession *session) noexcept
+{
+	if(layer == 0 || layer >= fec::FECHeader::MAX_LAYERS)
+		return;
+	std::lock_guard<decltype(_mutex)> lk(_mutex);
+	auto & simulcast = d_ptr->layers[layer];
+	simulcast.queue = queue;
+	if(simulcast.session == session)
+		return;
+	//如果之前设置了一个会话，则先吧之前的会话关闭
+	if(simulcast.session != nullptr)
+		d_ptr->exit_session(simulcast.session,nullptr,0,true,layer);
+	simulcast.session = session;
+	if(session == nullptr)
+		return;
+	session->set_simulcast_layer(layer);
+	if(_video_session == nullptr)
+		return;
+	//用户名和推流标志和视频会话一样，已经加入房间的话立即创建会话
+	session->set_local_name(_video_session->get_local_name());
+	session->set_push_flag(_video_session->get_push_flag());
+	auto & room = _video_session->get_room_name();
+	if(room.size() != 0){
+		d_ptr->init_session(session,0,1.0 / RTPMediaClock::VIDEO_CLOCK_RATE,true,layer);
+		session->set_room_name(room);
+	}
+}
+
 void RTPSendThread::send_video_packet(core::FramePacket::SharedPacket packet)
 {
 	if(packet == nullptr)
@@ -407,6 +871,28 @@ void RTPSendThread::send_audio_packet(core::FramePacket::SharedPacket packet)
 	d_ptr->send_packet(packet,false);
 }
 
+void RTPSendThread::set_server_address(const uint8_t *ip, uint16_t port_base, uint16_t local_port_base) noexcept
+{
+	std::lock_guard<decltype(_mutex)> lk(_mutex);
+	memcpy(d_ptr->server_ip,ip,sizeof(d_ptr->server_ip));
+	d_ptr->server_port_base = port_base;
+	d_ptr->local_port_base = local_port_base;
+}
+
+void RTPSendThread::set_network_impairment(const RTPNetworkEmulator::Params *params) noexcept
+{
+	std::lock_guard<decltype(_mutex)> lk(_mutex);
+	d_ptr->impairment = params != nullptr;
+	if(params != nullptr)
+		d_ptr->impairment_params = *params;
+}
+
+void RTPSendThread::set_media_bundle(bool enable) noexcept
+{
+	std::lock_guard<decltype(_mutex)> lk(_mutex);
+	d_ptr->bundle = enable;
+}
+
 void RTPSendThread::set_destination( const uint8_t *ip, uint16_t port_base) noexcept
 {
 	std::lock_guard<decltype(_mutex)> lk(_mutex);
@@ -418,6 +904,12 @@ void RTPSendThread::set_destination( const uint8_t *ip, uint16_t port_base) noex
 	else
 		d_ptr->set_destination(ip,port_base,_video_session,"video");
 	
+	//联播的其他层和视频使用同样的目标地址
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(d_ptr->layers[n].session != nullptr)
+			d_ptr->set_destination(ip,port_base,d_ptr->layers[n].session,"video");
+	}
+	
 	if(_audio_session == nullptr){
 		//没有设置会话
 		return;
@@ -436,6 +928,10 @@ bool RTPSendThread::set_local_name(const std::string &name) noexcept
 	if(_audio_session != nullptr){
 		ret_a = _audio_session->set_local_name(name);
 	}
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(d_ptr->layers[n].session != nullptr)
+			d_ptr->layers[n].session->set_local_name(name);
+	}
 	if(ret_v < 0)
 		core::Logger::Print_RTP_Info(ret_v,
 									 __PRETTY_FUNCTION__,
@@ -450,7 +946,8 @@ bool RTPSendThread::set_local_name(const std::string &name) noexcept
 bool RTPSendThread::set_room_name(const std::string &name) noexcept
 {
 	//在设置房间名的时候就设置好用户管理的标志位
-	RTPUserManager::Get_user_manager()->set_active(name.size() != 0);
+	if(_user_manager != nullptr)
+		_user_manager->set_active(name.size() != 0);
 	std::lock_guard<decltype(_mutex)> lk(_mutex);
 	//这个是退出房间
 	if(name.size() == 0){
@@ -458,24 +955,35 @@ bool RTPSendThread::set_room_name(const std::string &name) noexcept
 		if(_video_session != nullptr )
 			d_ptr->exit_session(_video_session,reason,sizeof(reason),true);
 		if(_audio_session != nullptr)
-			d_ptr->exit_session(_audio_session,reason,sizeof(reason),true);
+			d_ptr->exit_session(_audio_session,reason,sizeof(reason),false);
+		for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+			if(d_ptr->layers[n].session != nullptr)
+				d_ptr->exit_session(d_ptr->layers[n].session,reason,sizeof(reason),true,n);
+		}
 	}
 	//加入房间
 	else {
-		//使用服务器的时候就是随机端口
+		//使用服务器的时候就是随机端口，除非设置了本地端口(联播的其他层只发送，总是随机端口)
 		//如果是从一个房间换到另一个房间，这里也不会出现问题
 		//因为会话在创建的时候会关闭之前的会话
-		
+		auto local_port = d_ptr->local_port_base;
 		if(_video_session != nullptr)
 			d_ptr->init_session(_video_session,
-								0,
-								1.0 / 15.0,
+								local_port,
+								1.0 / RTPMediaClock::VIDEO_CLOCK_RATE,
 								true);
 		if(_audio_session != nullptr)
 			d_ptr->init_session(_audio_session,
-								0,
-								1.0 / 8000.0,
+								local_port == 0 ? 0 : local_port + AUDIO_PORTBASE - VIDEO_PORTBASE,
+								1.0 / DEFAULT_SAMPLE_RATE,
 								false);
+		for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+			if(d_ptr->layers[n].session != nullptr)
+				d_ptr->init_session(d_ptr->layers[n].session,
+									0,
+									1.0 / RTPMediaClock::VIDEO_CLOCK_RATE,
+									true,n);
+		}
 	}
 	
 	int ret_v{0},ret_a{0};
@@ -485,6 +993,10 @@ bool RTPSendThread::set_room_name(const std::string &name) noexcept
 	if(_audio_session != nullptr){
 		ret_a = _audio_session->set_room_name(name);
 	}
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(d_ptr->layers[n].session != nullptr)
+			d_ptr->layers[n].session->set_room_name(name);
+	}
 	if(ret_v < 0)
 		core::Logger::Print_RTP_Info(ret_v,
 									 __PRETTY_FUNCTION__,
@@ -505,6 +1017,10 @@ bool RTPSendThread::set_push_flag(bool flag) noexcept
 	if(_audio_session != nullptr){
 		ret_a = _audio_session->set_push_flag(flag);
 	}
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(d_ptr->layers[n].session != nullptr)
+			d_ptr->layers[n].session->set_push_flag(flag);
+	}
 	if(ret_v < 0)
 		core::Logger::Print_RTP_Info(ret_v,
 									 __PRETTY_FUNCTION__,
@@ -516,6 +1032,30 @@ bool RTPSendThread::set_push_flag(bool flag) noexcept
 	return ret_v >= 0 && ret_a >=0;
 }
 
+void RTPSendThread::set_target_bitrate(uint64_t bitrate) noexcept
+{
+	//节拍器是线程安全的，不需要加锁，否则需要等待当前帧发送完成
+	d_ptr->pacer.set_target_bitrate(bitrate);
+}
+
+uint64_t RTPSendThread::get_target_bitrate() noexcept
+{
+	return d_ptr->pacer.get_target_bitrate();
+}
+
+uint64_t RTPSendThread::get_media_bitrate() noexcept
+{
+	//每个包除了负载还有FEC头部、rtp头部(12字节)以及udp/ip头部(28字节)
+	auto symbol_size = static_cast<double>(d_ptr->fec_encoder.get_symbol_size());
+	auto payload = symbol_size / (symbol_size + fec::FECHeader::MAX_SIZE + 12 + 28);
+	return static_cast<uint64_t>(get_target_bitrate() * payload * d_ptr->fec_encoder.get_code_rate());
+}
+
+void RTPSendThread::set_fec_redundancy_range(float min_ratio, float max_ratio) noexcept
+{
+	d_ptr->fec_encoder.set_redundancy_range(min_ratio,max_ratio);
+}
+
 void RTPSendThread::on_thread_run() noexcept
 {
 	//让出时间片，因为可能会一直占用着锁
@@ -542,6 +1082,13 @@ void RTPSendThread::on_thread_run() noexcept
 			}
 		}
 	}
+	//联播的其他层，不等待，有数据才发送
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		auto queue = d_ptr->layers[n].queue;
+		if(queue != nullptr && queue->has_data())
+			d_ptr->send_layer_packet(n,queue->get_next());
+	}
+	d_ptr->process_nack();
 }
 
 
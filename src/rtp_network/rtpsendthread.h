@@ -5,12 +5,15 @@
 #include "../core/abstractqueue.h"
 #include "rtpsession.h"
 #include "../core/format.h"
+#include "../core/globalcallback.h"
 
 namespace rtplivelib{
 
 namespace rtp_network{
 
 class RtpSendThreadPrivateData;
+class RTPUserManager;
+class RTPCongestionController;
 
 /**
  * @brief The RTPSendThread class
@@ -19,7 +22,9 @@ class RtpSendThreadPrivateData;
  * 由于session所有操作都不是线程安全的
  * 所以在设置参数的接口上，使用该类的接口
  */
-class RTPLIVELIBSHARED_EXPORT RTPSendThread : public core::AbstractThread
+class RTPLIVELIBSHARED_EXPORT RTPSendThread :
+		public core::AbstractThread,
+		public core::CallBackObject
 {
 private:
 	using SendQueue = core::AbstractQueue<core::FramePacket>;
@@ -66,6 +71,18 @@ public:
 	 */
 	void set_audio_session(RTPSession *audio_session) noexcept;
 	
+	/**
+	 * @brief set_simulcast_layer
+	 * 设置联播(simulcast)的某一层的发送队列和会话，第0层就是视频队列和视频会话
+	 * 每一层使用独立的ssrc，接收端可以选择只接收其中一层
+	 * 该类不拥有session的所有权，要求同set_video_session
+	 * @param layer
+	 * [1,FECHeader::MAX_LAYERS)
+	 * @param queue
+	 * 该层的编码器，nullptr表示不再发送该层
+	 */
+	void set_simulcast_layer(uint8_t layer,SendQueue * queue,RTPSession * session) noexcept;
+	
 	/**
 	 * @brief send_video_packet
 	 * 利用之前设置的RTPSession，发送视频编码帧
@@ -95,6 +112,36 @@ public:
 	 */
 	void set_destination(const uint8_t *ip,uint16_t port_base = 0) noexcept;
 	
+	/**
+	 * @brief set_server_address
+	 * 设置加入房间时使用的服务器地址和本地端口，下一次加入房间的时候生效
+	 * 默认是config.h里的SERVER_IP和VIDEO_PORTBASE，本地端口随机
+	 * 在本机测试的时候可以让两个引擎互相把对方的本地端口作为服务器端口
+	 * @param ip
+	 * 服务器IP
+	 * @param port_base
+	 * 服务器端口，和set_destination一样，视频x，音频x+2
+	 * @param local_port_base
+	 * 本地端口，0则由系统自动分配
+	 */
+	void set_server_address(const uint8_t *ip,uint16_t port_base,uint16_t local_port_base = 0) noexcept;
+	
+	/**
+	 * @brief set_network_impairment
+	 * 设置所有会话的网络损伤模拟，下一次加入房间(创建会话)的时候生效
+	 * @param params
+	 * 损伤参数，nullptr则关闭
+	 * @see RTPSession::set_network_impairment
+	 */
+	void set_network_impairment(const RTPNetworkEmulator::Params * params) noexcept;
+	
+	/**
+	 * @brief set_media_bundle
+	 * 音频会话是否和视频会话共用一个socket，下一次加入房间(创建会话)的时候生效
+	 * @see RTPSession::set_bundle_session
+	 */
+	void set_media_bundle(bool enable) noexcept;
+	
 	/**
 	 * @brief set_local_name
 	 * 设置在会话中的名字
@@ -129,6 +176,47 @@ public:
 	 * 默认不允许
 	 */
 	bool set_push_flag(bool flag) noexcept;
+	
+	/**
+	 * @brief set_user_manager
+	 * 设置用户管理器，用于保存本地ssrc和进入房间的标志
+	 * 该类不拥有该对象的所有权
+	 */
+	void set_user_manager(RTPUserManager * manager) noexcept;
+	
+	/**
+	 * @brief set_target_bitrate
+	 * 设置视频的目标码率(bit/s)，视频包将会以该码率的若干倍匀速发送
+	 * 避免关键帧突发发送造成丢包
+	 */
+	void set_target_bitrate(uint64_t bitrate) noexcept;
+	
+	/**
+	 * @brief get_target_bitrate
+	 * 获取视频的目标码率(bit/s)
+	 */
+	uint64_t get_target_bitrate() noexcept;
+	
+	/**
+	 * @brief get_media_bitrate
+	 * 获取视频编码器可以使用的码率(bit/s)
+	 * 也就是目标码率扣除FEC冗余包和rtp/udp/ip头部之后剩下的部分
+	 */
+	uint64_t get_media_bitrate() noexcept;
+	
+	/**
+	 * @brief set_congestion_controller
+	 * 设置拥塞控制器，每一帧视频都会根据它统计的丢包情况选择FEC冗余包的数量
+	 * 该类不拥有该对象的所有权
+	 */
+	void set_congestion_controller(RTPCongestionController * controller) noexcept;
+	
+	/**
+	 * @brief set_fec_redundancy_range
+	 * 设置FEC冗余包数量占源数据包数量的比例范围
+	 * @see fec::FECEncoder::set_redundancy_range
+	 */
+	void set_fec_redundancy_range(float min_ratio,float max_ratio) noexcept;
 protected:
 	/**
 	 * @brief on_thread_run
@@ -150,6 +238,8 @@ private:
 	SendQueue						*_audio_queue;
 	RTPSession						*_video_session;
 	RTPSession						*_audio_session;
+	RTPUserManager					*_user_manager{nullptr};
+	RTPCongestionController			*_congestion{nullptr};
 	std::recursive_mutex			_mutex;
 	RtpSendThreadPrivateData * const d_ptr;
 	
@@ -166,6 +256,14 @@ inline void RTPSendThread::set_audio_send_queue(SendQueue * input_queue) noexcep
 	_audio_queue = input_queue;
 	this->notify_thread();
 }
+inline void RTPSendThread::set_user_manager(RTPUserManager *manager) noexcept				{
+	std::lock_guard<decltype(_mutex)> lk(_mutex);
+	_user_manager = manager;
+}
+inline void RTPSendThread::set_congestion_controller(RTPCongestionController *controller) noexcept	{
+	std::lock_guard<decltype(_mutex)> lk(_mutex);
+	_congestion = controller;
+}
 inline bool RTPSendThread::get_thread_pause_condition() noexcept							{
 	//只要有一组是正常的，线程就不需要暂停
 	return ( _video_queue == nullptr || _video_session == nullptr) &&
@@ -3,23 +3,92 @@
 #include "jrtplib3/rtpudpv4transmitter.h"
 #include "jrtplib3/rtpsessionparams.h"
 #include "jrtplib3/rtpsourcedata.h"
+#include "jrtplib3/rtperrors.h"
+#include "jrtplib3/rtpexternaltransmitter.h"
+#include "jrtplib3/rtprawpacket.h"
 #include "rtprecvthread.h"
 #include "rtpusermanager.h"
+#include "rtpbatchtransmitter.h"
+#include "rtpimpairmenttransmitter.h"
+#include "rtpmemorypool.h"
 #include "../core/logger.h"
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
 
 namespace rtplivelib {
 
 namespace rtp_network {
 
-class RTPSessionPrivataData: public jrtplib::RTPSession{
+class RTPSessionPrivataData;
+
+/**
+ * @brief The RTPBundleSender class
+ * 绑定到其他会话(bundle)的时候，jrtplib的外部传输器通过它使用主会话的传输器发送
+ */
+class RTPBundleSender : public jrtplib::RTPExternalSender {
+public:
+	explicit RTPBundleSender(RTPSessionPrivataData * owner):
+		owner(owner)
+	{		}
+	
+	virtual bool SendRTP(const void *data, size_t len) override;
+	
+	virtual bool SendRTCP(const void *data, size_t len) override;
+	
+	virtual bool ComesFromThisSender(const jrtplib::RTPAddress *a) override;
+private:
+	RTPSessionPrivataData * const owner;
+};
+
+/**
+ * @brief The RTPSessionMemoryPool struct
+ * 会话使用的内存池，作为第一个基类，保证在jrtplib的会话析构之后才释放
+ */
+struct RTPSessionMemoryPool {
+	//接收线程持有的包也会引用它，所有包释放之后才真正销毁
+	std::shared_ptr<RTPMemoryPool> pool{std::make_shared<RTPMemoryPool>()};
+};
+
+class RTPSessionPrivataData: private RTPSessionMemoryPool, public jrtplib::RTPSession{
 public:
 	rtp_network::RTPSession * obj;
 	rtp_network::RTPRecvThread * recv_obj;
+	//传输器由jrtplib的会话负责释放，会话销毁后该指针失效
+	RTPBatchTransmitter * transmitter;
+	//发送的rtp包的历史记录，创建传输器的时候设置进去
+	RTPPacketHistory * history;
+	//网络损伤模拟的参数，开启的时候创建传输器使用带损伤模拟的子类
+	bool impairment{false};
+	RTPNetworkEmulator::Params impairment_params;
+	//一次轮询收到的rtp包，轮询结束后一次性交给接收线程
+	std::vector<RTPPacket::SharedRTPPacket> pending_packets;
+	//设置的绑定会话，下一次创建的时候生效
+	RTPSessionPrivataData * bundle{nullptr};
+	//当前绑定的主会话，没有绑定则为nullptr
+	RTPSessionPrivataData * master{nullptr};
+	RTPBundleSender sender;
+	//外部传输器的注入接口，主会话分流出来的包通过它交给该会话
+	jrtplib::RTPExternalPacketInjecter * injecter{nullptr};
+	//作为主会话:绑定在该会话上的会话和已知的属于它的ssrc，轮询线程和发送线程都会访问
+	std::mutex bundle_mutex;
+	RTPSessionPrivataData * slave{nullptr};
+	std::unordered_set<uint32_t> slave_ssrcs;
 	
 	RTPSessionPrivataData(rtp_network::RTPSession * object):
+		jrtplib::RTPSession(nullptr,pool.get()),
 		obj(object),
-		recv_obj(nullptr)
-	{		}
+		recv_obj(nullptr),
+		transmitter(nullptr),
+		history(nullptr),
+		sender(this)
+	{
+		pending_packets.reserve(MAX_PENDING_PACKETS);
+	}
+	
+	inline RTPMemoryPool::Statistics get_memory_pool_statistics() noexcept {
+		return pool->get_statistics();
+	}
 	
 	virtual ~RTPSessionPrivataData() override {
 		
@@ -40,18 +109,135 @@ public:
 		else
 			return true;
 	}
+	
+	/**
+	 * @brief create_bundled
+	 * 通过主会话的传输器创建会话，没有自己的socket和轮询线程
+	 */
+	int create_bundled(jrtplib::RTPSessionParams & sessparams) noexcept {
+		sessparams.SetUsePollThread(false);
+		jrtplib::RTPExternalTransmissionParams transparams(&sender,RTPUDPV4TRANS_HEADERSIZE);
+		master = bundle;
+		auto ret = Create(sessparams,&transparams,jrtplib::RTPTransmitter::ExternalProto);
+		if(ret < 0){
+			master = nullptr;
+			return ret;
+		}
+		auto info = static_cast<jrtplib::RTPExternalTransmissionInfo *>(GetTransmissionInfo());
+		if(info != nullptr){
+			injecter = info->GetPacketInjector();
+			DeleteTransmissionInfo(info);
+		}
+		std::lock_guard<std::mutex> lk(master->bundle_mutex);
+		master->slave = this;
+		master->slave_ssrcs.clear();
+		return ret;
+	}
+	
+	/**
+	 * @brief destroy
+	 * 销毁会话，绑定在该会话上的会话需要通过这里的socket发送BYE，所以先销毁它
+	 */
+	void destroy(const jrtplib::RTPTime & max_time,const void *reason,size_t reason_len) noexcept {
+		RTPSessionPrivataData * bundled{nullptr};
+		{
+			std::lock_guard<std::mutex> lk(bundle_mutex);
+			bundled = slave;
+		}
+		if(bundled != nullptr)
+			bundled->destroy(max_time,reason,reason_len);
+		//先停止分流，BYE还是通过主会话发送
+		if(master != nullptr){
+			std::lock_guard<std::mutex> lk(master->bundle_mutex);
+			master->slave = nullptr;
+			master->slave_ssrcs.clear();
+		}
+		if(IsActive())
+			BYEDestroy(max_time,reason,reason_len);
+		master = nullptr;
+		injecter = nullptr;
+		transmitter = nullptr;
+	}
+	
+	/**
+	 * @brief demux
+	 * 作为主会话的时候分流收到的包，在轮询线程调用
+	 * rtp包按照负载类型分流，rtcp包按照第一个包的发送者ssrc分流
+	 * 还没有收到对方音频rtp包的时候，它的rtcp包会交给主会话，jrtplib和用户管理器都可以处理
+	 * @return 
+	 * 交给了绑定的会话则返回true
+	 */
+	bool demux(jrtplib::RTPRawPacket & packet) noexcept {
+		auto data = packet.GetData();
+		auto len = packet.GetDataLength();
+		if(data == nullptr || len < 8 || packet.GetSenderAddress() == nullptr)
+			return false;
+		std::lock_guard<std::mutex> lk(bundle_mutex);
+		if(slave == nullptr || slave->injecter == nullptr)
+			return false;
+		if(packet.IsRTP()){
+			if(len < 12 || (data[1] & 0x7F) != rtp_network::RTPSession::RTP_PT_AAC)
+				return false;
+			slave_ssrcs.insert(Read_SSRC(data + 8));
+			slave->injecter->InjectRTP(data,len,*packet.GetSenderAddress());
+			return true;
+		}
+		if(slave_ssrcs.count(Read_SSRC(data + 4)) == 0)
+			return false;
+		slave->injecter->InjectRTCP(data,len,*packet.GetSenderAddress());
+		return true;
+	}
 protected:
+	/**
+	 * @brief NewUserDefinedTransmitter
+	 * 创建会话的时候使用批量发送的传输器
+	 */
+	virtual jrtplib::RTPTransmitter *NewUserDefinedTransmitter() override {
+		if(impairment)
+			transmitter = RTPNew(GetMemoryManager(),RTPMEM_TYPE_CLASS_RTPTRANSMITTER)
+						  RTPImpairmentTransmitter(GetMemoryManager(),impairment_params);
+		else
+			transmitter = RTPNew(GetMemoryManager(),RTPMEM_TYPE_CLASS_RTPTRANSMITTER)
+						  RTPBatchTransmitter(GetMemoryManager());
+		if(transmitter != nullptr){
+			transmitter->set_packet_history(history);
+			transmitter->set_demuxer([this](jrtplib::RTPRawPacket & packet){
+				return demux(packet);
+			});
+		}
+		return transmitter;
+	}
+	
 	virtual void OnValidatedRTPPacket(jrtplib::RTPSourceData *srcdat, jrtplib::RTPPacket *rtppack,
 									  bool isonprobation, bool *ispackethandled) override {
 		UNUSED(isonprobation)
 		*ispackethandled = true;
 		
 		if(recv_obj == nullptr){
-			delete rtppack;
+			DeletePacket(rtppack);
 			return;
 		}
-		//rtp包就交给接收线程处理
-		recv_obj->push_one(RTPPacket::Make_Shared(rtppack,srcdat));
+		//rtp包先缓存起来，一次轮询结束后再交给接收线程处理(OnPollThreadStep)
+		pending_packets.push_back(RTPPacket::Make_Shared(rtppack,srcdat,pool));
+		if(pending_packets.size() >= MAX_PENDING_PACKETS)
+			recv_obj->push_batch(pending_packets);
+	}
+	
+	/**
+	 * @brief OnPollThreadStep
+	 * 轮询线程每处理完一次数据就会回调，在这里把这次收到的所有rtp包交给接收线程
+	 */
+	virtual void OnPollThreadStep() override {
+		if(recv_obj == nullptr)
+			pending_packets.clear();
+		else
+			recv_obj->push_batch(pending_packets);
+		//绑定的会话没有轮询线程，由这里处理它的包和rtcp
+		std::lock_guard<std::mutex> lk(bundle_mutex);
+		if(slave != nullptr){
+			slave->Poll();
+			slave->OnPollThreadStep();
+		}
 	}
 	
 	virtual void OnRTCPCompoundPacket(jrtplib::RTCPCompoundPacket *pack,
@@ -59,11 +245,21 @@ protected:
 									  const jrtplib::RTPAddress *senderaddress) override {
 		UNUSED(receivetime)
 		UNUSED(senderaddress)
-		//rtcp包就交给RTPUserManager处理,没有开线程
+		//rtcp包就交给接收线程所属的RTPUserManager处理,没有开线程
 		//如果效果不好则考虑开线程
-		rtp_network::RTPUserManager::Get_user_manager()->deal_with_rtcp(pack);
+		if(recv_obj == nullptr || recv_obj->get_user_manager() == nullptr)
+			return;
+		recv_obj->get_user_manager()->deal_with_rtcp(pack);
 	}
 private:
+	//缓存的包数超过该值则直接交给接收线程
+	static constexpr size_t MAX_PENDING_PACKETS = 256;
+	
+	static uint32_t Read_SSRC(const uint8_t * data) noexcept {
+		return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+				(static_cast<uint32_t>(data[2]) << 8) | data[3];
+	}
+	
 	/**
 	 * @brief set_ip_from_Source
 	 * 从Source中提取ip字符串和端口
@@ -100,16 +296,49 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool RTPBundleSender::SendRTP(const void *data, size_t len)
+{
+	//不经过主会话的历史记录，重传只针对主会话自己的包
+	auto master = owner->master;
+	if(master == nullptr || master->transmitter == nullptr)
+		return false;
+	return master->transmitter->resend_rtp_data(data,len) >= 0;
+}
+
+bool RTPBundleSender::SendRTCP(const void *data, size_t len)
+{
+	auto master = owner->master;
+	if(master == nullptr || master->transmitter == nullptr)
+		return false;
+	return master->transmitter->SendRTCPData(data,len) >= 0;
+}
+
+bool RTPBundleSender::ComesFromThisSender(const jrtplib::RTPAddress *a)
+{
+	auto master = owner->master;
+	if(master == nullptr || master->transmitter == nullptr)
+		return false;
+	return master->transmitter->ComesFromThisTransmitter(a);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+//socket收发缓冲区大小
+static constexpr int SOCKET_BUFFER_SIZE = 1024 * 1024;
+//联播层的SDES TOOL字段:前缀 + 层(一个数字)
+static constexpr char SIMULCAST_TOOL[] = "rtplivelib-simulcast:";
+static constexpr size_t SIMULCAST_TOOL_SIZE = sizeof(SIMULCAST_TOOL) - 1;
+
 RTPSession::RTPSession():
 	d_ptr(new RTPSessionPrivataData(this)),
-	_push_flag(false)
+	_push_flag(false),
+	_layer(0)
 {
 }
 
 RTPSession::~RTPSession()
 {
-	if(d_ptr->IsActive())
-		d_ptr->BYEDestroy(jrtplib::RTPTime(10,0),nullptr,0);
+	d_ptr->destroy(jrtplib::RTPTime(10,0),nullptr,0);
 	d_ptr->ClearDestinations();
 	delete d_ptr;
 }
@@ -147,12 +376,26 @@ int RTPSession::create(const double &timestamp_unit, const uint16_t &port_base)
 	transparams.SetRTCPMultiplexing(true);
 #endif
 	transparams.SetPortbase(port_base);
+	//默认的socket缓冲区只有32K，一个关键帧就有上百个包，突发的时候会被内核丢弃
+	transparams.SetRTPReceiveBuffer(SOCKET_BUFFER_SIZE);
+	transparams.SetRTPSendBuffer(SOCKET_BUFFER_SIZE);
 	
-	int ret = d_ptr->Create(sessparams,&transparams);
+	int ret;
+	auto bundle = d_ptr->bundle;
+	if(bundle != nullptr && bundle->IsActive() && bundle->transmitter != nullptr)
+		ret = d_ptr->create_bundled(sessparams);
+	else
+		//传输器的参数依旧是UDPv4的参数，只是传输器换成了可以批量发送的子类
+		ret = d_ptr->Create(sessparams,&transparams,jrtplib::RTPTransmitter::UserDefinedProto);
+	if(ret < 0)
+		d_ptr->transmitter = nullptr;
 	//如果在创建会话之前设置过了用户名，则只是设置了参数
 	//得在会话创建成功后，设置到会话中
-	if(ret >= 0)
+	if(ret >= 0){
 		set_local_name(_local_name);
+		if(_layer != 0)
+			set_simulcast_layer(_layer);
+	}
 	return ret;
 }
 
@@ -163,6 +406,9 @@ bool RTPSession::is_active() noexcept
 
 int RTPSession::add_destination(const uint8_t *ip, const uint16_t &port_base) noexcept
 {
+	//绑定的时候使用主会话的目标地址
+	if(d_ptr->master != nullptr)
+		return 0;
 	//	return d_ptr->AddDestination(jrtplib::RTPIPv4Address(ip,port_base));
 #ifdef SINGLEPORT
 	return d_ptr->AddDestination(jrtplib::RTPIPv4Address(ip,port_base,port_base));
@@ -173,6 +419,8 @@ int RTPSession::add_destination(const uint8_t *ip, const uint16_t &port_base) no
 
 int RTPSession::delete_destination(const uint8_t *ip, const uint16_t &port_base) noexcept
 {
+	if(d_ptr->master != nullptr)
+		return 0;
 	//	return d_ptr->DeleteDestination(jrtplib::RTPIPv4Address(ip,port_base));
 #ifdef SINGLEPORT
 	return d_ptr->DeleteDestination(jrtplib::RTPIPv4Address(ip,port_base,port_base));
@@ -183,6 +431,8 @@ int RTPSession::delete_destination(const uint8_t *ip, const uint16_t &port_base)
 
 void RTPSession::clear_destinations() noexcept
 {
+	if(d_ptr->master != nullptr)
+		return;
 	d_ptr->ClearDestinations();
 }
 
@@ -217,23 +467,95 @@ int RTPSession::send_packet_ex(const void *data,const uint64_t &len,
 							   hdrextdata,numhdrextwords);
 }
 
+void RTPSession::begin_batch() noexcept
+{
+	if(d_ptr->IsActive() && d_ptr->transmitter != nullptr)
+		d_ptr->transmitter->begin_batch();
+}
+
+int RTPSession::end_batch() noexcept
+{
+	if(d_ptr->IsActive() && d_ptr->transmitter != nullptr)
+		return d_ptr->transmitter->flush_batch();
+	return 0;
+}
+
 int RTPSession::send_rtcp_app_packet(RTPSession::APPPacketType packet_type, const uint8_t name[],
 									 const void *appdata, size_t appdatalen) noexcept
 {
 	return d_ptr->SendRTCPAPPPacket(packet_type,name,appdata,appdatalen);
 }
 
+void RTPSession::set_packet_history(RTPPacketHistory *history) noexcept
+{
+	d_ptr->history = history;
+	if(d_ptr->IsActive() && d_ptr->transmitter != nullptr)
+		d_ptr->transmitter->set_packet_history(history);
+}
+
+int RTPSession::resend_packet(const void *data, size_t len) noexcept
+{
+	if(d_ptr->IsActive() && d_ptr->transmitter != nullptr)
+		return d_ptr->transmitter->resend_rtp_data(data,len);
+	return ERR_RTP_SESSION_NOTCREATED;
+}
+
+void RTPSession::set_network_impairment(const RTPNetworkEmulator::Params *params) noexcept
+{
+	d_ptr->impairment = params != nullptr;
+	if(params == nullptr)
+		return;
+	d_ptr->impairment_params = *params;
+	auto impairment = dynamic_cast<RTPImpairmentTransmitter *>(d_ptr->transmitter);
+	if(d_ptr->IsActive() && impairment != nullptr)
+		impairment->get_emulator().set_params(*params);
+}
+
+void RTPSession::set_bundle_session(RTPSession *master) noexcept
+{
+	d_ptr->bundle = master == nullptr || master == this ? nullptr : master->d_ptr;
+}
+
+bool RTPSession::is_bundled() noexcept
+{
+	return d_ptr->master != nullptr;
+}
+
+void RTPSession::get_memory_pool_statistics(RTPMemoryPoolStatistics &statistics) noexcept
+{
+	statistics = d_ptr->get_memory_pool_statistics();
+}
+
+bool RTPSession::get_network_impairment_statistics(RTPNetworkEmulator::Statistics &statistics) noexcept
+{
+	auto impairment = dynamic_cast<RTPImpairmentTransmitter *>(d_ptr->transmitter);
+	if(!d_ptr->IsActive() || impairment == nullptr)
+		return false;
+	statistics = impairment->get_emulator().get_statistics();
+	return true;
+}
+
 int RTPSession::increment_timestamp_default() noexcept
 {
 	return d_ptr->IncrementTimestampDefault();
 }
 
+int RTPSession::increment_timestamp(uint32_t inc) noexcept
+{
+	return d_ptr->IncrementTimestamp(inc);
+}
+
+int RTPSession::set_timestamp_unit(double unit) noexcept
+{
+	return d_ptr->SetTimestampUnit(unit);
+}
+
 void RTPSession::BYE_destroy(const int64_t& max_time_seconds, const uint32_t & max_time_microseconds,
 							 const void *reason, const uint64_t& reason_len) noexcept
 {
 	if(!d_ptr->IsActive())
 		return;
-	d_ptr->BYEDestroy(jrtplib::RTPTime(max_time_seconds,max_time_microseconds),reason,reason_len);
+	d_ptr->destroy(jrtplib::RTPTime(max_time_seconds,max_time_microseconds),reason,reason_len);
 	//因为这个没有返回值，所以在类内发送日志
 	core::Logger::Print_APP_Info(core::Result::Rtp_destroy_session,
 								 __PRETTY_FUNCTION__,
@@ -271,6 +593,75 @@ int RTPSession::set_push_flag(const bool &flag) noexcept
 	return d_ptr->set_room_name();
 }
 
+int RTPSession::set_simulcast_layer(uint8_t layer) noexcept
+{
+	_layer = layer;
+	if(!d_ptr->IsActive())
+		return 0;
+	//TOOL字段和用户名一样每个rtcp包都带上，保证接收端先知道这是哪一层再插入用户
+	d_ptr->SetToolInterval(1);
+	if(layer == 0)
+		return d_ptr->SetLocalTool(nullptr,0);
+	std::string tool(SIMULCAST_TOOL);
+	tool.push_back(static_cast<char>('0' + layer));
+	return d_ptr->SetLocalTool(tool.c_str(),tool.size());
+}
+
+uint8_t RTPSession::Get_Simulcast_Layer(const void *tool, size_t len) noexcept
+{
+	if(tool == nullptr || len != SIMULCAST_TOOL_SIZE + 1 ||
+			memcmp(tool,SIMULCAST_TOOL,SIMULCAST_TOOL_SIZE) != 0)
+		return 0;
+	auto c = static_cast<const char*>(tool)[SIMULCAST_TOOL_SIZE];
+	return c > '0' && c <= '9' ? static_cast<uint8_t>(c - '0') : 0;
+}
+
+const uint8_t RTPSession::LAYER_APP_NAME[4] = {'L','A','Y','R'};
+
+bool RTPSession::Parse_Room_Note(const void *note, size_t len, std::string &room, bool &push) noexcept
+{
+	if(note == nullptr || len < 1)
+		return false;
+	auto str = static_cast<const char*>(note);
+	if(str[len - 1] != '0' && str[len - 1] != '1')
+		return false;
+	push = str[len - 1] == '1';
+	room.assign(str,len - 1);
+	return true;
+}
+
+void RTPSession::Pack_Layer_Selection(const LayerSelection &selection, std::vector<uint8_t> &output) noexcept
+{
+	output.clear();
+	for(auto & pair : selection){
+		if(pair.first.empty() || pair.first.size() > UINT8_MAX)
+			continue;
+		output.push_back(pair.second);
+		output.push_back(static_cast<uint8_t>(pair.first.size()));
+		output.insert(output.end(),pair.first.begin(),pair.first.end());
+	}
+	//用户名长度为0表示结束
+	while(output.size() % 4 != 0)
+		output.push_back(0);
+}
+
+bool RTPSession::Unpack_Layer_Selection(const void *data, size_t len, LayerSelection &selection) noexcept
+{
+	selection.clear();
+	if(data == nullptr || len % 4 != 0)
+		return false;
+	auto ptr = static_cast<const uint8_t *>(data);
+	size_t n = 0;
+	while(n + 2 <= len && ptr[n + 1] != 0){
+		size_t size = ptr[n + 1];
+		if(n + 2 + size > len)
+			return false;
+		selection[std::string(reinterpret_cast<const char *>(ptr + n + 2),size)] = ptr[n];
+		n += 2 + size;
+	}
+	return true;
+}
+
 void RTPSession::set_rtp_recv_object(RTPRecvThread *object) noexcept
 {
 	d_ptr->recv_obj = object;
@@ -3,7 +3,10 @@
 
 #include "../core/config.h"
 #include "../core/globalcallback.h"
+#include "rtpnetworkemulator.h"
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 namespace rtplivelib {
 
@@ -11,6 +14,8 @@ namespace rtp_network {
 
 class RTPSessionPrivataData;
 class RTPRecvThread;
+class RTPPacketHistory;
+struct RTPMemoryPoolStatistics;
 
 /**
  * @brief The RTPSession class
@@ -43,9 +48,19 @@ public:
 	enum APPPacketType{
 		RTP_APP_TYPE_UNKNOWN = 0,
 		RTP_APP_TYPE_USER_JOIN,
-		RTP_APP_TYPE_USER_EXIT
+		RTP_APP_TYPE_USER_EXIT,
+		RTP_APP_TYPE_NACK,
+		RTP_APP_TYPE_PLI,
+		RTP_APP_TYPE_FIR,
+		RTP_APP_TYPE_LAYER
 	};
 	
+	/*选择接收的每个用户的联播层，用户名 -> 层*/
+	using LayerSelection = std::unordered_map<std::string,uint8_t>;
+	
+	//通知中继选择接收的联播层的APP包的名字
+	static const uint8_t LAYER_APP_NAME[4];
+	
 public:
 	/**
 	 * @brief RTPSession
@@ -197,6 +212,21 @@ public:
 					   const uint16_t &hdrextID,
 					   const void *hdrextdata,const uint64_t &numhdrextwords) noexcept;
 	
+	/**
+	 * @brief begin_batch
+	 * 开始批量发送，之后发送的rtp包先缓存起来，调用end_batch的时候一次性发送
+	 * 用于一帧数据分成多个包的情况，减少系统调用次数
+	 */
+	void begin_batch() noexcept;
+	
+	/**
+	 * @brief end_batch
+	 * 发送缓存的rtp包，并结束批量发送
+	 * @return 
+	 * 失败返回小于0的错误码
+	 */
+	int end_batch() noexcept;
+	
 	/**
 	 * @brief send_rtcp_app_packet
 	 * 发送rtcp包，属于app字段的信令
@@ -216,6 +246,69 @@ public:
 	int send_rtcp_app_packet(APPPacketType packet_type, const uint8_t name[4],
 	const void *appdata, size_t appdatalen ) noexcept;
 	
+	/**
+	 * @brief set_packet_history
+	 * 设置发送的rtp包的历史记录，之后发送的每个rtp包都会保存一份，用于NACK重传
+	 * 历史记录由调用者负责释放，设置为nullptr则不再记录
+	 * 会话重新创建后依旧有效
+	 */
+	void set_packet_history(RTPPacketHistory * history) noexcept;
+	
+	/**
+	 * @brief resend_packet
+	 * 重传一个完整的rtp包(包括头部)，直接交给传输器发送，
+	 * 序列号和时间戳都保持原来的值，也不会再次保存到历史记录
+	 * @return 
+	 * 失败返回小于0的错误码
+	 */
+	int resend_packet(const void *data,size_t len) noexcept;
+	
+	/**
+	 * @brief set_network_impairment
+	 * 设置网络损伤模拟，用于在本机(回环地址)测试丢包、延迟、乱序和带宽限制下的表现
+	 * 会话已经开启了损伤模拟则立即修改参数，否则在下一次创建会话的时候生效
+	 * @param params
+	 * 损伤参数，nullptr则关闭(下一次创建会话的时候生效)
+	 * @see RTPImpairmentTransmitter
+	 */
+	void set_network_impairment(const RTPNetworkEmulator::Params * params) noexcept;
+	
+	/**
+	 * @brief set_bundle_session
+	 * 和另一个会话共用一个socket(bundle)，一般是音频会话绑定到视频会话，下一次创建会话的时候生效
+	 * 创建的时候master已经创建了，该会话就不再打开自己的socket和轮询线程:
+	 * 1.发送的rtp和rtcp包通过master的传输器发送到master的目标地址(不保存到master的历史记录)，
+	 *   该会话的目标地址将被忽略
+	 * 2.master收到的包按照负载类型和ssrc分流，音频负载类型的rtp包以及同一个ssrc的rtcp包交给该会话
+	 * 3.master的轮询线程顺便处理该会话的包和rtcp
+	 * master没有创建的时候依旧使用自己的socket
+	 * master销毁的时候会先销毁该会话(需要通过master的socket发送BYE)，master需要比该会话后释放
+	 * 服务器或者对方也需要使用同一个端口接收和发送音视频
+	 * @param master
+	 * nullptr则取消绑定
+	 */
+	void set_bundle_session(RTPSession * master) noexcept;
+	
+	/**
+	 * @brief is_bundled
+	 * 是否通过其他会话的socket收发
+	 */
+	bool is_bundled() noexcept;
+	
+	/**
+	 * @brief get_network_impairment_statistics
+	 * 获取损伤模拟的统计
+	 * @return 
+	 * 会话没有开启损伤模拟则返回false
+	 */
+	bool get_network_impairment_statistics(RTPNetworkEmulator::Statistics & statistics) noexcept;
+	
+	/**
+	 * @brief get_memory_pool_statistics
+	 * 获取接收的包使用的内存池的统计
+	 */
+	void get_memory_pool_statistics(RTPMemoryPoolStatistics & statistics) noexcept;
+	
 	/**
 	 * @brief increment_timestamp_default
 	 * 手动增加默认的时间戳增量
@@ -223,6 +316,19 @@ public:
 	 */
 	int increment_timestamp_default() noexcept;
 	
+	/**
+	 * @brief increment_timestamp
+	 * 增加时间戳，用于按照帧的媒体时间设置时间戳
+	 * 一帧的所有包使用同一个时间戳，发送这一帧之前调用
+	 */
+	int increment_timestamp(uint32_t inc) noexcept;
+	
+	/**
+	 * @brief set_timestamp_unit
+	 * 设置时间戳的单位(秒)，即时钟频率的倒数，rtcp的发送报告根据该值把时间换算成时间戳
+	 */
+	int set_timestamp_unit(double unit) noexcept;
+	
 	/**
 	 * @brief BYE_destroy
 	 * 发送给结束会话的信息，在要退出rtp会话时需要调用该函数
@@ -278,6 +384,61 @@ public:
 	 */
 	int set_push_flag(const bool& flag) noexcept;
 	
+	/**
+	 * @brief get_push_flag
+	 * 获取推流标志
+	 */
+	bool get_push_flag() noexcept;
+	
+	/**
+	 * @brief set_simulcast_layer
+	 * 设置该会话发送的联播(simulcast)层，0是原始分辨率，也是默认值
+	 * 非0的层会通过SDES的TOOL字段告诉接收端，接收端据此把同一个用户的多个视频ssrc区分开
+	 */
+	int set_simulcast_layer(uint8_t layer) noexcept;
+	
+	/**
+	 * @brief get_simulcast_layer
+	 * 获取该会话发送的联播层
+	 */
+	uint8_t get_simulcast_layer() noexcept;
+	
+	/**
+	 * @brief Get_Simulcast_Layer
+	 * 从SDES的TOOL字段解析联播的层
+	 * @return 
+	 * 不是联播的层则返回0
+	 */
+	static uint8_t Get_Simulcast_Layer(const void * tool,size_t len) noexcept;
+	
+	/**
+	 * @brief Parse_Room_Note
+	 * 解析SDES的NOTE字段，格式为房间名加上推流标志(见set_room_name)
+	 * @param room
+	 * 输出房间名，没有加入房间则为空
+	 * @param push
+	 * 输出推流标志
+	 * @return 
+	 * 格式不对则返回false
+	 */
+	static bool Parse_Room_Note(const void * note,size_t len,std::string & room,bool & push) noexcept;
+	
+	/**
+	 * @brief Pack_Layer_Selection
+	 * 把选择接收的联播层打包成APP包的数据，中继据此只转发选择的那一层
+	 * 每个用户:层(1字节) + 用户名长度(1字节) + 用户名，最后补0对齐到4字节
+	 * 用户名超过255字节的用户不打包
+	 */
+	static void Pack_Layer_Selection(const LayerSelection & selection,std::vector<uint8_t> & output) noexcept;
+	
+	/**
+	 * @brief Unpack_Layer_Selection
+	 * 解析APP包的数据
+	 * @return 
+	 * 数据格式不对则返回false
+	 */
+	static bool Unpack_Layer_Selection(const void * data,size_t len,LayerSelection & selection) noexcept;
+	
 	/**
 	 * @brief set_rtp_recv_object
 	 * 设置rtp接收对象，用于专门处理接收到的rtp数据包
@@ -289,6 +450,7 @@ private:
 	std::string _room_name;
 	std::string _local_name;
 	bool _push_flag;
+	uint8_t _layer;
 	
 	friend class RTPSessionPrivataData;
 	friend class RTPRecvThread;
@@ -301,6 +463,13 @@ inline const std::string& RTPSession::get_room_name() noexcept									{
 inline const std::string& RTPSession::get_local_name() noexcept									{
 	return _local_name;
 }
+inline bool RTPSession::get_push_flag() noexcept												{
+	return _push_flag;
+}
+
+inline uint8_t RTPSession::get_simulcast_layer() noexcept										{
+	return _layer;
+}
 
 
 } // namespace rtp_network
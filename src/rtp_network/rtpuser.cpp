@@ -1,4 +1,5 @@
 #include "rtpuser.h"
+#include "rtpmediaclock.h"
 #include <memory>
 #include "jrtplib3/rtppacket.h"
 #include "jrtplib3/rtpsourcedata.h"
@@ -18,11 +19,16 @@ namespace rtp_network {
 
 RTPUser::RTPUser()
 {
-	_vdecoder.set_player_object(&_vplay);
+	//视频的时间戳是90kHz的媒体时间
+	_vjitter.set_clock_rate(RTPMediaClock::VIDEO_CLOCK_RATE);
 }
 
 RTPUser::~RTPUser()
 {
+	//先让解码器不再使用播放器
+	_vdecoder.set_player_object(nullptr);
+	if(_vplay != nullptr)
+		delete _vplay;
 }
 
 void RTPUser::deal_with_packet(RTPPacket::SharedRTPPacket rtp_packet) noexcept
@@ -42,12 +48,14 @@ void RTPUser::deal_with_packet(RTPPacket::SharedRTPPacket rtp_packet) noexcept
 	
 	fec::FECDecoder * fec_ptr;
 	codec::VideoDecoder::Queue * decoder_ptr{nullptr};
+	RTPNackGenerator * nack_ptr{nullptr};
 	switch(pt){
 	case RTPSession::PayloadType::RTP_PT_HEVC:
 	case RTPSession::PayloadType::RTP_PT_H264:
 	case RTPSession::PayloadType::RTP_PT_VP9:
 		fec_ptr = &_vfecdecoder;
 		decoder_ptr = &_vdecoder;
+		nack_ptr = &_vnack;
 		break;
 	case RTPSession::PayloadType::RTP_PT_AAC:
 		fec_ptr = &_afecdecoder;
@@ -57,14 +65,70 @@ void RTPUser::deal_with_packet(RTPPacket::SharedRTPPacket rtp_packet) noexcept
 		return;
 	}
 	
+	//视频的组帧、丢包检测和抖动缓冲区只属于正在接收的那一层
+	std::unique_lock<std::mutex> lk(_video_mutex,std::defer_lock);
+	if(fec_ptr == &_vfecdecoder){
+		lk.lock();
+		if(!_accept_video(packet->GetSSRC()))
+			return;
+	}
+	
+	//先记录丢包情况，解码成功说明有帧输出了(完整或者放弃等待)
+	//输出的帧的包不再需要重传，还在等待的帧的包继续请求
+	if(nack_ptr != nullptr)
+		nack_ptr->on_packet(packet->GetSSRC(),packet->GetExtendedSequenceNumber());
 	if(fec_ptr->decode(rtp_packet) != core::Result::Success)
 		return;
+	if(nack_ptr != nullptr)
+		nack_ptr->on_frame_complete(fec_ptr->get_output_sequence());
+	if(fec_ptr == &_vfecdecoder){
+		//之前的帧不完整(重传和FEC都没能恢复)，需要关键帧
+		auto && lost = _vfecdecoder.get_lost_frame_count();
+		if(lost != _vlost_frames){
+			_vlost_frames = lost;
+			_vkeyframe.on_frame_lost(packet->GetSSRC());
+		}
+		//组帧完成的视频帧先进入抖动缓冲区，按照顺序和播放时间交给解码器
+		//之前等待的帧也会一起输出
+		core::FramePacket::SharedPacket frame;
+		while( (frame = fec_ptr->get_packet()) != nullptr ){
+			if(frame->is_key())
+				_vkeyframe.on_key_frame(packet->GetSSRC());
+			//来得太晚被丢弃的帧同样需要关键帧恢复
+			if(!_vjitter.push(static_cast<uint32_t>(frame->pts),frame))
+				_vkeyframe.on_frame_lost(packet->GetSSRC());
+		}
+		play_out();
+		return;
+	}
 	decoder_ptr->push_one(std::make_shared<codec::VideoDecoder::Packet>(_pt,fec_ptr->get_packet()));
 }
 
+core::Clock::TimePoint RTPUser::play_out() noexcept
+{
+	std::lock_guard<std::mutex> lk(_play_mutex);
+	core::FramePacket::SharedPacket frame;
+	while( (frame = _vjitter.pop()) != nullptr ){
+		auto && pt = static_cast<RTPSession::PayloadType>(frame->payload_type);
+		_vdecoder.push_one(std::make_shared<codec::VideoDecoder::Packet>(pt,frame));
+	}
+	return _vjitter.get_next_playout_time();
+}
+
+void RTPUser::check_decoder_error() noexcept
+{
+	auto && errors = _vdecoder.get_error_count();
+	if(errors == _vdecoder_errors)
+		return;
+	_vdecoder_errors = errors;
+	_vkeyframe.on_decode_error(_receiving_ssrc);
+}
+
 void RTPUser::set_win_id(void *id) noexcept
 {
-	_vplay.set_win_id(id);
+	auto player = _get_player();
+	if(player != nullptr)
+		player->set_win_id(id);
 }
 
 void RTPUser::set_video_hwd_type(codec::HardwareDevice::HWDType type) noexcept
@@ -80,7 +144,62 @@ codec::HardwareDevice::HWDType RTPUser::get_video_hwd_type() noexcept
 void RTPUser::set_display_screen_size(const int &win_w, const int &win_h,
 									  const int &frame_w, const int &frame_h) noexcept
 {
-	_vplay.show_screen_size_changed(win_w,win_h,frame_w,frame_h);
+	auto player = _get_player();
+	if(player != nullptr)
+		player->show_screen_size_changed(win_w,win_h,frame_w,frame_h);
+}
+
+void RTPUser::set_frame_sink(core::AbstractQueue<core::FramePacket> *video_sink,
+							 core::AbstractQueue<core::FramePacket> *audio_sink) noexcept
+{
+	_vdecoder.set_frame_sink(video_sink);
+	_adecoder.set_frame_sink(audio_sink);
+}
+
+bool RTPUser::_accept_video(uint32_t ssrc) noexcept
+{
+	uint8_t layer{0};
+	for(uint8_t n = 1; n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(layer_ssrc[n] == ssrc){
+			layer = n;
+			break;
+		}
+	}
+	//对方没有发送选择的那一层则接收第0层
+	uint8_t selected = _video_layer;
+	if(selected >= fec::FECHeader::MAX_LAYERS || layer_ssrc[selected] == 0)
+		selected = 0;
+	if(layer != selected)
+		return false;
+	_receiving_ssrc = ssrc;
+	if(layer != _receiving_layer){
+		if(_receiving_layer >= 0)
+			core::Logger::Print("user:{} switch video layer {} -> {}",
+								__PRETTY_FUNCTION__,
+								LogLevel::INFO_LEVEL,
+								name,_receiving_layer,layer);
+		//切换层之后需要新的一层的关键帧，第一次接收的时候等待正常的关键帧就可以了
+		if(_receiving_layer >= 0)
+			_vkeyframe.on_stream_start(ssrc);
+		_receiving_layer = layer;
+		_vfecdecoder.reset();
+		_vnack.reset();
+		std::lock_guard<std::mutex> lk(_play_mutex);
+		_vjitter.reset();
+	}
+	return true;
+}
+
+player::VideoPlayer *RTPUser::_get_player() noexcept
+{
+	std::lock_guard<std::mutex> lk(_vplay_mutex);
+	if(_vplay == nullptr){
+		_vplay = new (std::nothrow) player::VideoPlayer;
+		if(_vplay == nullptr)
+			return nullptr;
+		_vdecoder.set_player_object(_vplay);
+	}
+	return _vplay;
 }
 
 } // rtp_network
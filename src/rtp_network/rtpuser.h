@@ -8,8 +8,14 @@
 #include "../player/videoplayer.h"
 #include "rtpsession.h"
 #include "rtppacket.h"
+#include "rtpnackgenerator.h"
+#include "rtpkeyframerequester.h"
+#include "rtpjitterbuffer.h"
 #include "fec/fecdecoder.h"
+#include "fec/fecheader.h"
 #include <string>
+#include <mutex>
+#include <atomic>
 
 namespace rtplivelib{
 
@@ -37,6 +43,10 @@ struct RTPLIVELIBSHARED_EXPORT RTPUser
 	uint32_t ssrc{0};
 	/*与自己配套(音频和视频)的另一个会话ssrc*/
 	uint32_t another_ssrc{0};
+	/*联播(simulcast)的其他层的视频ssrc，下标是层，第0层就是上面两个ssrc中的一个*/
+	/*在RTPUserManager的锁内修改，工作线程组帧的时候不加锁读取*/
+	std::atomic<uint32_t> layer_ssrc[fec::FECHeader::MAX_LAYERS]{};
+	
 	/*用户名,唯一标识*/
 	std::string name;
 	/*用户类型,用于判断是否有流接收*/
@@ -86,16 +96,102 @@ protected:
 	
 	void set_display_screen_size(const int &win_w,const int & win_h,
 								 const int & frame_w,const int & frame_h) noexcept;
+	
+	/**
+	 * @brief set_frame_sink
+	 * 设置解码帧的输出队列，用于无界面模式
+	 * @param video_sink
+	 * 视频帧输出队列，nullptr则不输出
+	 * @param audio_sink
+	 * 音频帧输出队列，nullptr则不输出
+	 */
+	void set_frame_sink(core::AbstractQueue<core::FramePacket> * video_sink,
+						core::AbstractQueue<core::FramePacket> * audio_sink) noexcept;
+	
+	/**
+	 * @brief set_video_layer
+	 * 选择接收的联播层，0是原始分辨率，对方没有发送这一层的时候接收第0层
+	 * 切换之后需要等到新的一层的关键帧才能正常解码
+	 */
+	void set_video_layer(uint8_t layer) noexcept;
+	
+	/**
+	 * @brief get_video_layer
+	 * 获取选择接收的联播层
+	 */
+	uint8_t get_video_layer() noexcept;
+	
+	/**
+	 * @brief get_video_decoder_cpu_time
+	 * 获取视频解码线程占用的CPU时间，单位纳秒
+	 */
+	int64_t get_video_decoder_cpu_time() noexcept;
+	
+	/**
+	 * @brief play_out
+	 * 把抖动缓冲区里到了播放时间的视频帧交给解码器
+	 * 工作线程处理完一批包或者等待到下一帧的播放时间的时候调用
+	 * @return 
+	 * 下一帧的播放时间，没有缓冲的帧则返回TimePoint::max()
+	 */
+	core::Clock::TimePoint play_out() noexcept;
+	
+	/**
+	 * @brief check_decoder_error
+	 * 检查视频解码器是否出错，出错则请求关键帧
+	 * 只在发送线程取出关键帧请求之前调用
+	 */
+	void check_decoder_error() noexcept;
+private:
+	/**
+	 * @brief _get_player
+	 * 获取播放器，第一次使用时才创建
+	 * 没有设置过窗口的用户不会创建播放器，也就不会初始化SDL
+	 */
+	player::VideoPlayer * _get_player() noexcept;
+	
+	/**
+	 * @brief _accept_video
+	 * 联播的时候同一个用户有多个视频流，只接收选择的那一层
+	 * 接收的层改变的时候重置组帧、丢包检测和抖动缓冲区，两层的序列号和时间戳没有关系
+	 * 需要在_video_mutex内调用
+	 */
+	bool _accept_video(uint32_t ssrc) noexcept;
 private:
 	codec::VideoDecoder			_vdecoder;
 	codec::AudioDecoder			_adecoder;
-	player::VideoPlayer			_vplay;
+	player::VideoPlayer			*_vplay{nullptr};
+	std::mutex					_vplay_mutex;
 	fec::FECDecoder				_afecdecoder;
 	fec::FECDecoder				_vfecdecoder;
+	//视频流的丢包检测，音频包很小，丢了就丢了
+	RTPNackGenerator			_vnack;
+	//视频流的关键帧请求
+	RTPKeyFrameRequester		_vkeyframe;
+	//上一次检查时组帧无法恢复的帧数，在_video_mutex内使用
+	uint64_t					_vlost_frames{0};
+	//上一次检查时解码出错的次数，只在发送线程使用
+	uint64_t					_vdecoder_errors{0};
+	//视频帧的抖动缓冲区，音频帧直接解码
+	RTPJitterBuffer				_vjitter;
+	//多个工作线程都会调用play_out，保证交给解码器的顺序
+	std::mutex					_play_mutex;
+	//选择接收的联播层
+	std::atomic<uint8_t>		_video_layer{0};
+	//正在接收的联播层，-1表示还没有收到视频
+	int							_receiving_layer{-1};
+	//正在接收的视频流的ssrc，发送线程请求关键帧的时候使用
+	std::atomic<uint32_t>		_receiving_ssrc{0};
+	//不同层的ssrc可能在不同的工作线程处理，切换层的时候保证组帧不会被同时使用
+	std::mutex					_video_mutex;
 	
 	friend class RTPUserManager;
 };
 
+inline void RTPUser::set_video_layer(uint8_t layer) noexcept						{		_video_layer = layer;}
+inline uint8_t RTPUser::get_video_layer() noexcept									{		return _video_layer;}
+inline int64_t RTPUser::get_video_decoder_cpu_time() noexcept						{		return _vdecoder.get_thread_cpu_time();}
+
 } // rtp_network
 
 } // rtplivelib
@@ -1,4 +1,5 @@
 #include "rtpusermanager.h"
+#include "rtpcongestioncontroller.h"
 #include "jrtplib3/rtppacket.h"
 #include "jrtplib3/rtpsourcedata.h"
 #include "jrtplib3/rtpaddress.h"
@@ -10,14 +11,15 @@
 #include "jrtplib3/rtcpsdespacket.h"
 #include "jrtplib3/rtpipv4address.h"
 #include "../core/logger.h"
+#include <cstring>
+#include <algorithm>
 
 namespace rtplivelib{
 
 namespace rtp_network {
 
-RTPUserManager * RTPUserManager::_manager = nullptr;
-volatile uint32_t RTPUserManager::_local_video_ssrc = 0;
-volatile uint32_t RTPUserManager::_local_audio_ssrc = 0;
+//保存的重传请求的上限
+static constexpr size_t MAX_RESEND_REQUESTS = 1024;
 
 void RTPUserManager::deal_with_rtp(RTPPacket::SharedRTPPacket rtp_packet) noexcept
 {
@@ -53,36 +55,23 @@ void RTPUserManager::deal_with_rtcp(void *p) noexcept
 		switch(rtcp_packet->GetPacketType()){
 		case jrtplib::RTCPPacket::PacketType::SR:
 		{
-//			auto packet = static_cast<jrtplib::RTCPSRPacket*>(rtcp_packet);
-			//发送端报文先不解析，因为可能有多个发送端
-//			core::Logger::Info("SR: send[{}],recv[{}],lost[{}]",
-//							   api,
-//							   packet->GetSenderPacketCount(),
-//							   packet->GetFractionLost(packet-> GetReceptionReportCount() - 1 ),
-//							   packet->GetLostPacketCount(packet-> GetReceptionReportCount() - 1 ));
+			//推流的用户会发送SR，关于本地流的接收报告也在SR里面
+			auto packet = static_cast<jrtplib::RTCPSRPacket*>(rtcp_packet);
+			for(int n = 0; n < packet->GetReceptionReportCount(); ++n){
+				deal_with_report_block(packet->GetSenderSSRC(),packet->GetSSRC(n),packet->GetFractionLost(n),
+									   packet->GetLostPacketCount(n),packet->GetExtendedHighestSequenceNumber(n),
+									   packet->GetJitter(n),packet->GetLSR(n),packet->GetDLSR(n));
+			}
 			break;
 		}
 		case jrtplib::RTCPPacket::PacketType::RR:
 		{
 			auto packet = static_cast<jrtplib::RTCPRRPacket*>(rtcp_packet);
-			if(core::GlobalCallBack::Get_CallBack() == nullptr)
-				return;
-			packet->GetLSR(packet-> GetReceptionReportCount() - 1 );
-			const auto& fl = static_cast<float>(packet->GetFractionLost(packet-> GetReceptionReportCount() - 1 )) / 256.0f;
-			const auto& jitter = packet->GetJitter(packet-> GetReceptionReportCount() - 1 );
-			const auto& LSR = packet->GetLSR(packet-> GetReceptionReportCount() - 1 );
-			auto DLSR = packet->GetDLSR(packet-> GetReceptionReportCount() - 1 );
-			uint32_t rtt;
-			if( LSR == 0 || DLSR == 0)
-				rtt = 999999999;
-			{
-				const auto& recv_time = jrtplib::RTPTime::CurrentTime().GetNTPTime();
-				rtt = ( (recv_time.GetMSW() << 16) & 0xFFFF0000 ) | ( (recv_time.GetLSW() >> 16) & 0xFFFF );
-				rtt -= LSR;
-				rtt -= DLSR;
-				rtt = static_cast<uint32_t>( static_cast<double>(rtt) / 65536.0 * 1000);
+			for(int n = 0; n < packet->GetReceptionReportCount(); ++n){
+				deal_with_report_block(packet->GetSenderSSRC(),packet->GetSSRC(n),packet->GetFractionLost(n),
+									   packet->GetLostPacketCount(n),packet->GetExtendedHighestSequenceNumber(n),
+									   packet->GetJitter(n),packet->GetLSR(n),packet->GetDLSR(n));
 			}
-			core::GlobalCallBack::Get_CallBack()->on_local_network_information(jitter,fl,rtt);
 			break;
 		}
 		case jrtplib::RTCPPacket::PacketType::BYE:
@@ -104,8 +93,23 @@ void RTPUserManager::deal_with_rtcp(void *p) noexcept
 			}while(packet->GotoNextChunk());
 			break;
 		}
-		//不处理APP数据包
 		case jrtplib::RTCPPacket::PacketType::APP:
+		{
+			//目前只处理重传请求和关键帧请求
+			auto packet = static_cast<jrtplib::RTCPAPPPacket*>(rtcp_packet);
+			if(packet->GetSubType() == RTPSession::APPPacketType::RTP_APP_TYPE_NACK &&
+					memcmp(packet->GetName(),RTPNackGenerator::APP_NAME,4) == 0)
+				deal_with_nack(packet->GetAPPData(),packet->GetAPPDataLength());
+			else if(packet->GetSubType() == RTPSession::APPPacketType::RTP_APP_TYPE_PLI &&
+					memcmp(packet->GetName(),RTPKeyFrameRequester::PLI_NAME,4) == 0)
+				deal_with_key_frame_request(RTPKeyFrameRequester::PLI,
+											packet->GetAPPData(),packet->GetAPPDataLength());
+			else if(packet->GetSubType() == RTPSession::APPPacketType::RTP_APP_TYPE_FIR &&
+					memcmp(packet->GetName(),RTPKeyFrameRequester::FIR_NAME,4) == 0)
+				deal_with_key_frame_request(RTPKeyFrameRequester::FIR,
+											packet->GetAPPData(),packet->GetAPPDataLength());
+			break;
+		}
 		default:
 //				core::Logger::Info("unknown:[length:{}]",
 //								   api,
@@ -115,6 +119,131 @@ void RTPUserManager::deal_with_rtcp(void *p) noexcept
 	}
 }
 
+void RTPUserManager::deal_with_report_block(uint32_t reporter, uint32_t ssrc, uint8_t fraction_lost,
+											int32_t lost, uint32_t highest_seq,
+											uint32_t jitter, uint32_t lsr, uint32_t dlsr) noexcept
+{
+	//报告里面包含了对方收到的所有源，只关心本地视频流的报告
+	if(ssrc == 0 || ssrc != _local_video_ssrc)
+		return;
+	const auto fl = static_cast<float>(fraction_lost) / 256.0f;
+	//rtt = 当前NTP时间的中间32位 - LSR - DLSR，单位是1/65536秒
+	//对方还没收到过SR的时候LSR为0，无法计算
+	int64_t rtt{-1};
+	if(lsr != 0){
+		const auto& recv_time = jrtplib::RTPTime::CurrentTime().GetNTPTime();
+		uint32_t now = ( (recv_time.GetMSW() << 16) & 0xFFFF0000 ) | ( (recv_time.GetLSW() >> 16) & 0xFFFF );
+		uint32_t delay = now - lsr - dlsr;
+		//时钟误差可能导致结果为"负数"(溢出成很大的数)，这种情况丢弃
+		if(delay < 0x80000000u)
+			rtt = static_cast<int64_t>( static_cast<double>(delay) / 65536.0 * 1000);
+	}
+	if(_congestion != nullptr){
+		_congestion->on_receiver_report(reporter,fl,rtt);
+		_congestion->on_loss_report(reporter,lost,highest_seq);
+	}
+	if(get_callback() != nullptr)
+		get_callback()->on_local_network_information(jitter,fl,rtt < 0 ? 999999999u : static_cast<uint32_t>(rtt));
+}
+
+void RTPUserManager::get_nack_requests(std::vector<NackRequest> &output) noexcept
+{
+	output.clear();
+	auto index = _get_index();
+	if(index == nullptr)
+		return;
+	for(auto & user:index->users){
+		RTPNackGenerator::NackList list;
+		auto && ssrc = user->_vnack.get_nack_list(list);
+		if(!list.empty())
+			output.emplace_back(ssrc,std::move(list));
+	}
+}
+
+void RTPUserManager::take_resend_requests(RTPNackGenerator::NackList &output) noexcept
+{
+	output.clear();
+	std::lock_guard<std::mutex> lk(_nack_mutex);
+	output.swap(_resend_requests);
+}
+
+void RTPUserManager::get_key_frame_requests(std::vector<KeyFrameRequest> &output) noexcept
+{
+	output.clear();
+	auto index = _get_index();
+	if(index == nullptr)
+		return;
+	for(auto & user:index->users){
+		user->check_decoder_error();
+		uint32_t ssrc{0};
+		RTPKeyFrameRequester::Type type;
+		if(user->_vkeyframe.get_request(ssrc,type))
+			output.emplace_back(ssrc,type);
+	}
+}
+
+void RTPUserManager::set_key_frame_observer(KeyFrameObserver observer) noexcept
+{
+	std::lock_guard<std::mutex> lk(_nack_mutex);
+	_key_frame_observer = observer;
+}
+
+core::Clock::TimePoint RTPUserManager::play_out() noexcept
+{
+	auto next = core::Clock::TimePoint::max();
+	auto index = _get_index();
+	if(index == nullptr)
+		return next;
+	for(auto & user:index->users)
+		next = std::min(next,user->play_out());
+	return next;
+}
+
+void RTPUserManager::deal_with_nack(const void *data, size_t len) noexcept
+{
+	uint32_t ssrc{0};
+	RTPNackGenerator::NackList list;
+	if(!RTPNackGenerator::Unpack(data,len,ssrc,list))
+		return;
+	//请求的是别人的流，或者自己没有推流
+	if(ssrc == 0 || ssrc != _local_video_ssrc)
+		return;
+	std::lock_guard<std::mutex> lk(_nack_mutex);
+	//发送线程来不及处理的时候丢弃旧的请求，历史记录里面也早就没有了
+	if(_resend_requests.size() + list.size() > MAX_RESEND_REQUESTS)
+		_resend_requests.clear();
+	_resend_requests.insert(_resend_requests.end(),list.begin(),list.end());
+}
+
+void RTPUserManager::deal_with_key_frame_request(RTPKeyFrameRequester::Type type,
+												 const void *data, size_t len) noexcept
+{
+	uint32_t ssrc{0};
+	if(!RTPKeyFrameRequester::Unpack(data,len,ssrc) || ssrc == 0)
+		return;
+	//请求的是别人的流，或者自己没有推流
+	int layer = ssrc == _local_video_ssrc ? 0 : -1;
+	for(uint8_t n = 1; layer < 0 && n < fec::FECHeader::MAX_LAYERS; ++n){
+		if(_local_layer_ssrc[n] == ssrc)
+			layer = n;
+	}
+	if(layer < 0)
+		return;
+	core::Logger::Print("{} request key frame of layer {}",
+						__PRETTY_FUNCTION__,
+						LogLevel::MOREINFO_LEVEL,
+						type == RTPKeyFrameRequester::FIR ? "FIR" : "PLI",
+						layer);
+	KeyFrameObserver observer;
+	{
+		std::lock_guard<std::mutex> lk(_nack_mutex);
+		observer = _key_frame_observer;
+	}
+	//多个接收端同时请求的时候由编码器合并
+	if(observer)
+		observer(static_cast<uint8_t>(layer));
+}
+
 const std::list<std::string> RTPUserManager::get_all_users_name() noexcept
 {
 	std::list<std::string> list;
@@ -125,19 +254,24 @@ const std::list<std::string> RTPUserManager::get_all_users_name() noexcept
 	return list;
 }
 
-bool RTPUserManager::get_user(const std::string &name, RTPUserManager::User &user) noexcept
+int64_t RTPUserManager::get_video_decoder_cpu_time() noexcept
 {
-	if(get_user_count() == 0)
-		return false;
+	int64_t total{0};
 	std::lock_guard<std::mutex> lk(_mutex);
-	auto it = _user_list.begin();
-	for( ; it != _user_list.end(); ++it) {
-		if( (*it)->name == name ){
-			user = (*it);
-			return true;
-		}
+	for(auto & user:_user_list){
+		total += user->get_video_decoder_cpu_time();
 	}
-	return false;
+	return total;
+}
+
+bool RTPUserManager::get_user(const std::string &name, RTPUserManager::User &user) noexcept
+{
+	std::lock_guard<std::mutex> lk(_mutex);
+	auto it = _name_map.find(name);
+	if(it == _name_map.end())
+		return false;
+	user = it->second;
+	return true;
 }
 
 void RTPUserManager::set_decoder_hwd_type(const std::string &name,
@@ -153,7 +287,10 @@ void RTPUserManager::set_decoder_hwd_type(const std::string &name,
 void RTPUserManager::set_decoder_hwd_type(codec::HardwareDevice::HWDType type) noexcept
 {
 	_type = type;
-	for(auto i:_user_list){
+	auto index = _get_index();
+	if(index == nullptr)
+		return;
+	for(auto & i:index->users){
 		i->set_video_hwd_type(type);
 	}
 }
@@ -162,8 +299,10 @@ std::map<std::string, codec::HardwareDevice::HWDType>
 RTPUserManager::get_decoder_hwd_type() noexcept
 {
 	std::map<std::string, codec::HardwareDevice::HWDType> map;
-	
-	for(auto i:_user_list){
+	auto index = _get_index();
+	if(index == nullptr)
+		return map;
+	for(auto & i:index->users){
 		map[i->name] = i->_vdecoder.get_hwd_type();
 	}
 	
@@ -216,6 +355,45 @@ void RTPUserManager::set_screen_size(const std::string &name,
 	}
 }
 
+void RTPUserManager::set_frame_sink(const std::string &name,
+									core::AbstractQueue<core::FramePacket> *video_sink,
+									core::AbstractQueue<core::FramePacket> *audio_sink) noexcept
+{
+	//没进入房间不处理
+	if( _active == false)
+		return;
+	if(name.size() == 0)
+		return;
+	
+	User user(nullptr);
+	if(get_user(name,user) == true){
+		user->set_frame_sink(video_sink,audio_sink);
+	}
+}
+
+void RTPUserManager::set_video_layer(const std::string &name, uint8_t layer) noexcept
+{
+	User user(nullptr);
+	if(get_user(name,user) == true){
+		user->set_video_layer(layer);
+		_layer_changed = true;
+	}
+}
+
+bool RTPUserManager::get_layer_selection(RTPSession::LayerSelection &output) noexcept
+{
+	output.clear();
+	auto changed = _layer_changed.exchange(false);
+	auto index = _get_index();
+	if(index == nullptr)
+		return changed;
+	for(auto & user:index->users){
+		if(!user->name.empty())
+			output[user->name] = user->get_video_layer();
+	}
+	return changed;
+}
+
 RTPUserManager::RTPUserManager()
 {
 	
@@ -264,12 +442,32 @@ bool RTPUserManager::insert(uint32_t ssrc, const std::string &name) noexcept
 		return false;
 	}
 	
+	//ssrc改变了，收包路径需要看到新的用户列表
+	_publish_index();
+	
 	//这个是新添加的，而不是已存在的，所以需要回调一下
 	//这里说明一下，在获取到其中一个源的时候就开启回调了
 	//为了防止回调两次，所以在两个源都设置的时候不回调
 	if( user->ssrc == 0 || user->another_ssrc == 0)
-		if(core::GlobalCallBack::Get_CallBack() != nullptr)
-			core::GlobalCallBack::Get_CallBack()->on_new_user_join(name);
+		if(get_callback() != nullptr)
+			get_callback()->on_new_user_join(name);
+	return true;
+}
+
+bool RTPUserManager::insert_layer(uint32_t ssrc, const std::string &name, uint8_t layer) noexcept
+{
+	if( _active == false || layer == 0 || layer >= fec::FECHeader::MAX_LAYERS)
+		return false;
+	std::lock_guard<std::mutex> lk(_mutex);
+	//先收到其他层的SDES的时候不创建用户，等到第0层的ssrc加入之后的下一个rtcp包再添加
+	auto it = _name_map.find(name);
+	if(it == _name_map.end())
+		return false;
+	auto & user = it->second;
+	if(user->layer_ssrc[layer] == ssrc)
+		return true;
+	user->layer_ssrc[layer] = ssrc;
+	_publish_index();
 	return true;
 }
 
@@ -287,29 +485,30 @@ bool RTPUserManager::remove(uint32_t ssrc, const void *reason, const size_t &len
 	bool ret;
 	User user;
 	ret = find(ssrc,user);
+	//就算没有移除用户，也可能把其中一个ssrc置为0了
+	_publish_index();
 	if(ret == false){
 		//查找失败，应该是一开始并没有该元素
 		return false;
 	}
 	else {
 		//查找成功,并在find的时候移除了该元素
-		if(core::GlobalCallBack::Get_CallBack() != nullptr)
-			core::GlobalCallBack::Get_CallBack()->on_user_exit(user->name,reason,length);
+		if(get_callback() != nullptr)
+			get_callback()->on_user_exit(user->name,reason,length);
 		return true;
 	}
 }
 
 RTPUserManager::User RTPUserManager::find(const std::string &name) noexcept
 {
-	auto it = _user_list.begin();
-	for( ; it != _user_list.end(); ++it) {
-		if( (*it)->name == name )
-			return *it;
-	}
+	auto it = _name_map.find(name);
+	if(it != _name_map.end())
+		return it->second;
 	//找不到
 	User user(new RTPUser);
 	user->name = name;
 	_user_list.push_back(user);
+	_name_map[name] = user;
 	return user;
 }
 
@@ -327,8 +526,9 @@ bool RTPUserManager::find(const uint32_t & ssrc,User &user) noexcept
 										 (*it)->name.c_str());
 			auto i = it;
 			++it;
-			if(core::GlobalCallBack::Get_CallBack() != nullptr)
-				core::GlobalCallBack::Get_CallBack()->on_user_exit((*i)->name,nullptr,0);
+			if(get_callback() != nullptr)
+				get_callback()->on_user_exit((*i)->name,nullptr,0);
+			_name_map.erase((*i)->name);
 			_user_list.erase(i);
 			continue;
 		}
@@ -338,11 +538,16 @@ bool RTPUserManager::find(const uint32_t & ssrc,User &user) noexcept
 		if( (*it)->another_ssrc == ssrc){
 			(*it)->another_ssrc = 0;
 		}
+		for(auto & layer_ssrc:(*it)->layer_ssrc){
+			if(layer_ssrc == ssrc)
+				layer_ssrc = 0;
+		}
 		//操作完成后，两个源都为0则是要移除他了
 		if( (*it)->ssrc == 0 && (*it)->another_ssrc == 0){
 			//如果一开始就两个ssrc都是0，好像是有点问题的
 			//得记录一下
 			user = (*it);
+			_name_map.erase(user->name);
 			_user_list.erase(it);
 			return true;
 		}
@@ -354,17 +559,33 @@ bool RTPUserManager::find(const uint32_t & ssrc,User &user) noexcept
 
 bool RTPUserManager::get_user(const uint32_t & ssrc,User & user) noexcept 
 {
-	if(get_user_count() == 0)
+	//每个rtp包都会调用，读取快照，不加锁
+	auto index = _get_index();
+	if(index == nullptr)
 		return false;
-	std::lock_guard<std::mutex> lk(_mutex);
-	auto it = _user_list.begin();
-	for( ; it != _user_list.end(); ++it) {
-		if( (*it)->ssrc == ssrc || (*it)->another_ssrc == ssrc ){
-			user = (*it);
-			return true;
+	auto it = index->ssrc_map.find(ssrc);
+	if(it == index->ssrc_map.end())
+		return false;
+	user = it->second;
+	return true;
+}
+
+void RTPUserManager::_publish_index() noexcept
+{
+	auto index = std::make_shared<UserIndex>();
+	index->users.reserve(_user_list.size());
+	for(auto & user:_user_list){
+		index->users.push_back(user);
+		if(user->ssrc != 0)
+			index->ssrc_map[user->ssrc] = user;
+		if(user->another_ssrc != 0)
+			index->ssrc_map[user->another_ssrc] = user;
+		for(auto & layer_ssrc:user->layer_ssrc){
+			if(layer_ssrc != 0)
+				index->ssrc_map[layer_ssrc] = user;
 		}
 	}
-	return false;
+	std::atomic_store(&_index,SharedIndex(std::move(index)));
 }
 
 void RTPUserManager::deal_with_sdes(void *sdes) noexcept
@@ -376,6 +597,7 @@ void RTPUserManager::deal_with_sdes(void *sdes) noexcept
 	
 	auto && ssrc = packet->GetChunkSSRC();
 	std::string name,note;
+	uint8_t layer{0};
 	void * p;
 	
 	do{
@@ -392,6 +614,10 @@ void RTPUserManager::deal_with_sdes(void *sdes) noexcept
 		case jrtplib::RTCPSDESPacket::NOTE:
 			note.append(static_cast<char*>(p),packet->GetItemLength());
 			break;
+		case jrtplib::RTCPSDESPacket::TOOL:
+			//联播的其他层，见RTPSession::set_simulcast_layer
+			layer = RTPSession::Get_Simulcast_Layer(p,packet->GetItemLength());
+			break;
 		default:
 			//其他字段不关心
 			break;
@@ -401,7 +627,10 @@ void RTPUserManager::deal_with_sdes(void *sdes) noexcept
 	//只存在加入
 	if(name.size() < 1)
 		return;
-	insert(ssrc,name);
+	if(layer != 0)
+		insert_layer(ssrc,name,layer);
+	else
+		insert(ssrc,name);
 //	if( note.size() <= 1) {
 //		//房间值都为0了，就是没加入房间，也没推流，没必要继续处理
 //		//只有推流标志位也不行，也就是没有加入房间
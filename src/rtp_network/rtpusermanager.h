@@ -9,36 +9,49 @@
 #include "rtppacket.h"
 #include <mutex>
 #include <list>
-//#include <unordered_set>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
 #include <memory>
+#include <functional>
 
 namespace rtplivelib{
 
 namespace rtp_network {
 
+class RTPCongestionController;
+
 /**
  * @brief The RTPUserManager class
  * rtp会话用户管理
  * 用来管理发送源用户
  * 统一SSRC，用户名等信息
  * 由于要维护非推流用户太费资源，所以这里只统计推流用户
+ * 每个引擎(房间)拥有一个自己的用户管理器，由LiveEngine创建，
+ * 然后设置到收发线程，不再是全局唯一的
  */
-class RTPLIVELIBSHARED_EXPORT RTPUserManager
+class RTPLIVELIBSHARED_EXPORT RTPUserManager : public core::CallBackObject
 {
 public:
 	using User = std::shared_ptr<RTPUser>;
-public:
+	//需要发送的重传请求:媒体流的ssrc和丢失的序列号
+	using NackRequest = std::pair<uint32_t,RTPNackGenerator::NackList>;
+	//需要发送的关键帧请求:媒体流的ssrc和请求的类型
+	using KeyFrameRequest = std::pair<uint32_t,RTPKeyFrameRequester::Type>;
 	/**
-	 * @brief get_user_manager
-	 * 获取全局的用户管理器
+	 * @brief KeyFrameObserver
+	 * 其他用户请求本地视频流的关键帧时回调，参数是联播的层
+	 * 在接收线程回调，不能阻塞
 	 */
-	static RTPUserManager * Get_user_manager() noexcept;
+	using KeyFrameObserver = std::function<void(uint8_t)>;
+public:
+	RTPUserManager();
 	
-	/**
-	 * @brief Release
-	 * 析构全局的用户管理器
-	 */
-	static void Release() noexcept;
+	~RTPUserManager();
+	
+	RTPUserManager(const RTPUserManager&) = delete;
+	
+	RTPUserManager& operator = (const RTPUserManager&) = delete;
 	
 	/**
 	 * @brief clear_all
@@ -77,6 +90,13 @@ public:
 	 */
 	const std::list<std::string> get_all_users_name() noexcept;
 	
+	/**
+	 * @brief get_video_decoder_cpu_time
+	 * 获取所有用户的视频解码线程占用的CPU时间之和，单位纳秒
+	 * 已经退出的用户不再统计
+	 */
+	int64_t get_video_decoder_cpu_time() noexcept;
+	
 	/**
 	 * @brief get_user
 	 * 根据用户名获取user
@@ -91,8 +111,8 @@ public:
 	/**
 	 * 获取自己的音视频id,没开启会话则是0
 	 */
-	static uint32_t get_local_video_ssrc() noexcept;
-	static uint32_t get_local_audio_ssrc() noexcept;
+	uint32_t get_local_video_ssrc() noexcept;
+	uint32_t get_local_audio_ssrc() noexcept;
 	
 	/**
 	 * @brief set_decoder_hwd_type
@@ -154,11 +174,86 @@ public:
 	void set_screen_size(const std::string & name,
 						 const int &win_w,const int & win_h,
 						 const int & frame_w,const int & frame_h) noexcept;
-protected:
-	RTPUserManager();
 	
-	~RTPUserManager();
+	/**
+	 * @brief set_frame_sink
+	 * 设置该用户解码帧的输出队列，用于无界面模式
+	 * 可以在on_new_user_join回调里面设置
+	 * @param name
+	 * 用户名
+	 * @param video_sink
+	 * 视频帧输出队列，nullptr则不输出
+	 * @param audio_sink
+	 * 音频帧输出队列，nullptr则不输出
+	 */
+	void set_frame_sink(const std::string & name,
+						core::AbstractQueue<core::FramePacket> * video_sink,
+						core::AbstractQueue<core::FramePacket> * audio_sink) noexcept;
+	
+	/**
+	 * @brief set_video_layer
+	 * 选择该用户接收的联播(simulcast)层，0是原始分辨率
+	 * 显示缩略图的时候可以选择低分辨率的层，减少下行带宽和解码开销
+	 * 和set_frame_sink一样，在用户退出后或者没有加入的时候设置是不会生效的
+	 * 选择的层会通过rtcp告诉中继，中继只转发这一层(见get_layer_selection)
+	 */
+	void set_video_layer(const std::string & name,uint8_t layer) noexcept;
+	
+	/**
+	 * @brief get_layer_selection
+	 * 收集所有用户选择接收的联播层，由发送线程定时发送给中继
+	 * @param output
+	 * 原来的数据将会被擦除
+	 * @return 
+	 * 上一次调用之后选择改变过则返回true，需要立即发送
+	 */
+	bool get_layer_selection(RTPSession::LayerSelection & output) noexcept;
+	
+	/**
+	 * @brief set_congestion_controller
+	 * 设置拥塞控制器，收到关于本地视频流的接收报告时交给它估计带宽
+	 * 该类不拥有该对象的所有权
+	 */
+	void set_congestion_controller(RTPCongestionController * controller) noexcept;
+	
+	/**
+	 * @brief get_nack_requests
+	 * 收集所有用户的视频流需要请求重传的包，由发送线程定时调用后发送给推流端
+	 * @param output
+	 * 原来的数据将会被擦除，只包含有丢包的流
+	 */
+	void get_nack_requests(std::vector<NackRequest> & output) noexcept;
+	
+	/**
+	 * @brief take_resend_requests
+	 * 取出其他用户请求重传的本地视频流的序列号，由发送线程从历史记录中重传
+	 * @param output
+	 * 原来的数据将会被擦除
+	 */
+	void take_resend_requests(RTPNackGenerator::NackList & output) noexcept;
+	
+	/**
+	 * @brief get_key_frame_requests
+	 * 收集所有用户的视频流需要请求的关键帧，由发送线程定时调用后发送给推流端
+	 * @param output
+	 * 原来的数据将会被擦除
+	 */
+	void get_key_frame_requests(std::vector<KeyFrameRequest> & output) noexcept;
+	
+	/**
+	 * @brief set_key_frame_observer
+	 * 设置本地视频流被请求关键帧时的回调，一般是让编码器立即编码一个关键帧
+	 */
+	void set_key_frame_observer(KeyFrameObserver observer) noexcept;
 	
+	/**
+	 * @brief play_out
+	 * 把所有用户的抖动缓冲区里到了播放时间的帧交给解码器
+	 * @return 
+	 * 最早的下一帧播放时间，工作线程据此决定等待多久
+	 */
+	core::Clock::TimePoint play_out() noexcept;
+protected:
 	/**
 	 * @brief insert
 	 * 添加ssrc,然后设置用户名
@@ -172,6 +267,17 @@ protected:
 	 */
 	bool insert(uint32_t ssrc,const std::string& name) noexcept;
 	
+	/**
+	 * @brief insert_layer
+	 * 添加联播的其他层的ssrc，用户需要已经存在
+	 * 这些ssrc不影响用户的加入和退出
+	 * @param layer
+	 * 联播的层，大于0
+	 * @return 
+	 * 用户不存在或者层超出范围则返回false
+	 */
+	bool insert_layer(uint32_t ssrc,const std::string& name,uint8_t layer) noexcept;
+	
 	/**
 	 * @brief remove
 	 * 移除ssrc源，当一个用户的两个源都被移除后，该用户判定是退出会话
@@ -222,41 +328,105 @@ protected:
 	 */
 	void deal_with_sdes(void * sdes) noexcept;
 	
+	/**
+	 * @brief deal_with_report_block
+	 * 处理SR/RR里面的一个接收报告块
+	 * @param reporter
+	 * 发送该报告的源
+	 * @param ssrc
+	 * 报告所描述的源，只处理本地视频源
+	 * @param fraction_lost
+	 * 丢包率，单位是1/256
+	 * @param lost
+	 * 累计丢包数
+	 * @param highest_seq
+	 * 收到的最大扩展序列号
+	 * @param jitter
+	 * 抖动
+	 * @param lsr
+	 * 对方最后收到的SR的时间(NTP时间的中间32位)
+	 * @param dlsr
+	 * 对方从收到SR到发送该报告的时间间隔，单位是1/65536秒
+	 */
+	void deal_with_report_block(uint32_t reporter,uint32_t ssrc,uint8_t fraction_lost,
+								int32_t lost,uint32_t highest_seq,
+								uint32_t jitter,uint32_t lsr,uint32_t dlsr) noexcept;
+	
+	/**
+	 * @brief deal_with_nack
+	 * 处理重传请求的APP包，只保存关于本地视频流的请求
+	 */
+	void deal_with_nack(const void * data,size_t len) noexcept;
+	
+	/**
+	 * @brief deal_with_key_frame_request
+	 * 处理PLI/FIR的APP包，只处理关于本地视频流(包括联播的其他层)的请求
+	 */
+	void deal_with_key_frame_request(RTPKeyFrameRequester::Type type,const void * data,size_t len) noexcept;
+	
 	/**
 	 * @brief set_active
 	 * 设置进入房间的标志
 	 */
 	void set_active(bool flag) noexcept;
 private:
-	static RTPUserManager			*_manager;
-	static volatile uint32_t		_local_video_ssrc;
-	static volatile uint32_t		_local_audio_ssrc;
-	//考虑使用unordered_set,查找比list更快速
+	/**
+	 * @brief The UserIndex struct
+	 * 用户列表的只读快照，收包路径上不加锁读取
+	 * 用户列表改变的时候(加入、退出、ssrc改变)在锁内重新生成，然后原子地替换，
+	 * 旧的快照在最后一个读者释放后自动销毁(RCU的做法)
+	 */
+	struct UserIndex{
+		//每个用户的两个ssrc以及联播的其他层的ssrc都指向该用户
+		std::unordered_map<uint32_t,User>	ssrc_map;
+		std::vector<User>					users;
+	};
+	using SharedIndex = std::shared_ptr<const UserIndex>;
+	
+	/**
+	 * @brief _publish_index
+	 * 根据当前的用户列表重新生成快照，调用前需要锁住_mutex
+	 */
+	void _publish_index() noexcept;
+	
+	/**
+	 * @brief _get_index
+	 * 获取当前的快照，不需要加锁
+	 */
+	SharedIndex _get_index() noexcept;
+private:
+	volatile uint32_t				_local_video_ssrc{0};
+	volatile uint32_t				_local_audio_ssrc{0};
+	//本地联播的其他层的视频ssrc，下标是层，第0个不使用
+	volatile uint32_t				_local_layer_ssrc[fec::FECHeader::MAX_LAYERS]{0};
+	//用户列表，保持加入的顺序，修改的时候需要锁住_mutex
 	std::list<User>					_user_list;
+	//用户名索引，和_user_list同步修改
+	std::unordered_map<std::string,User>	_name_map;
 	std::mutex						_mutex;
+	//用户列表的快照，通过std::atomic_load/atomic_store读写
+	SharedIndex						_index;
 	//判断自己是否进入房间
-	volatile bool					_active;
+	volatile bool					_active{false};
 	//全局的硬解方案
 	codec::HardwareDevice::HWDType	_type{codec::HardwareDevice::Auto};
+	//拥塞控制器，由外部设置
+	RTPCongestionController			*_congestion{nullptr};
+	//其他用户请求重传的序列号，接收线程写入，发送线程取出
+	std::mutex						_nack_mutex;
+	RTPNackGenerator::NackList		_resend_requests;
+	//本地视频流被请求关键帧的回调，使用_nack_mutex保护
+	KeyFrameObserver				_key_frame_observer;
+	//选择接收的联播层改变了，还没有发送给中继
+	std::atomic<bool>				_layer_changed{false};
 	
 	friend class RTPSendThread;
 	friend class RtpSendThreadPrivateData;
 };
 
-inline RTPUserManager * RTPUserManager::Get_user_manager() noexcept				{
-	if(_manager == nullptr){
-		_manager = new RTPUserManager;
-	}
-	return _manager;
-}
-inline void RTPUserManager::Release() noexcept									{
-	if(_manager != nullptr){
-		delete _manager;
-		_manager = nullptr;
-	}
-}
 inline size_t RTPUserManager::get_user_count() noexcept							{
-	return _user_list.size();
+	auto index = _get_index();
+	return index == nullptr ? 0 : index->users.size();
 }
 inline uint32_t RTPUserManager::get_local_video_ssrc() noexcept					{
 	return _local_video_ssrc;
@@ -265,6 +435,9 @@ inline uint32_t RTPUserManager::get_local_audio_ssrc() noexcept					{
 	return _local_audio_ssrc;
 }
 
+inline void RTPUserManager::set_congestion_controller(RTPCongestionController *controller) noexcept	{
+	_congestion = controller;
+}
 inline codec::HardwareDevice::HWDType 
 RTPUserManager::get_global_hwd_type() noexcept									{
 	return _type;
@@ -272,6 +445,11 @@ RTPUserManager::get_global_hwd_type() noexcept									{
 inline void RTPUserManager::clear_all() noexcept								{
 	std::lock_guard<std::mutex> lk(_mutex);
 	_user_list.clear();
+	_name_map.clear();
+	_publish_index();
+}
+inline RTPUserManager::SharedIndex RTPUserManager::_get_index() noexcept			{
+	return std::atomic_load(&_index);
 }
 inline void RTPUserManager::set_active(bool flag) noexcept						{
 	_active = flag;
@@ -0,0 +1,87 @@
+
+#include "rtp_network/rtpbatchtransmitter.h"
+#include "rtp_network/rtpsession.h"
+#include "jrtplib3/rtprawpacket.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#if defined (unix)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+/**
+ * 用于测试音视频共用一个socket(bundle)时传输器的分流
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+#if defined (unix)
+
+static constexpr uint16_t BUNDLE_PORT = 34700;
+
+/**
+ * 只有rtp固定头部的包
+ */
+static std::vector<uint8_t> make_rtp(uint8_t pt,uint32_t ssrc){
+	std::vector<uint8_t> data(12,0);
+	data[0] = 0x80;
+	data[1] = pt;
+	data[8] = static_cast<uint8_t>(ssrc >> 24);
+	data[9] = static_cast<uint8_t>(ssrc >> 16);
+	data[10] = static_cast<uint8_t>(ssrc >> 8);
+	data[11] = static_cast<uint8_t>(ssrc);
+	return data;
+}
+
+TEST(RTPBatchTransmitter,demuxer){
+	jrtplib::RTPUDPv4TransmissionParams params;
+	params.SetRTCPMultiplexing(true);
+	params.SetPortbase(BUNDLE_PORT);
+	RTPBatchTransmitter transmitter(nullptr);
+	//音频负载类型的包交给其他会话
+	std::vector<uint32_t> demuxed;
+	transmitter.set_demuxer([&demuxed](jrtplib::RTPRawPacket & packet){
+		if(!packet.IsRTP() || (packet.GetData()[1] & 0x7F) != RTPSession::RTP_PT_AAC)
+			return false;
+		demuxed.push_back(packet.GetDataLength());
+		return true;
+	});
+	ASSERT_GE(transmitter.Init(true),0);
+	ASSERT_GE(transmitter.Create(4096,&params),0);
+
+	int fd = socket(AF_INET,SOCK_DGRAM,0);
+	sockaddr_in addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(BUNDLE_PORT);
+	//视频、音频、视频，然后是一个空的接收报告
+	std::vector<std::vector<uint8_t>> packets{make_rtp(RTPSession::RTP_PT_HEVC,1),
+											  make_rtp(RTPSession::RTP_PT_AAC,2),
+											  make_rtp(RTPSession::RTP_PT_HEVC,1),
+											  {0x80,201,0,1,0,0,0,2}};
+	for(auto & packet : packets)
+		sendto(fd,packet.data(),packet.size(),0,reinterpret_cast<sockaddr*>(&addr),sizeof(addr));
+
+	std::vector<bool> rtp;
+	for(int n = 0; n < 50 && rtp.size() + demuxed.size() < packets.size(); ++n){
+		bool available{false};
+		transmitter.WaitForIncomingData(jrtplib::RTPTime(0,10000),&available);
+		transmitter.Poll();
+		jrtplib::RTPRawPacket * raw{nullptr};
+		while( (raw = transmitter.GetNextPacket()) != nullptr ){
+			rtp.push_back(raw->IsRTP());
+			delete raw;
+		}
+	}
+	close(fd);
+	transmitter.Destroy();
+
+	ASSERT_EQ(demuxed.size(),1u);
+	//rtcp包不是音频负载类型，依旧由该传输器处理
+	ASSERT_EQ(rtp,std::vector<bool>({true,true,false}));
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "core/clock.h"
+
+/**
+ * @brief The ScopedVirtualClock class
+ * 测试用的模拟时钟，构造的时候注册为全局时钟，析构的时候恢复系统时钟
+ * 断言失败提前返回的时候也会恢复，不会留下指向已经销毁的时钟的指针
+ */
+class ScopedVirtualClock : public rtplivelib::core::VirtualClock
+{
+public:
+	ScopedVirtualClock() noexcept {
+		rtplivelib::core::Clock::Register_Clock(this);
+	}
+
+	~ScopedVirtualClock() override {
+		rtplivelib::core::Clock::Register_Clock(nullptr);
+	}
+
+	ScopedVirtualClock(const ScopedVirtualClock &) = delete;
+	ScopedVirtualClock & operator=(const ScopedVirtualClock &) = delete;
+};
@@ -0,0 +1,73 @@
+
+#include "core/clock.h"
+#include "core/frameclock.h"
+#include "core/abstractqueue.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+/**
+ * 用于测试模拟时钟以及基于时钟的帧节拍
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::core;
+
+TEST(VirtualClock,advance){
+	VirtualClock clock;
+	auto start = clock.now();
+	clock.advance(std::chrono::seconds(5));
+	ASSERT_EQ(clock.now() - start,std::chrono::seconds(5));
+	//时间不会倒退
+	clock.advance_to(start);
+	ASSERT_EQ(clock.now() - start,std::chrono::seconds(5));
+
+	bool wake{false};
+	std::thread t([&](){
+		clock.sleep_for(std::chrono::seconds(1));
+		wake = true;
+	});
+	while(clock.get_waiting_count() == 0)
+		std::this_thread::yield();
+	ASSERT_FALSE(wake);
+	clock.advance(std::chrono::seconds(1));
+	t.join();
+	ASSERT_TRUE(wake);
+}
+
+TEST(VirtualClock,auto_advance){
+	ScopedVirtualClock clock;
+	clock.set_participants(1);
+	auto start = clock.now();
+	//只有一个参与者，睡眠时时钟直接跳到截止时间
+	clock.sleep_for(std::chrono::hours(1));
+	ASSERT_EQ(clock.now() - start,std::chrono::hours(1));
+
+	//队列等待也是按照模拟时间超时
+	AbstractQueue<int> queue;
+	auto real_start = std::chrono::steady_clock::now();
+	ASSERT_FALSE(queue.wait_for_resource_push(60 * 1000));
+	ASSERT_LT(std::chrono::steady_clock::now() - real_start,std::chrono::seconds(10));
+	ASSERT_EQ(clock.now() - start,std::chrono::hours(1) + std::chrono::minutes(1));
+}
+
+TEST(FrameClock,pacing){
+	ScopedVirtualClock clock;
+	clock.set_participants(1);
+
+	FrameClock frame_clock(25);
+	frame_clock.start(1000);
+	auto start = clock.now();
+	for(int i = 0;i < 100; ++i){
+		ASSERT_EQ(frame_clock.wait_next_frame(),0);
+	}
+	ASSERT_EQ(frame_clock.get_frame_index(),100);
+	ASSERT_EQ(frame_clock.get_pts(),1000 + 4000000);
+	ASSERT_EQ(clock.now() - start,std::chrono::seconds(4));
+
+	//处理耗时超过一秒，跳过错过的帧
+	clock.advance(std::chrono::seconds(1));
+	ASSERT_EQ(frame_clock.wait_next_frame(),24);
+	ASSERT_EQ(frame_clock.get_overrun_count(),24u);
+	ASSERT_EQ(frame_clock.get_pts(),1000 + 5000000);
+}
@@ -0,0 +1,127 @@
+
+#include "core/clock.h"
+#include "rtp_network/rtpcongestioncontroller.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试拥塞控制是否根据丢包和延迟调整码率
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::core;
+using namespace rtplivelib::rtp_network;
+
+TEST(RTPCongestionController,loss){
+	ScopedVirtualClock clock;
+	
+	RTPCongestionController controller(1000000);
+	uint64_t observed{0};
+	controller.set_observer([&](uint64_t bitrate){ observed = bitrate;});
+	
+	//网络良好，码率慢慢增加
+	for(int n = 0;n < 10; ++n){
+		controller.on_receiver_report(1,0,50);
+		clock.advance(std::chrono::seconds(1));
+	}
+	auto good = controller.get_target_bitrate();
+	ASSERT_GT(good,1500000u);
+	ASSERT_EQ(observed,good);
+	
+	//丢包率20%，码率下降10%
+	controller.on_receiver_report(1,0.2f,50);
+	ASSERT_LT(controller.get_target_bitrate(),good * 0.91);
+	
+	//丢包率在2%到10%之间，码率保持不变
+	auto hold = controller.get_target_bitrate();
+	clock.advance(std::chrono::seconds(1));
+	controller.on_receiver_report(1,0.05f,50);
+	ASSERT_EQ(controller.get_target_bitrate(),hold);
+	
+	//限制码率的范围
+	controller.set_bitrate_range(100000,500000);
+	ASSERT_EQ(controller.get_target_bitrate(),500000u);
+	ASSERT_EQ(observed,500000u);
+}
+
+TEST(RTPCongestionController,delay){
+	ScopedVirtualClock clock;
+	
+	RTPCongestionController controller(1000000);
+	//没有丢包，但是rtt一直在增长，说明网络队列在堆积
+	int64_t rtt = 50;
+	for(int n = 0;n < 5; ++n){
+		controller.on_receiver_report(1,0,rtt);
+		clock.advance(std::chrono::seconds(1));
+		rtt += 30;
+	}
+	ASSERT_EQ(controller.get_delay_state(),RTPCongestionController::Overuse);
+	ASSERT_LT(controller.get_target_bitrate(),1000000u);
+	
+	//rtt回落，不再判断为过载
+	auto low = controller.get_target_bitrate();
+	for(int n = 0;n < 5; ++n){
+		rtt = 50;
+		controller.on_receiver_report(1,0,rtt);
+		clock.advance(std::chrono::seconds(1));
+	}
+	ASSERT_NE(controller.get_delay_state(),RTPCongestionController::Overuse);
+	ASSERT_GE(controller.get_target_bitrate(),low);
+}
+
+TEST(RTPCongestionController,receivers){
+	ScopedVirtualClock clock;
+	
+	RTPCongestionController controller(1000000);
+	//远近不同的两个接收端交替报告，各自的rtt都很稳定，不是过载
+	for(int n = 0;n < 20; ++n){
+		controller.on_receiver_report(1,0,20);
+		controller.on_receiver_report(2,0,200);
+		clock.advance(std::chrono::milliseconds(500));
+	}
+	ASSERT_EQ(controller.get_delay_state(),RTPCongestionController::Normal);
+	ASSERT_GT(controller.get_target_bitrate(),1000000u);
+	
+	//只有远的接收端rtt在增长，以它为准
+	auto good = controller.get_target_bitrate();
+	int64_t rtt = 200;
+	for(int n = 0;n < 5; ++n){
+		controller.on_receiver_report(1,0,20);
+		controller.on_receiver_report(3,0,rtt);
+		clock.advance(std::chrono::seconds(1));
+		rtt += 30;
+	}
+	ASSERT_LT(controller.get_target_bitrate(),good);
+}
+
+TEST(RTPCongestionController,burst){
+	RTPCongestionController controller;
+	//每个间隔1000个包，平均丢20个
+	//随机丢包的时候每个间隔的丢包数都差不多
+	int32_t lost{0};
+	uint32_t seq{0};
+	controller.on_loss_report(1,lost,seq);
+	for(int n = 0;n < 16; ++n){
+		seq += 1000;
+		lost += 20 + (n % 2 == 0 ? 3 : -3);
+		controller.on_loss_report(1,lost,seq);
+	}
+	ASSERT_LT(controller.get_burst_length(),1.5f);
+	
+	//突发丢包的时候丢包集中在少数几个间隔
+	controller.reset();
+	lost = 0;
+	controller.on_loss_report(1,lost,seq);
+	for(int n = 0;n < 16; ++n){
+		seq += 1000;
+		lost += n % 4 == 0 ? 80 : 0;
+		controller.on_loss_report(1,lost,seq);
+	}
+	ASSERT_GT(controller.get_burst_length(),3.0f);
+	
+	//丢包率增加时立即跟随，减少时缓慢下降
+	controller.on_receiver_report(1,0.2f,-1);
+	ASSERT_FLOAT_EQ(controller.get_loss_rate(),0.2f);
+	controller.on_receiver_report(1,0,-1);
+	ASSERT_GT(controller.get_loss_rate(),0.1f);
+}
@@ -75,3 +75,27 @@ using namespace rtplivelib::rtp_network::fec;
 //        write_file("./debug/1.txt",pack.second,src_nb,size);
 //    }
 //}
+
+TEST(FECEncoder,redundancy){
+	FECEncoder encoder;
+	//没有丢包的时候使用最小冗余比例
+	encoder.set_loss_statistics(0,1);
+	ASSERT_EQ(encoder.get_repair_count(100,false),5u + 1);
+	
+	//丢包率10%的随机丢包，冗余包数量要比平均丢包数多
+	encoder.set_loss_statistics(0.1f,1);
+	auto random = encoder.get_repair_count(100,false);
+	ASSERT_GT(random,10u);
+	//关键帧冗余包更多
+	ASSERT_GT(encoder.get_repair_count(100,true),random);
+	
+	//同样的丢包率，突发丢包需要更多的冗余包
+	encoder.set_loss_statistics(0.1f,4);
+	ASSERT_GT(encoder.get_repair_count(100,false),random);
+	
+	//不超过最大冗余比例
+	encoder.set_redundancy_range(0.05f,0.2f);
+	encoder.set_loss_statistics(0.5f,4);
+	ASSERT_EQ(encoder.get_repair_count(100,false),20u + 1);
+	ASSERT_GE(encoder.get_code_rate(),0.79f);
+}
@@ -0,0 +1,88 @@
+
+#include "rtp_network/fec/fecdecoder.h"
+#include "rtp_network/fec/fecheader.h"
+#include "rtp_network/rtpsession.h"
+#include "jrtplib3/rtppacket.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试NAL模式下不完整的帧等待重传和按照顺序输出
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+using namespace rtplivelib::rtp_network::fec;
+
+static constexpr int32_t SYMBOL_SIZE = 100;
+
+/**
+ * 一个没有FEC编码的NAL模式的包，负载是一个H.264的slice
+ */
+static RTPPacket::SharedRTPPacket make_packet(uint32_t ts,uint32_t seq,uint16_t pos,int32_t src_nb){
+	FECParam param;
+	param.nal = 1;
+	param.symbol_size = SYMBOL_SIZE;
+	param.size = src_nb * SYMBOL_SIZE;
+	const uint8_t nal[] = {0x41,0x9A,static_cast<uint8_t>(pos),0x10,0x20};
+	uint8_t payload[FECHeader::MAX_SIZE + sizeof(nal)];
+	auto n = FECHeader::Pack(param,pos,sizeof(nal),payload);
+	memcpy(payload + n,nal,sizeof(nal));
+	auto packet = new jrtplib::RTPPacket(RTPSession::RTP_PT_H264,payload,n + sizeof(nal),
+										 static_cast<uint16_t>(seq),ts,1,false,0,nullptr,
+										 false,0,0,nullptr,1400);
+	packet->SetExtendedSequenceNumber(seq);
+	return RTPPacket::Make_Shared(packet,nullptr);
+}
+
+static std::vector<uint32_t> get_frames(FECDecoder & decoder){
+	std::vector<uint32_t> frames;
+	core::FramePacket::SharedPacket frame;
+	while( (frame = decoder.get_packet()) != nullptr )
+		frames.push_back(static_cast<uint32_t>(frame->pts));
+	return frames;
+}
+
+TEST(FECDecoder,retransmission){
+	ScopedVirtualClock clock;
+	FECDecoder decoder;
+	//第一帧丢了一个包，第二帧完整，但是要等第一帧
+	ASSERT_EQ(decoder.decode(make_packet(1000,10,0,2)),core::Result::FEC_Decode_Need_More);
+	ASSERT_EQ(decoder.decode(make_packet(4000,12,0,1)),core::Result::FEC_Decode_Need_More);
+	ASSERT_TRUE(get_frames(decoder).empty());
+
+	//重传的包在截止时间之前到达，两帧按照顺序输出
+	clock.advance(std::chrono::milliseconds(FECDecoder::DEFAULT_MAX_WAIT_MS - 10));
+	ASSERT_EQ(decoder.decode(make_packet(1000,11,1,2)),core::Result::Success);
+	ASSERT_EQ(get_frames(decoder),std::vector<uint32_t>({1000,4000}));
+	ASSERT_EQ(decoder.get_lost_frame_count(),0u);
+	ASSERT_EQ(decoder.get_output_sequence(),12u);
+
+	//已经输出的帧的包来得太晚
+	ASSERT_EQ(decoder.decode(make_packet(1000,11,1,2)),core::Result::FEC_Decode_Failed);
+}
+
+TEST(FECDecoder,deadline){
+	ScopedVirtualClock clock;
+	FECDecoder decoder;
+	ASSERT_EQ(decoder.decode(make_packet(1000,10,0,2)),core::Result::FEC_Decode_Need_More);
+	ASSERT_EQ(decoder.decode(make_packet(4000,12,0,1)),core::Result::FEC_Decode_Need_More);
+
+	//到了截止时间，下一个包到来的时候输出不完整的帧
+	clock.advance(std::chrono::milliseconds(FECDecoder::DEFAULT_MAX_WAIT_MS));
+	ASSERT_EQ(decoder.decode(make_packet(7000,13,0,2)),core::Result::Success);
+	ASSERT_EQ(get_frames(decoder),std::vector<uint32_t>({1000,4000}));
+	ASSERT_EQ(decoder.get_lost_frame_count(),1u);
+	ASSERT_EQ(decoder.get_output_sequence(),12u);
+	ASSERT_EQ(decoder.decode(make_packet(1000,11,1,2)),core::Result::FEC_Decode_Failed);
+}
+
+TEST(FECDecoder,wrap){
+	ScopedVirtualClock clock;
+	FECDecoder decoder;
+	//时间戳翻转前后的两帧，翻转之前的帧依旧先输出
+	ASSERT_EQ(decoder.decode(make_packet(0xFFFFF000,10,0,2)),core::Result::FEC_Decode_Need_More);
+	ASSERT_EQ(decoder.decode(make_packet(0x800,12,0,1)),core::Result::FEC_Decode_Need_More);
+	ASSERT_EQ(decoder.decode(make_packet(0xFFFFF000,11,1,2)),core::Result::Success);
+	ASSERT_EQ(get_frames(decoder),std::vector<uint32_t>({0xFFFFF000,0x800}));
+}
@@ -0,0 +1,111 @@
+
+#include "rtp_network/fec/fecheader.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试FEC负载头部的打包和解析
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network::fec;
+
+TEST(FECHeader,pack){
+	uint8_t buffer[FECHeader::MAX_SIZE + 1200];
+	FECParam param;
+	param.size = 30000;
+	param.symbol_size = 1200;
+	param.repair_nb = 3;
+	param.flag = 1;
+
+	//普通的包，块大小就是负载大小
+	auto n = FECHeader::Pack(param,300,1200,buffer);
+	ASSERT_EQ(n,6u);
+	FECParam output;
+	uint16_t pos{0};
+	ASSERT_EQ(FECHeader::Unpack(buffer,n + 1200,output,pos),n);
+	ASSERT_EQ(pos,300);
+	ASSERT_EQ(output.flag,1);
+	ASSERT_EQ(output.size,30000);
+	ASSERT_EQ(output.symbol_size,1200);
+
+	//最后一个源数据包比块大小小，需要带上块大小
+	n = FECHeader::Pack(param,24,0,buffer);
+	ASSERT_EQ(FECHeader::Unpack(buffer,n,output,pos),n);
+	ASSERT_EQ(pos,24);
+	ASSERT_EQ(output.symbol_size,1200);
+
+	//整帧只有一个包
+	param.size = 100;
+	param.flag = 0;
+	ASSERT_EQ(FECHeader::Pack(param,0,100,buffer),1u);
+	ASSERT_EQ(FECHeader::Unpack(buffer,101,output,pos),1u);
+	ASSERT_EQ(pos,0);
+	ASSERT_EQ(output.flag,0);
+	ASSERT_EQ(output.size,100);
+
+	//版本不对或者数据不完整
+	n = FECHeader::Pack(param,1,100,buffer);
+	ASSERT_EQ(FECHeader::Unpack(buffer,n - 1,output,pos),0u);
+	buffer[0] ^= 0xC0;
+	ASSERT_EQ(FECHeader::Unpack(buffer,n + 100,output,pos),0u);
+}
+
+TEST(FECHeader,layer){
+	uint8_t buffer[FECHeader::MAX_SIZE];
+	FECParam param;
+	param.size = 100;
+	param.layer = 2;
+	FECParam output;
+	uint16_t pos{0};
+
+	//整帧只有一个包的时候也要带上层
+	ASSERT_EQ(FECHeader::Pack(param,0,100,buffer),1u);
+	ASSERT_EQ(FECHeader::Unpack(buffer,101,output,pos),1u);
+	ASSERT_EQ(output.layer,2);
+
+	param.size = 30000;
+	param.symbol_size = 1200;
+	param.flag = 1;
+	param.layer = FECHeader::MAX_LAYERS - 1;
+	auto n = FECHeader::Pack(param,7,1200,buffer);
+	ASSERT_EQ(FECHeader::Unpack(buffer,n + 1200,output,pos),n);
+	ASSERT_EQ(output.layer,FECHeader::MAX_LAYERS - 1);
+	ASSERT_EQ(output.size,30000);
+	ASSERT_EQ(pos,7);
+}
+
+TEST(FECHeader,varint){
+	uint8_t buffer[FECHeader::MAX_SIZE];
+	FECParam param;
+	param.size = 300;
+	param.symbol_size = 1200;
+	param.flag = 1;
+	auto n = FECHeader::Pack(param,0,1200,buffer);
+	ASSERT_EQ(n,4u);
+	FECParam output;
+	uint16_t pos{0};
+
+	//把帧大小换成5个字节的INT32_MAX，块大小是最大的65495，后面是100字节的负载
+	uint8_t header[10 + 100] = {static_cast<uint8_t>(buffer[0] | 0x10),0x00,
+								0xFF,0xFF,0xFF,0xFF,0x07,0xD7,0xFF,0x03};
+	ASSERT_EQ(FECHeader::Unpack(header,sizeof(header),output,pos),10u);
+	ASSERT_EQ(output.size,INT32_MAX);
+	ASSERT_EQ(output.symbol_size,FECHeader::MAX_SYMBOL_SIZE);
+
+	//第5个字节超出32位的高位不能被忽略
+	header[6] = 0x17;
+	ASSERT_EQ(FECHeader::Unpack(header,sizeof(header),output,pos),0u);
+	header[6] = 0x07;
+
+	//块大小超出rtp负载
+	header[9] = 0x04;
+	ASSERT_EQ(FECHeader::Unpack(header,sizeof(header),output,pos),0u);
+
+	//没有块大小字段，块大小是负载长度(100)，源数据包数量超出16位的位置
+	uint8_t small[7 + 100] = {buffer[0],0x00,0xFF,0xFF,0xFF,0xFF,0x07};
+	ASSERT_EQ(FECHeader::Unpack(small,sizeof(small),output,pos),0u);
+	//刚好65536个源数据包
+	uint8_t limit[6 + 100] = {buffer[0],0x00,0x80,0x80,0x90,0x03};
+	ASSERT_EQ(FECHeader::Unpack(limit,sizeof(limit),output,pos),6u);
+	ASSERT_EQ(output.get_src_nb(),FECHeader::MAX_SOURCE_NB);
+}
@@ -0,0 +1,86 @@
+
+#include "core/clock.h"
+#include "rtp_network/rtpjitterbuffer.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试接收端的抖动缓冲区
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::core;
+using namespace rtplivelib::rtp_network;
+
+static RTPJitterBuffer::Frame make_frame(int64_t pts){
+	auto frame = FramePacket::Make_Shared();
+	frame->pts = frame->dts = pts;
+	return frame;
+}
+
+TEST(RTPJitterBuffer,order){
+	ScopedVirtualClock clock;
+
+	RTPJitterBuffer buffer;
+	buffer.set_delay_range(20,500);
+	//第2帧比第1帧先完成
+	ASSERT_TRUE(buffer.push(10,make_frame(10)));
+	ASSERT_TRUE(buffer.push(30,make_frame(30)));
+	ASSERT_TRUE(buffer.push(20,make_frame(20)));
+	//还没到播放时间
+	ASSERT_EQ(buffer.pop(),nullptr);
+	clock.advance(std::chrono::milliseconds(20));
+	for(int64_t pts : {10,20,30}){
+		auto frame = buffer.pop();
+		ASSERT_NE(frame,nullptr);
+		ASSERT_EQ(frame->pts,pts);
+	}
+	ASSERT_EQ(buffer.get_next_playout_time(),RTPJitterBuffer::TimePoint::max());
+	//已经播放过的帧来得太晚，丢弃
+	ASSERT_FALSE(buffer.push(25,make_frame(25)));
+	ASSERT_EQ(buffer.get_late_count(),1u);
+	
+	//时间戳翻转后依旧是递增的
+	buffer.reset();
+	ASSERT_TRUE(buffer.push(0x10,make_frame(2)));
+	ASSERT_TRUE(buffer.push(0xFFFFFFF0u,make_frame(1)));
+	clock.advance(std::chrono::milliseconds(20));
+	ASSERT_EQ(buffer.pop()->pts,1);
+	ASSERT_EQ(buffer.pop()->pts,2);
+}
+
+TEST(RTPJitterBuffer,adapt){
+	ScopedVirtualClock clock;
+
+	//90kHz，每帧40ms，前一半的帧准时到达，后一半的帧每隔一帧晚到30ms
+	constexpr int frame_count = 200;
+	RTPJitterBuffer buffer(90000);
+	buffer.set_delay_range(0,500);
+	auto start = clock.now();
+	int pushed = 0;
+	std::vector<int64_t> playout;
+	for(int ms = 0; pushed < frame_count || buffer.size() > 0; ++ms){
+		while(pushed < frame_count){
+			auto arrival = pushed * 40 + (pushed >= frame_count / 2 && pushed % 2 ? 30 : 0);
+			if(arrival > ms)
+				break;
+			ASSERT_TRUE(buffer.push(static_cast<uint32_t>(pushed * 3600),make_frame(pushed)));
+			++pushed;
+			if(pushed == frame_count / 2){
+				//没有抖动，目标延迟保持最小
+				ASSERT_LT(buffer.get_target_delay(),1);
+			}
+		}
+		while(buffer.pop() != nullptr)
+			playout.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(clock.now() - start).count());
+		clock.advance(std::chrono::milliseconds(1));
+	}
+	ASSERT_EQ(playout.size(),static_cast<size_t>(frame_count));
+	ASSERT_GT(buffer.get_jitter(),10);
+	ASSERT_GT(buffer.get_target_delay(),30);
+	//目标延迟稳定之后，晚到的帧也按照均匀的间隔播放
+	for(size_t n = frame_count * 3 / 4; n < playout.size(); ++n){
+		ASSERT_GE(playout[n] - playout[n - 1],39);
+		ASSERT_LE(playout[n] - playout[n - 1],41);
+	}
+}
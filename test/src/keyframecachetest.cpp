@@ -0,0 +1,136 @@
+
+#include "rtp_network/rtpkeyframecache.h"
+#include "rtp_network/rtpsession.h"
+#include "rtp_network/fec/fecheader.h"
+#include "jrtplib3/rtprawpacket.h"
+#include "jrtplib3/rtpipv4address.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试转发服务器的关键帧缓存
+ * 包按照发送端NAL模式的格式构造:rtp头部 + FEC头部 + H.264负载
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+using SharedRawPacket = RTPKeyFrameCache::SharedRawPacket;
+
+static constexpr uint32_t SYMBOL_SIZE = 1000;
+
+/**
+ * 构造一帧中的一个包
+ * @param nal_type
+ * H.264的NAL类型，5是IDR，1是普通的slice
+ */
+static SharedRawPacket make_packet(uint32_t ssrc,uint16_t seq,uint32_t timestamp,
+								   uint16_t pos,uint16_t src_nb,uint8_t nal_type){
+	fec::FECParam param;
+	param.nal = 1;
+	param.symbol_size = SYMBOL_SIZE;
+	param.size = static_cast<int32_t>(src_nb * SYMBOL_SIZE);
+	std::vector<uint8_t> payload(100,0xAA);
+	payload[0] = static_cast<uint8_t>(0x60 | nal_type);
+
+	std::vector<uint8_t> data{0x80,RTPSession::PayloadType::RTP_PT_H264};
+	if(pos + 1 == src_nb)
+		data[1] |= 0x80;
+	data.push_back(static_cast<uint8_t>(seq >> 8));
+	data.push_back(static_cast<uint8_t>(seq));
+	for(auto value : {timestamp,ssrc})
+		for(int shift = 24; shift >= 0; shift -= 8)
+			data.push_back(static_cast<uint8_t>(value >> shift));
+	uint8_t header[fec::FECHeader::MAX_SIZE];
+	auto n = fec::FECHeader::Pack(param,pos,static_cast<uint32_t>(payload.size()),header);
+	data.insert(data.end(),header,header + n);
+	data.insert(data.end(),payload.begin(),payload.end());
+
+	//rtp包释放的时候会释放数据和地址
+	auto buffer = new uint8_t[data.size()];
+	std::copy(data.begin(),data.end(),buffer);
+	jrtplib::RTPTime time(0);
+	auto raw = new jrtplib::RTPRawPacket(buffer,data.size(),new jrtplib::RTPIPv4Address(0x7F000001,5000),
+										 time,true);
+	return SharedRawPacket(raw);
+}
+
+/**
+ * 放入一整帧，skip是不放入的包的位置
+ */
+static void put_frame(RTPKeyFrameCache & cache,uint32_t ssrc,uint16_t & seq,uint32_t timestamp,
+					  uint16_t src_nb,uint8_t nal_type,int skip = -1){
+	for(uint16_t pos = 0; pos < src_nb; ++pos,++seq){
+		if(pos != skip)
+			cache.put(make_packet(ssrc,seq,timestamp,pos,src_nb,nal_type));
+	}
+}
+
+TEST(RTPKeyFrameCache,gop){
+	RTPKeyFrameCache cache;
+	std::vector<SharedRawPacket> output;
+	uint16_t seq{0};
+
+	//没有关键帧的时候不缓存
+	put_frame(cache,1,seq,100,2,1);
+	put_frame(cache,1,seq,200,2,1);
+	ASSERT_FALSE(cache.has_key_frame());
+	ASSERT_FALSE(cache.get(output));
+
+	//完整的关键帧加上后面的帧
+	put_frame(cache,1,seq,300,3,5);
+	ASSERT_TRUE(cache.has_key_frame());
+	ASSERT_TRUE(cache.get(output));
+	ASSERT_EQ(output.size(),3u);
+	put_frame(cache,1,seq,400,2,1);
+	put_frame(cache,1,seq,500,2,1);
+	output.clear();
+	ASSERT_TRUE(cache.get(output));
+	ASSERT_EQ(output.size(),7u);
+
+	//重复的包不缓存，旧的帧重传的包追加到后面
+	cache.put(make_packet(1,seq - 1,500,1,2,1));
+	cache.put(make_packet(1,seq - 3,400,1,2,1));
+	output.clear();
+	ASSERT_TRUE(cache.get(output));
+	ASSERT_EQ(output.size(),8u);
+
+	//新的关键帧代替原来的GOP
+	put_frame(cache,1,seq,600,2,5);
+	put_frame(cache,1,seq,700,2,1);
+	output.clear();
+	ASSERT_TRUE(cache.get(output));
+	ASSERT_EQ(output.size(),4u);
+	ASSERT_EQ(cache.get_size(),output.size() * output.front()->GetDataLength());
+
+	//不完整的关键帧清空缓存
+	put_frame(cache,1,seq,800,3,5,1);
+	put_frame(cache,1,seq,900,2,1);
+	ASSERT_FALSE(cache.has_key_frame());
+
+	//ssrc变化清空缓存
+	put_frame(cache,1,seq,1000,2,5);
+	ASSERT_TRUE(cache.has_key_frame());
+	put_frame(cache,2,seq,1100,2,1);
+	ASSERT_FALSE(cache.has_key_frame());
+	output.clear();
+	ASSERT_FALSE(cache.get(output));
+	ASSERT_TRUE(output.empty());
+}
+
+TEST(RTPKeyFrameCache,limit){
+	//每个包大约120字节，最多缓存10个包
+	RTPKeyFrameCache cache(1200);
+	std::vector<SharedRawPacket> output;
+	uint16_t seq{0};
+	put_frame(cache,1,seq,100,4,5);
+	put_frame(cache,1,seq,200,4,1);
+	ASSERT_TRUE(cache.get(output));
+	ASSERT_EQ(output.size(),8u);
+	//GOP太长则放弃，等待下一个关键帧
+	put_frame(cache,1,seq,300,4,1);
+	put_frame(cache,1,seq,400,4,1);
+	ASSERT_FALSE(cache.has_key_frame());
+	ASSERT_LE(cache.get_size(),1200u);
+	put_frame(cache,1,seq,500,4,5);
+	ASSERT_TRUE(cache.has_key_frame());
+}
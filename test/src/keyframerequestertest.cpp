@@ -0,0 +1,101 @@
+
+#include "core/clock.h"
+#include "rtp_network/rtpkeyframerequester.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试接收端的关键帧请求(PLI/FIR)
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::core;
+using namespace rtplivelib::rtp_network;
+
+TEST(RTPKeyFrameRequester,pack){
+	std::vector<uint8_t> data;
+	RTPKeyFrameRequester::Pack(0x12345678,data);
+	ASSERT_EQ(data.size(),4u);
+
+	uint32_t ssrc{0};
+	ASSERT_TRUE(RTPKeyFrameRequester::Unpack(data.data(),data.size(),ssrc));
+	ASSERT_EQ(ssrc,0x12345678u);
+	ASSERT_FALSE(RTPKeyFrameRequester::Unpack(data.data(),3,ssrc));
+}
+
+TEST(RTPKeyFrameRequester,debounce){
+	ScopedVirtualClock clock;
+
+	RTPKeyFrameRequester requester;
+	uint32_t ssrc{0};
+	RTPKeyFrameRequester::Type type;
+	ASSERT_FALSE(requester.get_request(ssrc,type));
+
+	//连续丢失多帧只请求一次
+	requester.on_frame_lost(1);
+	requester.on_frame_lost(1);
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+	ASSERT_EQ(ssrc,1u);
+	ASSERT_EQ(type,RTPKeyFrameRequester::PLI);
+	ASSERT_FALSE(requester.get_request(ssrc,type));
+
+	//间隔之内不会重复请求，关键帧没到则每隔一段时间重发(请求的包或者关键帧可能丢失了)
+	requester.on_frame_lost(1);
+	ASSERT_FALSE(requester.get_request(ssrc,type));
+	clock.advance(std::chrono::milliseconds(RTPKeyFrameRequester::RETRY_INTERVAL_MS));
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+	clock.advance(std::chrono::milliseconds(RTPKeyFrameRequester::RETRY_INTERVAL_MS));
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+
+	//关键帧到了，之前的请求作废
+	requester.on_key_frame(1);
+	clock.advance(std::chrono::milliseconds(RTPKeyFrameRequester::RETRY_INTERVAL_MS));
+	ASSERT_FALSE(requester.get_request(ssrc,type));
+}
+
+TEST(RTPKeyFrameRequester,fir){
+	ScopedVirtualClock clock;
+
+	RTPKeyFrameRequester requester;
+	uint32_t ssrc{0};
+	RTPKeyFrameRequester::Type type;
+	requester.on_frame_lost(1);
+	requester.on_stream_start(1);
+	requester.on_frame_lost(1);
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+	ASSERT_EQ(type,RTPKeyFrameRequester::FIR);
+
+	//切换到新的流，不受之前的请求间隔限制
+	requester.on_stream_start(2);
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+	ASSERT_EQ(ssrc,2u);
+	ASSERT_EQ(type,RTPKeyFrameRequester::FIR);
+
+	//旧的流的关键帧不会取消新的流的请求，FIR一直重发到新的流的关键帧到达
+	requester.on_key_frame(1);
+	clock.advance(std::chrono::milliseconds(RTPKeyFrameRequester::RETRY_INTERVAL_MS));
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+	ASSERT_EQ(ssrc,2u);
+	ASSERT_EQ(type,RTPKeyFrameRequester::FIR);
+	requester.on_key_frame(2);
+	clock.advance(std::chrono::milliseconds(RTPKeyFrameRequester::RETRY_INTERVAL_MS));
+	ASSERT_FALSE(requester.get_request(ssrc,type));
+}
+
+TEST(RTPKeyFrameRequester,decode_error){
+	ScopedVirtualClock clock;
+
+	RTPKeyFrameRequester requester;
+	uint32_t ssrc{0};
+	RTPKeyFrameRequester::Type type;
+	//关键帧之前的帧还在解码，出错不需要请求
+	requester.on_key_frame(1);
+	requester.on_decode_error(1);
+	ASSERT_FALSE(requester.get_request(ssrc,type));
+
+	clock.advance(std::chrono::milliseconds(RTPKeyFrameRequester::DECODE_ERROR_GRACE_MS));
+	requester.on_decode_error(1);
+	ASSERT_TRUE(requester.get_request(ssrc,type));
+	ASSERT_EQ(ssrc,1u);
+	ASSERT_EQ(type,RTPKeyFrameRequester::PLI);
+}
@@ -0,0 +1,61 @@
+
+#include "rtp_network/rtpmediaclock.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试发送端的媒体时钟
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+TEST(RTPMediaClock,video){
+	//pts单位微秒
+	RTPMediaClock clock(RTPMediaClock::VIDEO_CLOCK_RATE,1000000);
+	ASSERT_EQ(clock.next_frame(5000000,6000),0u);
+	//15帧，帧间隔66666微秒
+	int64_t pts = 5000000;
+	for(int n = 1; n <= 15; ++n){
+		pts += 66666;
+		clock.next_frame(pts,6000);
+	}
+	//按照pts换算，而不是默认时长
+	ASSERT_EQ(clock.get_timestamp(),89999);
+
+	//pts回退，按照默认时长递增，并以该帧作为新的起点
+	ASSERT_EQ(clock.next_frame(0,6000),6000u);
+	ASSERT_EQ(clock.next_frame(33333,6000),2999u);
+	//同一个pts不会得到同一个时间戳
+	ASSERT_EQ(clock.next_frame(33333,6000),6000u);
+	//跳变太大
+	ASSERT_EQ(clock.next_frame(100000000,6000),6000u);
+}
+
+TEST(RTPMediaClock,decode_order){
+	//I0 P2 B1 P4 B3 ...，B帧的pts回退不会让时钟重新选择起点，时间戳不会越来越快
+	RTPMediaClock clock(RTPMediaClock::VIDEO_CLOCK_RATE,1000000);
+	ASSERT_EQ(clock.next_frame(0,6000),0u);
+	int64_t max_pts = 0;
+	for(int n = 1; n < 60; ++n){
+		auto index = n % 2 == 1 ? n + 1 : n - 1;
+		auto pts = index * 66666;
+		max_pts = std::max<int64_t>(max_pts,pts);
+		ASSERT_GT(clock.next_frame(pts,6000),0u);
+		//最多比最大的pts对应的时间戳多一帧
+		auto expected = max_pts * 90000 / 1000000;
+		ASSERT_GE(clock.get_timestamp(),expected);
+		ASSERT_LE(clock.get_timestamp(),expected + 6000);
+	}
+}
+
+TEST(RTPMediaClock,audio){
+	//pts不可用，按照采样数递增
+	RTPMediaClock clock(44100,0);
+	ASSERT_EQ(clock.next_frame(123,1024),0u);
+	ASSERT_EQ(clock.next_frame(-1,1024),1024u);
+	ASSERT_EQ(clock.next_frame(0,1024),1024u);
+	ASSERT_EQ(clock.get_timestamp(),2048);
+	clock.set_clock_rate(48000,0);
+	ASSERT_EQ(clock.next_frame(0,1024),0u);
+	ASSERT_EQ(clock.get_timestamp(),0);
+}
@@ -0,0 +1,78 @@
+
+#include "rtp_network/rtpmemorypool.h"
+#include "rtp_network/rtppacket.h"
+#include "jrtplib3/rtppacket.h"
+#include "jrtplib3/rtprawpacket.h"
+#include <gtest/gtest.h>
+#include <vector>
+#include <cstring>
+
+/**
+ * 用于测试jrtplib使用的内存池
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+TEST(RTPMemoryPool,reuse){
+	RTPMemoryPool pool;
+	std::vector<void *> buffers;
+	//第一轮需要向系统申请slab
+	for(int n = 0; n < 100; ++n)
+		buffers.push_back(pool.AllocateBuffer(static_cast<size_t>(n * 13),RTPMEM_TYPE_BUFFER_RECEIVEDRTPPACKET));
+	for(auto buffer : buffers){
+		ASSERT_NE(buffer,nullptr);
+		ASSERT_EQ(reinterpret_cast<uintptr_t>(buffer) % alignof(std::max_align_t),0u);
+		pool.FreeBuffer(buffer);
+	}
+	auto warm = pool.get_statistics();
+	ASSERT_GT(warm.system_allocations,0u);
+
+	//稳定之后不再向系统申请内存
+	for(int round = 0; round < 10; ++round){
+		buffers.clear();
+		for(int n = 0; n < 100; ++n)
+			buffers.push_back(pool.AllocateBuffer(static_cast<size_t>(n * 13),RTPMEM_TYPE_BUFFER_RECEIVEDRTPPACKET));
+		for(auto buffer : buffers)
+			pool.FreeBuffer(buffer);
+	}
+	auto statistics = pool.get_statistics();
+	ASSERT_EQ(statistics.system_allocations,warm.system_allocations);
+	ASSERT_EQ(statistics.slab_bytes,warm.slab_bytes);
+	ASSERT_EQ(statistics.allocations,warm.allocations + 1000);
+}
+
+TEST(RTPMemoryPool,large){
+	RTPMemoryPool pool;
+	auto buffer = static_cast<uint8_t *>(pool.AllocateBuffer(RTPMemoryPool::MAX_BLOCK_SIZE * 4,RTPMEM_TYPE_OTHER));
+	ASSERT_NE(buffer,nullptr);
+	buffer[RTPMemoryPool::MAX_BLOCK_SIZE * 4 - 1] = 1;
+	pool.FreeBuffer(buffer);
+	pool.FreeBuffer(nullptr);
+	auto statistics = pool.get_statistics();
+	ASSERT_EQ(statistics.system_allocations,1u);
+	ASSERT_EQ(statistics.slab_bytes,0u);
+}
+
+TEST(RTPMemoryPool,packet){
+	auto pool = std::make_shared<RTPMemoryPool>();
+	std::weak_ptr<RTPMemoryPool> weak = pool;
+	auto data = static_cast<uint8_t *>(pool->AllocateBuffer(12,RTPMEM_TYPE_BUFFER_RECEIVEDRTPPACKET));
+	memset(data,0,12);
+	data[0] = 0x80;
+	jrtplib::RTPTime time(0,0);
+	auto raw = RTPNew(pool.get(),RTPMEM_TYPE_CLASS_RTPRAWPACKET)
+			   jrtplib::RTPRawPacket(data,12,nullptr,time,true,pool.get());
+	auto packet = RTPNew(pool.get(),RTPMEM_TYPE_CLASS_RTPPACKET) jrtplib::RTPPacket(*raw,pool.get());
+	RTPDelete(raw,pool.get());
+	ASSERT_EQ(packet->GetCreationError(),0);
+
+	//包装对象和控制块也从内存池分配，并且持有内存池的引用
+	auto shared = RTPPacket::Make_Shared(packet,nullptr,pool);
+	auto allocations = pool->get_statistics().allocations;
+	pool.reset();
+	ASSERT_FALSE(weak.expired());
+	shared.reset();
+	ASSERT_TRUE(weak.expired());
+	ASSERT_GT(allocations,3u);
+}
@@ -0,0 +1,107 @@
+
+#include "core/clock.h"
+#include "rtp_network/rtpnackgenerator.h"
+#include "rtp_network/rtppackethistory.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试NACK重传:接收端的丢包检测和发送端的历史记录
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::core;
+using namespace rtplivelib::rtp_network;
+
+using NackList = RTPNackGenerator::NackList;
+
+TEST(RTPNackGenerator,pack){
+	//跨越序列号翻转，并且超过一个条目的范围
+	NackList list{65534,65535,0,3,16,40};
+	std::vector<uint8_t> data;
+	RTPNackGenerator::Pack(0x12345678,list,data);
+	//ssrc + 3个条目
+	ASSERT_EQ(data.size(),16u);
+
+	uint32_t ssrc{0};
+	NackList output;
+	ASSERT_TRUE(RTPNackGenerator::Unpack(data.data(),data.size(),ssrc,output));
+	ASSERT_EQ(ssrc,0x12345678u);
+	ASSERT_EQ(output,list);
+
+	ASSERT_FALSE(RTPNackGenerator::Unpack(data.data(),data.size() - 1,ssrc,output));
+	ASSERT_FALSE(RTPNackGenerator::Unpack(data.data(),4,ssrc,output));
+}
+
+TEST(RTPNackGenerator,retry){
+	ScopedVirtualClock clock;
+
+	RTPNackGenerator nack;
+	NackList list;
+	nack.on_packet(1,100);
+	nack.on_packet(1,101);
+	//丢失了102~104
+	nack.on_packet(1,105);
+	//还在等待乱序的包
+	nack.get_nack_list(list);
+	ASSERT_TRUE(list.empty());
+	//103乱序到达
+	nack.on_packet(1,103);
+
+	clock.advance(std::chrono::milliseconds(RTPNackGenerator::REORDER_DELAY_MS));
+	ASSERT_EQ(nack.get_nack_list(list),1u);
+	ASSERT_EQ(list,(NackList{102,104}));
+	//还没到重试的时间
+	nack.get_nack_list(list);
+	ASSERT_TRUE(list.empty());
+
+	//重传的102到达
+	nack.on_packet(1,102);
+	clock.advance(std::chrono::milliseconds(RTPNackGenerator::RETRY_INTERVAL_MS));
+	nack.get_nack_list(list);
+	ASSERT_EQ(list,(NackList{104}));
+
+	//超过重试次数后放弃
+	for(int n = 2; n < RTPNackGenerator::MAX_RETRIES; ++n){
+		clock.advance(std::chrono::milliseconds(RTPNackGenerator::RETRY_INTERVAL_MS));
+		nack.get_nack_list(list);
+		ASSERT_EQ(list,(NackList{104}));
+	}
+	clock.advance(std::chrono::milliseconds(RTPNackGenerator::RETRY_INTERVAL_MS));
+	nack.get_nack_list(list);
+	ASSERT_TRUE(list.empty());
+
+	//帧已经通过FEC恢复，之前的丢包不再请求
+	nack.on_packet(1,110);
+	nack.on_frame_complete(110);
+	clock.advance(std::chrono::milliseconds(RTPNackGenerator::REORDER_DELAY_MS));
+	nack.get_nack_list(list);
+	ASSERT_TRUE(list.empty());
+}
+
+TEST(RTPPacketHistory,resend){
+	ScopedVirtualClock clock;
+
+	RTPPacketHistory history(16);
+	uint8_t packet[20]{0x80,96};
+	for(uint16_t seq = 0; seq < 20; ++seq){
+		packet[2] = static_cast<uint8_t>(seq >> 8);
+		packet[3] = static_cast<uint8_t>(seq);
+		history.put(packet,sizeof(packet));
+	}
+	std::vector<uint8_t> output;
+	auto interval = std::chrono::milliseconds(20);
+	//已经被覆盖
+	ASSERT_FALSE(history.get_for_resend(3,output,interval));
+	ASSERT_TRUE(history.get_for_resend(19,output,interval));
+	ASSERT_EQ(output.size(),sizeof(packet));
+	ASSERT_EQ(output[3],19);
+	//一个间隔内只重传一次
+	ASSERT_FALSE(history.get_for_resend(19,output,interval));
+	clock.advance(interval);
+	ASSERT_TRUE(history.get_for_resend(19,output,interval));
+	ASSERT_EQ(history.get_resend_count(),2u);
+	//太旧的包不再重传
+	clock.advance(std::chrono::milliseconds(RTPPacketHistory::MAX_AGE_MS + 1));
+	ASSERT_FALSE(history.get_for_resend(18,output,interval));
+}
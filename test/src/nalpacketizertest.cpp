@@ -0,0 +1,107 @@
+
+#include "rtp_network/rtpnalpacketizer.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试H.264/HEVC按照NAL单元分包和组包
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+using Payloads = std::vector<std::vector<uint8_t>>;
+
+static void append_nal(std::vector<uint8_t> & frame,std::vector<uint8_t> header,size_t size){
+	static const uint8_t start_code[4] = {0,0,0,1};
+	frame.insert(frame.end(),start_code,start_code + 4);
+	frame.insert(frame.end(),header.begin(),header.end());
+	for(size_t n = 0; n < size; ++n)
+		frame.push_back(static_cast<uint8_t>(n % 251 + 1));
+}
+
+static std::vector<RTPNalPacketizer::Payload> to_payloads(const Payloads & packets){
+	std::vector<RTPNalPacketizer::Payload> payloads;
+	for(auto & packet:packets)
+		payloads.emplace_back(packet.data(),packet.size());
+	return payloads;
+}
+
+TEST(RTPNalPacketizer,h264){
+	//SPS、PPS、IDR(需要分片)、非IDR的slice
+	std::vector<uint8_t> frame;
+	append_nal(frame,{0x67},20);
+	append_nal(frame,{0x68},4);
+	append_nal(frame,{0x65},2500);
+	append_nal(frame,{0x41},300);
+
+	Payloads packets;
+	RTPNalPacketizer::Packetize(RTPNalPacketizer::H264,frame.data(),frame.size(),1000,packets);
+	//STAP-A + 3个FU-A + 单NAL单元
+	ASSERT_EQ(packets.size(),5u);
+	ASSERT_EQ(packets[0][0] & 0x1F,24);
+	ASSERT_EQ(packets[1][0] & 0x1F,28);
+	ASSERT_EQ(packets[1][1],0x80 | 0x05);
+	ASSERT_EQ(packets[3][1],0x40 | 0x05);
+	ASSERT_EQ(packets[4][0],0x41);
+	for(auto & packet:packets)
+		ASSERT_LE(packet.size(),1000u);
+
+	std::vector<uint8_t> output;
+	auto payloads = to_payloads(packets);
+	ASSERT_EQ(RTPNalPacketizer::Depacketize(RTPNalPacketizer::H264,payloads,output),4u);
+	ASSERT_EQ(output,frame);
+
+	//丢失一个分片，只丢弃这个NAL单元
+	payloads[2] = RTPNalPacketizer::Payload(nullptr,0);
+	ASSERT_EQ(RTPNalPacketizer::Depacketize(RTPNalPacketizer::H264,payloads,output),3u);
+	std::vector<uint8_t> expect;
+	append_nal(expect,{0x67},20);
+	append_nal(expect,{0x68},4);
+	append_nal(expect,{0x41},300);
+	ASSERT_EQ(output,expect);
+}
+
+TEST(RTPNalPacketizer,hevc){
+	//VPS、SPS、PPS、IDR
+	std::vector<uint8_t> frame;
+	append_nal(frame,{0x40,0x01},20);
+	append_nal(frame,{0x42,0x01},30);
+	append_nal(frame,{0x44,0x01},5);
+	append_nal(frame,{0x26,0x01},1500);
+
+	Payloads packets;
+	RTPNalPacketizer::Packetize(RTPNalPacketizer::HEVC,frame.data(),frame.size(),1000,packets);
+	//AP + 2个FU
+	ASSERT_EQ(packets.size(),3u);
+	ASSERT_EQ((packets[0][0] >> 1) & 0x3F,48);
+	ASSERT_EQ((packets[1][0] >> 1) & 0x3F,49);
+	ASSERT_EQ(packets[1][2],0x80 | 19);
+
+	std::vector<uint8_t> output;
+	ASSERT_EQ(RTPNalPacketizer::Depacketize(RTPNalPacketizer::HEVC,to_payloads(packets),output),4u);
+	ASSERT_EQ(output,frame);
+}
+
+TEST(RTPNalPacketizer,key_payload){
+	//关键帧:STAP-A(SPS+PPS)、IDR的FU-A分片，普通帧:单NAL单元
+	std::vector<uint8_t> frame;
+	append_nal(frame,{0x67},20);
+	append_nal(frame,{0x68},4);
+	append_nal(frame,{0x65},2500);
+	Payloads packets;
+	RTPNalPacketizer::Packetize(RTPNalPacketizer::H264,frame.data(),frame.size(),1000,packets);
+	for(auto & packet:packets)
+		ASSERT_TRUE(RTPNalPacketizer::Is_Key_Payload(RTPNalPacketizer::H264,packet.data(),packet.size()));
+	frame.clear();
+	append_nal(frame,{0x41},2500);
+	RTPNalPacketizer::Packetize(RTPNalPacketizer::H264,frame.data(),frame.size(),1000,packets);
+	for(auto & packet:packets)
+		ASSERT_FALSE(RTPNalPacketizer::Is_Key_Payload(RTPNalPacketizer::H264,packet.data(),packet.size()));
+
+	//HEVC的IDR_W_RADL(19)和TRAIL_R(1)
+	uint8_t idr[] = {0x26,0x01,0xAA};
+	uint8_t trail[] = {0x02,0x01,0xAA};
+	ASSERT_TRUE(RTPNalPacketizer::Is_Key_Payload(RTPNalPacketizer::HEVC,idr,sizeof(idr)));
+	ASSERT_FALSE(RTPNalPacketizer::Is_Key_Payload(RTPNalPacketizer::HEVC,trail,sizeof(trail)));
+	ASSERT_FALSE(RTPNalPacketizer::Is_Key_Payload(RTPNalPacketizer::HEVC,nullptr,0));
+}
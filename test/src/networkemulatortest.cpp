@@ -0,0 +1,128 @@
+
+#include "rtp_network/rtpnetworkemulator.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试网络损伤模拟的丢包、延迟、乱序和带宽限制
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+using namespace std::chrono;
+
+using TimePoint = RTPNetworkEmulator::TimePoint;
+
+/**
+ * 每隔1ms发送一个包，返回每个包是否丢失
+ */
+static std::vector<bool> send_packets(RTPNetworkEmulator & emulator,int count){
+	std::vector<bool> lost;
+	std::vector<TimePoint> release;
+	TimePoint now;
+	for(int n = 0; n < count; ++n){
+		lost.push_back(emulator.process(1000,now,release) == 0);
+		now += milliseconds(1);
+	}
+	return lost;
+}
+
+TEST(RTPNetworkEmulator,none){
+	RTPNetworkEmulator emulator;
+	std::vector<TimePoint> release;
+	TimePoint now(seconds(1));
+	for(int n = 0; n < 100; ++n){
+		ASSERT_EQ(emulator.process(1200,now,release),1u);
+		ASSERT_TRUE(release[0] == now);
+	}
+	ASSERT_EQ(emulator.get_statistics().packets,100u);
+	ASSERT_EQ(emulator.get_statistics().lost,0u);
+}
+
+TEST(RTPNetworkEmulator,loss){
+	RTPNetworkEmulator::Params params;
+	params.loss_rate = 0.1;
+	params.seed = 7;
+	RTPNetworkEmulator emulator(params);
+	auto lost = send_packets(emulator,10000);
+	auto count = emulator.get_statistics().lost;
+	ASSERT_GE(count,850u);
+	ASSERT_LE(count,1150u);
+
+	//同样的种子得到同样的结果
+	emulator.reset();
+	ASSERT_EQ(send_packets(emulator,10000),lost);
+	params.seed = 8;
+	emulator.set_params(params);
+	ASSERT_NE(send_packets(emulator,10000),lost);
+}
+
+TEST(RTPNetworkEmulator,burst){
+	//平均丢包率p/(p+r)约为4%，平均突发长度1/r为4
+	RTPNetworkEmulator::Params params;
+	params.burst_enter = 0.01;
+	params.burst_exit = 0.25;
+	RTPNetworkEmulator emulator(params);
+	auto lost = send_packets(emulator,100000);
+	size_t bursts{0},total{0};
+	for(size_t n = 0; n < lost.size(); ++n){
+		if(!lost[n])
+			continue;
+		++total;
+		if(n == 0 || !lost[n - 1])
+			++bursts;
+	}
+	ASSERT_GT(bursts,0u);
+	auto rate = static_cast<double>(total) / lost.size();
+	auto length = static_cast<double>(total) / bursts;
+	ASSERT_GT(rate,0.03);
+	ASSERT_LT(rate,0.05);
+	ASSERT_GT(length,3.5);
+	ASSERT_LT(length,4.5);
+}
+
+TEST(RTPNetworkEmulator,delay){
+	RTPNetworkEmulator::Params params;
+	params.delay_ms = 50;
+	params.jitter_ms = 10;
+	params.reorder_rate = 0.2;
+	RTPNetworkEmulator emulator(params);
+	std::vector<TimePoint> release;
+	TimePoint now,last;
+	bool reordered{false};
+	for(int n = 0; n < 1000; ++n){
+		ASSERT_EQ(emulator.process(1000,now,release),1u);
+		auto delay = duration_cast<milliseconds>(release[0] - now).count();
+		ASSERT_GE(delay,40);
+		ASSERT_LE(delay,60 + static_cast<int64_t>(params.reorder_delay_ms));
+		if(release[0] < last)
+			reordered = true;
+		last = release[0];
+		now += milliseconds(5);
+	}
+	ASSERT_TRUE(reordered);
+	ASSERT_GT(emulator.get_statistics().reordered,100u);
+}
+
+TEST(RTPNetworkEmulator,bandwidth){
+	//1Mbit/s，1000字节的包需要8ms，队列只能放5个包
+	RTPNetworkEmulator::Params params;
+	params.bandwidth = 1000000;
+	params.queue_bytes = 5000;
+	params.duplicate_rate = 1;
+	RTPNetworkEmulator emulator(params);
+	std::vector<TimePoint> release;
+	TimePoint now;
+	//复制的包也要排队
+	ASSERT_EQ(emulator.process(1000,now,release),2u);
+	ASSERT_EQ(duration_cast<milliseconds>(release[0] - now).count(),8);
+	ASSERT_EQ(duration_cast<milliseconds>(release[1] - now).count(),16);
+	ASSERT_EQ(emulator.process(1000,now,release),2u);
+	ASSERT_EQ(emulator.process(1000,now,release),1u);
+	ASSERT_EQ(duration_cast<milliseconds>(release[0] - now).count(),40);
+	ASSERT_EQ(emulator.get_statistics().queue_dropped,1u);
+
+	//队列清空之后又可以发送
+	now += milliseconds(40);
+	ASSERT_EQ(emulator.process(1000,now,release),2u);
+	ASSERT_EQ(duration_cast<milliseconds>(release[0] - now).count(),8);
+}
@@ -0,0 +1,54 @@
+
+#include "core/clock.h"
+#include "rtp_network/rtppacer.h"
+#include "clockguard.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试发送端的节拍器是否按照设置的速率发送
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::core;
+using namespace rtplivelib::rtp_network;
+
+/**
+ * 按照节拍器发送count个size字节的包，返回所用的模拟时间(毫秒)
+ */
+static int64_t send_packets(VirtualClock & clock,RTPPacer & pacer,int count,size_t size){
+	auto start = clock.now();
+	for(int n = 0;n < count; ++n){
+		while(!pacer.try_consume(size)){
+			clock.sleep_until(pacer.get_next_send_time(size));
+		}
+	}
+	return std::chrono::duration_cast<std::chrono::milliseconds>(clock.now() - start).count();
+}
+
+TEST(RTPPacer,rate){
+	ScopedVirtualClock clock;
+	clock.set_participants(1);
+	
+	//1Mbit/s,也就是每秒125000字节
+	RTPPacer pacer(1000000,1);
+	ASSERT_EQ(pacer.get_pacing_rate(),1000000u);
+	//一开始桶是满的，可以突发发送
+	ASSERT_TRUE(pacer.try_consume(1000));
+	ASSERT_TRUE(pacer.try_consume(1000));
+	ASSERT_FALSE(pacer.try_consume(1000));
+	
+	//100000字节大约需要800ms
+	auto ms = send_packets(clock,pacer,100,1000);
+	ASSERT_GE(ms,780);
+	ASSERT_LE(ms,820);
+	
+	//速率翻倍，时间减半
+	pacer.set_target_bitrate(2000000);
+	ms = send_packets(clock,pacer,100,1000);
+	ASSERT_GE(ms,390);
+	ASSERT_LE(ms,410);
+	
+	//比桶还大的包，等桶满了就可以发送，不会永远等待
+	ms = send_packets(clock,pacer,2,100000);
+	ASSERT_LE(ms,1000);
+}
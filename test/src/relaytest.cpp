@@ -0,0 +1,350 @@
+
+#include "rtp_network/rtprelay.h"
+#include "rtp_network/rtpsession.h"
+#include "rtp_network/fec/fecheader.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <cstring>
+#if defined (unix)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+/**
+ * 用于测试中继按照房间转发rtp和rtcp包
+ * 客户端直接使用udp socket，手动构造rtcp包(接收报告 + SDES或者BYE)
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::rtp_network;
+
+#if defined (unix)
+
+static constexpr uint16_t RELAY_PORT = 34600;
+
+class Client {
+public:
+	explicit Client(uint32_t ssrc):ssrc(ssrc){
+		fd = socket(AF_INET,SOCK_DGRAM,0);
+		sockaddr_in addr;
+		memset(&addr,0,sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(fd,reinterpret_cast<sockaddr*>(&addr),sizeof(addr));
+	}
+	~Client(){
+		close(fd);
+	}
+
+	void send(const std::vector<uint8_t> & data){
+		sockaddr_in addr;
+		memset(&addr,0,sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(RELAY_PORT);
+		sendto(fd,data.data(),data.size(),0,reinterpret_cast<sockaddr*>(&addr),sizeof(addr));
+	}
+
+	/**
+	 * 接收一个包，超时返回空
+	 */
+	std::vector<uint8_t> recv(int timeout_ms = 500){
+		pollfd pfd{fd,POLLIN,0};
+		if(poll(&pfd,1,timeout_ms) <= 0)
+			return {};
+		std::vector<uint8_t> data(2048);
+		auto len = ::recv(fd,data.data(),data.size(),0);
+		data.resize(len > 0 ? static_cast<size_t>(len) : 0);
+		return data;
+	}
+
+	/**
+	 * 空的接收报告 + SDES(NAME和NOTE，联播的其他层还有TOOL)
+	 */
+	std::vector<uint8_t> make_sdes(const std::string & name,const std::string & note,
+								   const std::string & tool = std::string()){
+		auto data = make_rr();
+		std::vector<uint8_t> chunk;
+		put32(chunk,ssrc);
+		for(auto item : {std::make_pair(2,name),std::make_pair(7,note),std::make_pair(6,tool)}){
+			if(item.second.empty())
+				continue;
+			chunk.push_back(static_cast<uint8_t>(item.first));
+			chunk.push_back(static_cast<uint8_t>(item.second.size()));
+			chunk.insert(chunk.end(),item.second.begin(),item.second.end());
+		}
+		//结束标志，然后对齐到4字节
+		do{
+			chunk.push_back(0);
+		}while(chunk.size() % 4 != 0);
+		put_header(data,1,202,chunk.size());
+		data.insert(data.end(),chunk.begin(),chunk.end());
+		return data;
+	}
+
+	std::vector<uint8_t> make_bye(){
+		auto data = make_rr();
+		put_header(data,1,203,4);
+		put32(data,ssrc);
+		return data;
+	}
+
+	/**
+	 * 空的接收报告 + 选择联播层的APP包
+	 */
+	std::vector<uint8_t> make_layer_selection(const RTPSession::LayerSelection & selection){
+		auto data = make_rr();
+		std::vector<uint8_t> app;
+		RTPSession::Pack_Layer_Selection(selection,app);
+		put_header(data,RTPSession::APPPacketType::RTP_APP_TYPE_LAYER,204,8 + app.size());
+		put32(data,ssrc);
+		data.insert(data.end(),RTPSession::LAYER_APP_NAME,RTPSession::LAYER_APP_NAME + 4);
+		data.insert(data.end(),app.begin(),app.end());
+		return data;
+	}
+
+	std::vector<uint8_t> make_rtp(uint16_t seq){
+		std::vector<uint8_t> data{0x80,96};
+		data.push_back(static_cast<uint8_t>(seq >> 8));
+		data.push_back(static_cast<uint8_t>(seq));
+		put32(data,seq * 3000u);
+		put32(data,ssrc);
+		data.insert(data.end(),100,static_cast<uint8_t>(seq));
+		return data;
+	}
+
+	/**
+	 * 按照发送端NAL模式的格式构造H.264关键帧(IDR)的一个包
+	 */
+	std::vector<uint8_t> make_key_rtp(uint16_t seq,uint16_t pos,uint16_t src_nb){
+		fec::FECParam param;
+		param.nal = 1;
+		param.symbol_size = 1000;
+		param.size = src_nb * 1000;
+		std::vector<uint8_t> data{0x80,RTPSession::PayloadType::RTP_PT_H264};
+		data.push_back(static_cast<uint8_t>(seq >> 8));
+		data.push_back(static_cast<uint8_t>(seq));
+		put32(data,3000u);
+		put32(data,ssrc);
+		uint8_t header[fec::FECHeader::MAX_SIZE];
+		auto n = fec::FECHeader::Pack(param,pos,100,header);
+		data.insert(data.end(),header,header + n);
+		data.push_back(0x65);
+		data.insert(data.end(),99,static_cast<uint8_t>(seq));
+		return data;
+	}
+
+	int fd;
+	uint32_t ssrc;
+private:
+	std::vector<uint8_t> make_rr(){
+		std::vector<uint8_t> data;
+		put_header(data,0,201,4);
+		put32(data,ssrc);
+		return data;
+	}
+	static void put_header(std::vector<uint8_t> & data,int count,int type,size_t body){
+		data.push_back(static_cast<uint8_t>(0x80 | count));
+		data.push_back(static_cast<uint8_t>(type));
+		auto words = body / 4;
+		data.push_back(static_cast<uint8_t>(words >> 8));
+		data.push_back(static_cast<uint8_t>(words));
+	}
+	static void put32(std::vector<uint8_t> & data,uint32_t value){
+		for(int shift = 24; shift >= 0; shift -= 8)
+			data.push_back(static_cast<uint8_t>(value >> shift));
+	}
+};
+
+/**
+ * 等待中继的成员数达到count
+ */
+static bool wait_members(RTPRelay & relay,uint64_t count){
+	for(int n = 0; n < 100; ++n){
+		if(relay.get_statistics().members == count)
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return false;
+}
+
+TEST(RTPRelay,note){
+	std::string room;
+	bool push{false};
+	ASSERT_TRUE(RTPSession::Parse_Room_Note("room1",5,room,push));
+	ASSERT_EQ(room,"room");
+	ASSERT_TRUE(push);
+	ASSERT_TRUE(RTPSession::Parse_Room_Note("0",1,room,push));
+	ASSERT_TRUE(room.empty());
+	ASSERT_FALSE(push);
+	ASSERT_FALSE(RTPSession::Parse_Room_Note("room",4,room,push));
+	ASSERT_FALSE(RTPSession::Parse_Room_Note(nullptr,0,room,push));
+}
+
+TEST(RTPRelay,forward){
+	RTPRelay relay;
+	ASSERT_TRUE(relay.start(RELAY_PORT));
+	Client a(0x1111),b(0x2222),c(0x3333);
+
+	//a推流，b只拉流，c在另外一个房间
+	a.send(a.make_sdes("a","room1"));
+	ASSERT_TRUE(wait_members(relay,1));
+	auto sdes = b.make_sdes("b","room0");
+	b.send(sdes);
+	c.send(c.make_sdes("c","other1"));
+	ASSERT_TRUE(wait_members(relay,3));
+	//b的rtcp包原样转发给a
+	ASSERT_EQ(a.recv(),sdes);
+
+	//a的rtp包只转发给同一个房间的b
+	auto rtp = a.make_rtp(1);
+	a.send(rtp);
+	ASSERT_EQ(b.recv(),rtp);
+	ASSERT_TRUE(c.recv(100).empty());
+
+	//没有推流的用户的rtp包不转发
+	b.send(b.make_rtp(2));
+	ASSERT_TRUE(a.recv(100).empty());
+	ASSERT_GE(relay.get_statistics().ignored,1u);
+
+	auto members = relay.get_room_members("room");
+	ASSERT_EQ(members.size(),2u);
+
+	//BYE转发给房间里的其他成员之后移除
+	auto bye = a.make_bye();
+	a.send(bye);
+	ASSERT_EQ(b.recv(),bye);
+	ASSERT_TRUE(wait_members(relay,2));
+	members = relay.get_room_members("room");
+	ASSERT_EQ(members.size(),1u);
+	ASSERT_EQ(members.front(),"b");
+
+	relay.stop();
+	ASSERT_FALSE(relay.is_running());
+}
+
+TEST(RTPRelay,replay){
+	RTPRelay relay;
+	ASSERT_TRUE(relay.start(RELAY_PORT));
+	Client a(0x1111),b(0x2222);
+
+	//a推流的时候房间里没有其他人
+	auto sdes = a.make_sdes("a","room1");
+	a.send(sdes);
+	ASSERT_TRUE(wait_members(relay,1));
+	std::vector<std::vector<uint8_t>> frame;
+	for(uint16_t pos = 0; pos < 3; ++pos){
+		frame.push_back(a.make_key_rtp(pos,pos,3));
+		a.send(frame.back());
+	}
+
+	//b加入之后先收到a的SDES，然后是缓存的关键帧
+	b.send(b.make_sdes("b","room0"));
+	ASSERT_EQ(b.recv(),sdes);
+	for(auto & packet : frame)
+		ASSERT_EQ(b.recv(),packet);
+	ASSERT_EQ(relay.get_statistics().replayed,4u);
+
+	relay.stop();
+}
+
+TEST(RTPRelay,bundle){
+	RTPRelay relay;
+	ASSERT_TRUE(relay.start(RELAY_PORT));
+	//a的音频和视频共用一个socket，两个ssrc都发送SDES
+	Client a(0x1111),b(0x2222);
+	auto video_sdes = a.make_sdes("a","room1");
+	a.send(video_sdes);
+	ASSERT_TRUE(wait_members(relay,1));
+	a.ssrc = 0x1112;
+	auto audio_sdes = a.make_sdes("a","room1");
+	a.send(audio_sdes);
+	a.ssrc = 0x1111;
+	std::vector<std::vector<uint8_t>> frame;
+	for(uint16_t pos = 0; pos < 2; ++pos){
+		frame.push_back(a.make_key_rtp(pos,pos,2));
+		a.send(frame.back());
+	}
+
+	//b加入之后收到a的两个SDES(顺序不确定)，然后是缓存的关键帧
+	b.send(b.make_sdes("b","room0"));
+	std::vector<std::vector<uint8_t>> sdes{b.recv(),b.recv()};
+	ASSERT_TRUE(sdes[0] == video_sdes || sdes[1] == video_sdes);
+	ASSERT_TRUE(sdes[0] == audio_sdes || sdes[1] == audio_sdes);
+	for(auto & packet : frame)
+		ASSERT_EQ(b.recv(),packet);
+	ASSERT_EQ(relay.get_statistics().replayed,4u);
+
+	//音频的BYE不会移除a，两个ssrc都离开之后才移除
+	a.ssrc = 0x1112;
+	auto bye = a.make_bye();
+	a.send(bye);
+	ASSERT_EQ(b.recv(),bye);
+	ASSERT_EQ(relay.get_statistics().members,2u);
+	ASSERT_EQ(relay.get_room_members("room").size(),2u);
+	a.ssrc = 0x1111;
+	a.send(a.make_bye());
+	ASSERT_TRUE(wait_members(relay,1));
+
+	relay.stop();
+}
+
+TEST(RTPRelay,layer_selection){
+	RTPSession::LayerSelection selection{{"a",2},{"bb",0}},result;
+	std::vector<uint8_t> data;
+	RTPSession::Pack_Layer_Selection(selection,data);
+	ASSERT_EQ(data.size() % 4,0u);
+	ASSERT_TRUE(RTPSession::Unpack_Layer_Selection(data.data(),data.size(),result));
+	ASSERT_EQ(result,selection);
+	ASSERT_FALSE(RTPSession::Unpack_Layer_Selection(data.data(),data.size() - 1,result));
+}
+
+TEST(RTPRelay,simulcast){
+	RTPRelay relay;
+	ASSERT_TRUE(relay.start(RELAY_PORT));
+	//a的第0层和第1层是两个会话，b拉流
+	Client a(0x1111),a1(0x1112),b(0x2222);
+
+	a.send(a.make_sdes("a","room1"));
+	auto sdes = a1.make_sdes("a","room1","rtplivelib-simulcast:1");
+	a1.send(sdes);
+	ASSERT_TRUE(wait_members(relay,2));
+	std::vector<std::vector<uint8_t>> frame;
+	for(uint16_t pos = 0; pos < 2; ++pos){
+		frame.push_back(a1.make_key_rtp(pos,pos,2));
+		a1.send(frame.back());
+	}
+	b.send(b.make_sdes("b","room0"));
+	ASSERT_TRUE(wait_members(relay,3));
+
+	//没有选择的时候只转发第0层
+	auto rtp = a.make_rtp(1);
+	a.send(rtp);
+	a1.send(a1.make_rtp(10));
+	ASSERT_EQ(b.recv(),rtp);
+	ASSERT_TRUE(b.recv(100).empty());
+
+	//选择第1层之后立即收到第1层的SDES和关键帧缓存，之后只转发第1层
+	b.send(b.make_layer_selection({{"a",1}}));
+	ASSERT_EQ(b.recv(),sdes);
+	for(auto & packet : frame)
+		ASSERT_EQ(b.recv(),packet);
+	a.send(a.make_rtp(2));
+	rtp = a1.make_rtp(11);
+	a1.send(rtp);
+	ASSERT_EQ(b.recv(),rtp);
+	ASSERT_TRUE(b.recv(100).empty());
+
+	//选择的层不存在则转发第0层
+	b.send(b.make_layer_selection({{"a",2}}));
+	rtp = a.make_rtp(3);
+	a.send(rtp);
+	ASSERT_EQ(b.recv(),rtp);
+
+	relay.stop();
+}
+
+#endif
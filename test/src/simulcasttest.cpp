@@ -0,0 +1,56 @@
+
+#include "codec/simulcastencoder.h"
+#include <gtest/gtest.h>
+
+/**
+ * 用于测试联播各层的分辨率和码率分配
+ */
+
+using namespace rtplivelib;
+using namespace rtplivelib::codec;
+
+TEST(SimulcastEncoder,layer_format){
+	core::Format format;
+	format.width = 1280;
+	format.height = 720;
+	format.frame_rate = 30;
+
+	auto output = SimulcastEncoder::Get_Layer_Format(format,0);
+	ASSERT_EQ(output.width,1280);
+	ASSERT_EQ(output.height,720);
+	output = SimulcastEncoder::Get_Layer_Format(format,1);
+	ASSERT_EQ(output.width,640);
+	ASSERT_EQ(output.height,360);
+	ASSERT_EQ(output.frame_rate,30);
+	output = SimulcastEncoder::Get_Layer_Format(format,2);
+	ASSERT_EQ(output.width,320);
+	ASSERT_EQ(output.height,180);
+
+	//长宽取偶数
+	format.width = 644;
+	format.height = 364;
+	output = SimulcastEncoder::Get_Layer_Format(format,2);
+	ASSERT_EQ(output.width,160);
+	ASSERT_EQ(output.height,90);
+
+	//分辨率太小的层不编码
+	format.width = 100;
+	format.height = 100;
+	output = SimulcastEncoder::Get_Layer_Format(format,2);
+	ASSERT_EQ(output.width,0);
+	ASSERT_EQ(output.height,0);
+}
+
+TEST(SimulcastEncoder,layer_bitrate){
+	//只有一层的时候全部分配给第0层
+	ASSERT_EQ(SimulcastEncoder::Get_Layer_Bitrate(1000000,0,1),1000000u);
+	ASSERT_EQ(SimulcastEncoder::Get_Layer_Bitrate(1000000,1,1),0u);
+
+	//三层按照9:3:1分配
+	ASSERT_EQ(SimulcastEncoder::Get_Layer_Bitrate(1300000,0,3),900000u);
+	ASSERT_EQ(SimulcastEncoder::Get_Layer_Bitrate(1300000,1,3),300000u);
+	ASSERT_EQ(SimulcastEncoder::Get_Layer_Bitrate(1300000,2,3),100000u);
+
+	//0表示自动选择
+	ASSERT_EQ(SimulcastEncoder::Get_Layer_Bitrate(0,1,2),0u);
+}
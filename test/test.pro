@@ -5,7 +5,23 @@ CONFIG -= qt
 
 SOURCES += \
         src/feccodectest.cpp \
+    src/bundletest.cpp \
+    src/clocktest.cpp \
+    src/congestiontest.cpp \
+    src/fecdecodertest.cpp \
+    src/fecheadertest.cpp \
+    src/jitterbuffertest.cpp \
+    src/keyframecachetest.cpp \
+    src/keyframerequestertest.cpp \
+    src/mediaclocktest.cpp \
+    src/memorypooltest.cpp \
+    src/nalpacketizertest.cpp \
+    src/nacktest.cpp \
+    src/networkemulatortest.cpp \
+    src/pacertest.cpp \
     src/queuetest.cpp \
+    src/relaytest.cpp \
+    src/simulcasttest.cpp \
     src/testmain.cpp \
     src/wirehairtest.cpp
 
@@ -23,5 +39,6 @@ INCLUDEPATH += $$PWD/../src
 DEPENDPATH += $$PWD/../src
 
 HEADERS += \
+    src/clockguard.h \
     src/fectest.h
 